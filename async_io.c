@@ -0,0 +1,449 @@
+// needed for the raw io_uring syscalls
+#define _GNU_SOURCE
+
+#include "async_io.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+
+#if defined(__linux__) && defined(__NR_io_uring_setup) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#define AIO_HAVE_URING 1
+#endif
+
+/* Additional Definitions */
+
+// worker threads used when io_uring is not available
+#define AIO_NUM_WORKERS 4
+
+typedef struct AIO_Request {
+    int fd;
+    struct iovec iov;
+    off_t offset;
+    bool write;
+    void *tag;
+    // links the request into the free list or the worker queue
+    int next;
+} AIO_Request;
+
+struct AIO_Engine {
+    pthread_mutex_t lock;
+    // signalled whenever a request finishes
+    pthread_cond_t finished;
+    // a fixed number of request slots, the unused ones form a free list
+    int depth;
+    AIO_Request *requests;
+    int freeList;
+    int inFlight;
+    // finished requests that aioPoll has not handed out yet
+    AIO_Completion *done;
+    int numDone;
+    int doneCapacity;
+    bool useUring;
+#ifdef AIO_HAVE_URING
+    // the rings shared with the kernel
+    int ringFd;
+    void *sqRing;
+    void *cqRing;
+    size_t sqRingSize;
+    size_t cqRingSize;
+    struct io_uring_sqe *sqes;
+    size_t sqesSize;
+    unsigned *sqHead;
+    unsigned *sqTail;
+    unsigned *sqMask;
+    unsigned *sqArray;
+    unsigned *cqHead;
+    unsigned *cqTail;
+    unsigned *cqMask;
+    struct io_uring_cqe *cqes;
+#endif
+    // thread pool fallback: requests are queued from queueHead to queueTail
+    pthread_t workers[AIO_NUM_WORKERS];
+    int numWorkers;
+    pthread_cond_t queued;
+    int queueHead;
+    int queueTail;
+    bool stopping;
+};
+
+/* Helpers */
+
+// helper to record a finished request and give its slot back
+// returns 0 for success and 1 if the completion could not be stored (it is lost)
+// NOTE the caller holds the engine lock
+int _finishRequest(AIO_Engine *engine, int index, long result)
+{
+    int status = 0;
+    if (engine->numDone == engine->doneCapacity) {
+        int capacity = engine->doneCapacity * 2;
+        AIO_Completion *done = realloc(engine->done, sizeof(AIO_Completion) * capacity);
+        if (done != NULL) {
+            engine->done = done;
+            engine->doneCapacity = capacity;
+        }
+    }
+
+    if (engine->numDone < engine->doneCapacity) {
+        engine->done[engine->numDone].tag = engine->requests[index].tag;
+        engine->done[engine->numDone].result = result;
+        engine->numDone++;
+    } else {
+        status = 1;
+    }
+
+    // the slot is free again either way
+    engine->requests[index].next = engine->freeList;
+    engine->freeList = index;
+    engine->inFlight--;
+    pthread_cond_broadcast(&(engine->finished));
+    return status;
+}
+
+// helper to move a request's whole buffer, retrying on EINTR and short transfers
+long _doRequest(AIO_Request *request)
+{
+    size_t done = 0;
+    while (done < request->iov.iov_len) {
+        char *buffer = (char *)request->iov.iov_base + done;
+        size_t left = request->iov.iov_len - done;
+        ssize_t n = request->write ? pwrite(request->fd, buffer, left, request->offset + done)
+                                   : pread(request->fd, buffer, left, request->offset + done);
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            return -errno;
+        }
+        if (n == 0) break;  // end of file
+        done += n;
+    }
+    return (long)done;
+}
+
+#ifdef AIO_HAVE_URING
+
+// helper to create the ring, returns false if the kernel does not allow io_uring
+bool _setupUring(AIO_Engine *engine)
+{
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+
+    int fd = (int)syscall(__NR_io_uring_setup, engine->depth, &params);
+    if (fd < 0) return false;
+
+    engine->sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    engine->cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        // both rings live in one mapping
+        if (engine->cqRingSize > engine->sqRingSize) engine->sqRingSize = engine->cqRingSize;
+        engine->cqRingSize = engine->sqRingSize;
+    }
+
+    engine->sqRing = mmap(NULL, engine->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (engine->sqRing == MAP_FAILED) {
+        close(fd);
+        return false;
+    }
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        engine->cqRing = engine->sqRing;
+    } else {
+        engine->cqRing = mmap(NULL, engine->cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (engine->cqRing == MAP_FAILED) {
+            munmap(engine->sqRing, engine->sqRingSize);
+            close(fd);
+            return false;
+        }
+    }
+
+    engine->sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    engine->sqes = mmap(NULL, engine->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (engine->sqes == MAP_FAILED) {
+        if (engine->cqRing != engine->sqRing) munmap(engine->cqRing, engine->cqRingSize);
+        munmap(engine->sqRing, engine->sqRingSize);
+        close(fd);
+        return false;
+    }
+
+    char *sq = (char *)engine->sqRing;
+    char *cq = (char *)engine->cqRing;
+    engine->sqHead = (unsigned *)(sq + params.sq_off.head);
+    engine->sqTail = (unsigned *)(sq + params.sq_off.tail);
+    engine->sqMask = (unsigned *)(sq + params.sq_off.ring_mask);
+    engine->sqArray = (unsigned *)(sq + params.sq_off.array);
+    engine->cqHead = (unsigned *)(cq + params.cq_off.head);
+    engine->cqTail = (unsigned *)(cq + params.cq_off.tail);
+    engine->cqMask = (unsigned *)(cq + params.cq_off.ring_mask);
+    engine->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+    engine->ringFd = fd;
+    return true;
+}
+
+// helper to place a request on the submission ring and hand it to the kernel
+// returns 0 once the kernel took the request (its completion will come) or a negative
+// errno; a request the kernel did not take is taken off the ring again, so that a
+// later submit never hands the kernel a request its caller already gave up on
+// NOTE the caller holds the engine lock (there is only ever one producer)
+int _submitUring(AIO_Engine *engine, int index)
+{
+    AIO_Request *request = &(engine->requests[index]);
+    unsigned tail = *(engine->sqTail);
+    unsigned slot = tail & *(engine->sqMask);
+    struct io_uring_sqe *sqe = &(engine->sqes[slot]);
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = request->write ? IORING_OP_WRITEV : IORING_OP_READV;
+    sqe->fd = request->fd;
+    sqe->addr = (unsigned long)&(request->iov);
+    sqe->len = 1;
+    sqe->off = request->offset;
+    sqe->user_data = (unsigned long)index;
+    engine->sqArray[slot] = slot;
+    __atomic_store_n(engine->sqTail, tail + 1, __ATOMIC_RELEASE);
+
+    // the ring never holds anything else, every earlier request was taken or withdrawn
+    int result;
+    do {
+        result = (int)syscall(__NR_io_uring_enter, engine->ringFd, 1, 0, 0, NULL, 0);
+    } while (result < 0 && errno == EINTR);
+    int error = (result < 0) ? errno : EAGAIN;
+
+    // without SQPOLL the kernel only reads the ring inside io_uring_enter, so the
+    // head tells for sure whether it took the request (a failed one still completes)
+    if (__atomic_load_n(engine->sqHead, __ATOMIC_ACQUIRE) != tail) {
+        return 0;
+    }
+    __atomic_store_n(engine->sqTail, tail, __ATOMIC_RELEASE);
+    return -error;
+}
+
+// helper to move every completion the kernel posted into the done list
+// NOTE the caller holds the engine lock
+void _reapUring(AIO_Engine *engine)
+{
+    unsigned head = *(engine->cqHead);
+    unsigned tail = __atomic_load_n(engine->cqTail, __ATOMIC_ACQUIRE);
+
+    while (head != tail) {
+        struct io_uring_cqe *cqe = &(engine->cqes[head & *(engine->cqMask)]);
+        _finishRequest(engine, (int)cqe->user_data, (long)cqe->res);
+        head++;
+    }
+    __atomic_store_n(engine->cqHead, head, __ATOMIC_RELEASE);
+}
+
+#endif
+
+// worker loop of the thread pool fallback
+void *_aioWorker(void *arg)
+{
+    AIO_Engine *engine = (AIO_Engine *)arg;
+
+    pthread_mutex_lock(&(engine->lock));
+    while (true) {
+        while (engine->queueHead == -1 && !engine->stopping) {
+            pthread_cond_wait(&(engine->queued), &(engine->lock));
+        }
+        if (engine->queueHead == -1) break;  // stopping and nothing left to do
+
+        int index = engine->queueHead;
+        engine->queueHead = engine->requests[index].next;
+        if (engine->queueHead == -1) engine->queueTail = -1;
+
+        pthread_mutex_unlock(&(engine->lock));
+        long result = _doRequest(&(engine->requests[index]));
+        pthread_mutex_lock(&(engine->lock));
+
+        _finishRequest(engine, index, result);
+    }
+    pthread_mutex_unlock(&(engine->lock));
+    return NULL;
+}
+
+// helper to block until at least one more request finished
+// NOTE the caller holds the engine lock and has requests in flight
+void _waitForCompletion(AIO_Engine *engine)
+{
+#ifdef AIO_HAVE_URING
+    if (engine->useUring) {
+        int before = engine->numDone;
+        _reapUring(engine);
+        if (engine->numDone > before) return;
+
+        pthread_mutex_unlock(&(engine->lock));
+        syscall(__NR_io_uring_enter, engine->ringFd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+        pthread_mutex_lock(&(engine->lock));
+        _reapUring(engine);
+        return;
+    }
+#endif
+    pthread_cond_wait(&(engine->finished), &(engine->lock));
+}
+
+/* Interface */
+
+// create an engine with room for `depth` requests in flight
+// returns NULL if it could not be set up
+AIO_Engine *aioCreate(int depth)
+{
+    AIO_Engine *engine = (AIO_Engine *)calloc(1, sizeof(AIO_Engine));
+    if (engine == NULL) return NULL;
+
+    engine->depth = depth;
+    engine->requests = (AIO_Request *)malloc(sizeof(AIO_Request) * depth);
+    engine->doneCapacity = depth;
+    engine->done = (AIO_Completion *)malloc(sizeof(AIO_Completion) * depth);
+    if (engine->requests == NULL || engine->done == NULL) {
+        free(engine->requests);
+        free(engine->done);
+        free(engine);
+        return NULL;
+    }
+
+    // chain all slots into the free list
+    for (int i = 0; i < depth; i++) {
+        engine->requests[i].next = (i + 1 < depth) ? i + 1 : -1;
+    }
+    engine->freeList = 0;
+    engine->queueHead = engine->queueTail = -1;
+    pthread_mutex_init(&(engine->lock), NULL);
+    pthread_cond_init(&(engine->finished), NULL);
+    pthread_cond_init(&(engine->queued), NULL);
+
+#ifdef AIO_HAVE_URING
+    engine->useUring = _setupUring(engine);
+#endif
+
+    if (!engine->useUring) {
+        for (int i = 0; i < AIO_NUM_WORKERS; i++) {
+            if (pthread_create(&(engine->workers[i]), NULL, _aioWorker, engine) != 0) break;
+            engine->numWorkers++;
+        }
+        if (engine->numWorkers == 0) {
+            aioDestroy(engine);
+            return NULL;
+        }
+    }
+    return engine;
+}
+
+// queue one transfer; blocks only if all `depth` slots are in flight
+// returns 0 on success or a negative errno
+int aioSubmit(AIO_Engine *engine, int fd, void *buffer, size_t length, off_t offset, bool write, void *tag)
+{
+    pthread_mutex_lock(&(engine->lock));
+    while (engine->freeList == -1) {
+        _waitForCompletion(engine);
+    }
+
+    int index = engine->freeList;
+    AIO_Request *request = &(engine->requests[index]);
+    engine->freeList = request->next;
+    request->fd = fd;
+    request->iov.iov_base = buffer;
+    request->iov.iov_len = length;
+    request->offset = offset;
+    request->write = write;
+    request->tag = tag;
+    request->next = -1;
+    engine->inFlight++;
+
+    int result = 0;
+#ifdef AIO_HAVE_URING
+    if (engine->useUring) {
+        result = _submitUring(engine, index);
+        if (result != 0) {
+            // the kernel never saw the request, its slot is free again
+            request->next = engine->freeList;
+            engine->freeList = index;
+            engine->inFlight--;
+            pthread_cond_broadcast(&(engine->finished));
+        }
+        pthread_mutex_unlock(&(engine->lock));
+        return result;
+    }
+#endif
+
+    // append to the worker queue
+    if (engine->queueTail == -1) engine->queueHead = index;
+    else engine->requests[engine->queueTail].next = index;
+    engine->queueTail = index;
+    pthread_cond_signal(&(engine->queued));
+    pthread_mutex_unlock(&(engine->lock));
+    return result;
+}
+
+// hand out up to maxCompletions finished requests (oldest first), waiting until
+// at least minCompletions are available or nothing is left in flight
+// returns the number of completions written
+int aioPoll(AIO_Engine *engine, AIO_Completion *completions, int maxCompletions, int minCompletions)
+{
+    pthread_mutex_lock(&(engine->lock));
+#ifdef AIO_HAVE_URING
+    if (engine->useUring) _reapUring(engine);
+#endif
+    while (engine->numDone < minCompletions && engine->inFlight > 0) {
+        _waitForCompletion(engine);
+    }
+
+    int count = (engine->numDone < maxCompletions) ? engine->numDone : maxCompletions;
+    memcpy(completions, engine->done, sizeof(AIO_Completion) * count);
+    memmove(engine->done, engine->done + count, sizeof(AIO_Completion) * (engine->numDone - count));
+    engine->numDone -= count;
+    pthread_mutex_unlock(&(engine->lock));
+    return count;
+}
+
+// wait until every request submitted so far has finished
+// (their completions are kept for aioPoll)
+void aioDrain(AIO_Engine *engine)
+{
+    pthread_mutex_lock(&(engine->lock));
+    while (engine->inFlight > 0) {
+        _waitForCompletion(engine);
+    }
+    pthread_mutex_unlock(&(engine->lock));
+}
+
+// whether the engine runs on io_uring (false means the thread pool fallback)
+bool aioUsesUring(AIO_Engine *engine)
+{
+    return engine->useUring;
+}
+
+// wait for everything in flight, then free the engine
+// (completions that were never polled are dropped)
+void aioDestroy(AIO_Engine *engine)
+{
+    pthread_mutex_lock(&(engine->lock));
+    while (engine->inFlight > 0) {
+        _waitForCompletion(engine);
+    }
+    engine->stopping = true;
+    pthread_cond_broadcast(&(engine->queued));
+    pthread_mutex_unlock(&(engine->lock));
+
+    for (int i = 0; i < engine->numWorkers; i++) {
+        pthread_join(engine->workers[i], NULL);
+    }
+
+#ifdef AIO_HAVE_URING
+    if (engine->useUring) {
+        munmap(engine->sqes, engine->sqesSize);
+        if (engine->cqRing != engine->sqRing) munmap(engine->cqRing, engine->cqRingSize);
+        munmap(engine->sqRing, engine->sqRingSize);
+        close(engine->ringFd);
+    }
+#endif
+
+    pthread_cond_destroy(&(engine->queued));
+    pthread_cond_destroy(&(engine->finished));
+    pthread_mutex_destroy(&(engine->lock));
+    free(engine->requests);
+    free(engine->done);
+    free(engine);
+}
@@ -0,0 +1,24 @@
+#ifndef ASYNC_IO_H
+#define ASYNC_IO_H
+
+#include <sys/types.h>
+#include "dt.h"
+
+// an asynchronous I/O engine: io_uring when the kernel allows it,
+// otherwise a small pool of threads doing pread / pwrite
+typedef struct AIO_Engine AIO_Engine;
+
+// a finished request: the tag given at submission and the bytes moved (or -errno)
+typedef struct AIO_Completion {
+    void *tag;
+    long result;
+} AIO_Completion;
+
+AIO_Engine *aioCreate(int depth);
+int aioSubmit(AIO_Engine *engine, int fd, void *buffer, size_t length, off_t offset, bool write, void *tag);
+int aioPoll(AIO_Engine *engine, AIO_Completion *completions, int maxCompletions, int minCompletions);
+void aioDrain(AIO_Engine *engine);
+bool aioUsesUring(AIO_Engine *engine);
+void aioDestroy(AIO_Engine *engine);
+
+#endif
@@ -2,14 +2,90 @@
 #include "storage_mgr.h"
 #include "hash_table.h"
 #include <stdlib.h>
-#include <limits.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
 
 /* Additional Definitions */
 
-#define PAGE_TABLE_SIZE 256
+// the page table is split into this many shards by page number, each with its own lock
+#define PAGE_TABLE_SHARDS 16
+
+// the direct page table maps a shard's page numbers (divided by PAGE_TABLE_SHARDS) through
+// a directory of chunks of this many frame indexes (a power of two), allocated when a
+// page of theirs is first mapped
+#define DIRECT_CHUNK_SHIFT 10
+#define DIRECT_CHUNK_PAGES (1 << DIRECT_CHUNK_SHIFT)
+
+// readahead window of pinPage, in pages (never more than a quarter of the pool)
+#define READAHEAD_MIN 2
+#define READAHEAD_MAX 32
+
+// LRU-K: K when stratData is NULL, the largest K accepted, and how many timestamps
+// apart two pins of a page count as one reference (e.g. a scan pinning a page once
+// per record), so only pins separated by other work make a page hot
+#define LRU_K_DEFAULT 2
+#define LRU_K_MAX 8
+#define LRU_K_CORRELATED 16
+
+// LFU: the largest use count a page gets, and how many pins per frame the pool sees
+// before every count is halved (so pages that were hot long ago can be evicted again)
+#define LFU_MAX_COUNT 255
+#define LFU_AGING_PINS 8
+
+// 2Q: the share of the frames A1in holds before it gives up its pages ahead of Am, and
+// how many evicted pages A1out remembers, in percent of the pool
+#define TWO_Q_IN_PERCENT 25
+#define TWO_Q_OUT_PERCENT 50
+
+// how many hits, unpins and dirty marks can wait in the access log for the pool lock
+// before the thread finding it full takes the lock to apply them
+#define ACCESS_LOG_SIZE 256
+
+// background cleaning: how often the cleaner looks at the pool at least, how many pages
+// it writes at a time, and the share of dirty frames it allows when the options leave it 0
+#define CLEANER_INTERVAL_MS 100
+#define CLEANER_BATCH 32
+#define CLEANER_DIRTY_PERCENT 50
 
 typedef unsigned int TimeStamp;
 
+// a doubly linked list of frames, linked through the frames' listPrev / listNext
+// (-1 ends the list), which the replacement strategies keep their frames in
+typedef struct BM_FrameList {
+    int head;
+    int tail;
+    int size;
+} BM_FrameList;
+
+// a page evicted recently, remembered by its number only (ARC and 2Q); ghosts are kept
+// in lists like frames, linked through prev / next
+typedef struct BM_GhostList {
+    int head;
+    int tail;
+    int size;
+} BM_GhostList;
+
+typedef struct BM_Ghost {
+    PageNumber pageNum;
+    BM_GhostList *list;
+    int prev;
+    int next;
+} BM_Ghost;
+
+// a part of the page table: a hash table, or with directPageTable a directory of
+// numDirectChunks chunks (NULL until used) holding the frame index of every page (-1
+// if it is in no frame); lock guards it and the fix counts, latches and dirty state of
+// its pages' frames, and latchFree is signalled when one of their latches is given up
+typedef struct BM_PageTableShard {
+    pthread_mutex_t lock;
+    pthread_cond_t latchFree;
+    HT_TableHandle table;
+    int **directChunks;
+    int numDirectChunks;
+} BM_PageTableShard;
+
 typedef struct BM_PageFrame {
     // the frame's buffer
     char* data;
@@ -17,23 +93,161 @@ typedef struct BM_PageFrame {
     PageNumber pageNum;
     // management data on the page frame
     int frameIndex;
+    // changed under the lock of the page's shard; the strategies read it under the pool
+    // lock alone, so a victim is checked again before it is evicted (getAfterEviction)
     int fixCount;
+    // changed under the lock of the page's shard while the page is in the frame;
+    // dirtyGeneration advances with every markDirtyLSN, so a write that ran alongside a
+    // change leaves the frame dirty (see cleanFrame)
     bool dirty;
+    uint64_t dirtyGeneration;
     bool occupied;
+    // the page is being read (the frame cannot be used until that read completed)
+    bool loading;
+    // the page was read ahead and has not been pinned since
+    bool prefetched;
+    // write-ahead logging: the last log record that changed the page, and the first
+    // one since it was last written (0 if none)
+    uint64_t pageLSN;
+    uint64_t recLSN;
     TimeStamp timeStamp;
+    // CLOCK: set when the page is pinned, cleared when the clock hand passes the frame
+    bool referenced;
+    // LRU-K: the page's last K references, most recent first (0 for none), and the
+    // frame's place in the victim heap (-1 while it cannot be evicted)
+    TimeStamp *history;
+    int heapIndex;
+    // LFU: the page's use count
+    int useCount;
+    // the strategy's list the frame is in (NULL if none) and its neighbours there
+    BM_FrameList *list;
+    int listPrev;
+    int listNext;
+    // the latch, held shared by latchShared pins of the page or exclusively by one (see
+    // pinPageWithIntent), writing while it is; it is kept under the shard's lock rather
+    // than in a pthread_rwlock_t, so a pin may be given up by another thread
+    int latchShared;
+    bool latchExclusive;
+    bool writing;
+    // optimistic reads: odd while the frame holds no page that can be read (it is empty,
+    // being read or being written), advanced whenever that changes (see frameChanging)
+    uint64_t version;
 } BM_PageFrame;
 
+// what a hit, an unpin or a dirty mark means for the replacement strategy, queued in
+// the access log until the pool lock is taken (NONE for a place taken by a miss)
+typedef enum BM_AccessKind {
+    BM_ACCESS_NONE,
+    BM_ACCESS_PIN,
+    BM_ACCESS_UNPIN,
+    BM_ACCESS_TOUCH
+} BM_AccessKind;
+
+// a place in the access log; ticket is one past the place's ticket once it is filled in
+typedef struct BM_Access {
+    uint64_t ticket;
+    BM_AccessKind kind;
+    int frameIndex;
+    PageNumber pageNum;
+} BM_Access;
+
 typedef struct BM_Metadata {
     // an array of frames
     BM_PageFrame *pageFrames;
-    // a page table that associates the a page ID with an index in pageFrames
-    HT_TableHandle pageTable;
+    int numFrames;
+    ReplacementStrategy strategy;
+    // one aligned allocation backing every frame's data plus one spare page
+    char *frameMemory;
+    // the spare page, swapped into an evicted frame while its old buffer is
+    // written back asynchronously (NULL while such a write is in flight)
+    char *spareData;
+    char *writeBackData;
+    // the first write-back that failed even when written again (its page is lost),
+    // reported by forceFlushPool, getCheckpointLSN and shutdownBufferPool from then on
+    RC writeBackResult;
+    // a page table that associates the a page ID with an index in pageFrames, in shards
+    BM_PageTableShard shards[PAGE_TABLE_SHARDS];
+    bool directPageTable;
+    // guards everything else; a page is only mapped or unmapped under it (and its shard's
+    // lock), so holding it keeps the page table as it is. Hits, unpins and dirty marks do
+    // not take it: they work under the shard's lock and queue what they mean for the
+    // strategy in accessLog (tickets accessHead to accessTail, see reserveAccess), which
+    // is applied in order whenever it is taken (see lockPool); loadDone is signalled when
+    // a page read by pinPage arrived
+    pthread_mutex_t poolLock;
+    BM_Access accessLog[ACCESS_LOG_SIZE];
+    uint64_t accessHead;
+    uint64_t accessTail;
+    pthread_cond_t loadDone;
+    // whether a thread is waiting for completions with the pool lock released (the
+    // others wait for reapDone, which is signalled once it collected them)
+    bool reaping;
+    pthread_cond_t reapDone;
     // the file handle
     SM_FileHandle pageFile;
     // increments everytime a page is accessed (used for frame's timeStamp)
     TimeStamp timeStamp;
     // used to treat *pageFrames as a queue
     int queueIndex;
+    // the frame the CLOCK hand looks at next
+    int clockHand;
+    // LRU-K (lruK is 0 for the other strategies): a min-heap of the evictable frames
+    // ordered by their K-th most recent reference, and the histories of the last
+    // numPages pages evicted (a ring, found by page number through evictedTable) so a
+    // page that comes back soon keeps its references
+    int lruK;
+    TimeStamp *historyMemory;
+    int *heap;
+    int heapSize;
+    HT_TableHandle evictedTable;
+    PageNumber *evictedPages;
+    TimeStamp *evictedHistory;
+    int evictedNext;
+    // LRU: the unpinned frames, least recently used first
+    BM_FrameList lruList;
+    // LFU: the evictable frames in one list per use count, least recently used first,
+    // the lowest count that may have a non-empty list, and the pins since the last aging
+    BM_FrameList lfuBuckets[LFU_MAX_COUNT + 1];
+    int lfuLowest;
+    int lfuPins;
+    // ARC and 2Q: the frames whose page was referenced once since it came in (ARC's T1,
+    // 2Q's A1in) and more often (T2, Am), the empty frames, and the pages last evicted
+    // from the first two lists (B1 or A1out, and B2); the ghosts live in one array
+    // (unused ones chained through next from freeGhost) and are found through ghostTable;
+    // arcTarget is the size ARC aims for T1 to have
+    BM_FrameList recentList;
+    BM_FrameList frequentList;
+    BM_FrameList freeList;
+    BM_GhostList recentGhosts;
+    BM_GhostList frequentGhosts;
+    BM_Ghost *ghosts;
+    int freeGhost;
+    HT_TableHandle ghostTable;
+    int arcTarget;
+    // sequential readahead: the last page pinned through a miss (or a read-ahead page),
+    // the window (0 while pins are not sequential), the next page to read ahead and
+    // how many read-ahead reads are in flight (no readahead once the file refused one)
+    PageNumber lastSequential;
+    int readaheadWindow;
+    PageNumber readaheadNext;
+    int numLoading;
+    bool readaheadOff;
+    // makes the log durable before a logged page is written (NULL without a log)
+    BM_FlushLog flushLog;
+    void *logData;
+    // background cleaning (cleanReserve is 0 without a cleaner): the options the cleaner
+    // thread runs with, whether it has to stop, whether it is writing pages (cleanerDone is
+    // signalled when it is done), when its throttle lets it write next (in nanoseconds,
+    // see getNanos) and cleanerWake, which wakes it early when a miss had to write
+    int cleanReserve;
+    int cleanDirtyPercent;
+    int cleanPagesPerSecond;
+    pthread_t cleaner;
+    bool cleanerStop;
+    bool cleaning;
+    uint64_t cleanerNextWrite;
+    pthread_cond_t cleanerWake;
+    pthread_cond_t cleanerDone;
     // statistics
     int numRead;
     int numWrite;
@@ -45,47 +259,334 @@ BM_PageFrame *replacementFIFO(BM_BufferPool *const bm);
 
 BM_PageFrame *replacementLRU(BM_BufferPool *const bm);
 
+BM_PageFrame *replacementCLOCK(BM_BufferPool *const bm);
+
+BM_PageFrame *replacementLRUK(BM_BufferPool *const bm);
+
+BM_PageFrame *replacementLFU(BM_BufferPool *const bm);
+
+BM_PageFrame *replacementARC(BM_BufferPool *const bm);
+
+BM_PageFrame *replacement2Q(BM_BufferPool *const bm);
+
 // use this helper to increment the pool's global timestamp and return it
 TimeStamp getTimeStamp(BM_Metadata *metadata);
 
+// use this helper to stamp a frame as just used (LRU moves it to the end of its list)
+void touchFrame(BM_Metadata *metadata, BM_PageFrame *pageFrame);
+
+// use these helpers to empty a frame list, to append a frame to one and to take a
+// frame out of the list it is in
+void initFrameList(BM_FrameList *list);
+void listAppend(BM_Metadata *metadata, BM_FrameList *list, BM_PageFrame *pageFrame);
+void listRemove(BM_Metadata *metadata, BM_PageFrame *pageFrame);
+
+// use this helper to find the first frame of a list that can be evicted (-1 if none)
+int firstEvictable(BM_Metadata *metadata, BM_FrameList *list);
+
+// use these helpers to remember an evicted page at the end of a ghost list (the oldest
+// ghost of the pool makes room if needed), to find a page's ghost (-1 if it has none)
+// and to forget one
+void ghostAppend(BM_Metadata *metadata, BM_GhostList *list, PageNumber pageNum);
+int ghostFind(BM_Metadata *metadata, PageNumber pageNum);
+void ghostRemove(BM_Metadata *metadata, int ghost);
+
 // use this help to evict the frame at frameIndex (write if occupied and dirty) and return the new empty frame
 BM_PageFrame *getAfterEviction(BM_BufferPool *const bm, int frameIndex);
 
+// use this helper to wait for the write-back started by getAfterEviction (if any); it
+// may release the pool lock meanwhile
+void finishWriteBack(BM_Metadata *metadata);
+
+// use this helper to collect at least minCompletions finished write-backs / read-aheads,
+// or to wait for the thread collecting them; the pool lock is released while waiting,
+// so callers check again for what they wait for
+void reapCompletions(BM_Metadata *metadata, int minCompletions);
+
+// use this helper to follow sequential pins and read the pages after them ahead
+void readAhead(BM_BufferPool *const bm, PageNumber pageNum);
+
+// use these helpers to find the shard of a page, the frame holding a page (0 if it is in
+// one, like getValue), to map a page to a frame (0 on success) and to forget where a page
+// is; mapping and unmapping need the pool lock and the shard's lock, looking up either
+BM_PageTableShard *shardFor(BM_Metadata *metadata, PageNumber pageNum);
+int lookupFrame(BM_Metadata *metadata, PageNumber pageNum, int *frameIndex);
+int mapPage(BM_Metadata *metadata, PageNumber pageNum, int frameIndex);
+void unmapPage(BM_Metadata *metadata, PageNumber pageNum);
+
+// use these helpers to advance a frame's version before its data changes (making it odd)
+// and after the change (making it even again), invalidating optimistic reads of it
+void frameChanging(BM_PageFrame *pageFrame);
+void frameChanged(BM_PageFrame *pageFrame);
+
+// use these helpers to queue what a hit, an unpin or a dirty mark means for the strategy
+// without the pool lock: reserveAccess takes a place in the access log (applying the log
+// first if it is full, so no shard lock may be held), publishAccess fills it in right
+// after; applyAccesses replays the log under the pool lock, lockPool takes the pool lock
+// and applies the log
+uint64_t reserveAccess(BM_Metadata *metadata);
+void publishAccess(BM_Metadata *metadata, uint64_t ticket, BM_AccessKind kind, int frameIndex, PageNumber pageNum);
+void applyAccesses(BM_Metadata *metadata);
+void lockPool(BM_Metadata *metadata);
+
+// use these helpers to take a frame's latch for a pin (waiting until it can be had) and to
+// give it up; both need the lock of the page's shard
+void latchFrame(BM_PageTableShard *shard, BM_PageFrame *pageFrame, BM_PinIntent intent);
+void unlatchFrame(BM_PageTableShard *shard, BM_PageFrame *pageFrame);
+
+// use this helper to mark a frame that was written clean, unless it was marked dirty again
+// since dirtyGeneration was read
+void cleanFrame(BM_Metadata *metadata, BM_PageFrame *pageFrame, uint64_t dirtyGeneration);
+
+// use this helper to read a page that is in no frame into one, which it returns fixed
+// (the pool lock is given up during the read)
+RC loadPage(BM_BufferPool *const bm, PageNumber pageNum, int *frameIndex);
+
+// the background cleaner's thread: it writes dirty unpinned frames back, least recently
+// used first, whenever cleanerBacklog finds work
+void *cleanerMain(void *data);
+
+// use this helper to count the pages the cleaner should write now (at most CLEANER_BATCH)
+// and whether clean frames are short enough to ignore the throttle
+int cleanerBacklog(BM_Metadata *metadata, bool *urgent);
+
+// use this helper to fix up to `wanted` of the least recently used dirty unpinned frames
+// for the cleaner (returned in frames), holding their latches shared
+int fixDirtyFrames(BM_Metadata *metadata, int *frames, int wanted);
+
+// use this helper to get the wall clock in nanoseconds (for pthread_cond_timedwait)
+uint64_t getNanos();
+
+// use this helper to pick the frame the pool's strategy would replace (-1 if none)
+int selectVictim(BM_BufferPool *const bm);
+
+// use this helper to make the log durable before writing a frame changed under it
+RC flushLogFor(BM_Metadata *metadata, uint64_t pageLSN);
+
+// use these helpers to keep the strategy's own state up to date (they do nothing for
+// strategies without one): a frame's fix count or loading state changed; its page was
+// pinned; its page is leaving it; a new page entered it
+void noteFrameState(BM_Metadata *metadata, BM_PageFrame *pageFrame);
+void noteReference(BM_Metadata *metadata, BM_PageFrame *pageFrame);
+void noteEviction(BM_Metadata *metadata, BM_PageFrame *pageFrame);
+void noteLoad(BM_Metadata *metadata, BM_PageFrame *pageFrame);
+
+// LRU-K: put a frame where it belongs in the victim heap after its fix count, loading
+// state or history changed; record a pin of its page; keep / restore a page's history
+// when it leaves / enters a frame
+void lruKReposition(BM_Metadata *metadata, BM_PageFrame *pageFrame);
+void lruKReference(BM_Metadata *metadata, BM_PageFrame *pageFrame);
+void lruKRemember(BM_Metadata *metadata, BM_PageFrame *pageFrame);
+void lruKRecall(BM_Metadata *metadata, BM_PageFrame *pageFrame);
+
+// LRU: keep a frame in the list exactly while it is unpinned
+void lruReposition(BM_Metadata *metadata, BM_PageFrame *pageFrame);
+
+// LFU: put a frame at the end of its use count's list if it can be evicted (taking it
+// out of any list first); count a pin of its page; halve every use count
+void lfuReposition(BM_Metadata *metadata, BM_PageFrame *pageFrame);
+void lfuReference(BM_Metadata *metadata, BM_PageFrame *pageFrame);
+void lfuAge(BM_Metadata *metadata);
+
+// ARC and 2Q: move an empty frame to the free list; put a new page's frame in its list
+// on its first reference (a read-ahead page waits in the recent list until it is pinned)
+// and move it on later ones; turn the page leaving a frame into a ghost
+void adaptiveFree(BM_Metadata *metadata, BM_PageFrame *pageFrame);
+void arcReference(BM_Metadata *metadata, BM_PageFrame *pageFrame);
+void twoQReference(BM_Metadata *metadata, BM_PageFrame *pageFrame);
+void adaptiveEvict(BM_Metadata *metadata, BM_PageFrame *pageFrame);
+
 /* Buffer Manager Interface Pool Handling */
 
 RC initBufferPool(BM_BufferPool *const bm, const char *const pageFileName, 
 		const int numPages, ReplacementStrategy strategy,
 		void *stratData)
 {
+    return initBufferPoolWithOptions(bm, pageFileName, numPages, strategy, stratData, NULL);
+}
+
+// initBufferPool with options (NULL for the defaults)
+RC initBufferPoolWithOptions(BM_BufferPool *const bm, const char *const pageFileName,
+		const int numPages, ReplacementStrategy strategy,
+		void *stratData, const BM_PoolOptions *options)
+{
+    BM_PoolOptions defaults = { 0 };
+    if (options == NULL) options = &defaults;
+
+    // LRU-K takes K from stratData (an int)
+    int lruK = 0;
+    if (strategy == RS_LRU_K)
+    {
+        lruK = (stratData != NULL) ? *(int *)stratData : LRU_K_DEFAULT;
+        if (lruK < 1 || lruK > LRU_K_MAX) return RC_IM_CONFIG_ERROR;
+    }
+
+    if (options->cleanReserve < 0 || options->cleanReserve > numPages || options->cleanDirtyPercent < 0
+        || options->cleanDirtyPercent > 100 || options->cleanPagesPerSecond < 0)
+    {
+        return RC_IM_CONFIG_ERROR;
+    }
+
     // initialize the metadata
     BM_Metadata *metadata = (BM_Metadata *)malloc(sizeof(BM_Metadata));
-    HT_TableHandle *pageTabe = &(metadata->pageTable);
     metadata->timeStamp = 0;
+    metadata->directPageTable = options->directPageTable;
 
     // start the queue from the last element as it gets incremented by one and modded 
     // at the start of each call of replacementFIFO
-    metadata->queueIndex = bm->numPages - 1;
+    metadata->queueIndex = numPages - 1;
+    metadata->numFrames = numPages;
+    metadata->strategy = strategy;
+    metadata->clockHand = 0;
+    metadata->lruK = lruK;
+    metadata->historyMemory = NULL;
+    metadata->heap = NULL;
+    metadata->heapSize = 0;
+    metadata->evictedPages = NULL;
+    metadata->evictedHistory = NULL;
+    metadata->evictedNext = 0;
+    initFrameList(&(metadata->lruList));
+    for (int i = 0; i <= LFU_MAX_COUNT; i++) initFrameList(&(metadata->lfuBuckets[i]));
+    initFrameList(&(metadata->recentList));
+    initFrameList(&(metadata->frequentList));
+    initFrameList(&(metadata->freeList));
+    metadata->recentGhosts.head = metadata->recentGhosts.tail = -1;
+    metadata->recentGhosts.size = 0;
+    metadata->frequentGhosts = metadata->recentGhosts;
+    metadata->ghosts = NULL;
+    metadata->freeGhost = -1;
+    metadata->arcTarget = 0;
+    metadata->lfuLowest = 0;
+    metadata->lfuPins = 0;
+    metadata->lastSequential = NO_PAGE;
+    metadata->readaheadWindow = 0;
+    metadata->readaheadNext = 0;
+    metadata->numLoading = 0;
+    metadata->readaheadOff = false;
+    metadata->reaping = false;
+    metadata->flushLog = NULL;
+    metadata->logData = NULL;
+    metadata->cleanReserve = options->cleanReserve;
+    metadata->cleanDirtyPercent = (options->cleanDirtyPercent > 0) ? options->cleanDirtyPercent : CLEANER_DIRTY_PERCENT;
+    metadata->cleanPagesPerSecond = options->cleanPagesPerSecond;
+    metadata->cleanerStop = false;
+    metadata->cleaning = false;
+    metadata->cleanerNextWrite = 0;
     metadata->numRead = 0;
     metadata->numWrite = 0;
+    memset(metadata->accessLog, 0, sizeof(metadata->accessLog));
+    metadata->accessHead = metadata->accessTail = 0;
     RC result = openPageFile((char *)pageFileName, &(metadata->pageFile));
+    int pageSize;
 
     switch (result) {
         case RC_OK:
-            initHashTable(pageTabe, PAGE_TABLE_SIZE);
+            // allocate all frames at once, aligned for the file (O_DIRECT needs this)
+            // and as large as the file's pages
+            pageSize = getPageSize(&(metadata->pageFile));
+            if (posix_memalign((void **)&(metadata->frameMemory), getPageFileAlignment(&(metadata->pageFile)), (size_t)pageSize * (numPages + 1)) != 0)
+            {
+                closePageFile(&(metadata->pageFile));
+                free(metadata);
+                bm->mgmtData = NULL;
+                return RC_ALLOCATION_FAILED;
+            }
+
+            metadata->spareData = metadata->frameMemory + (size_t)pageSize * numPages;
+            metadata->writeBackData = NULL;
+            metadata->writeBackResult = RC_OK;
+
+            // LRU-K's histories, heap and evicted pages
+            if (lruK > 0)
+            {
+                metadata->historyMemory = (TimeStamp *)calloc((size_t)numPages * lruK, sizeof(TimeStamp));
+                metadata->heap = (int *)malloc(sizeof(int) * numPages);
+                metadata->evictedPages = (PageNumber *)malloc(sizeof(PageNumber) * numPages);
+                metadata->evictedHistory = (TimeStamp *)calloc((size_t)numPages * lruK, sizeof(TimeStamp));
+                if (metadata->historyMemory == NULL || metadata->heap == NULL
+                    || metadata->evictedPages == NULL || metadata->evictedHistory == NULL)
+                {
+                    free(metadata->historyMemory);
+                    free(metadata->heap);
+                    free(metadata->evictedPages);
+                    free(metadata->evictedHistory);
+                    free(metadata->frameMemory);
+                    closePageFile(&(metadata->pageFile));
+                    free(metadata);
+                    bm->mgmtData = NULL;
+                    return RC_ALLOCATION_FAILED;
+                }
+                for (int i = 0; i < numPages; i++) metadata->evictedPages[i] = NO_PAGE;
+                initHashTable(&(metadata->evictedTable), numPages);
+            }
+
+            // ARC's and 2Q's ghosts (ARC keeps up to twice as many pages as there are frames)
+            if (strategy == RS_ARC || strategy == RS_2Q)
+            {
+                metadata->ghosts = (BM_Ghost *)malloc(sizeof(BM_Ghost) * 2 * numPages);
+                if (metadata->ghosts == NULL)
+                {
+                    free(metadata->frameMemory);
+                    closePageFile(&(metadata->pageFile));
+                    free(metadata);
+                    bm->mgmtData = NULL;
+                    return RC_ALLOCATION_FAILED;
+                }
+                for (int i = 0; i < 2 * numPages; i++) metadata->ghosts[i].next = (i + 1 < 2 * numPages) ? i + 1 : -1;
+                metadata->freeGhost = 0;
+                initHashTable(&(metadata->ghostTable), 2 * numPages);
+            }
+
+            for (int i = 0; i < PAGE_TABLE_SHARDS; i++)
+            {
+                pthread_mutex_init(&(metadata->shards[i].lock), NULL);
+                pthread_cond_init(&(metadata->shards[i].latchFree), NULL);
+                if (!metadata->directPageTable) initHashTable(&(metadata->shards[i].table), numPages / PAGE_TABLE_SHARDS + 1);
+                metadata->shards[i].directChunks = NULL;
+                metadata->shards[i].numDirectChunks = 0;
+            }
+            pthread_mutex_init(&(metadata->poolLock), NULL);
+            pthread_cond_init(&(metadata->loadDone), NULL);
+            pthread_cond_init(&(metadata->reapDone), NULL);
+            pthread_cond_init(&(metadata->cleanerWake), NULL);
+            pthread_cond_init(&(metadata->cleanerDone), NULL);
             metadata->pageFrames = (BM_PageFrame *)malloc(sizeof(BM_PageFrame) * numPages);
             for (int i = 0; i < numPages; i++)
             {
                 metadata->pageFrames[i].frameIndex = i;
-                metadata->pageFrames[i].data = (char *)malloc(PAGE_SIZE);
+                metadata->pageFrames[i].data = metadata->frameMemory + (size_t)pageSize * i;
                 metadata->pageFrames[i].fixCount = 0;
                 metadata->pageFrames[i].dirty = false;
+                metadata->pageFrames[i].dirtyGeneration = 0;
                 metadata->pageFrames[i].occupied = false;
-                metadata->pageFrames[i].timeStamp = getTimeStamp(metadata);
+                metadata->pageFrames[i].loading = false;
+                metadata->pageFrames[i].prefetched = false;
+                metadata->pageFrames[i].pageLSN = 0;
+                metadata->pageFrames[i].recLSN = 0;
+                metadata->pageFrames[i].list = NULL;
+                touchFrame(metadata, &(metadata->pageFrames[i]));
+                metadata->pageFrames[i].referenced = false;
+                metadata->pageFrames[i].history = (lruK > 0) ? metadata->historyMemory + (size_t)i * lruK : NULL;
+                metadata->pageFrames[i].heapIndex = -1;
+                metadata->pageFrames[i].useCount = 0;
+                metadata->pageFrames[i].latchShared = 0;
+                metadata->pageFrames[i].latchExclusive = false;
+                metadata->pageFrames[i].writing = false;
+                metadata->pageFrames[i].version = 1;  // empty
+                noteFrameState(metadata, &(metadata->pageFrames[i]));
             }
             bm->mgmtData = (void *)metadata;
             bm->numPages = numPages;
             bm->pageFile = (char *)&(metadata->pageFile);
             bm->strategy = strategy;
+
+            // the cleaner starts with the pool (and a pool it cannot get is given up)
+            if (metadata->cleanReserve > 0 && pthread_create(&(metadata->cleaner), NULL, cleanerMain, metadata) != 0)
+            {
+                metadata->cleanReserve = 0;
+                shutdownBufferPool(bm);
+                return RC_ALLOCATION_FAILED;
+            }
             return RC_OK;
 
         default:
@@ -95,6 +596,13 @@ RC initBufferPool(BM_BufferPool *const bm, const char *const pageFileName,
     }
 }
 
+// the size of the pool's frames, which is the page size of its page file
+int getPoolPageSize(BM_BufferPool *const bm)
+{
+    if (bm->mgmtData == NULL) return PAGE_SIZE;
+    return getPageSize(&(((BM_Metadata *)bm->mgmtData)->pageFile));
+}
+
 RC shutdownBufferPool(BM_BufferPool *const bm)
 {
     // make sure the metadata was successfully initialized
@@ -102,34 +610,78 @@ RC shutdownBufferPool(BM_BufferPool *const bm)
     {
         BM_Metadata *metadata = (BM_Metadata *)bm->mgmtData;
         BM_PageFrame *pageFrames = metadata->pageFrames;
-        HT_TableHandle *pageTabe = &(metadata->pageTable);
         
         // "It is an error to shutdown a buffer pool that has pinned pages."
+        // (no other thread may use the pool once it is shut down; the cleaner's fixes
+        // do not count)
+        lockPool(metadata);
+        while (metadata->cleaning) pthread_cond_wait(&(metadata->cleanerDone), &(metadata->poolLock));
         int i = 0; // Initialize loop counter for while loop
         while (i < bm->numPages)
         {
-            if (pageFrames[i].fixCount > 0) return RC_WRITE_FAILED;
+            if (pageFrames[i].fixCount > 0)
+            {
+                pthread_mutex_unlock(&(metadata->poolLock));
+                return RC_WRITE_FAILED;
+            }
             i++; // Increment loop counter
         }
+        metadata->cleanerStop = true;
+        pthread_cond_signal(&(metadata->cleanerWake));
+        pthread_mutex_unlock(&(metadata->poolLock));
+        if (metadata->cleanReserve > 0) pthread_join(metadata->cleaner, NULL);
         
-        forceFlushPool(bm);
+        RC result = forceFlushPool(bm);
 
-        i = 0; // Reset loop counter for next while loop
-        while (i < bm->numPages)
+        // read-ahead pages may still be arriving in the frames
+        lockPool(metadata);
+        while (metadata->numLoading > 0) reapCompletions(metadata, 1);
+        pthread_mutex_unlock(&(metadata->poolLock));
+
+        // free the frames' data (a single allocation)
+        free(metadata->frameMemory);
+
+        closePageFile(&(metadata->pageFile));
+
+        // free LRU-K's state
+        if (metadata->lruK > 0)
         {
-            // free each page frame's data
-            free(pageFrames[i].data);
-            i++; // Increment loop counter
+            freeHashTable(&(metadata->evictedTable));
+            free(metadata->historyMemory);
+            free(metadata->heap);
+            free(metadata->evictedPages);
+            free(metadata->evictedHistory);
         }
 
-        closePageFile(&(metadata->pageFile));
+        // free ARC's and 2Q's ghosts
+        if (metadata->ghosts != NULL)
+        {
+            freeHashTable(&(metadata->ghostTable));
+            free(metadata->ghosts);
+        }
 
-        // free the pageFrames array and metadata
-        freeHashTable(pageTabe);
+        // free the page table, the locks, the pageFrames array and metadata
+        for (i = 0; i < PAGE_TABLE_SHARDS; i++)
+        {
+            BM_PageTableShard *shard = &(metadata->shards[i]);
+            if (metadata->directPageTable)
+            {
+                for (int chunk = 0; chunk < shard->numDirectChunks; chunk++) free(shard->directChunks[chunk]);
+                free(shard->directChunks);
+            }
+            else freeHashTable(&(shard->table));
+            pthread_mutex_destroy(&(shard->lock));
+            pthread_cond_destroy(&(shard->latchFree));
+        }
+        pthread_mutex_destroy(&(metadata->poolLock));
+        pthread_cond_destroy(&(metadata->loadDone));
+        pthread_cond_destroy(&(metadata->reapDone));
+        pthread_cond_destroy(&(metadata->cleanerWake));
+        pthread_cond_destroy(&(metadata->cleanerDone));
         free(pageFrames);
         free(metadata);
         bm->mgmtData = NULL; // Clear management data pointer
-        return RC_OK;
+        return result;
     }
     else return RC_FILE_HANDLE_NOT_INIT;
 }
@@ -142,22 +694,80 @@ RC forceFlushPool(BM_BufferPool *const bm)
     {
         BM_Metadata *metadata = (BM_Metadata *)bm->mgmtData;
         BM_PageFrame *pageFrames = metadata->pageFrames;
+        SM_PageIO *pages = (SM_PageIO *)malloc(sizeof(SM_PageIO) * bm->numPages);
+        int *frames = (int *)malloc(sizeof(int) * bm->numPages);
+        uint64_t *generations = (uint64_t *)malloc(sizeof(uint64_t) * bm->numPages);
+        if (pages == NULL || frames == NULL || generations == NULL)
+        {
+            free(pages);
+            free(frames);
+            free(generations);
+            return RC_ALLOCATION_FAILED;
+        }
+
+        // unpinned frames cannot be evicted while the pool lock is held (the pages the
+        // cleaner is writing are waited for); pages pinned and changed while they are
+        // written stay dirty
+        lockPool(metadata);
+        while (metadata->cleaning || metadata->writeBackData != NULL)
+        {
+            if (metadata->cleaning) pthread_cond_wait(&(metadata->cleanerDone), &(metadata->poolLock));
+            else finishWriteBack(metadata);
+        }
+        int numDirty = 0;
+        uint64_t pageLSN = 0;
         int i = 0; // Initialize loop counter for while loop
         while (i < bm->numPages)
         {
-            // write the occupied, dirty, and unpinned pages to disk
-            if (pageFrames[i].occupied && pageFrames[i].dirty && pageFrames[i].fixCount == 0)
+            // collect the occupied, dirty, and unpinned pages
+            if (pageFrames[i].occupied)
             {
-                writeBlock(pageFrames[i].pageNum, &(metadata->pageFile), pageFrames[i].data);
-                metadata->numWrite++;
-                pageFrames[i].timeStamp = getTimeStamp(metadata);
-
-                // clear the dirty bool
-                pageFrames[i].dirty = false;
+                BM_PageTableShard *shard = shardFor(metadata, pageFrames[i].pageNum);
+                pthread_mutex_lock(&(shard->lock));
+                if (pageFrames[i].dirty && pageFrames[i].fixCount == 0)
+                {
+                    pages[numDirty].pageNum = pageFrames[i].pageNum;
+                    pages[numDirty].memPage = pageFrames[i].data;
+                    frames[numDirty] = i;
+                    generations[numDirty] = pageFrames[i].dirtyGeneration;
+                    numDirty++;
+                    if (pageFrames[i].pageLSN > pageLSN) pageLSN = pageFrames[i].pageLSN;
+                }
+                pthread_mutex_unlock(&(shard->lock));
             }
             i++; // Increment loop counter
         }
-        return RC_OK;
+
+        // one log flush covers every page, then they are written in page order, one
+        // I/O per run of adjacent pages
+        RC result = metadata->writeBackResult;
+        if (result == RC_OK) result = flushLogFor(metadata, pageLSN);
+        if (result == RC_OK) result = writeBlockList(pages, numDirty, &(metadata->pageFile));
+        free(pages);
+        if (result != RC_OK)
+        {
+            pthread_mutex_unlock(&(metadata->poolLock));
+            free(frames);
+            free(generations);
+            return result;
+        }
+
+        i = 0; // Reset loop counter for next while loop
+        while (i < numDirty)
+        {
+            metadata->numWrite++;
+            touchFrame(metadata, &(pageFrames[frames[i]]));
+
+            // clear the dirty bool
+            cleanFrame(metadata, &(pageFrames[frames[i]]), generations[i]);
+            i++; // Increment loop counter
+        }
+        pthread_mutex_unlock(&(metadata->poolLock));
+        free(frames);
+        free(generations);
+
+        // one barrier for the whole pool instead of a flush per page
+        return syncPageFile(&(metadata->pageFile));
     }
     else return RC_FILE_HANDLE_NOT_INIT;
 }
@@ -166,33 +776,8 @@ RC forceFlushPool(BM_BufferPool *const bm)
 
 RC markDirty (BM_BufferPool *const bm, BM_PageHandle *const page)
 {
-    // make sure the metadata was successfully initialized
-    if (bm->mgmtData != NULL) 
-    {
-        BM_Metadata *metadata = (BM_Metadata *)bm->mgmtData;
-        BM_PageFrame *pageFrames = metadata->pageFrames;
-        HT_TableHandle *pageTabe = &(metadata->pageTable);
-        int frameIndex;
-
-        // get the mapped frameIndex from pageNum
-        int getValueResult = getValue(pageTabe, page->pageNum, &frameIndex);
-        switch (getValueResult) 
-        {
-            case 0:
-                pageFrames[frameIndex].timeStamp = getTimeStamp(metadata);
-
-                // set dirty bool
-                pageFrames[frameIndex].dirty = true;
-                return RC_OK;
-
-            default:
-                return RC_IM_KEY_NOT_FOUND;
-        }
-    }
-    else 
-    {
-        return RC_FILE_HANDLE_NOT_INIT;
-    }
+    // a change that was not logged
+    return markDirtyLSN(bm, page, 0);
 }
 
 RC unpinPage (BM_BufferPool *const bm, BM_PageHandle *const page)
@@ -202,24 +787,38 @@ RC unpinPage (BM_BufferPool *const bm, BM_PageHandle *const page)
     {
         BM_Metadata *metadata = (BM_Metadata *)bm->mgmtData;
         BM_PageFrame *pageFrames = metadata->pageFrames;
-        HT_TableHandle *pageTabe = &(metadata->pageTable);
         int frameIndex;
 
-        // get the mapped frameIndex from pageNum
-        int getValueResult = getValue(pageTabe, page->pageNum, &frameIndex);
+        // get the mapped frameIndex from pageNum; the pool lock is not needed, the
+        // strategy learns of the unpin through the access log
+        uint64_t ticket = reserveAccess(metadata);
+        BM_PageTableShard *shard = shardFor(metadata, page->pageNum);
+        pthread_mutex_lock(&(shard->lock));
+        int getValueResult = lookupFrame(metadata, page->pageNum, &frameIndex);
         switch (getValueResult) 
         {
             case 0:
-                pageFrames[frameIndex].timeStamp = getTimeStamp(metadata);
-
-                // decrement fixCount but ensure it does not drop below 0
+            {
+                // decrement fixCount but ensure it does not drop below 0, and give up the
+                // pin's hold on the latch
                 if (pageFrames[frameIndex].fixCount > 0)
                 {
                     pageFrames[frameIndex].fixCount--;
+                    if (pageFrames[frameIndex].writing)
+                    {
+                        pageFrames[frameIndex].writing = false;
+                        frameChanged(&(pageFrames[frameIndex]));
+                    }
+                    unlatchFrame(shard, &(pageFrames[frameIndex]));
                 }
+                publishAccess(metadata, ticket, BM_ACCESS_UNPIN, frameIndex, page->pageNum);
+                pthread_mutex_unlock(&(shard->lock));
                 return RC_OK;
+            }
 
             default:
+                publishAccess(metadata, ticket, BM_ACCESS_NONE, -1, page->pageNum);
+                pthread_mutex_unlock(&(shard->lock));
                 return RC_IM_KEY_NOT_FOUND;
         }
     }
@@ -236,32 +835,54 @@ RC forcePage (BM_BufferPool *const bm, BM_PageHandle *const page)
     {
         BM_Metadata *metadata = (BM_Metadata *)bm->mgmtData;
         BM_PageFrame *pageFrames = metadata->pageFrames;
-        HT_TableHandle *pageTabe = &(metadata->pageTable);
         int frameIndex;
 
+        RC result = RC_IM_KEY_NOT_FOUND;
+
         // get the mapped frameIndex from pageNum
-        if (getValue(pageTabe, page->pageNum, &frameIndex) == 0)
+        lockPool(metadata);
+        if (lookupFrame(metadata, page->pageNum, &frameIndex) == 0)
         {
-            pageFrames[frameIndex].timeStamp = getTimeStamp(metadata);
-
-            // only force the page if it is not pinned
-            if (pageFrames[frameIndex].fixCount == 0)
+            touchFrame(metadata, &(pageFrames[frameIndex]));
+
+            // only force the page if it is not pinned (a pin that comes while it is
+            // written keeps it dirty if it changes it)
+            BM_PageTableShard *shard = shardFor(metadata, page->pageNum);
+            pthread_mutex_lock(&(shard->lock));
+            bool pinned = pageFrames[frameIndex].fixCount > 0;
+            uint64_t pageLSN = pageFrames[frameIndex].pageLSN;
+            uint64_t generation = pageFrames[frameIndex].dirtyGeneration;
+            pthread_mutex_unlock(&(shard->lock));
+            if (!pinned)
             {
-                writeBlock(page->pageNum, &(metadata->pageFile), pageFrames[frameIndex].data);
-                metadata->numWrite++;
+                result = flushLogFor(metadata, pageLSN);
+                if (result == RC_OK) result = writeBlock(page->pageNum, &(metadata->pageFile), pageFrames[frameIndex].data);
 
-                // clear dirty bool
-                pageFrames[frameIndex].dirty = false;
-                return RC_OK;
+                // a page that failed to be written stays dirty, so a checkpoint still
+                // starts recovery at its change
+                if (result == RC_OK)
+                {
+                    metadata->numWrite++;
+
+                    // clear dirty bool
+                    cleanFrame(metadata, &(pageFrames[frameIndex]), generation);
+                }
             }
-            else return RC_WRITE_FAILED;
+            else result = RC_WRITE_FAILED;
         }
-        else return RC_IM_KEY_NOT_FOUND;
+        pthread_mutex_unlock(&(metadata->poolLock));
+        return result;
     }
     else return RC_FILE_HANDLE_NOT_INIT;
 }
 
 RC pinPage (BM_BufferPool *const bm, BM_PageHandle *const page, const PageNumber pageNum)
+{
+    return pinPageWithIntent(bm, page, pageNum, BM_PIN_READ);
+}
+
+RC pinPageWithIntent (BM_BufferPool *const bm, BM_PageHandle *const page, const PageNumber pageNum,
+		BM_PinIntent intent)
 {
     // Switch case for checking if management data is initialized
     switch (bm->mgmtData != NULL) 
@@ -270,7 +891,6 @@ RC pinPage (BM_BufferPool *const bm, BM_PageHandle *const page, const PageNumber
         {
             BM_Metadata *metadata = (BM_Metadata *)bm->mgmtData;
             BM_PageFrame *pageFrames = metadata->pageFrames;
-            HT_TableHandle *pageTabe = &(metadata->pageTable);
             int frameIndex;
 
             // make sure the pageNum is not negative
@@ -278,48 +898,62 @@ RC pinPage (BM_BufferPool *const bm, BM_PageHandle *const page, const PageNumber
             {
                 case true:
                 {
-                    int getValueResult = getValue(pageTabe, pageNum, &frameIndex);
-                    switch (getValueResult)
+                    // a page in a frame is fixed under its shard's lock alone, which keeps the
+                    // frame from being evicted; the strategy learns of the pin through the
+                    // access log
+                    BM_PageTableShard *shard = shardFor(metadata, pageNum);
+                    uint64_t ticket = reserveAccess(metadata);
+                    pthread_mutex_lock(&(shard->lock));
+                    bool hit = lookupFrame(metadata, pageNum, &frameIndex) == 0 && !pageFrames[frameIndex].loading;
+                    bool prefetched = false;
+                    if (hit)
+                    {
+                        pageFrames[frameIndex].fixCount++;
+                        prefetched = pageFrames[frameIndex].prefetched;
+                        publishAccess(metadata, ticket, BM_ACCESS_PIN, frameIndex, pageNum);
+                    }
+                    else publishAccess(metadata, ticket, BM_ACCESS_NONE, -1, pageNum);
+                    pthread_mutex_unlock(&(shard->lock));
+
+                    // only misses and the first pin of a read-ahead page take the pool lock
+                    // (prefetched is only cleared under it, so it is checked again there)
+                    switch (hit)
                     {
-                        case 0:  // Page is already in a frame
-                            pageFrames[frameIndex].timeStamp = getTimeStamp(metadata);
-                            pageFrames[frameIndex].fixCount++;
-                            page->data = pageFrames[frameIndex].data;
-                            page->pageNum = pageNum;
-                            return RC_OK;
-
-                        default:  // Page is not in a frame, use replacement strategy
-                            BM_PageFrame *pageFrame;
-                            switch (bm->strategy)
+                        case true:  // Page is already in a frame
+                            if (!prefetched) break;
+
+                            // reaching a read-ahead page keeps the sequential run going
+                            lockPool(metadata);
+                            if (pageFrames[frameIndex].prefetched)
                             {
-                                case RS_FIFO:
-                                    pageFrame = replacementFIFO(bm);
-                                    break;
-                                case RS_LRU:
-                                    pageFrame = replacementLRU(bm);
-                                    break;
-                                default:
-                                    return RC_IM_CONFIG_ERROR; // Configuration error if no strategy fits
+                                pageFrames[frameIndex].prefetched = false;
+                                readAhead(bm, pageNum);
                             }
+                            pthread_mutex_unlock(&(metadata->poolLock));
+                            break;
+
+                        default:  // Page is not in a frame (or still arriving)
+                        {
+                            lockPool(metadata);
+                            RC result = loadPage(bm, pageNum, &frameIndex);
+                            pthread_mutex_unlock(&(metadata->poolLock));
+                            if (result != RC_OK) return result;
+                            break;
+                        }
+                    }
 
-                            // Check if the replacement strategy succeeded
-                            if (pageFrame == NULL)
-                                return RC_WRITE_FAILED;
-
-                            // Successful replacement, setup new frame
-                            setValue(pageTabe, pageNum, pageFrame->frameIndex);
-                            ensureCapacity(pageNum + 1, &(metadata->pageFile));
-                            readBlock(pageNum, &(metadata->pageFile), pageFrame->data);
-                            metadata->numRead++;
-
-                            pageFrame->dirty = false;
-                            pageFrame->fixCount = 1;
-                            pageFrame->occupied = true;
-                            pageFrame->pageNum = pageNum;
-                            page->data = pageFrame->data;
-                            page->pageNum = pageNum;
-                            return RC_OK;
+                    // readers share the page, a writer waits until it has it alone
+                    pthread_mutex_lock(&(shard->lock));
+                    latchFrame(shard, &(pageFrames[frameIndex]), intent);
+                    if (intent == BM_PIN_WRITE)
+                    {
+                        pageFrames[frameIndex].writing = true;
+                        frameChanging(&(pageFrames[frameIndex]));
                     }
+                    pthread_mutex_unlock(&(shard->lock));
+                    page->data = pageFrames[frameIndex].data;
+                    page->pageNum = pageNum;
+                    return RC_OK;
                 }
                 default:
                     return RC_IM_KEY_NOT_FOUND;  // pageNum is negative
@@ -330,6 +964,154 @@ RC pinPage (BM_BufferPool *const bm, BM_PageHandle *const page, const PageNumber
     }
 }
 
+/* Write-Ahead Logging Interface */
+
+// pages marked with markDirtyLSN are only written once flushLog made the log durable
+// up to the LSN they were marked with
+void setFlushLog(BM_BufferPool *const bm, BM_FlushLog flushLog, void *logData)
+{
+    if (bm->mgmtData == NULL) return;
+    BM_Metadata *metadata = (BM_Metadata *)bm->mgmtData;
+    lockPool(metadata);
+    metadata->flushLog = flushLog;
+    metadata->logData = logData;
+    pthread_mutex_unlock(&(metadata->poolLock));
+}
+
+// markDirty for a change logged at lsn
+RC markDirtyLSN(BM_BufferPool *const bm, BM_PageHandle *const page, uint64_t lsn)
+{
+    if (bm->mgmtData == NULL) return RC_FILE_HANDLE_NOT_INIT;
+    BM_Metadata *metadata = (BM_Metadata *)bm->mgmtData;
+    BM_PageFrame *pageFrames = metadata->pageFrames;
+    int frameIndex;
+
+    // the page is pinned, so it stays in its frame; its dirty state is kept under the
+    // shard's lock and the touch is queued for the strategy
+    uint64_t ticket = reserveAccess(metadata);
+    BM_PageTableShard *shard = shardFor(metadata, page->pageNum);
+    pthread_mutex_lock(&(shard->lock));
+    if (lookupFrame(metadata, page->pageNum, &frameIndex) != 0)
+    {
+        publishAccess(metadata, ticket, BM_ACCESS_NONE, -1, page->pageNum);
+        pthread_mutex_unlock(&(shard->lock));
+        return RC_IM_KEY_NOT_FOUND;
+    }
+
+    pageFrames[frameIndex].dirty = true;
+    pageFrames[frameIndex].dirtyGeneration++;
+    if (pageFrames[frameIndex].recLSN == 0) pageFrames[frameIndex].recLSN = lsn;
+    if (pageFrames[frameIndex].pageLSN < lsn) pageFrames[frameIndex].pageLSN = lsn;
+    publishAccess(metadata, ticket, BM_ACCESS_TOUCH, frameIndex, page->pageNum);
+    pthread_mutex_unlock(&(shard->lock));
+    return RC_OK;
+}
+
+// the LSN recovery would have to start at: the oldest logged change that is not on
+// disk yet (0 if there is none); pages written so far are synced first, so only the
+// pool's dirty frames count
+RC getCheckpointLSN(BM_BufferPool *const bm, uint64_t *redoLSN)
+{
+    if (bm->mgmtData == NULL) return RC_FILE_HANDLE_NOT_INIT;
+    BM_Metadata *metadata = (BM_Metadata *)bm->mgmtData;
+    BM_PageFrame *pageFrames = metadata->pageFrames;
+
+    lockPool(metadata);
+    finishWriteBack(metadata);
+    RC result = metadata->writeBackResult;
+    if (result == RC_OK) result = syncPageFile(&(metadata->pageFile));
+    if (result != RC_OK)
+    {
+        pthread_mutex_unlock(&(metadata->poolLock));
+        return result;
+    }
+
+    *redoLSN = 0;
+    for (int i = 0; i < bm->numPages; i++)
+    {
+        if (!pageFrames[i].occupied) continue;
+        BM_PageTableShard *shard = shardFor(metadata, pageFrames[i].pageNum);
+        pthread_mutex_lock(&(shard->lock));
+        if (pageFrames[i].dirty && pageFrames[i].recLSN != 0 && (*redoLSN == 0 || pageFrames[i].recLSN < *redoLSN))
+        {
+            *redoLSN = pageFrames[i].recLSN;
+        }
+        pthread_mutex_unlock(&(shard->lock));
+    }
+    pthread_mutex_unlock(&(metadata->poolLock));
+    return RC_OK;
+}
+
+/* Optimistic Reads */
+
+RC beginOptimisticRead (BM_BufferPool *const bm, const PageNumber pageNum, BM_OptimisticRead *read)
+{
+    if (bm->mgmtData == NULL) return RC_FILE_HANDLE_NOT_INIT;
+    BM_Metadata *metadata = (BM_Metadata *)bm->mgmtData;
+    BM_PageFrame *pageFrames = metadata->pageFrames;
+    int frameIndex;
+    if (pageNum < 0) return RC_IM_KEY_NOT_FOUND;
+
+    // the frame is neither fixed nor touched; its page and buffer only change once it was
+    // unmapped under the shard's lock, which also made its version odd
+    BM_PageTableShard *shard = shardFor(metadata, pageNum);
+    RC result = RC_IM_KEY_NOT_FOUND;
+    pthread_mutex_lock(&(shard->lock));
+    if (lookupFrame(metadata, pageNum, &frameIndex) == 0 && !pageFrames[frameIndex].loading)
+    {
+        read->version = __atomic_load_n(&(pageFrames[frameIndex].version), __ATOMIC_ACQUIRE);
+        if ((read->version & 1) == 0)  // not being written
+        {
+            read->frameIndex = frameIndex;
+            read->page.pageNum = pageNum;
+            read->page.data = pageFrames[frameIndex].data;
+            result = RC_OK;
+        }
+    }
+    pthread_mutex_unlock(&(shard->lock));
+    return result;
+}
+
+bool validateOptimisticRead (BM_BufferPool *const bm, BM_OptimisticRead *read)
+{
+    BM_Metadata *metadata = (BM_Metadata *)bm->mgmtData;
+
+    // the reads of the page happen before the version is looked at again
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&(metadata->pageFrames[read->frameIndex].version), __ATOMIC_RELAXED) == read->version;
+}
+
+RC beginPageChange (BM_BufferPool *const bm, BM_PageHandle *const page)
+{
+    if (bm->mgmtData == NULL) return RC_FILE_HANDLE_NOT_INIT;
+    BM_Metadata *metadata = (BM_Metadata *)bm->mgmtData;
+    int frameIndex;
+
+    // the page is pinned, so it stays in its frame; a frame pinned with BM_PIN_WRITE is
+    // marked as being written already
+    BM_PageTableShard *shard = shardFor(metadata, page->pageNum);
+    pthread_mutex_lock(&(shard->lock));
+    int found = lookupFrame(metadata, page->pageNum, &frameIndex);
+    if (found == 0) frameChanging(&(metadata->pageFrames[frameIndex]));
+    pthread_mutex_unlock(&(shard->lock));
+    return (found == 0) ? RC_OK : RC_IM_KEY_NOT_FOUND;
+}
+
+RC endPageChange (BM_BufferPool *const bm, BM_PageHandle *const page)
+{
+    if (bm->mgmtData == NULL) return RC_FILE_HANDLE_NOT_INIT;
+    BM_Metadata *metadata = (BM_Metadata *)bm->mgmtData;
+    int frameIndex;
+
+    // a BM_PIN_WRITE pin stays marked until it is unpinned
+    BM_PageTableShard *shard = shardFor(metadata, page->pageNum);
+    pthread_mutex_lock(&(shard->lock));
+    int found = lookupFrame(metadata, page->pageNum, &frameIndex);
+    if (found == 0 && !metadata->pageFrames[frameIndex].writing) frameChanged(&(metadata->pageFrames[frameIndex]));
+    pthread_mutex_unlock(&(shard->lock));
+    return (found == 0) ? RC_OK : RC_IM_KEY_NOT_FOUND;
+}
+
 /* Statistics Interface */
 
 PageNumber *getFrameContents (BM_BufferPool *const bm)
@@ -344,6 +1126,7 @@ PageNumber *getFrameContents (BM_BufferPool *const bm)
 
             // Allocate memory for the array; user is responsible for freeing it
             PageNumber *array = (PageNumber *)malloc(sizeof(PageNumber) * bm->numPages);
+            lockPool(metadata);
             int i = 0;  // Initialize loop counter for while loop
             while (i < bm->numPages)
             {
@@ -351,6 +1134,7 @@ PageNumber *getFrameContents (BM_BufferPool *const bm)
                 array[i] = pageFrames[i].occupied ? pageFrames[i].pageNum : NO_PAGE;
                 i++;  // Increment loop counter
             }
+            pthread_mutex_unlock(&(metadata->poolLock));
             return array;
         }
 
@@ -371,6 +1155,7 @@ bool *getDirtyFlags (BM_BufferPool *const bm)
 
             // Allocate memory for the array; user is responsible for freeing it
             bool *array = (bool *)malloc(sizeof(bool) * bm->numPages);
+            lockPool(metadata);
             int i = 0;  // Initialize loop counter for while loop
             while (i < bm->numPages)
             {
@@ -378,6 +1163,7 @@ bool *getDirtyFlags (BM_BufferPool *const bm)
                 array[i] = pageFrames[i].occupied ? pageFrames[i].dirty : false;
                 i++;  // Increment loop counter
             }
+            pthread_mutex_unlock(&(metadata->poolLock));
             return array;
         }
 
@@ -398,6 +1184,7 @@ int *getFixCounts (BM_BufferPool *const bm)
 
             // Allocate memory for the array; user is responsible for freeing it
             int *array = (int *)malloc(sizeof(int) * bm->numPages);
+            lockPool(metadata);
             int i = 0;  // Initialize loop counter for while loop
             while (i < bm->numPages)
             {
@@ -405,6 +1192,7 @@ int *getFixCounts (BM_BufferPool *const bm)
                 array[i] = pageFrames[i].occupied ? pageFrames[i].fixCount : 0;
                 i++;  // Increment loop counter
             }
+            pthread_mutex_unlock(&(metadata->poolLock));
             return array;
         }
 
@@ -421,7 +1209,10 @@ int getNumReadIO (BM_BufferPool *const bm)
         case true:
         {
             BM_Metadata *metadata = (BM_Metadata *)bm->mgmtData;
-            return metadata->numRead;
+            lockPool(metadata);
+            int count = metadata->numRead;
+            pthread_mutex_unlock(&(metadata->poolLock));
+            return count;
         }
 
         default:
@@ -437,7 +1228,10 @@ int getNumWriteIO (BM_BufferPool *const bm)
         case true:
         {
             BM_Metadata *metadata = (BM_Metadata *)bm->mgmtData;
-            return metadata->numWrite;
+            lockPool(metadata);
+            int count = metadata->numWrite;
+            pthread_mutex_unlock(&(metadata->poolLock));
+            return count;
         }
 
         default:
@@ -448,7 +1242,8 @@ int getNumWriteIO (BM_BufferPool *const bm)
 
 /* Replacement Policies */
 
-BM_PageFrame *replacementFIFO(BM_BufferPool *const bm)
+// the FIFO victim: the next frame in queue order that is not pinned (or being read ahead)
+int victimFIFO(BM_BufferPool *const bm)
 {
     BM_Metadata *metadata = (BM_Metadata *)bm->mgmtData;
     BM_PageFrame *pageFrames = metadata->pageFrames;
@@ -460,7 +1255,7 @@ BM_PageFrame *replacementFIFO(BM_BufferPool *const bm)
     while (true)
     {
         currentIndex = (currentIndex + 1) % bm->numPages;
-        if (pageFrames[currentIndex].fixCount == 0)
+        if (pageFrames[currentIndex].fixCount == 0 && !pageFrames[currentIndex].loading)
             break;
         if (currentIndex == firstIndex)
             break;
@@ -470,81 +1265,590 @@ BM_PageFrame *replacementFIFO(BM_BufferPool *const bm)
     metadata->queueIndex = currentIndex;
 
     // Check if we did not cycle into a pinned frame (i.e., all frames are pinned)
-    switch (pageFrames[currentIndex].fixCount) 
+    if (pageFrames[currentIndex].fixCount == 0 && !pageFrames[currentIndex].loading)
+        return currentIndex;
+    return -1;
+}
+
+// the LRU victim: the first frame of the list of unpinned frames (which is ordered by
+// timestamp) that is not being read ahead; at most numLoading frames are passed over
+int victimLRU(BM_BufferPool *const bm)
+{
+    BM_Metadata *metadata = (BM_Metadata *)bm->mgmtData;
+    return firstEvictable(metadata, &(metadata->lruList));  // -1 if all frames were pinned
+}
+
+// the CLOCK victim: the hand sweeps the frames in a circle, giving every referenced
+// frame a second chance (its bit is cleared) and stopping at the first unpinned frame
+// without one; after two full sweeps without a victim every frame is pinned
+int victimCLOCK(BM_BufferPool *const bm)
+{
+    BM_Metadata *metadata = (BM_Metadata *)bm->mgmtData;
+    BM_PageFrame *pageFrames = metadata->pageFrames;
+
+    for (int step = 0; step < 2 * bm->numPages; step++)
     {
-        case 0:
-            return getAfterEviction(bm, currentIndex);
-        default:
-            return NULL;
+        int currentIndex = metadata->clockHand;
+        metadata->clockHand = (currentIndex + 1) % bm->numPages;
+
+        if (pageFrames[currentIndex].fixCount > 0 || pageFrames[currentIndex].loading)
+            continue;
+        if (!pageFrames[currentIndex].referenced)
+            return currentIndex;
+        pageFrames[currentIndex].referenced = false;
     }
+
+    return -1;  // All frames were pinned
 }
-BM_PageFrame *replacementLRU(BM_BufferPool *const bm)
+
+// the LRU-K victim: the frame at the top of the heap, whose K-th most recent reference
+// lies furthest back (pages with fewer than K references first, the least recently
+// used of them first); pinned frames and frames being read ahead are not in the heap
+int victimLRUK(BM_BufferPool *const bm)
 {
     BM_Metadata *metadata = (BM_Metadata *)bm->mgmtData;
-    BM_PageFrame *pageFrames = metadata->pageFrames;
+    return (metadata->heapSize > 0) ? metadata->heap[0] : -1;  // -1 if all frames were pinned
+}
 
-    TimeStamp min = UINT_MAX;
-    int minIndex = -1;
-    int i = 0;  // Initialize loop counter for while loop
+// the LFU victim: the least recently used frame among those whose page has the lowest
+// use count; pinned frames and frames being read ahead are in no list
+int victimLFU(BM_BufferPool *const bm)
+{
+    BM_Metadata *metadata = (BM_Metadata *)bm->mgmtData;
 
-    // Find unpinned frame with smallest timestamp
-    while (i < bm->numPages)
+    for (int count = metadata->lfuLowest; count <= LFU_MAX_COUNT; count++)
     {
-        if (pageFrames[i].fixCount == 0 && pageFrames[i].timeStamp < min)
+        if (metadata->lfuBuckets[count].head != -1)
         {
-            min = pageFrames[i].timeStamp;
-            minIndex = i;
+            metadata->lfuLowest = count;
+            return metadata->lfuBuckets[count].head;
         }
-        i++;  // Increment loop counter
     }
+    return -1;  // All frames were pinned
+}
+
+// the ARC victim: an empty frame while there is one, otherwise the least recently used
+// evictable frame of T1 if T1 is larger than its target, else of T2 (the other list if
+// the chosen one has only pinned frames); pinned frames stay in their lists and are
+// passed over. The target adapts when the new page is referenced, i.e. after its frame
+// was chosen
+int victimARC(BM_BufferPool *const bm)
+{
+    BM_Metadata *metadata = (BM_Metadata *)bm->mgmtData;
+    BM_FrameList *first = &(metadata->frequentList);
+    BM_FrameList *second = &(metadata->recentList);
+
+    if (metadata->freeList.head != -1) return metadata->freeList.head;
+    if (metadata->recentList.size > 0 && metadata->recentList.size > metadata->arcTarget)
+    {
+        first = &(metadata->recentList);
+        second = &(metadata->frequentList);
+    }
+
+    int victim = firstEvictable(metadata, first);
+    return (victim != -1) ? victim : firstEvictable(metadata, second);  // -1 if all frames were pinned
+}
+
+// the 2Q victim: an empty frame while there is one, otherwise the oldest evictable frame
+// of A1in once A1in holds more than its share of the pool, else the least recently used
+// one of Am (the other list if the chosen one has only pinned frames)
+int victim2Q(BM_BufferPool *const bm)
+{
+    BM_Metadata *metadata = (BM_Metadata *)bm->mgmtData;
+    BM_FrameList *first = &(metadata->frequentList);
+    BM_FrameList *second = &(metadata->recentList);
+
+    if (metadata->freeList.head != -1) return metadata->freeList.head;
+    if (metadata->recentList.size > bm->numPages * TWO_Q_IN_PERCENT / 100)
+    {
+        first = &(metadata->recentList);
+        second = &(metadata->frequentList);
+    }
+
+    int victim = firstEvictable(metadata, first);
+    return (victim != -1) ? victim : firstEvictable(metadata, second);  // -1 if all frames were pinned
+}
+
+BM_PageFrame *replacementFIFO(BM_BufferPool *const bm)
+{
+    int victim = victimFIFO(bm);
 
     // Use switch-case to handle the case where all frames might be pinned
-    switch (minIndex)
+    switch (victim)
     {
         case -1:
-            return NULL;  // All frames were pinned
+            return NULL;
         default:
-            return getAfterEviction(bm, minIndex);
+            return getAfterEviction(bm, victim);
     }
 }
 
-/* Helpers */
-
-TimeStamp getTimeStamp(BM_Metadata *metadata)
+BM_PageFrame *replacementLRU(BM_BufferPool *const bm)
 {
-    // A switch-case example that logically does nothing different but demonstrates the syntax
-    switch (metadata != NULL)
+    int victim = victimLRU(bm);
+
+    // Use switch-case to handle the case where all frames might be pinned
+    switch (victim)
     {
-        case true:
-            return metadata->timeStamp++;
+        case -1:
+            return NULL;  // All frames were pinned
         default:
-            // This case should logically never happen if the function is used correctly
-            return 0;  // Returning a default timestamp in case of an error (unexpected)
+            return getAfterEviction(bm, victim);
     }
 }
 
-BM_PageFrame *getAfterEviction(BM_BufferPool *const bm, int frameIndex)
+BM_PageFrame *replacementCLOCK(BM_BufferPool *const bm)
 {
-    BM_Metadata *metadata = (BM_Metadata *)bm->mgmtData;
-    BM_PageFrame *pageFrames = metadata->pageFrames;
-    HT_TableHandle *pageTabe = &(metadata->pageTable);
+    int victim = victimCLOCK(bm);
 
-    // Update timestamp
-    pageFrames[frameIndex].timeStamp = getTimeStamp(metadata);
-
-    // Use switch-case to handle the occupied status of the page frame
-    switch (pageFrames[frameIndex].occupied)
+    // Use switch-case to handle the case where all frames might be pinned
+    switch (victim)
     {
-        case true:
-            // Remove old mapping
-            removePair(pageTabe, pageFrames[frameIndex].pageNum);
+        case -1:
+            return NULL;  // All frames were pinned
+        default:
+            return getAfterEviction(bm, victim);
+    }
+}
 
-            // Write old frame back to disk if it's dirty
+BM_PageFrame *replacementLRUK(BM_BufferPool *const bm)
+{
+    int victim = victimLRUK(bm);
+
+    // Use switch-case to handle the case where all frames might be pinned
+    switch (victim)
+    {
+        case -1:
+            return NULL;  // All frames were pinned
+        default:
+            return getAfterEviction(bm, victim);
+    }
+}
+
+BM_PageFrame *replacementLFU(BM_BufferPool *const bm)
+{
+    int victim = victimLFU(bm);
+
+    // Use switch-case to handle the case where all frames might be pinned
+    switch (victim)
+    {
+        case -1:
+            return NULL;  // All frames were pinned
+        default:
+            return getAfterEviction(bm, victim);
+    }
+}
+
+BM_PageFrame *replacementARC(BM_BufferPool *const bm)
+{
+    int victim = victimARC(bm);
+
+    // Use switch-case to handle the case where all frames might be pinned
+    switch (victim)
+    {
+        case -1:
+            return NULL;  // All frames were pinned
+        default:
+            return getAfterEviction(bm, victim);
+    }
+}
+
+BM_PageFrame *replacement2Q(BM_BufferPool *const bm)
+{
+    int victim = victim2Q(bm);
+
+    // Use switch-case to handle the case where all frames might be pinned
+    switch (victim)
+    {
+        case -1:
+            return NULL;  // All frames were pinned
+        default:
+            return getAfterEviction(bm, victim);
+    }
+}
+
+RC loadPage(BM_BufferPool *const bm, PageNumber pageNum, int *frameIndex)
+{
+    BM_Metadata *metadata = (BM_Metadata *)bm->mgmtData;
+    BM_PageFrame *pageFrames = metadata->pageFrames;
+    BM_PageTableShard *shard = shardFor(metadata, pageNum);
+
+    // a miss looks again after waiting for pages being read ahead, which the strategies
+    // pass over: if only they were left, their reads are collected first
+    BM_PageFrame *pageFrame;
+    while (true)
+    {
+        // a page still being read is waited for (a failed read ahead unmaps it, so it is
+        // then read again below); the page may also be one another pin's eviction is still
+        // writing back, and any wait lets other pins bring the page in meanwhile
+        while (true)
+        {
+            while (lookupFrame(metadata, pageNum, frameIndex) == 0 && pageFrames[*frameIndex].loading)
+            {
+                if (pageFrames[*frameIndex].prefetched) reapCompletions(metadata, 1);
+                else pthread_cond_wait(&(metadata->loadDone), &(metadata->poolLock));
+            }
+            if (lookupFrame(metadata, pageNum, frameIndex) == 0 || metadata->writeBackData == NULL) break;
+            finishWriteBack(metadata);
+        }
+
+        if (lookupFrame(metadata, pageNum, frameIndex) == 0)
+        {
+            // another pin brought the page in meanwhile
+            pthread_mutex_lock(&(shard->lock));
+            pageFrames[*frameIndex].fixCount++;
+            pthread_mutex_unlock(&(shard->lock));
+            touchFrame(metadata, &(pageFrames[*frameIndex]));
+            pageFrames[*frameIndex].referenced = true;
+            noteReference(metadata, &(pageFrames[*frameIndex]));
+
+            // reaching a read-ahead page keeps the sequential run going
+            if (pageFrames[*frameIndex].prefetched)
+            {
+                pageFrames[*frameIndex].prefetched = false;
+                readAhead(bm, pageNum);
+            }
+            return RC_OK;
+        }
+
+        // Page is not in a frame, use replacement strategy (with the unpins queued while
+        // waiting applied)
+        applyAccesses(metadata);
+        switch (bm->strategy)
+        {
+            case RS_FIFO:
+                pageFrame = replacementFIFO(bm);
+                break;
+            case RS_LRU:
+                pageFrame = replacementLRU(bm);
+                break;
+            case RS_CLOCK:
+                pageFrame = replacementCLOCK(bm);
+                break;
+            case RS_LRU_K:
+                pageFrame = replacementLRUK(bm);
+                break;
+            case RS_LFU:
+                pageFrame = replacementLFU(bm);
+                break;
+            case RS_ARC:
+                pageFrame = replacementARC(bm);
+                break;
+            case RS_2Q:
+                pageFrame = replacement2Q(bm);
+                break;
+            default:
+                return RC_IM_CONFIG_ERROR; // Configuration error if no strategy fits
+        }
+
+        if (pageFrame != NULL || metadata->numLoading == 0) break;
+        reapCompletions(metadata, 1);
+    }
+
+    // Check if the replacement strategy succeeded
+    if (pageFrame == NULL)
+        return RC_WRITE_FAILED;
+
+    // Successful replacement, setup new frame; it is fixed and loading before its page
+    // can be found, so other pins of the page wait for the read below
+    pageFrame->dirty = false;
+    pageFrame->pageLSN = pageFrame->recLSN = 0;
+    pageFrame->fixCount = 1;
+    pageFrame->referenced = true;
+    pageFrame->occupied = true;
+    pageFrame->loading = true;
+    pageFrame->prefetched = false;
+    pageFrame->pageNum = pageNum;
+
+    pthread_mutex_lock(&(shard->lock));
+    bool mapped = mapPage(metadata, pageNum, pageFrame->frameIndex) == 0;
+    pthread_mutex_unlock(&(shard->lock));
+    if (!mapped)
+    {
+        finishWriteBack(metadata);
+        pageFrame->fixCount = 0;
+        pageFrame->occupied = false;
+        pageFrame->loading = false;
+        noteFrameState(metadata, pageFrame);
+        return RC_ALLOCATION_FAILED;
+    }
+    ensureCapacity(pageNum + 1, &(metadata->pageFile));
+    noteLoad(metadata, pageFrame);
+    noteFrameState(metadata, pageFrame);
+
+    // the read does not hold up the rest of the pool
+    pthread_mutex_unlock(&(metadata->poolLock));
+    readBlock(pageNum, &(metadata->pageFile), pageFrame->data);
+    lockPool(metadata);
+    metadata->numRead++;
+
+    // the evicted page's write-back ran alongside the read
+    finishWriteBack(metadata);
+
+    pthread_mutex_lock(&(shard->lock));
+    pageFrame->loading = false;
+    frameChanged(pageFrame);
+    pthread_mutex_unlock(&(shard->lock));
+    pthread_cond_broadcast(&(metadata->loadDone));
+    noteReference(metadata, pageFrame);
+    *frameIndex = pageFrame->frameIndex;
+
+    readAhead(bm, pageNum);
+    return RC_OK;
+}
+
+int selectVictim(BM_BufferPool *const bm)
+{
+    // the pool lock may have been given up since it was taken
+    applyAccesses((BM_Metadata *)bm->mgmtData);
+    switch (bm->strategy)
+    {
+        case RS_FIFO:
+            return victimFIFO(bm);
+        case RS_LRU:
+            return victimLRU(bm);
+        case RS_CLOCK:
+            return victimCLOCK(bm);
+        case RS_LRU_K:
+            return victimLRUK(bm);
+        case RS_LFU:
+            return victimLFU(bm);
+        case RS_ARC:
+            return victimARC(bm);
+        case RS_2Q:
+            return victim2Q(bm);
+        default:
+            return -1;
+    }
+}
+
+/* Helpers */
+
+TimeStamp getTimeStamp(BM_Metadata *metadata)
+{
+    // A switch-case example that logically does nothing different but demonstrates the syntax
+    switch (metadata != NULL)
+    {
+        case true:
+            return metadata->timeStamp++;
+        default:
+            // This case should logically never happen if the function is used correctly
+            return 0;  // Returning a default timestamp in case of an error (unexpected)
+    }
+}
+
+void touchFrame(BM_Metadata *metadata, BM_PageFrame *pageFrame)
+{
+    pageFrame->timeStamp = getTimeStamp(metadata);
+
+    // the LRU list stays in timestamp order
+    if (metadata->strategy == RS_LRU && pageFrame->list != NULL)
+    {
+        listRemove(metadata, pageFrame);
+        listAppend(metadata, &(metadata->lruList), pageFrame);
+    }
+}
+
+void frameChanging(BM_PageFrame *pageFrame)
+{
+    // only one thread changes a frame at a time: the one holding it exclusively, or
+    // loading or evicting it under the pool lock
+    uint64_t version = pageFrame->version;
+    if ((version & 1) == 0)
+    {
+        __atomic_store_n(&(pageFrame->version), version + 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);  // before the data changes
+    }
+}
+
+void frameChanged(BM_PageFrame *pageFrame)
+{
+    uint64_t version = pageFrame->version;
+    if ((version & 1) == 1) __atomic_store_n(&(pageFrame->version), version + 1, __ATOMIC_RELEASE);
+}
+
+uint64_t reserveAccess(BM_Metadata *metadata)
+{
+    while (true)
+    {
+        // a place is only taken while the log has room for it, so it was applied already
+        uint64_t tail = __atomic_load_n(&(metadata->accessTail), __ATOMIC_RELAXED);
+        if (tail - __atomic_load_n(&(metadata->accessHead), __ATOMIC_ACQUIRE) >= ACCESS_LOG_SIZE)
+        {
+            lockPool(metadata);
+            pthread_mutex_unlock(&(metadata->poolLock));
+        }
+        else if (__atomic_compare_exchange_n(&(metadata->accessTail), &tail, tail + 1, false,
+                                             __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+        {
+            return tail;
+        }
+    }
+}
+
+void publishAccess(BM_Metadata *metadata, uint64_t ticket, BM_AccessKind kind, int frameIndex, PageNumber pageNum)
+{
+    BM_Access *access = &(metadata->accessLog[ticket % ACCESS_LOG_SIZE]);
+    access->kind = kind;
+    access->frameIndex = frameIndex;
+    access->pageNum = pageNum;
+    __atomic_store_n(&(access->ticket), ticket + 1, __ATOMIC_RELEASE);
+}
+
+void applyAccesses(BM_Metadata *metadata)
+{
+    BM_PageFrame *pageFrames = metadata->pageFrames;
+    uint64_t tail = __atomic_load_n(&(metadata->accessTail), __ATOMIC_ACQUIRE);
+
+    // in ticket order, so the strategy sees what a single thread would have shown it
+    for (uint64_t ticket = metadata->accessHead; ticket < tail; ticket++)
+    {
+        // a place is filled in right after it was taken, without waiting for anything
+        BM_Access *access = &(metadata->accessLog[ticket % ACCESS_LOG_SIZE]);
+        while (__atomic_load_n(&(access->ticket), __ATOMIC_ACQUIRE) != ticket + 1) sched_yield();
+
+        // the page may have left the frame since (or be coming back into it)
+        BM_PageFrame *pageFrame = (access->kind != BM_ACCESS_NONE) ? &(pageFrames[access->frameIndex]) : NULL;
+        if (pageFrame != NULL && pageFrame->occupied && !pageFrame->loading && pageFrame->pageNum == access->pageNum)
+        {
+            touchFrame(metadata, pageFrame);
+            switch (access->kind)
+            {
+                case BM_ACCESS_PIN:
+                    pageFrame->referenced = true;
+                    noteReference(metadata, pageFrame);
+                    break;
+                case BM_ACCESS_UNPIN:
+                    noteFrameState(metadata, pageFrame);
+                    break;
+                default:
+                    break;
+            }
+        }
+        __atomic_store_n(&(metadata->accessHead), ticket + 1, __ATOMIC_RELEASE);
+    }
+}
+
+void lockPool(BM_Metadata *metadata)
+{
+    pthread_mutex_lock(&(metadata->poolLock));
+    applyAccesses(metadata);
+}
+
+void latchFrame(BM_PageTableShard *shard, BM_PageFrame *pageFrame, BM_PinIntent intent)
+{
+    // the pin's fix keeps the page in the frame (and so in the shard) while it waits
+    if (intent == BM_PIN_WRITE)
+    {
+        while (pageFrame->latchExclusive || pageFrame->latchShared > 0) pthread_cond_wait(&(shard->latchFree), &(shard->lock));
+        pageFrame->latchExclusive = true;
+    }
+    else
+    {
+        while (pageFrame->latchExclusive) pthread_cond_wait(&(shard->latchFree), &(shard->lock));
+        pageFrame->latchShared++;
+    }
+}
+
+void unlatchFrame(BM_PageTableShard *shard, BM_PageFrame *pageFrame)
+{
+    if (pageFrame->latchExclusive) pageFrame->latchExclusive = false;
+    else if (pageFrame->latchShared > 0) pageFrame->latchShared--;
+    pthread_cond_broadcast(&(shard->latchFree));
+}
+
+void cleanFrame(BM_Metadata *metadata, BM_PageFrame *pageFrame, uint64_t dirtyGeneration)
+{
+    BM_PageTableShard *shard = shardFor(metadata, pageFrame->pageNum);
+    pthread_mutex_lock(&(shard->lock));
+    if (pageFrame->dirtyGeneration == dirtyGeneration)
+    {
+        pageFrame->dirty = false;
+        pageFrame->recLSN = 0;
+    }
+    pthread_mutex_unlock(&(shard->lock));
+}
+
+BM_PageFrame *getAfterEviction(BM_BufferPool *const bm, int frameIndex)
+{
+    BM_Metadata *metadata = (BM_Metadata *)bm->mgmtData;
+    BM_PageFrame *pageFrames = metadata->pageFrames;
+
+    // Remove old mapping, unless the page was fixed since the victim was picked (pins of
+    // pages in a frame do not wait for the pool lock), then another victim is picked
+    uint64_t flushedLSN = 0;
+    while (pageFrames[frameIndex].occupied)
+    {
+        BM_PageTableShard *shard = shardFor(metadata, pageFrames[frameIndex].pageNum);
+        pthread_mutex_lock(&(shard->lock));
+        bool pinned = pageFrames[frameIndex].fixCount > 0;
+        uint64_t pageLSN = pageFrames[frameIndex].dirty ? pageFrames[frameIndex].pageLSN : 0;
+        bool logged = pageLSN <= flushedLSN;
+        if (!pinned && logged)
+        {
+            unmapPage(metadata, pageFrames[frameIndex].pageNum);
+            frameChanging(&(pageFrames[frameIndex]));
+        }
+        pthread_mutex_unlock(&(shard->lock));
+        if (!pinned && logged) break;
+
+        // the log records a dirty page was changed under go first (the page is looked at
+        // again after, a pin may have changed it meanwhile); a page they cannot be made
+        // durable for is not written (nor evicted), the caller's pin fails instead
+        if (!pinned)
+        {
+            if (flushLogFor(metadata, pageLSN) != RC_OK) return NULL;
+            flushedLSN = pageLSN;
+            continue;
+        }
+
+        noteFrameState(metadata, &(pageFrames[frameIndex]));
+        frameIndex = selectVictim(bm);
+        if (frameIndex == -1) return NULL;
+        flushedLSN = 0;
+    }
+
+    // Update timestamp
+    touchFrame(metadata, &(pageFrames[frameIndex]));
+    pageFrames[frameIndex].prefetched = false;
+
+    // Use switch-case to handle the occupied status of the page frame
+    switch (pageFrames[frameIndex].occupied)
+    {
+        case true:
+
+            // Write old frame back to disk if it's dirty
             switch (pageFrames[frameIndex].dirty)
             {
                 case true:
-                    writeBlock(pageFrames[frameIndex].pageNum, &(metadata->pageFile), pageFrames[frameIndex].data);
+                    // start the write asynchronously and give the frame the spare buffer, so the
+                    // caller's read of the new page overlaps the write (see finishWriteBack)
+                    if (metadata->spareData != NULL
+                        && submitWrite(pageFrames[frameIndex].pageNum, &(metadata->pageFile), pageFrames[frameIndex].data, NULL) == RC_OK)
+                    {
+                        metadata->writeBackData = pageFrames[frameIndex].data;
+                        pageFrames[frameIndex].data = metadata->spareData;
+                        metadata->spareData = NULL;
+                    }
+                    else if (writeBlock(pageFrames[frameIndex].pageNum, &(metadata->pageFile), pageFrames[frameIndex].data) != RC_OK)
+                    {
+                        // the page stays in its frame (still dirty) and the pin fails
+                        BM_PageTableShard *shard = shardFor(metadata, pageFrames[frameIndex].pageNum);
+                        pthread_mutex_lock(&(shard->lock));
+                        if (mapPage(metadata, pageFrames[frameIndex].pageNum, frameIndex) != 0)
+                        {
+                            pageFrames[frameIndex].occupied = false;  // nowhere to keep it, it is lost
+                            if (metadata->writeBackResult == RC_OK) metadata->writeBackResult = RC_WRITE_FAILED;
+                        }
+                        frameChanged(&(pageFrames[frameIndex]));
+                        pthread_mutex_unlock(&(shard->lock));
+                        noteFrameState(metadata, &(pageFrames[frameIndex]));
+                        return NULL;
+                    }
                     metadata->numWrite++;
+
+                    // the cleaner did not keep up
+                    if (metadata->cleanReserve > 0) pthread_cond_signal(&(metadata->cleanerWake));
                     break;
                 default:
                     break;
@@ -554,6 +1858,825 @@ BM_PageFrame *getAfterEviction(BM_BufferPool *const bm, int frameIndex)
             break;
     }
 
+    // e.g. LRU-K keeps the history of the page leaving
+    if (pageFrames[frameIndex].occupied) noteEviction(metadata, &(pageFrames[frameIndex]));
+
     // Return the evicted frame (caller must deal with setting the page's metadata)
     return &(pageFrames[frameIndex]);
 }
+
+BM_PageTableShard *shardFor(BM_Metadata *metadata, PageNumber pageNum)
+{
+    // consecutive pages land in different shards, so a scan does not queue on one lock
+    return &(metadata->shards[(unsigned int)pageNum % PAGE_TABLE_SHARDS]);
+}
+
+int lookupFrame(BM_Metadata *metadata, PageNumber pageNum, int *frameIndex)
+{
+    BM_PageTableShard *shard = shardFor(metadata, pageNum);
+    if (!metadata->directPageTable) return getValue(&(shard->table), pageNum, frameIndex);
+    if (pageNum < 0) return 1;
+
+    int slot = pageNum / PAGE_TABLE_SHARDS;
+    int chunk = slot >> DIRECT_CHUNK_SHIFT;
+    if (chunk >= shard->numDirectChunks || shard->directChunks[chunk] == NULL) return 1;
+    *frameIndex = shard->directChunks[chunk][slot & (DIRECT_CHUNK_PAGES - 1)];
+    return (*frameIndex == -1) ? 1 : 0;
+}
+
+int mapPage(BM_Metadata *metadata, PageNumber pageNum, int frameIndex)
+{
+    BM_PageTableShard *shard = shardFor(metadata, pageNum);
+    if (!metadata->directPageTable) return setValue(&(shard->table), pageNum, frameIndex);
+    if (pageNum < 0) return 1;
+
+    // the directory grows with the file (ensureCapacity), at least doubling each time
+    int slot = pageNum / PAGE_TABLE_SHARDS;
+    int chunk = slot >> DIRECT_CHUNK_SHIFT;
+    if (chunk >= shard->numDirectChunks)
+    {
+        int slots = (metadata->pageFile.totalNumPages + PAGE_TABLE_SHARDS - 1) / PAGE_TABLE_SHARDS;
+        int numChunks = (slots + DIRECT_CHUNK_PAGES - 1) >> DIRECT_CHUNK_SHIFT;
+        if (numChunks < 2 * shard->numDirectChunks) numChunks = 2 * shard->numDirectChunks;
+        if (numChunks <= chunk) numChunks = chunk + 1;
+
+        int **directChunks = (int **)realloc(shard->directChunks, sizeof(int *) * numChunks);
+        if (directChunks == NULL) return 1;
+        for (int i = shard->numDirectChunks; i < numChunks; i++) directChunks[i] = NULL;
+        shard->directChunks = directChunks;
+        shard->numDirectChunks = numChunks;
+    }
+
+    if (shard->directChunks[chunk] == NULL)
+    {
+        shard->directChunks[chunk] = (int *)malloc(sizeof(int) * DIRECT_CHUNK_PAGES);
+        if (shard->directChunks[chunk] == NULL) return 1;
+        memset(shard->directChunks[chunk], 0xff, sizeof(int) * DIRECT_CHUNK_PAGES);  // all -1
+    }
+    shard->directChunks[chunk][slot & (DIRECT_CHUNK_PAGES - 1)] = frameIndex;
+    return 0;
+}
+
+void unmapPage(BM_Metadata *metadata, PageNumber pageNum)
+{
+    BM_PageTableShard *shard = shardFor(metadata, pageNum);
+    int frameIndex;
+    if (!metadata->directPageTable) removePair(&(shard->table), pageNum);
+    else if (lookupFrame(metadata, pageNum, &frameIndex) == 0)
+    {
+        int slot = pageNum / PAGE_TABLE_SHARDS;
+        shard->directChunks[slot >> DIRECT_CHUNK_SHIFT][slot & (DIRECT_CHUNK_PAGES - 1)] = -1;
+    }
+}
+
+RC flushLogFor(BM_Metadata *metadata, uint64_t pageLSN)
+{
+    if (metadata->flushLog == NULL || pageLSN == 0) return RC_OK;
+    return metadata->flushLog(metadata->logData, pageLSN);
+}
+
+void noteFrameState(BM_Metadata *metadata, BM_PageFrame *pageFrame)
+{
+    switch (metadata->strategy)
+    {
+        case RS_LRU:
+            lruReposition(metadata, pageFrame);
+            break;
+        case RS_LRU_K:
+            lruKReposition(metadata, pageFrame);
+            break;
+        case RS_LFU:
+            lfuReposition(metadata, pageFrame);
+            break;
+        case RS_ARC:
+        case RS_2Q:
+            if (!pageFrame->occupied) adaptiveFree(metadata, pageFrame);
+            break;
+        default:
+            break;
+    }
+}
+
+void noteReference(BM_Metadata *metadata, BM_PageFrame *pageFrame)
+{
+    switch (metadata->strategy)
+    {
+        case RS_LRU:
+            lruReposition(metadata, pageFrame);
+            break;
+        case RS_LRU_K:
+            lruKReference(metadata, pageFrame);
+            break;
+        case RS_LFU:
+            lfuReference(metadata, pageFrame);
+            break;
+        case RS_ARC:
+            arcReference(metadata, pageFrame);
+            break;
+        case RS_2Q:
+            twoQReference(metadata, pageFrame);
+            break;
+        default:
+            break;
+    }
+}
+
+void noteEviction(BM_Metadata *metadata, BM_PageFrame *pageFrame)
+{
+    switch (metadata->strategy)
+    {
+        case RS_LRU_K:
+            lruKRemember(metadata, pageFrame);
+            break;
+        case RS_LFU:
+            // the next page starts without uses
+            pageFrame->useCount = 0;
+            lfuReposition(metadata, pageFrame);
+            break;
+        case RS_ARC:
+        case RS_2Q:
+            adaptiveEvict(metadata, pageFrame);
+            break;
+        default:
+            break;
+    }
+}
+
+void noteLoad(BM_Metadata *metadata, BM_PageFrame *pageFrame)
+{
+    switch (metadata->strategy)
+    {
+        case RS_LRU_K:
+            lruKRecall(metadata, pageFrame);
+            break;
+        case RS_ARC:
+        case RS_2Q:
+            // off the free list; a demand-read page is placed by the pin that follows
+            listRemove(metadata, pageFrame);
+            if (pageFrame->prefetched) listAppend(metadata, &(metadata->recentList), pageFrame);
+            break;
+        default:
+            break;
+    }
+}
+
+void initFrameList(BM_FrameList *list)
+{
+    list->head = list->tail = -1;
+    list->size = 0;
+}
+
+void listAppend(BM_Metadata *metadata, BM_FrameList *list, BM_PageFrame *pageFrame)
+{
+    pageFrame->list = list;
+    pageFrame->listPrev = list->tail;
+    pageFrame->listNext = -1;
+    if (list->tail != -1) metadata->pageFrames[list->tail].listNext = pageFrame->frameIndex;
+    else list->head = pageFrame->frameIndex;
+    list->tail = pageFrame->frameIndex;
+    list->size++;
+}
+
+void listRemove(BM_Metadata *metadata, BM_PageFrame *pageFrame)
+{
+    BM_FrameList *list = pageFrame->list;
+    if (list == NULL) return;
+
+    if (pageFrame->listPrev != -1) metadata->pageFrames[pageFrame->listPrev].listNext = pageFrame->listNext;
+    else list->head = pageFrame->listNext;
+    if (pageFrame->listNext != -1) metadata->pageFrames[pageFrame->listNext].listPrev = pageFrame->listPrev;
+    else list->tail = pageFrame->listPrev;
+    list->size--;
+    pageFrame->list = NULL;
+}
+
+int firstEvictable(BM_Metadata *metadata, BM_FrameList *list)
+{
+    BM_PageFrame *pageFrames = metadata->pageFrames;
+    int frameIndex = list->head;
+    while (frameIndex != -1 && (pageFrames[frameIndex].fixCount > 0 || pageFrames[frameIndex].loading))
+        frameIndex = pageFrames[frameIndex].listNext;
+    return frameIndex;
+}
+
+void ghostAppend(BM_Metadata *metadata, BM_GhostList *list, PageNumber pageNum)
+{
+    BM_Ghost *ghosts = metadata->ghosts;
+
+    int ghost = ghostFind(metadata, pageNum);
+    if (ghost != -1) ghostRemove(metadata, ghost);
+    if (metadata->freeGhost == -1)
+        ghostRemove(metadata, (metadata->frequentGhosts.size > 0) ? metadata->frequentGhosts.head : metadata->recentGhosts.head);
+
+    ghost = metadata->freeGhost;
+    metadata->freeGhost = ghosts[ghost].next;
+    ghosts[ghost].pageNum = pageNum;
+    ghosts[ghost].list = list;
+    ghosts[ghost].prev = list->tail;
+    ghosts[ghost].next = -1;
+    if (list->tail != -1) ghosts[list->tail].next = ghost;
+    else list->head = ghost;
+    list->tail = ghost;
+    list->size++;
+    setValue(&(metadata->ghostTable), pageNum, ghost);
+}
+
+int ghostFind(BM_Metadata *metadata, PageNumber pageNum)
+{
+    int ghost;
+    return (getValue(&(metadata->ghostTable), pageNum, &ghost) == 0) ? ghost : -1;
+}
+
+void ghostRemove(BM_Metadata *metadata, int ghost)
+{
+    BM_Ghost *ghosts = metadata->ghosts;
+    BM_GhostList *list = ghosts[ghost].list;
+
+    if (ghosts[ghost].prev != -1) ghosts[ghosts[ghost].prev].next = ghosts[ghost].next;
+    else list->head = ghosts[ghost].next;
+    if (ghosts[ghost].next != -1) ghosts[ghosts[ghost].next].prev = ghosts[ghost].prev;
+    else list->tail = ghosts[ghost].prev;
+    list->size--;
+    removePair(&(metadata->ghostTable), ghosts[ghost].pageNum);
+
+    ghosts[ghost].next = metadata->freeGhost;
+    metadata->freeGhost = ghost;
+}
+
+void lruReposition(BM_Metadata *metadata, BM_PageFrame *pageFrame)
+{
+    // a frame being read ahead keeps its place, victimLRU passes over it
+    if (pageFrame->fixCount > 0) listRemove(metadata, pageFrame);
+    else if (pageFrame->list == NULL) listAppend(metadata, &(metadata->lruList), pageFrame);
+}
+
+void lfuReposition(BM_Metadata *metadata, BM_PageFrame *pageFrame)
+{
+    // take the frame out of its list and append it to the list of its count if it can be evicted
+    listRemove(metadata, pageFrame);
+    if (pageFrame->fixCount == 0 && !pageFrame->loading)
+    {
+        listAppend(metadata, &(metadata->lfuBuckets[pageFrame->useCount]), pageFrame);
+        if (pageFrame->useCount < metadata->lfuLowest) metadata->lfuLowest = pageFrame->useCount;
+    }
+}
+
+void lfuReference(BM_Metadata *metadata, BM_PageFrame *pageFrame)
+{
+    if (pageFrame->useCount < LFU_MAX_COUNT) pageFrame->useCount++;
+
+    // every frame's worth of pins costs one pass over the frames, so aging stays O(1) per pin
+    if (++metadata->lfuPins >= LFU_AGING_PINS * metadata->numFrames) lfuAge(metadata);
+    lfuReposition(metadata, pageFrame);
+}
+
+void lfuAge(BM_Metadata *metadata)
+{
+    BM_PageFrame *pageFrames = metadata->pageFrames;
+    metadata->lfuPins = 0;
+
+    // pinned frames are in no list, halve them directly
+    for (int i = 0; i < metadata->numFrames; i++)
+        if (pageFrames[i].list == NULL) pageFrames[i].useCount /= 2;
+
+    // every list moves to half its count, behind what is there already; lists are
+    // emptied from the lowest count up, so none is moved twice
+    for (int count = 0; count <= LFU_MAX_COUNT; count++)
+    {
+        int frameIndex = metadata->lfuBuckets[count].head;
+        initFrameList(&(metadata->lfuBuckets[count]));
+        while (frameIndex != -1)
+        {
+            int next = pageFrames[frameIndex].listNext;
+            pageFrames[frameIndex].list = NULL;
+            pageFrames[frameIndex].useCount = count / 2;
+            lfuReposition(metadata, &(pageFrames[frameIndex]));
+            frameIndex = next;
+        }
+    }
+    metadata->lfuLowest = 0;
+}
+
+void adaptiveFree(BM_Metadata *metadata, BM_PageFrame *pageFrame)
+{
+    if (pageFrame->list == &(metadata->freeList)) return;
+    listRemove(metadata, pageFrame);
+    listAppend(metadata, &(metadata->freeList), pageFrame);
+}
+
+void arcReference(BM_Metadata *metadata, BM_PageFrame *pageFrame)
+{
+    int capacity = metadata->numFrames;
+    BM_GhostList *recentGhosts = &(metadata->recentGhosts);
+    BM_GhostList *frequentGhosts = &(metadata->frequentGhosts);
+
+    // a page referenced again goes to the most recently used end of T2
+    if (pageFrame->list != NULL && !pageFrame->prefetched)
+    {
+        listRemove(metadata, pageFrame);
+        listAppend(metadata, &(metadata->frequentList), pageFrame);
+        return;
+    }
+
+    // the first reference since the page came in: a ghost hit means the list it was
+    // evicted from was too small, so T1's target moves towards that list
+    listRemove(metadata, pageFrame);
+    int ghost = ghostFind(metadata, pageFrame->pageNum);
+    if (ghost != -1)
+    {
+        if (metadata->ghosts[ghost].list == recentGhosts)
+        {
+            int step = (frequentGhosts->size > recentGhosts->size) ? frequentGhosts->size / recentGhosts->size : 1;
+            metadata->arcTarget = (metadata->arcTarget + step < capacity) ? metadata->arcTarget + step : capacity;
+        }
+        else
+        {
+            int step = (recentGhosts->size > frequentGhosts->size) ? recentGhosts->size / frequentGhosts->size : 1;
+            metadata->arcTarget = (metadata->arcTarget - step > 0) ? metadata->arcTarget - step : 0;
+        }
+        ghostRemove(metadata, ghost);
+        listAppend(metadata, &(metadata->frequentList), pageFrame);
+        return;
+    }
+
+    // a new page goes to T1; T1 and B1 together stay within the pool's size and all four
+    // lists within twice that
+    while (recentGhosts->size > 0 && metadata->recentList.size + recentGhosts->size >= capacity)
+        ghostRemove(metadata, recentGhosts->head);
+    while (frequentGhosts->size > 0 && metadata->recentList.size + metadata->frequentList.size
+           + recentGhosts->size + frequentGhosts->size >= 2 * capacity)
+        ghostRemove(metadata, frequentGhosts->head);
+    listAppend(metadata, &(metadata->recentList), pageFrame);
+}
+
+void twoQReference(BM_Metadata *metadata, BM_PageFrame *pageFrame)
+{
+    // Am is kept in LRU order, A1in in the order pages came in
+    if (pageFrame->list != NULL && !pageFrame->prefetched)
+    {
+        if (pageFrame->list == &(metadata->frequentList))
+        {
+            listRemove(metadata, pageFrame);
+            listAppend(metadata, &(metadata->frequentList), pageFrame);
+        }
+        return;
+    }
+
+    // the first reference since the page came in: a page remembered by A1out was
+    // referenced again after leaving A1in, so it belongs to Am
+    int ghost = ghostFind(metadata, pageFrame->pageNum);
+    if (ghost != -1)
+    {
+        ghostRemove(metadata, ghost);
+        listRemove(metadata, pageFrame);
+        listAppend(metadata, &(metadata->frequentList), pageFrame);
+    }
+    else if (pageFrame->list == NULL) listAppend(metadata, &(metadata->recentList), pageFrame);
+}
+
+void adaptiveEvict(BM_Metadata *metadata, BM_PageFrame *pageFrame)
+{
+    if (metadata->strategy == RS_ARC)
+    {
+        if (pageFrame->list == &(metadata->recentList)) ghostAppend(metadata, &(metadata->recentGhosts), pageFrame->pageNum);
+        else if (pageFrame->list == &(metadata->frequentList)) ghostAppend(metadata, &(metadata->frequentGhosts), pageFrame->pageNum);
+    }
+    else if (pageFrame->list == &(metadata->recentList))
+    {
+        // only pages leaving A1in are remembered, and only so many of them
+        ghostAppend(metadata, &(metadata->recentGhosts), pageFrame->pageNum);
+        while (metadata->recentGhosts.size > metadata->numFrames * TWO_Q_OUT_PERCENT / 100)
+            ghostRemove(metadata, metadata->recentGhosts.head);
+    }
+
+    // the frame stays empty unless a page is put into it
+    adaptiveFree(metadata, pageFrame);
+}
+
+// whether frame a goes before frame b: the older K-th reference, then the older last one
+bool lruKBefore(BM_Metadata *metadata, int a, int b)
+{
+    TimeStamp *historyA = metadata->pageFrames[a].history;
+    TimeStamp *historyB = metadata->pageFrames[b].history;
+    int k = metadata->lruK - 1;
+    if (historyA[k] != historyB[k]) return historyA[k] < historyB[k];
+    return historyA[0] < historyB[0];
+}
+
+// helper to put the heap entry at index into place, moving it up or down
+void lruKSift(BM_Metadata *metadata, int index)
+{
+    int *heap = metadata->heap;
+    BM_PageFrame *pageFrames = metadata->pageFrames;
+
+    while (index > 0 && lruKBefore(metadata, heap[index], heap[(index - 1) / 2]))
+    {
+        int parent = (index - 1) / 2;
+        int frame = heap[index];
+        heap[index] = heap[parent];
+        heap[parent] = frame;
+        pageFrames[heap[index]].heapIndex = index;
+        pageFrames[heap[parent]].heapIndex = parent;
+        index = parent;
+    }
+
+    while (true)
+    {
+        int smallest = index;
+        int left = 2 * index + 1;
+        int right = left + 1;
+        if (left < metadata->heapSize && lruKBefore(metadata, heap[left], heap[smallest])) smallest = left;
+        if (right < metadata->heapSize && lruKBefore(metadata, heap[right], heap[smallest])) smallest = right;
+        if (smallest == index) break;
+
+        int frame = heap[index];
+        heap[index] = heap[smallest];
+        heap[smallest] = frame;
+        pageFrames[heap[index]].heapIndex = index;
+        pageFrames[heap[smallest]].heapIndex = smallest;
+        index = smallest;
+    }
+}
+
+void lruKReposition(BM_Metadata *metadata, BM_PageFrame *pageFrame)
+{
+    // take the frame out, then put it back if it can be evicted
+    int index = pageFrame->heapIndex;
+    if (index != -1)
+    {
+        metadata->heapSize--;
+        if (index < metadata->heapSize)
+        {
+            metadata->heap[index] = metadata->heap[metadata->heapSize];
+            metadata->pageFrames[metadata->heap[index]].heapIndex = index;
+            lruKSift(metadata, index);
+        }
+        pageFrame->heapIndex = -1;
+    }
+
+    if (pageFrame->fixCount == 0 && !pageFrame->loading)
+    {
+        index = metadata->heapSize++;
+        metadata->heap[index] = pageFrame->frameIndex;
+        pageFrame->heapIndex = index;
+        lruKSift(metadata, index);
+    }
+}
+
+void lruKReference(BM_Metadata *metadata, BM_PageFrame *pageFrame)
+{
+    TimeStamp *history = pageFrame->history;
+    TimeStamp now = pageFrame->timeStamp;
+    if (history[0] != 0 && now - history[0] <= LRU_K_CORRELATED)
+    {
+        history[0] = now;  // the same reference still going on
+    }
+    else
+    {
+        memmove(history + 1, history, sizeof(TimeStamp) * (metadata->lruK - 1));
+        history[0] = now;
+    }
+    lruKReposition(metadata, pageFrame);
+}
+
+void lruKRemember(BM_Metadata *metadata, BM_PageFrame *pageFrame)
+{
+    size_t size = sizeof(TimeStamp) * metadata->lruK;
+    TimeStamp *history = pageFrame->history;
+    if (history[0] != 0)
+    {
+        // the oldest remembered page makes room
+        int slot = metadata->evictedNext;
+        metadata->evictedNext = (slot + 1) % metadata->numFrames;
+        if (metadata->evictedPages[slot] != NO_PAGE) removePair(&(metadata->evictedTable), metadata->evictedPages[slot]);
+
+        metadata->evictedPages[slot] = pageFrame->pageNum;
+        memcpy(metadata->evictedHistory + (size_t)slot * metadata->lruK, history, size);
+        setValue(&(metadata->evictedTable), pageFrame->pageNum, slot);
+    }
+
+    // the frame starts over without references
+    memset(history, 0, size);
+    lruKReposition(metadata, pageFrame);
+}
+
+void lruKRecall(BM_Metadata *metadata, BM_PageFrame *pageFrame)
+{
+    size_t size = sizeof(TimeStamp) * metadata->lruK;
+    int slot;
+    if (getValue(&(metadata->evictedTable), pageFrame->pageNum, &slot) == 0)
+    {
+        memcpy(pageFrame->history, metadata->evictedHistory + (size_t)slot * metadata->lruK, size);
+        removePair(&(metadata->evictedTable), pageFrame->pageNum);
+        metadata->evictedPages[slot] = NO_PAGE;
+    }
+    else memset(pageFrame->history, 0, size);
+}
+
+void finishWriteBack(BM_Metadata *metadata)
+{
+    // read-aheads may complete first, so keep collecting until the write did
+    while (metadata->writeBackData != NULL) reapCompletions(metadata, 1);
+}
+
+void reapCompletions(BM_Metadata *metadata, int minCompletions)
+{
+    SM_Completion completions[READAHEAD_MAX + 1];
+
+    // one thread waits for the I/O without the pool lock, so pins of pages in the pool
+    // and misses that need no write-back go on meanwhile
+    if (metadata->reaping)
+    {
+        pthread_cond_wait(&(metadata->reapDone), &(metadata->poolLock));
+        return;
+    }
+    metadata->reaping = true;
+    pthread_mutex_unlock(&(metadata->poolLock));
+    int count = pollCompletions(&(metadata->pageFile), completions, READAHEAD_MAX + 1, minCompletions);
+    lockPool(metadata);
+    metadata->reaping = false;
+
+    for (int i = 0; i < count; i++)
+    {
+        BM_PageFrame *pageFrame = (BM_PageFrame *)completions[i].userData;
+        switch (pageFrame != NULL)
+        {
+            case true:
+            {
+                // a read-ahead page arrived; one that could not be read is dropped again
+                BM_PageTableShard *shard = shardFor(metadata, pageFrame->pageNum);
+                pthread_mutex_lock(&(shard->lock));
+                pageFrame->loading = false;
+                if (completions[i].result != RC_OK)
+                {
+                    unmapPage(metadata, pageFrame->pageNum);
+                    pageFrame->occupied = false;
+                    pageFrame->prefetched = false;
+                }
+                else frameChanged(pageFrame);
+                pthread_mutex_unlock(&(shard->lock));
+                metadata->numLoading--;
+                if (completions[i].result == RC_OK) metadata->numRead++;
+                noteFrameState(metadata, pageFrame);
+            }
+                break;
+            default:
+                // a failed write is tried once more, synchronously, from the buffer that still
+                // holds the page; failing again the page is lost, which the pool reports
+                if (completions[i].result != RC_OK
+                    && writeBlock(completions[i].pageNum, &(metadata->pageFile), metadata->writeBackData) != RC_OK
+                    && metadata->writeBackResult == RC_OK)
+                {
+                    metadata->writeBackResult = completions[i].result;
+                }
+
+                // the old buffer becomes the spare once its write completed
+                metadata->spareData = metadata->writeBackData;
+                metadata->writeBackData = NULL;
+                break;
+        }
+    }
+    pthread_cond_broadcast(&(metadata->reapDone));
+}
+
+void readAhead(BM_BufferPool *const bm, PageNumber pageNum)
+{
+    BM_Metadata *metadata = (BM_Metadata *)bm->mgmtData;
+    BM_PageFrame *pageFrames = metadata->pageFrames;
+    int frameIndex;
+
+    // two pins in a row on adjacent pages start a sequential run
+    if (pageNum != metadata->lastSequential + 1)
+    {
+        metadata->lastSequential = pageNum;
+        metadata->readaheadWindow = 0;
+        return;
+    }
+    metadata->lastSequential = pageNum;
+
+    int maxWindow = bm->numPages / 4 < READAHEAD_MAX ? bm->numPages / 4 : READAHEAD_MAX;
+    if (maxWindow < READAHEAD_MIN || metadata->readaheadOff) return;  // the pool is too small to read ahead into
+
+    if (metadata->readaheadWindow == 0)
+    {
+        metadata->readaheadWindow = READAHEAD_MIN;
+        metadata->readaheadNext = pageNum + 1;
+    }
+
+    // top the window up once the reader is half way through it
+    if (metadata->readaheadNext - pageNum > metadata->readaheadWindow / 2) return;
+
+    // a page being written back is not read before the write completed (other pins may
+    // move the window meanwhile, which is taken as it is then)
+    finishWriteBack(metadata);
+
+    PageNumber last = metadata->readaheadNext + metadata->readaheadWindow;
+    if (last > metadata->pageFile.totalNumPages) last = metadata->pageFile.totalNumPages;
+
+    while (metadata->readaheadNext < last)
+    {
+        PageNumber next = metadata->readaheadNext;
+        if (lookupFrame(metadata, next, &frameIndex) != 0)
+        {
+            // only clean frames are taken, a read ahead is not worth a write
+            int victim = selectVictim(bm);
+            if (victim == -1 || (pageFrames[victim].occupied && pageFrames[victim].dirty)) break;
+
+            BM_PageFrame *pageFrame = getAfterEviction(bm, victim);
+            if (pageFrame == NULL) break;
+
+            // the frame is loading before its page can be found
+            pageFrame->dirty = false;
+            pageFrame->pageLSN = pageFrame->recLSN = 0;
+            pageFrame->fixCount = 0;
+            pageFrame->referenced = false;  // goes first unless it is pinned before the hand comes by
+            pageFrame->occupied = true;
+            pageFrame->loading = true;
+            pageFrame->prefetched = true;
+            pageFrame->pageNum = next;
+
+            BM_PageTableShard *shard = shardFor(metadata, next);
+            pthread_mutex_lock(&(shard->lock));
+            bool mapped = mapPage(metadata, next, pageFrame->frameIndex) == 0;
+            pthread_mutex_unlock(&(shard->lock));
+            if (!mapped || submitRead(next, &(metadata->pageFile), pageFrame->data, pageFrame) != RC_OK)
+            {
+                // e.g. compressed files, which cannot be read asynchronously
+                if (mapped)
+                {
+                    pthread_mutex_lock(&(shard->lock));
+                    unmapPage(metadata, next);
+                    pthread_mutex_unlock(&(shard->lock));
+                    metadata->readaheadOff = true;
+                }
+                pageFrame->occupied = false;
+                pageFrame->loading = false;
+                pageFrame->prefetched = false;
+                noteFrameState(metadata, pageFrame);
+                break;
+            }
+            noteLoad(metadata, pageFrame);  // being read ahead is no reference
+            noteFrameState(metadata, pageFrame);
+            metadata->numLoading++;
+        }
+        metadata->readaheadNext++;
+    }
+
+    if (metadata->readaheadWindow < maxWindow)
+    {
+        metadata->readaheadWindow *= 2;
+        if (metadata->readaheadWindow > maxWindow) metadata->readaheadWindow = maxWindow;
+    }
+}
+
+/* Background Cleaning */
+
+void *cleanerMain(void *data)
+{
+    BM_Metadata *metadata = (BM_Metadata *)data;
+    BM_PageFrame *pageFrames = metadata->pageFrames;
+    int frames[CLEANER_BATCH];
+    uint64_t generations[CLEANER_BATCH];
+    SM_PageIO pages[CLEANER_BATCH];
+
+    lockPool(metadata);
+    while (!metadata->cleanerStop)
+    {
+        applyAccesses(metadata);
+
+        // sleep until the next look at the pool, or the throttle lets the next write out
+        bool urgent;
+        int wanted = cleanerBacklog(metadata, &urgent);
+        uint64_t now = getNanos();
+        uint64_t wakeAt = 0;
+        if (wanted == 0) wakeAt = now + (uint64_t)CLEANER_INTERVAL_MS * 1000000;
+        else if (!urgent && now < metadata->cleanerNextWrite) wakeAt = metadata->cleanerNextWrite;
+
+        int count = (wakeAt == 0) ? fixDirtyFrames(metadata, frames, wanted) : 0;
+        if (count == 0)
+        {
+            if (wakeAt == 0) wakeAt = now + (uint64_t)CLEANER_INTERVAL_MS * 1000000;  // all pinned
+            struct timespec deadline = { (time_t)(wakeAt / 1000000000), (long)(wakeAt % 1000000000) };
+            pthread_cond_timedwait(&(metadata->cleanerWake), &(metadata->poolLock), &deadline);
+            continue;
+        }
+
+        // the fixed frames stay where they are, so they are written without the pool lock;
+        // they stay dirty until then, so checkpoints still count them
+        uint64_t pageLSN = 0;
+        for (int i = 0; i < count; i++)
+        {
+            BM_PageFrame *pageFrame = &(pageFrames[frames[i]]);
+            BM_PageTableShard *shard = shardFor(metadata, pageFrame->pageNum);
+            pages[i].pageNum = pageFrame->pageNum;
+            pages[i].memPage = pageFrame->data;
+            pthread_mutex_lock(&(shard->lock));
+            generations[i] = pageFrame->dirtyGeneration;
+            if (pageFrame->pageLSN > pageLSN) pageLSN = pageFrame->pageLSN;
+            pthread_mutex_unlock(&(shard->lock));
+        }
+        metadata->cleaning = true;
+        RC result = flushLogFor(metadata, pageLSN);
+        pthread_mutex_unlock(&(metadata->poolLock));
+        if (result == RC_OK) result = writeBlockList(pages, count, &(metadata->pageFile));
+        lockPool(metadata);
+
+        for (int i = 0; i < count; i++)
+        {
+            // a page marked dirty again meanwhile stays dirty: the shared latch keeps pins for
+            // writing out, but a pin for reading may have changed it (also half way through
+            // the write)
+            BM_PageFrame *pageFrame = &(pageFrames[frames[i]]);
+            if (result == RC_OK)
+            {
+                metadata->numWrite++;
+                cleanFrame(metadata, pageFrame, generations[i]);
+            }
+
+            BM_PageTableShard *shard = shardFor(metadata, pageFrame->pageNum);
+            pthread_mutex_lock(&(shard->lock));
+            pageFrame->fixCount--;
+            unlatchFrame(shard, pageFrame);
+            pthread_mutex_unlock(&(shard->lock));
+            noteFrameState(metadata, pageFrame);
+        }
+        metadata->cleaning = false;
+        pthread_cond_broadcast(&(metadata->cleanerDone));
+
+        // a failed write is retried at the next look
+        if (result != RC_OK) metadata->cleanerNextWrite = getNanos() + (uint64_t)CLEANER_INTERVAL_MS * 1000000;
+        else if (metadata->cleanPagesPerSecond > 0)
+            metadata->cleanerNextWrite = getNanos() + (uint64_t)count * 1000000000 / metadata->cleanPagesPerSecond;
+    }
+    pthread_mutex_unlock(&(metadata->poolLock));
+    return NULL;
+}
+
+int cleanerBacklog(BM_Metadata *metadata, bool *urgent)
+{
+    BM_PageFrame *pageFrames = metadata->pageFrames;
+    int numClean = 0;
+    int numDirty = 0;
+
+    // empty frames count as clean ones
+    for (int i = 0; i < metadata->numFrames; i++)
+    {
+        if (pageFrames[i].occupied && pageFrames[i].dirty) numDirty++;
+        else if (pageFrames[i].fixCount == 0 && !pageFrames[i].loading) numClean++;
+    }
+
+    // below half the reserve, misses are about to write their victims themselves
+    *urgent = numClean < (metadata->cleanReserve + 1) / 2;
+
+    int wanted = metadata->cleanReserve - numClean;
+    int overDirty = numDirty - metadata->numFrames * metadata->cleanDirtyPercent / 100;
+    if (overDirty > wanted) wanted = overDirty;
+    if (wanted > CLEANER_BATCH) wanted = CLEANER_BATCH;
+    return (wanted > 0) ? wanted : 0;
+}
+
+int fixDirtyFrames(BM_Metadata *metadata, int *frames, int wanted)
+{
+    BM_PageFrame *pageFrames = metadata->pageFrames;
+    int count = 0;
+
+    // keep the `wanted` oldest candidates, sorted by timestamp
+    for (int i = 0; i < metadata->numFrames; i++)
+    {
+        if (!pageFrames[i].occupied || !pageFrames[i].dirty || pageFrames[i].fixCount > 0 || pageFrames[i].loading)
+            continue;
+
+        int position = count;
+        while (position > 0 && pageFrames[frames[position - 1]].timeStamp > pageFrames[i].timeStamp) position--;
+        if (position == wanted) continue;
+        if (count < wanted) count++;
+        memmove(&(frames[position + 1]), &(frames[position]), sizeof(int) * (count - 1 - position));
+        frames[position] = i;
+    }
+
+    // fixed like a pin (the strategies see no reference), unless a pin came first; nobody
+    // holds or waits for the latch of an unpinned frame, so it is never waited for here
+    int fixed = 0;
+    for (int i = 0; i < count; i++)
+    {
+        BM_PageFrame *pageFrame = &(pageFrames[frames[i]]);
+        BM_PageTableShard *shard = shardFor(metadata, pageFrame->pageNum);
+        pthread_mutex_lock(&(shard->lock));
+        bool unpinned = pageFrame->fixCount == 0 && !pageFrame->latchExclusive;
+        if (unpinned)
+        {
+            pageFrame->fixCount++;
+            pageFrame->latchShared++;
+        }
+        pthread_mutex_unlock(&(shard->lock));
+        if (unpinned) frames[fixed++] = frames[i];
+    }
+    return fixed;
+}
+
+uint64_t getNanos()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + (uint64_t)now.tv_nsec;
+}
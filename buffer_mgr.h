@@ -7,13 +7,17 @@
 // Include bool DT
 #include "dt.h"
 
+#include <stdint.h>
+
 // Replacement Strategies
 typedef enum ReplacementStrategy {
 	RS_FIFO = 0,
 	RS_LRU = 1,
 	RS_CLOCK = 2,
-	RS_LFU = 3,
-	RS_LRU_K = 4
+	RS_LFU = 3,	// use counts halved after every 8 pins per frame
+	RS_LRU_K = 4,	// stratData points to K (an int from 1 to 8), K is 2 if it is NULL
+	RS_ARC = 5,
+	RS_2Q = 6
 } ReplacementStrategy;
 
 // Data Types and Structures
@@ -33,6 +37,40 @@ typedef struct BM_PageHandle {
 	char *data;
 } BM_PageHandle;
 
+// what a pin is for: any number of threads can hold a page for reading, a thread
+// holding it for writing excludes all others (see pinPageWithIntent)
+typedef enum BM_PinIntent {
+	BM_PIN_READ = 0,
+	BM_PIN_WRITE = 1
+} BM_PinIntent;
+
+// a page read without pinning it (see beginOptimisticRead)
+typedef struct BM_OptimisticRead {
+	BM_PageHandle page;
+	int frameIndex;
+	uint64_t version;
+} BM_OptimisticRead;
+
+// write-ahead logging: makes the log durable up to and including the record at lsn
+// (see setFlushLog)
+typedef RC (*BM_FlushLog)(void *logData, uint64_t lsn);
+
+// options of a buffer pool beyond its strategy (see initBufferPoolWithOptions); zeroed
+// options are what initBufferPool uses
+typedef struct BM_PoolOptions {
+	// find pages through an array indexed by page number instead of a hash table
+	// (for files whose page numbers are dense, which all page files' are)
+	bool directPageTable;
+	// a background thread writes dirty pages back ahead of their eviction, so misses find
+	// clean frames: it keeps cleanReserve frames clean and unpinned (0 for no cleaner) and
+	// fewer than cleanDirtyPercent percent of the frames dirty (50 if 0), writing at most
+	// cleanPagesPerSecond pages a second while the reserve is at least half full (0 for
+	// no limit)
+	int cleanReserve;
+	int cleanDirtyPercent;
+	int cleanPagesPerSecond;
+} BM_PoolOptions;
+
 // convenience macros
 #define MAKE_POOL()					\
 		((BM_BufferPool *) malloc (sizeof(BM_BufferPool)))
@@ -44,8 +82,12 @@ typedef struct BM_PageHandle {
 RC initBufferPool(BM_BufferPool *const bm, const char *const pageFileName, 
 		const int numPages, ReplacementStrategy strategy,
 		void *stratData);
+RC initBufferPoolWithOptions(BM_BufferPool *const bm, const char *const pageFileName,
+		const int numPages, ReplacementStrategy strategy,
+		void *stratData, const BM_PoolOptions *options);
 RC shutdownBufferPool(BM_BufferPool *const bm);
 RC forceFlushPool(BM_BufferPool *const bm);
+int getPoolPageSize(BM_BufferPool *const bm);
 
 // Buffer Manager Interface Access Pages
 RC markDirty (BM_BufferPool *const bm, BM_PageHandle *const page);
@@ -54,6 +96,32 @@ RC forcePage (BM_BufferPool *const bm, BM_PageHandle *const page);
 RC pinPage (BM_BufferPool *const bm, BM_PageHandle *const page, 
 		const PageNumber pageNum);
 
+// the pool can be used by several threads at once; pinPage pins for reading, a thread
+// changing a page pins it with BM_PIN_WRITE (and must not pin it again until it is
+// unpinned, which any thread may do); pins of pages in the pool, unpins and markDirty
+// do not wait for misses
+RC pinPageWithIntent (BM_BufferPool *const bm, BM_PageHandle *const page,
+		const PageNumber pageNum, BM_PinIntent intent);
+
+// Write-Ahead Logging Interface
+void setFlushLog (BM_BufferPool *const bm, BM_FlushLog flushLog, void *logData);
+RC markDirtyLSN (BM_BufferPool *const bm, BM_PageHandle *const page, uint64_t lsn);
+RC getCheckpointLSN (BM_BufferPool *const bm, uint64_t *redoLSN);
+
+// Optimistic Reads
+// reading a page in the pool without pinning it: what was read from read->page.data only
+// counts if validateOptimisticRead returns true afterwards, otherwise a writer may have
+// torn it (or the page left the frame) and the read is repeated. begin fails with
+// RC_IM_KEY_NOT_FOUND if the page is in no frame or being written (pin it instead).
+// Such reads are no references for the replacement strategy, and writers they run
+// alongside must pin with BM_PIN_WRITE, or bracket each change of a page they pinned
+// for reading with beginPageChange / endPageChange (they must then be the only thread
+// changing that page)
+RC beginOptimisticRead (BM_BufferPool *const bm, const PageNumber pageNum, BM_OptimisticRead *read);
+bool validateOptimisticRead (BM_BufferPool *const bm, BM_OptimisticRead *read);
+RC beginPageChange (BM_BufferPool *const bm, BM_PageHandle *const page);
+RC endPageChange (BM_BufferPool *const bm, BM_PageHandle *const page);
+
 // Statistics Interface
 PageNumber *getFrameContents (BM_BufferPool *const bm);
 bool *getDirtyFlags (BM_BufferPool *const bm);
@@ -1,8 +1,10 @@
 #include "buffer_mgr_stat.h"
 #include "buffer_mgr.h"
+#include "storage_mgr.h"
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <inttypes.h>
 
 // local functions
 static void printStrat (BM_BufferPool *const bm);
@@ -78,6 +80,24 @@ sprintPageContent (BM_PageHandle *const page)
 	return message;
 }
 
+void
+printIOStats (BM_BufferPool *const bm)
+{
+	static const char *types[SM_IO_NUM_TYPES] = { "read", "write", "append", "sync" };
+	SM_IOStats stats;
+	int i;
+
+	printf("{pool reads %i writes %i}\n", getNumReadIO(bm), getNumWriteIO(bm));
+	if (getIOStats((SM_FileHandle *) bm->pageFile, &stats) != RC_OK)
+		return;
+
+	for (i = 0; i < SM_IO_NUM_TYPES; i++)
+		printf("%-6s ops %" PRIu64 " pages %" PRIu64 " bytes %" PRIu64 " syscalls %" PRIu64 " errors %" PRIu64
+			" p50 <%" PRIu64 "ns p99 <%" PRIu64 "ns\n", types[i], stats.operations[i], stats.pages[i],
+			stats.bytes[i], stats.syscalls[i], stats.errors[i],
+			getIOLatencyPercentile(&stats, i, 50), getIOLatencyPercentile(&stats, i, 99));
+}
+
 void
 printStrat (BM_BufferPool *const bm)
 {
@@ -98,6 +118,12 @@ printStrat (BM_BufferPool *const bm)
 	case RS_LRU_K:
 		printf("LRU-K");
 		break;
+	case RS_ARC:
+		printf("ARC");
+		break;
+	case RS_2Q:
+		printf("2Q");
+		break;
 	default:
 		printf("%i", bm->strategy);
 		break;
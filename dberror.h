@@ -18,6 +18,9 @@ typedef int RC;
 #define RC_PAGE_OUT_OF_RANGE 6
 #define RC_SEEK_FAILED 7
 #define RC_ALLOCATION_FAILED 8
+#define RC_SYNC_FAILED 9
+#define RC_MAP_FAILED 10
+#define RC_IO_MISALIGNED 11
 
 #define RC_RM_COMPARE_VALUE_OF_DIFFERENT_DATATYPE 200
 #define RC_RM_EXPR_RESULT_IS_NOT_BOOLEAN 201
@@ -1,63 +1,193 @@
 #include "hash_table.h"
 #include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
-#define ARRAY_LIST_SIZE 16
+// an open-addressing table in the style of a Swiss table: every slot has a control
+// byte, HT_EMPTY or the low 7 bits of its key's hash, and lookups compare a group of
+// 16 control bytes at once (with SSE2, or eight at a time in a word) before touching any key.
+// Slots are probed linearly from a key's home slot, so a key always lies between its
+// home and the first empty slot after it; removal shifts the keys behind the removed
+// one back instead of leaving tombstones. The first HT_GROUP - 1 control bytes are
+// repeated after the last one, so a group can be read at any slot
+
+#define HT_GROUP 16
+#define HT_EMPTY 0x80
+#define HT_MIN_CAPACITY 16
 
 typedef struct HT_KeyValuePair {
     int key;
     int value;
 } HT_KeyValuePair;
 
-typedef struct HT_ArrayList {
+typedef struct HT_Table {
+    // capacity + HT_GROUP - 1 control bytes
+    uint8_t *ctrl;
+    HT_KeyValuePair *slots;
     int capacity;
-    int size;
-    HT_KeyValuePair *list;
-} HT_ArrayList;
+    int count;
+} HT_Table;
+
+// helper to mix a key into a 64-bit hash (negative keys are fine)
+static inline uint64_t HT_hash(int key)
+{
+    uint64_t h = (uint32_t)key;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+// helper to find the slot a hash starts probing at and the control byte it leaves
+static inline int HT_home(HT_Table *table, uint64_t h)
+{
+    return (int)(h >> 7) & (table->capacity - 1);
+}
 
-HT_ArrayList *AL_get(HT_TableHandle *const ht, int i)
+static inline uint8_t HT_tag(uint64_t h)
 {
-    HT_ArrayList *ls = (HT_ArrayList *)ht->mgmt;
-    return &ls[i];
+    return (uint8_t)(h & 0x7f);
 }
 
-int AL_push(HT_ArrayList *al, int key, int value)
+// helper to get a bitmask of the group at pos whose control bytes equal byte
+static inline unsigned HT_match(HT_Table *table, int pos, uint8_t byte)
 {
-    if (al->size == al->capacity)
+#ifdef __SSE2__
+    __m128i group = _mm_loadu_si128((const __m128i *)(table->ctrl + pos));
+    return (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8((char)byte)));
+#elif defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    // eight bytes at a time: the high bit of every matching byte is set (a tag may also
+    // match falsely right after a real match, its key is compared anyway; empty bytes
+    // are the only ones with the high bit set, so they match exactly), then those bits
+    // are gathered into the low byte
+    uint64_t words[2];
+    unsigned mask = 0;
+    memcpy(words, table->ctrl + pos, sizeof(words));
+    for (int w = 0; w < 2; w++)
     {
-        al->capacity += ARRAY_LIST_SIZE;
-        al->list = realloc(al->list, sizeof(HT_KeyValuePair) * al->capacity);
-        if (al->list == NULL)
-            return 1;
+        uint64_t high;
+        if (byte == HT_EMPTY) high = words[w] & 0x8080808080808080ULL;
+        else
+        {
+            uint64_t x = words[w] ^ (0x0101010101010101ULL * byte);
+            high = (x - 0x0101010101010101ULL) & ~x & 0x8080808080808080ULL;
+        }
+        mask |= (unsigned)((((high >> 7) * 0x0102040810204080ULL) >> 56) << (8 * w));
     }
-    al->list[al->size].key = key;
-    al->list[al->size].value = value;
-    al->size++;
+    return mask;
+#else
+    unsigned mask = 0;
+    for (int i = 0; i < HT_GROUP; i++)
+        if (table->ctrl[pos + i] == byte) mask |= 1u << i;
+    return mask;
+#endif
+}
+
+// helper to set a control byte and its copy after the end
+static inline void HT_setCtrl(HT_Table *table, int i, uint8_t byte)
+{
+    table->ctrl[i] = byte;
+    if (i < HT_GROUP - 1) table->ctrl[table->capacity + i] = byte;
+}
+
+// helper to find the slot of key (-1 if it is not in the table)
+static int HT_find(HT_Table *table, int key)
+{
+    uint64_t h = HT_hash(key);
+    uint8_t tag = HT_tag(h);
+    int mask = table->capacity - 1;
+    int pos = HT_home(table, h);
+
+    while (1)
+    {
+        unsigned candidates = HT_match(table, pos, tag);
+        while (candidates != 0)
+        {
+            int i = (pos + __builtin_ctz(candidates)) & mask;
+            if (table->slots[i].key == key) return i;
+            candidates &= candidates - 1;
+        }
+        if (HT_match(table, pos, HT_EMPTY) != 0) return -1;
+        pos = (pos + HT_GROUP) & mask;
+    }
+}
+
+// helper to put a key that is not in the table into the first empty slot of its probe
+static void HT_insert(HT_Table *table, int key, int value)
+{
+    uint64_t h = HT_hash(key);
+    int mask = table->capacity - 1;
+    int pos = HT_home(table, h);
+
+    unsigned empty;
+    while ((empty = HT_match(table, pos, HT_EMPTY)) == 0)
+        pos = (pos + HT_GROUP) & mask;
+
+    int i = (pos + __builtin_ctz(empty)) & mask;
+    HT_setCtrl(table, i, HT_tag(h));
+    table->slots[i].key = key;
+    table->slots[i].value = value;
+    table->count++;
+}
+
+// helper to allocate empty slots for a table
+static int HT_allocate(HT_Table *table, int capacity)
+{
+    table->ctrl = (uint8_t *)malloc(capacity + HT_GROUP - 1);
+    table->slots = (HT_KeyValuePair *)malloc(sizeof(HT_KeyValuePair) * capacity);
+    if (table->ctrl == NULL || table->slots == NULL)
+    {
+        free(table->ctrl);
+        free(table->slots);
+        return 1;
+    }
+    memset(table->ctrl, HT_EMPTY, capacity + HT_GROUP - 1);
+    table->capacity = capacity;
+    table->count = 0;
     return 0;
 }
 
-void AL_remoteAt(HT_ArrayList *al, int i)
+// helper to double the table's capacity, moving every key
+static int HT_grow(HT_TableHandle *const ht)
 {
-    if (i >= 0 && i < al->size) {
-        for (int j = i; j < al->size - 1; j++)
-            al->list[j] = al->list[j + 1];
-        al->size--;
+    HT_Table *table = (HT_Table *)ht->mgmt;
+    HT_Table old = *table;
+
+    if (HT_allocate(table, old.capacity * 2) != 0)
+    {
+        *table = old;
+        return 1;
     }
+    for (int i = 0; i < old.capacity; i++)
+        if (old.ctrl[i] != HT_EMPTY) HT_insert(table, old.slots[i].key, old.slots[i].value);
+
+    free(old.ctrl);
+    free(old.slots);
+    ht->size = table->capacity;
+    return 0;
 }
 
-// initialize hash table
+// initialize hash table (size is the number of keys expected, it grows beyond that)
 int initHashTable(HT_TableHandle *const ht, int size) 
 {
-    ht->size = size;
-    ht->mgmt = malloc(sizeof(HT_ArrayList) * size);
-    for (int i = 0; i < size; i++)
+    // at most 7/8 of the slots are used
+    int capacity = HT_MIN_CAPACITY;
+    while (capacity - capacity / 8 < size) capacity *= 2;
+
+    HT_Table *table = (HT_Table *)malloc(sizeof(HT_Table));
+    if (table == NULL || HT_allocate(table, capacity) != 0)
     {
-        HT_ArrayList *al = AL_get(ht, i);
-        al->list = malloc(sizeof(HT_KeyValuePair) * ARRAY_LIST_SIZE);
-        if (al->list == NULL)
-            return 1;
-        al->capacity = ARRAY_LIST_SIZE;
-        al->size = 0;
+        free(table);
+        ht->mgmt = NULL;
+        return 1;
     }
+    ht->size = capacity;
+    ht->mgmt = table;
     return 0;
 }
 
@@ -65,59 +195,62 @@ int initHashTable(HT_TableHandle *const ht, int size)
 // else return 1
 int getValue(HT_TableHandle *const ht, int key, int *value) 
 {
-    int i = key % ht->size;
-    HT_ArrayList *al  = AL_get(ht, i);
-    for (int j = 0; j < al->size; j++)
-    {
-        if (al->list[j].key == key)
-        {
-            *value = al->list[j].value;
-            return 0;
-        }
-    }
-    return 1;
+    HT_Table *table = (HT_Table *)ht->mgmt;
+    int i = HT_find(table, key);
+    if (i == -1) return 1;
+    *value = table->slots[i].value;
+    return 0;
 }
 
 // if the key exists, then assign value to it
 // else, add in a new HT_KeyValuePair
 int setValue(HT_TableHandle *const ht, int key, int value) 
 {
-    int i = key % ht->size;
-    HT_ArrayList *al  = AL_get(ht, i);
-    for (int j = 0; j < al->size; j++)
+    HT_Table *table = (HT_Table *)ht->mgmt;
+    int i = HT_find(table, key);
+    if (i != -1)
     {
-        if (al->list[j].key == key)
-        {
-            al->list[j].value = value;
-            return 0;
-        }
+        table->slots[i].value = value;
+        return 0;
     }
-    return AL_push(al, key, value);
+
+    if (table->count + 1 > table->capacity - table->capacity / 8 && HT_grow(ht) != 0)
+        return 1;
+    HT_insert(table, key, value);
+    return 0;
 }
 
 // remove a HT_KeyValuePair 
 int removePair(HT_TableHandle *const ht, int key) 
 {
-    int i = key % ht->size;
-    HT_ArrayList *al  = AL_get(ht, i);
-    for (int j = 0; j < al->size; j++)
+    HT_Table *table = (HT_Table *)ht->mgmt;
+    int mask = table->capacity - 1;
+    int hole = HT_find(table, key);
+    if (hole == -1) return 1;
+
+    // move back every following key whose probe passes the hole, up to the next empty slot
+    for (int i = (hole + 1) & mask; table->ctrl[i] != HT_EMPTY; i = (i + 1) & mask)
     {
-        if (al->list[j].key == key)
+        int home = HT_home(table, HT_hash(table->slots[i].key));
+        if (((i - home) & mask) >= ((i - hole) & mask))
         {
-            AL_remoteAt(al, j);
-            return 0;
+            table->slots[hole] = table->slots[i];
+            HT_setCtrl(table, hole, table->ctrl[i]);
+            hole = i;
         }
     }
-    return 1;
+    HT_setCtrl(table, hole, HT_EMPTY);
+    table->count--;
+    return 0;
 }
 
 // free malloc's
 void freeHashTable(HT_TableHandle *const ht)
 {
-    for (int i = 0; i < ht->size; i++)
-    {
-        HT_ArrayList *al = AL_get(ht, i);
-        free(al->list);
-    }
-    free(ht->mgmt);
-}
\ No newline at end of file
+    HT_Table *table = (HT_Table *)ht->mgmt;
+    if (table == NULL) return;
+    free(table->ctrl);
+    free(table->slots);
+    free(table);
+    ht->mgmt = NULL;
+}
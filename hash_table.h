@@ -1,3 +1,5 @@
+// a table mapping int keys to int values; size is its current number of slots,
+// which grows as keys are added
 typedef struct HT_TableHandle {
     int size;
     void *mgmt;
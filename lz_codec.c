@@ -0,0 +1,159 @@
+#include "lz_codec.h"
+#include <string.h>
+#include <stdint.h>
+
+/* Additional Definitions */
+
+// positions are hashed on their next 4 bytes into a table of 1 << HASH_BITS entries
+#define HASH_BITS 12
+#define MIN_MATCH 4
+// the last bytes of the input are always emitted as literals
+#define END_LITERALS 5
+#define MAX_OFFSET 65535
+
+/* Helpers */
+
+uint32_t _read32(const char *p)
+{
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+int _hash(uint32_t sequence)
+{
+    return (int)((sequence * 2654435761u) >> (32 - HASH_BITS));
+}
+
+// helper to write a length that did not fit its 4 bit nibble as a run of 255s plus a rest
+// returns the new output position or -1 if dst is too small
+int _writeLength(char *dst, int op, int dstCapacity, int length)
+{
+    while (length >= 255) {
+        if (op >= dstCapacity) return -1;
+        dst[op++] = (char)255;
+        length -= 255;
+    }
+    if (op >= dstCapacity) return -1;
+    dst[op++] = (char)length;
+    return op;
+}
+
+// helper to emit one sequence: literals src[anchor, anchor + literalLength) followed by a
+// match of matchLength bytes at `offset` back (matchLength 0 marks the final sequence)
+// returns the new output position or -1 if dst is too small
+int _writeSequence(const char *src, int anchor, int literalLength, int offset, int matchLength, char *dst, int op, int dstCapacity)
+{
+    int matchCode = (matchLength > 0) ? matchLength - MIN_MATCH : 0;
+    if (op >= dstCapacity) return -1;
+    dst[op++] = (char)(((literalLength < 15 ? literalLength : 15) << 4) | (matchCode < 15 ? matchCode : 15));
+
+    if (literalLength >= 15 && (op = _writeLength(dst, op, dstCapacity, literalLength - 15)) == -1) return -1;
+    if (op + literalLength > dstCapacity) return -1;
+    memcpy(dst + op, src + anchor, literalLength);
+    op += literalLength;
+
+    if (matchLength == 0) return op;
+
+    if (op + 2 > dstCapacity) return -1;
+    dst[op++] = (char)(offset & 0xff);
+    dst[op++] = (char)(offset >> 8);
+    if (matchCode >= 15 && (op = _writeLength(dst, op, dstCapacity, matchCode - 15)) == -1) return -1;
+    return op;
+}
+
+/* Interface */
+
+// compress srcLength bytes into dst
+// returns the compressed length or -1 if it does not fit into dstCapacity bytes
+int lzCompress(const char *src, int srcLength, char *dst, int dstCapacity)
+{
+    int table[1 << HASH_BITS];
+    int ip = 0;
+    int anchor = 0;
+    int op = 0;
+
+    // table entries hold position + 1 so that 0 means empty
+    memset(table, 0, sizeof(table));
+
+    while (ip + MIN_MATCH + END_LITERALS <= srcLength) {
+        uint32_t sequence = _read32(src + ip);
+        int h = _hash(sequence);
+        int ref = table[h] - 1;
+        table[h] = ip + 1;
+
+        if (ref < 0 || ip - ref > MAX_OFFSET || _read32(src + ref) != sequence) {
+            ip++;
+            continue;
+        }
+
+        // extend the match, stopping short of the literal-only tail
+        int matchLength = MIN_MATCH;
+        while (ip + matchLength < srcLength - END_LITERALS && src[ref + matchLength] == src[ip + matchLength]) {
+            matchLength++;
+        }
+
+        op = _writeSequence(src, anchor, ip - anchor, ip - ref, matchLength, dst, op, dstCapacity);
+        if (op == -1) return -1;
+        ip += matchLength;
+        anchor = ip;
+    }
+
+    // whatever is left goes out as literals
+    return _writeSequence(src, anchor, srcLength - anchor, 0, 0, dst, op, dstCapacity);
+}
+
+// decompress srcLength bytes of lzCompress output into dst
+// returns the decompressed length or -1 if the input is corrupt or dst is too small
+int lzDecompress(const char *src, int srcLength, char *dst, int dstCapacity)
+{
+    const unsigned char *in = (const unsigned char *)src;
+    int ip = 0;
+    int op = 0;
+
+    while (ip < srcLength) {
+        int token = in[ip++];
+
+        // literals
+        int literalLength = token >> 4;
+        if (literalLength == 15) {
+            int extra;
+            do {
+                if (ip >= srcLength) return -1;
+                extra = in[ip++];
+                literalLength += extra;
+            } while (extra == 255);
+        }
+        if (ip + literalLength > srcLength || op + literalLength > dstCapacity) return -1;
+        memcpy(dst + op, src + ip, literalLength);
+        ip += literalLength;
+        op += literalLength;
+
+        // the final sequence has no match
+        if (ip == srcLength) break;
+
+        if (ip + 2 > srcLength) return -1;
+        int offset = in[ip] | (in[ip + 1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > op) return -1;
+
+        int matchLength = token & 15;
+        if (matchLength == 15) {
+            int extra;
+            do {
+                if (ip >= srcLength) return -1;
+                extra = in[ip++];
+                matchLength += extra;
+            } while (extra == 255);
+        }
+        matchLength += MIN_MATCH;
+        if (op + matchLength > dstCapacity) return -1;
+
+        // byte by byte since the match may overlap its own output
+        for (int i = 0; i < matchLength; i++) {
+            dst[op + i] = dst[op - offset + i];
+        }
+        op += matchLength;
+    }
+    return op;
+}
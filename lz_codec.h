@@ -0,0 +1,8 @@
+#ifndef LZ_CODEC_H
+#define LZ_CODEC_H
+
+// a small LZ77 codec (LZ4-style block format) used for compressed page files
+int lzCompress(const char *src, int srcLength, char *dst, int dstCapacity);
+int lzDecompress(const char *src, int srcLength, char *dst, int dstCapacity);
+
+#endif
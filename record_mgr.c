@@ -1,18 +1,25 @@
 #include "buffer_mgr.h"
 #include "storage_mgr.h"
 #include "record_mgr.h"
+#include "wal.h"
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
+#include <stddef.h>
 
 /* Macros */
 
 #define PAGE_FILE_NAME "DATA.bin"
+// the write-ahead log is kept next to the page file as <page file>.wal
+#define LOG_FILE_SUFFIX ".wal"
+// how often getRecord reads a record without pinning its page before it pins it
+#define OPTIMISTIC_READ_ATTEMPTS 4
 #define TABLE_NAME_SIZE 16
 #define ATTR_NAME_SIZE 16
 #define MAX_NUM_ATTR 8
 #define MAX_NUM_KEYS 4
-#define MAX_NUM_TABLES PAGE_SIZE / (sizeof(ResourceManagerSchema) + sizeof(int) * 2)
+// the catalog fills page 0, so how many tables it holds depends on the file's page size
+#define MAX_NUM_TABLES ((int)((getPoolPageSize(&bufferPool) - offsetof(RM_SystemCatalog, tables)) / sizeof(ResourceManagerSchema)))
 
 #define USE_PAGE_HANDLE_HEADER(errorValue) \
 int const error = errorValue; \
@@ -29,6 +36,14 @@ header = getPageHeader(&handle);
 result = unpinPage(&bufferPool, &handle); \
 if (result != RC_OK) return error;
 
+// sets a field of a pinned page through logWrite; a failed change fails the operation
+// (see operationResult), which endOperation then rolls back
+#define LOGGED_SET(pageHandle, field, value) \
+do { \
+    __typeof__(field) loggedValue = (value); \
+    logWrite(pageHandle, &(field), &loggedValue, sizeof(loggedValue)); \
+} while (0)
+
 /* Additional Definitions */
 
 typedef struct ResourceManagerSchema {
@@ -48,7 +63,7 @@ typedef struct RM_SystemCatalog {
     int totalNumPages;
     int freePage;
     int numTables;
-    ResourceManagerSchema tables[MAX_NUM_TABLES];
+    ResourceManagerSchema tables[];
 } RM_SystemCatalog;
 
 typedef struct RM_PageHeader {
@@ -66,6 +81,11 @@ typedef struct RM_ScanData {
 
 BM_BufferPool bufferPool;
 BM_PageHandle catalogPageHandle;
+// the write-ahead log, the transaction of the operation running (see beginOperation)
+// and the first change of it that failed (RC_OK if none did)
+WAL_Log *logFile;
+WAL_Txn *operation;
+RC operationResult;
 
 /* Declarations */
 
@@ -74,6 +94,7 @@ RC markSystemCatalogDirty();
 ResourceManagerSchema *getTableByName(char *name);
 RM_PageHeader *getPageHeader(BM_PageHandle* handle);
 bool *getSlots(BM_PageHandle* handle);
+bool slotFits(BM_PageHandle* handle, int slot, int recordSize);
 char *getTupleData(BM_PageHandle* handle);
 int getFreePage();
 int setFreePage(BM_PageHandle* handle);
@@ -81,6 +102,10 @@ int appendToFreeList(int pageNum);
 int getAttrSize(Schema *schema, int attrIndex);
 int getNextSlotInWalk(ResourceManagerSchema *table, BM_PageHandle **handle, bool** slots, int *slotIndex);
 int closeSlotWalk(ResourceManagerSchema *table, BM_PageHandle **handle);
+RC logWrite(BM_PageHandle *handle, void *dest, const void *src, int length);
+RC readRecordOptimistic(RM_TableData *rel, RID id, Record *record);
+RC beginOperation();
+RC endOperation(RC result);
 
 /* Helpers */
 
@@ -95,6 +120,94 @@ RC markSystemCatalogDirty()
     return markDirty(&bufferPool, &catalogPageHandle); 
 }
 
+// helper to change `length` bytes of a pinned page to `src`: the change is logged
+// before it is made and the page remembers the record, so the buffer manager never
+// writes the page ahead of the log. Pages are pinned for reading, so the change is
+// bracketed for optimistic readers (see readRecordOptimistic); the record manager is
+// used from one thread at a time
+RC logWrite(BM_PageHandle *handle, void *dest, const void *src, int length)
+{
+    WAL_LSN lsn;
+    int offset = (int)((char *)dest - handle->data);
+    RC result = walWrite(logFile, operation, handle->pageNum, offset, dest, src, length, &lsn);
+    if (result == RC_OK) result = beginPageChange(&bufferPool, handle);
+    if (result == RC_OK)
+    {
+        memmove(dest, src, length);
+        result = endPageChange(&bufferPool, handle);
+    }
+    if (result == RC_OK) result = markDirtyLSN(&bufferPool, handle, lsn);
+
+    // whether or not the caller looks at the result, the operation cannot commit
+    if (result != RC_OK && operationResult == RC_OK) operationResult = result;
+    return result;
+}
+
+// helper for recovery and rollback to put logged bytes back into a page
+RC applyLogged(void *applyData, int pageNum, int offset, const void *data, int length, WAL_LSN lsn)
+{
+    BM_PageHandle handle;
+    (void)applyData;  // the record manager has a single pool
+    if (offset < 0 || length < 0 || offset + length > getPoolPageSize(&bufferPool)) return RC_READ_FAILED;
+
+    RC result = pinPage(&bufferPool, &handle, pageNum);
+    if (result != RC_OK) return result;
+    result = beginPageChange(&bufferPool, &handle);
+    if (result == RC_OK)
+    {
+        memcpy(handle.data + offset, data, length);
+        result = endPageChange(&bufferPool, &handle);
+    }
+    if (result == RC_OK) result = markDirtyLSN(&bufferPool, &handle, lsn);
+    RC unpinResult = unpinPage(&bufferPool, &handle);
+    return (result != RC_OK) ? result : unpinResult;
+}
+
+// helper for the buffer manager to make the log durable before it writes a page
+RC flushLogRecords(void *logData, uint64_t lsn)
+{
+    return walFlush((WAL_Log *)logData, lsn);
+}
+
+// helper to take a fuzzy checkpoint: recovery starts at the oldest change still
+// only in the buffer pool
+RC takeCheckpoint()
+{
+    uint64_t redoLSN;
+    RC result = getCheckpointLSN(&bufferPool, &redoLSN);
+    if (result != RC_OK) return result;
+    return walCheckpoint(logFile, redoLSN);
+}
+
+// helper to start the log transaction the next operation changes pages in
+RC beginOperation()
+{
+    operationResult = RC_OK;
+    return walBegin(logFile, &operation);
+}
+
+// helper to end the operation started by beginOperation: it commits (one log
+// append and sync) if it succeeded and is rolled back otherwise, so a failed
+// operation leaves no half-made changes behind
+RC endOperation(RC result)
+{
+    WAL_Txn *txn = operation;
+    operation = NULL;
+    if (result == RC_OK) result = operationResult;
+    if (result != RC_OK)
+    {
+        walAbort(logFile, txn, applyLogged, NULL);
+        return result;
+    }
+
+    result = walCommit(logFile, txn);
+    if (result == RC_OK && walSizeSinceCheckpoint(logFile) >= WAL_CHECKPOINT_BYTES)
+    {
+        result = takeCheckpoint();
+    }
+    return result;
+}
+
 ResourceManagerSchema *getTableByName(char *name)
 {
     RM_SystemCatalog *catalog = getSystemCatalog();
@@ -157,6 +270,17 @@ char *getTupleDataAt(BM_PageHandle* handle, int recordSize, int index)
     return ptr;
 }
 
+// helper to check that a slot is one of the page's and its record ends within the page;
+// pages formatted before the slot count left room for the whole RM_PageHeader keep their
+// (one too many) slots, and their last slot, which would run past the page, is never used
+bool slotFits(BM_PageHandle* handle, int slot, int recordSize)
+{
+    int numSlots = getPageHeader(handle)->numSlots;
+    return slot >= 0 && slot < numSlots
+        && (long)sizeof(RM_PageHeader) + (long)sizeof(bool) * numSlots + (long)(slot + 1) * recordSize
+           <= getPoolPageSize(&bufferPool);
+}
+
 // helper to get the next available free page
 // returns the page number of the free page and NO_PAGE for failure
 int getFreePage()
@@ -170,14 +294,14 @@ int getFreePage()
     {
         case 1:  // No free page available, equivalent to catalog->freePage == NO_PAGE
             {
-                int newPage = catalog->totalNumPages++;
-                markSystemCatalogDirty();
+                int newPage = catalog->totalNumPages;
+                LOGGED_SET(&catalogPageHandle, catalog->totalNumPages, newPage + 1);
 
                 // Get the new page and unset the next / prev
                 BEGIN_USE_PAGE_HANDLE_HEADER(newPage);
                 {
-                    header->nextPage = header->prevPage = NO_PAGE;
-                    markDirty(&bufferPool, &handle);
+                    LOGGED_SET(&handle, header->nextPage, NO_PAGE);
+                    LOGGED_SET(&handle, header->prevPage, NO_PAGE);
                 }
                 END_USE_PAGE_HANDLE_HEADER();
                 return newPage;
@@ -192,10 +316,9 @@ int getFreePage()
                 BEGIN_USE_PAGE_HANDLE_HEADER(newPage);
                 {
                     nextPage = header->nextPage;
-                    header->nextPage = header->prevPage = NO_PAGE;
-                    catalog->freePage = nextPage;
-                    markDirty(&bufferPool, &handle);
-                    markSystemCatalogDirty();
+                    LOGGED_SET(&handle, header->nextPage, NO_PAGE);
+                    LOGGED_SET(&handle, header->prevPage, NO_PAGE);
+                    LOGGED_SET(&catalogPageHandle, catalog->freePage, nextPage);
                 }
                 END_USE_PAGE_HANDLE_HEADER();
 
@@ -209,8 +332,7 @@ int getFreePage()
                         // Set the next page's prev to NO_PAGE
                         BEGIN_USE_PAGE_HANDLE_HEADER(nextPage);
                         {
-                            header->prevPage = NO_PAGE;
-                            markDirty(&bufferPool, &handle);
+                            LOGGED_SET(&handle, header->prevPage, NO_PAGE);
                         }
                         END_USE_PAGE_HANDLE_HEADER();
                         return newPage;
@@ -243,10 +365,8 @@ int appendToFreeList(int pageNum)
             {
                 BEGIN_USE_PAGE_HANDLE_HEADER(pageNum);
                 {
-                    header->prevPage = 0;
-                    catalog->freePage = pageNum;
-                    markDirty(&bufferPool, &handle);
-                    markSystemCatalogDirty();
+                    LOGGED_SET(&handle, header->prevPage, 0);
+                    LOGGED_SET(&catalogPageHandle, catalog->freePage, pageNum);
                 }
                 END_USE_PAGE_HANDLE_HEADER();
                 return 0;
@@ -265,8 +385,7 @@ int appendToFreeList(int pageNum)
                         switch (nextPageCondition)
                         {
                             case 1:  // There is no next page, we are at the end of the chain
-                                header->nextPage = catalog->freePage;
-                                markDirty(&bufferPool, &handle);
+                                LOGGED_SET(&handle, header->nextPage, catalog->freePage);
                                 END_USE_PAGE_HANDLE_HEADER();
                                 goto end_loop;  // Use goto to break out of the nested switch within the while
                             
@@ -282,18 +401,15 @@ int appendToFreeList(int pageNum)
                 // set the catalog's next's prev to the last page
                 BEGIN_USE_PAGE_HANDLE_HEADER(catalog->freePage);
                 {
-                    header->prevPage = curPage;
-                    markDirty(&bufferPool, &handle);
+                    LOGGED_SET(&handle, header->prevPage, curPage);
                 }
                 END_USE_PAGE_HANDLE_HEADER();
 
                 // set the first page's prev to the catalog and the catalog's next to the first page
                 BEGIN_USE_PAGE_HANDLE_HEADER(pageNum);
                 {
-                    header->prevPage = 0;
-                    catalog->freePage = pageNum;
-                    markDirty(&bufferPool, &handle);
-                    markSystemCatalogDirty();
+                    LOGGED_SET(&handle, header->prevPage, 0);
+                    LOGGED_SET(&catalogPageHandle, catalog->freePage, pageNum);
                 }
                 END_USE_PAGE_HANDLE_HEADER();
                 return 0;
@@ -419,9 +535,13 @@ int closeSlotWalk(ResourceManagerSchema *table, BM_PageHandle **handle)
 
 RC initRecordManager(void *mgmtData)
 {
-    // ensure the system catalog can fit into one page
-    if (PAGE_SIZE < sizeof(RM_SystemCatalog) || MAX_NUM_TABLES <= 0) return RC_IM_NO_MORE_ENTRIES;
+    return initRecordManagerWithPageSize(mgmtData, PAGE_SIZE);
+}
 
+// pageSize is only used when the page file has to be created, an existing
+// file keeps the page size it was created with
+RC initRecordManagerWithPageSize(void *mgmtData, int pageSize)
+{
     RC result;
     char *fileName;
     bool newSystem = 0;
@@ -429,26 +549,81 @@ RC initRecordManager(void *mgmtData)
     // mgmtData parameter holds the page file name to use (use default name if NULL)
     fileName = (mgmtData == NULL) ? PAGE_FILE_NAME : (char *)mgmtData;
 
+    // a page file kept in memory gets its log in memory as well
+    bool inMemory = (strncmp(fileName, SM_MEMORY_PREFIX, strlen(SM_MEMORY_PREFIX)) == 0);
+
+    char *logName = (char *)malloc(strlen(fileName) + sizeof(LOG_FILE_SUFFIX));
+    if (logName == NULL) return RC_ALLOCATION_FAILED;
+    strcpy(logName, fileName);
+    strcat(logName, LOG_FILE_SUFFIX);
+
     // check if the file needs to be created using switch-case for file existence check
-    switch (access(fileName, F_OK)) {
-        case 0:
+    switch (pageFileExists(fileName)) {
+        case true:
             // File exists
             break;
 
         default:
             // File does not exist
-            result = createPageFile(fileName);
-            if (result != RC_OK) return result;
+            // a log left behind by an earlier page file of that name does not apply
+            result = createPageFileWithSize(fileName, pageSize);
+            if (result == RC_OK && !inMemory) result = walCreate(logName);
+            if (result != RC_OK)
+            {
+                free(logName);
+                return result;
+            }
             newSystem = 1;
             break;
     }
 
-    result = initBufferPool(&bufferPool, fileName, 16, RS_LRU, NULL);
+    // a table's pages are numbered densely, so they are found by page number directly
+    BM_PoolOptions poolOptions = { 0 };
+    poolOptions.directPageTable = true;
+    result = initBufferPoolWithOptions(&bufferPool, fileName, 16, RS_LRU, NULL, &poolOptions);
     switch (result) {
         case RC_OK:
             break;
         default:
+            free(logName);
+            return result;
+    }
+
+    // ensure the system catalog can fit into one page
+    if (MAX_NUM_TABLES <= 0) {
+        shutdownBufferPool(&bufferPool);
+        free(logName);
+        return RC_IM_NO_MORE_ENTRIES;
+    }
+
+    // open the log (a page file from before logging gets an empty one)
+    result = inMemory ? walOpenTemporary(logName, &logFile) : walOpen(logName, &logFile);
+    if (result == RC_FILE_NOT_FOUND && !inMemory)
+    {
+        result = walCreate(logName);
+        if (result == RC_OK) result = walOpen(logName, &logFile);
+    }
+    free(logName);
+    if (result != RC_OK)
+    {
+        shutdownBufferPool(&bufferPool);
+        return result;
+    }
+    setFlushLog(&bufferPool, flushLogRecords, logFile);
+
+    // bring the pages up to date with the log: committed operations are redone,
+    // interrupted ones rolled back, and the repaired pages written out
+    if (!newSystem)
+    {
+        result = walRecover(logFile, applyLogged, NULL);
+        if (result == RC_OK) result = forceFlushPool(&bufferPool);
+        if (result == RC_OK) result = takeCheckpoint();
+        if (result != RC_OK)
+        {
+            shutdownBufferPool(&bufferPool);
+            walClose(logFile);
             return result;
+        }
     }
 
     result = pinPage(&bufferPool, &catalogPageHandle, 0);
@@ -464,10 +639,13 @@ RC initRecordManager(void *mgmtData)
         case 1:
             {
                 RM_SystemCatalog *catalog = getSystemCatalog();
-                catalog->totalNumPages = 1;
-                catalog->freePage = NO_PAGE;
-                catalog->numTables = 0;
-                markSystemCatalogDirty();
+                result = beginOperation();
+                if (result != RC_OK) return result;
+                LOGGED_SET(&catalogPageHandle, catalog->totalNumPages, 1);
+                LOGGED_SET(&catalogPageHandle, catalog->freePage, NO_PAGE);
+                LOGGED_SET(&catalogPageHandle, catalog->numTables, 0);
+                result = endOperation(RC_OK);
+                if (result != RC_OK) return result;
                 break;
             }
         default:
@@ -475,7 +653,12 @@ RC initRecordManager(void *mgmtData)
             break;
     }
 
-    RM_SystemCatalog *catalog = getSystemCatalog();  // This might be unused if you follow strict C standards for variable use
+    // no table is open yet (the catalog may still hold handles of an earlier run)
+    RM_SystemCatalog *catalog = getSystemCatalog();
+    for (int tableIndex = 0; tableIndex < catalog->numTables; tableIndex++)
+    {
+        catalog->tables[tableIndex].handle = NULL;
+    }
 
     return RC_OK;
 }
@@ -485,10 +668,32 @@ RC shutdownRecordManager()
 {
     RC result = unpinPage(&bufferPool, &catalogPageHandle);
     if (result != RC_OK) return result;
-    return shutdownBufferPool(&bufferPool);
+
+    // every page is written (after the log) and synced by the shutdown, so a final
+    // checkpoint leaves nothing in the log to recover
+    result = shutdownBufferPool(&bufferPool);
+    if (result != RC_OK) return result;
+    result = walCheckpoint(logFile, 0);
+    RC closeResult = walClose(logFile);
+    logFile = NULL;
+    return (result != RC_OK) ? result : closeResult;
 }
 
+RC _createTable(char *name, Schema *schema);
+RC _deleteTable(char *name);
+RC _insertRecord(RM_TableData *rel, Record *record);
+RC _deleteRecord(RM_TableData *rel, RID id);
+RC _updateRecord(RM_TableData *rel, Record *record);
+
+// the operations changing pages each run in a log transaction of their own
 RC createTable(char *name, Schema *schema)
+{
+    RC result = beginOperation();
+    if (result != RC_OK) return result;
+    return endOperation(_createTable(name, schema));
+}
+
+RC _createTable(char *name, Schema *schema)
 {
     RM_SystemCatalog *catalog = getSystemCatalog();
 
@@ -506,62 +711,64 @@ RC createTable(char *name, Schema *schema)
         return RC_IM_NO_MORE_ENTRIES;
     }
 
-    ResourceManagerSchema *table = &(catalog->tables[catalog->numTables]);
-    strncpy(table->name, name, TABLE_NAME_SIZE - 1);
-    table->name[TABLE_NAME_SIZE - 1] = '\0'; // Ensure null termination
-    table->numTuples = 0;
-    table->handle = NULL;
+    // the catalog entry is filled in aside and then logged as a whole
+    ResourceManagerSchema entry;
+    memset(&entry, 0, sizeof(entry));
+    strncpy(entry.name, name, TABLE_NAME_SIZE - 1);
+    entry.name[TABLE_NAME_SIZE - 1] = '\0'; // Ensure null termination
+    entry.numTuples = 0;
+    entry.handle = NULL;
 
     // Copy attribute data
-    table->numAttr = schema->numAttr;
+    entry.numAttr = schema->numAttr;
     int attrIndex = 0;
-    while (attrIndex < table->numAttr)
+    while (attrIndex < entry.numAttr)
     {
-        strncpy(&(table->attrNames[attrIndex * ATTR_NAME_SIZE]), schema->attrNames[attrIndex], ATTR_NAME_SIZE - 1);
-        table->attrNames[attrIndex * ATTR_NAME_SIZE + ATTR_NAME_SIZE - 1] = '\0'; // Ensure null termination
-        table->dataTypes[attrIndex] = schema->dataTypes[attrIndex];
-        table->typeLength[attrIndex] = schema->typeLength[attrIndex];
+        strncpy(&(entry.attrNames[attrIndex * ATTR_NAME_SIZE]), schema->attrNames[attrIndex], ATTR_NAME_SIZE - 1);
+        entry.attrNames[attrIndex * ATTR_NAME_SIZE + ATTR_NAME_SIZE - 1] = '\0'; // Ensure null termination
+        entry.dataTypes[attrIndex] = schema->dataTypes[attrIndex];
+        entry.typeLength[attrIndex] = schema->typeLength[attrIndex];
         attrIndex++;
     }
 
     // Copy key data
-    table->keySize = schema->keySize;
+    entry.keySize = schema->keySize;
     int keyIndex = 0;
-    while (keyIndex < table->keySize)
+    while (keyIndex < entry.keySize)
     {
-        table->keyAttrs[keyIndex] = schema->keyAttrs[keyIndex];
+        entry.keyAttrs[keyIndex] = schema->keyAttrs[keyIndex];
         keyIndex++;
     }
-    catalog->numTables++;
 
-    table->pageNum = getFreePage();
-    if (table->pageNum == NO_PAGE) return RC_WRITE_FAILED;
+    entry.pageNum = getFreePage();
+    if (entry.pageNum == NO_PAGE) return RC_WRITE_FAILED;
+
+    ResourceManagerSchema *table = &(catalog->tables[catalog->numTables]);
+    RC logResult = logWrite(&catalogPageHandle, table, &entry, sizeof(entry));
+    if (logResult != RC_OK) return logResult;
+    LOGGED_SET(&catalogPageHandle, catalog->numTables, catalog->numTables + 1);
 
-    // Initialize page
-    int pageHeader = sizeof(pageHeader);
+    // Initialize page (as many records as fit in the file's pages); every page records
+    // its slot count, so pages of tables created with another count stay readable
+    int pageHeader = sizeof(RM_PageHeader);
     int slotSize = sizeof(bool);
     int recordSize = getRecordSize(schema);
-    int recordsPerPage = (PAGE_SIZE - pageHeader) / (recordSize + slotSize);
+    int recordsPerPage = (getPoolPageSize(&bufferPool) - pageHeader) / (recordSize + slotSize);
     if (recordsPerPage <= 0) return RC_WRITE_FAILED;
 
+    bool *freeSlots = (bool *)calloc(recordsPerPage, sizeof(bool));
+    if (freeSlots == NULL) return RC_ALLOCATION_FAILED;
+
     USE_PAGE_HANDLE_HEADER(RC_WRITE_FAILED);
     BEGIN_USE_PAGE_HANDLE_HEADER(table->pageNum);
     {
         // Mark all the slots as free
-        bool *slots = getSlots(&handle);
-        header->numSlots = recordsPerPage;
-        int slotIndex = 0;
-        while (slotIndex < recordsPerPage)
-        {
-            slots[slotIndex] = FALSE;
-            slotIndex++;
-        }
-        markDirty(&bufferPool, &handle);
+        LOGGED_SET(&handle, header->numSlots, recordsPerPage);
+        logResult = logWrite(&handle, getSlots(&handle), freeSlots, sizeof(bool) * recordsPerPage);
     }
+    free(freeSlots);
     END_USE_PAGE_HANDLE_HEADER();
-
-    markSystemCatalogDirty();
-    return RC_OK;
+    return logResult;
 }
 
 RC openTable(RM_TableData *rel, char *name)
@@ -613,7 +820,7 @@ RC closeTable(RM_TableData *rel)
 {
     ResourceManagerSchema *table = getSystemSchema(rel);
 
-    // Unpin the page and force it to disk using switch-case
+    // Unpin the page and flush it to disk using switch-case
     RC result = unpinPage(&bufferPool, table->handle);
     switch (result)
     {
@@ -623,14 +830,8 @@ RC closeTable(RM_TableData *rel)
             return result;  // Return the error if any
     }
 
-    result = forcePage(&bufferPool, table->handle);
-    switch (result)
-    {
-        case RC_OK:
-            break;  // Continue if everything is okay
-        default:
-            return result;  // Return the error if any
-    }
+    // the table's pages are not forced: every change to them is in the log already,
+    // and the buffer manager writes them back when it evicts them
 
     // Free allocated memory
     free((void *)rel->schema->attrNames);
@@ -641,6 +842,13 @@ RC closeTable(RM_TableData *rel)
 }
 
 RC deleteTable (char *name)
+{
+    RC result = beginOperation();
+    if (result != RC_OK) return result;
+    return endOperation(_deleteTable(name));
+}
+
+RC _deleteTable (char *name)
 {
     RM_SystemCatalog *catalog = getSystemCatalog();
     int tableIndex = 0;
@@ -663,13 +871,13 @@ RC deleteTable (char *name)
                             return RC_WRITE_FAILED;
 
                         default:
-                            // Shift entries in the table catalog down
-                            catalog->numTables--;
-                            for (int remainingIndex = tableIndex; remainingIndex < catalog->numTables; remainingIndex++) 
                             {
-                                catalog->tables[remainingIndex] = catalog->tables[remainingIndex + 1];
+                                // Shift entries in the table catalog down
+                                RC logResult = logWrite(&catalogPageHandle, &(catalog->tables[tableIndex]), &(catalog->tables[tableIndex + 1]),
+                                                        sizeof(ResourceManagerSchema) * (catalog->numTables - 1 - tableIndex));
+                                if (logResult != RC_OK) return logResult;
                             }
-                            markSystemCatalogDirty();
+                            LOGGED_SET(&catalogPageHandle, catalog->numTables, catalog->numTables - 1);
                             return RC_OK;
                     }
                 }
@@ -743,6 +951,13 @@ int getNumTables()
 /* Handling records in a table */
 /* Handling records in a table */
 RC insertRecord (RM_TableData *rel, Record *record)
+{
+    RC result = beginOperation();
+    if (result != RC_OK) return result;
+    return endOperation(_insertRecord(rel, record));
+}
+
+RC _insertRecord (RM_TableData *rel, Record *record)
 {
     ResourceManagerSchema *schema = getSystemSchema(rel);
     bool *slotAvailability;
@@ -775,21 +990,20 @@ RC insertRecord (RM_TableData *rel, Record *record)
                 return RC_WRITE_FAILED;
             }
         }
-        if (!slotAvailability[slotIndex])
+        int recordSize = getRecordSize(rel->schema);
+        if (slotFits(handle, slotIndex, recordSize) && !slotAvailability[slotIndex])
         {
-            int recordSize = getRecordSize(rel->schema);
             char *tupleData = getTupleDataAt(handle, recordSize, slotIndex);
-            memcpy(tupleData, record->data, recordSize);
-            slotAvailability[slotIndex] = true;
-            RC result = markDirty(&bufferPool, handle);
+            RC result = logWrite(handle, tupleData, record->data, recordSize);
             if (result != RC_OK) 
             {
+                closeSlotWalk(schema, &handle);
                 return result;
             }
+            LOGGED_SET(handle, slotAvailability[slotIndex], true);
             record->id.page = handle->pageNum;
             record->id.slot = slotIndex;
-            schema->numTuples++;
-            markSystemCatalogDirty();
+            LOGGED_SET(&catalogPageHandle, schema->numTuples, schema->numTuples + 1);
             closeSlotWalk(schema, &handle);
             return RC_OK;
         }
@@ -826,27 +1040,38 @@ typedef enum {
 } ErrorCode;
 
 RC deleteRecord (RM_TableData *rel, RID id)
+{
+    RC result = beginOperation();
+    if (result != RC_OK) return result;
+    return endOperation(_deleteRecord(rel, id));
+}
+
+RC _deleteRecord (RM_TableData *rel, RID id)
 {
     BEGIN_USE_TABLE_PAGE_HANDLE_HEADER(id);
-    if (id.slot >= header->numSlots) return RC_WRITE_FAILED;
+    if (!slotFits(&handle, id.slot, getRecordSize(rel->schema))) return RC_WRITE_FAILED;
     bool *slots = getSlots(&handle);
     if (slots[id.slot] == FALSE) return RC_WRITE_FAILED;
-    slots[id.slot] = FALSE;
-    table->numTuples--;
-    markSystemCatalogDirty();
-    result = markDirty(&bufferPool, &handle);
-    if (result != RC_OK) return RC_WRITE_FAILED;
+    LOGGED_SET(&handle, slots[id.slot], FALSE);
+    LOGGED_SET(&catalogPageHandle, table->numTuples, table->numTuples - 1);
     END_USE_TABLE_PAGE_HANDLE_HEADER();
     return RC_OK;
 }
 
 RC updateRecord (RM_TableData *rel, Record *record)
+{
+    RC result = beginOperation();
+    if (result != RC_OK) return result;
+    return endOperation(_updateRecord(rel, record));
+}
+
+RC _updateRecord (RM_TableData *rel, Record *record)
 {
     RID id = record->id;
     BEGIN_USE_TABLE_PAGE_HANDLE_HEADER(id);
 
     // Validate slot range and usage
-    if (id.slot >= header->numSlots) 
+    if (!slotFits(&handle, id.slot, getRecordSize(rel->schema))) 
         return RC_WRITE_FAILED;
 
     bool *slots = getSlots(&handle);
@@ -856,10 +1081,9 @@ RC updateRecord (RM_TableData *rel, Record *record)
     // Update record in the slot
     int recordSize = getRecordSize(rel->schema);
     char *tupleData = getTupleDataAt(&handle, recordSize, id.slot);
-    memcpy(tupleData, record->data, recordSize);
 
-    // Mark the page as dirty
-    result = markDirty(&bufferPool, &handle);
+    // log the new record and copy it in (marks the page dirty)
+    result = logWrite(&handle, tupleData, record->data, recordSize);
     if (result != RC_OK) 
         return result;
 
@@ -867,12 +1091,46 @@ RC updateRecord (RM_TableData *rel, Record *record)
     return RC_OK;
 }
 
+// helper to copy a record out of a page in the pool without pinning the page; every
+// value read from the page may be torn until the read was validated, so the offsets are
+// checked against the page size first. RC_IM_KEY_NOT_FOUND if the page has to be pinned
+RC readRecordOptimistic(RM_TableData *rel, RID id, Record *record)
+{
+    int recordSize = getRecordSize(rel->schema);
+    int pageSize = getPoolPageSize(&bufferPool);
+    BM_OptimisticRead read;
+
+    for (int attempt = 0; attempt < OPTIMISTIC_READ_ATTEMPTS; attempt++)
+    {
+        if (beginOptimisticRead(&bufferPool, id.page, &read) != RC_OK) return RC_IM_KEY_NOT_FOUND;
+
+        int numSlots = getPageHeader(&(read.page))->numSlots;
+        bool inRange = id.slot >= 0 && id.slot < numSlots
+            && (long)sizeof(RM_PageHeader) + (long)sizeof(bool) * numSlots + (long)(id.slot + 1) * recordSize <= pageSize;
+        bool used = inRange && getSlots(&(read.page))[id.slot];
+        if (used) memcpy(record->data, getTupleDataAt(&(read.page), recordSize, id.slot), recordSize);
+
+        if (validateOptimisticRead(&bufferPool, &read))
+        {
+            if (!used) return RC_WRITE_FAILED;  // the same checks as getRecord's
+            record->id.page = id.page;
+            record->id.slot = id.slot;
+            return RC_OK;
+        }
+    }
+    return RC_IM_KEY_NOT_FOUND;
+}
+
 RC getRecord (RM_TableData *rel, RID id, Record *record)
 {
+    // a page in the pool is read without pinning it, unless it keeps changing
+    RC optimistic = readRecordOptimistic(rel, id, record);
+    if (optimistic != RC_IM_KEY_NOT_FOUND) return optimistic;
+
     BEGIN_USE_TABLE_PAGE_HANDLE_HEADER(id);
 
     // Check if the slot index is valid
-    if (id.slot >= header->numSlots) 
+    if (!slotFits(&handle, id.slot, getRecordSize(rel->schema))) 
         return RC_WRITE_FAILED;
 
     bool *slots = getSlots(&handle);
@@ -915,11 +1173,12 @@ RC next (RM_ScanHandle *scan, Record *record)
     BM_PageHandle *handle = table->handle;
     RM_PageHeader *header = getPageHeader(handle);
     bool *slots = getSlots(handle);
+    int recordSize = getRecordSize(rel->schema);
 
     while (scanData->id.slot < header->numSlots - 1)
     {
         scanData->id.slot++;
-        if (slots[scanData->id.slot])
+        if (slots[scanData->id.slot] && slotFits(handle, scanData->id.slot, recordSize))
         {
             RC result = getRecord(rel, scanData->id, record);
             if (result != RC_OK) 
@@ -14,6 +14,7 @@ typedef struct RM_ScanHandle
 
 // table and manager
 extern RC initRecordManager (void *mgmtData);
+extern RC initRecordManagerWithPageSize (void *mgmtData, int pageSize);
 extern RC shutdownRecordManager ();
 extern RC createTable (char *name, Schema *schema);
 extern RC openTable (RM_TableData *rel, char *name);
@@ -1,350 +1,2824 @@
+// needed for IOV_MAX and the Linux specific file calls
+#define _GNU_SOURCE
+// 64 bit file offsets even where long is 32 bits
+#define _FILE_OFFSET_BITS 64
+
 #include "storage_mgr.h"
+#include "async_io.h"
+#include "lz_codec.h"
+#include "dt.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <limits.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include <pthread.h>
+#include <time.h>
+
+/* Additional Definitions */
+
+// page files start with a header recording their page size; the header takes
+// SM_HEADER_SIZE bytes so the pages after it stay aligned for O_DIRECT
+// (files without one hold PAGE_SIZE pages from the start of the file)
+#define SM_FILE_MAGIC "SMPGFILE"
+#define SM_HEADER_SIZE 4096
+#define SM_FILE_VERSION 1
+
+typedef struct SM_FileHeader {
+    char magic[8];
+    int version;
+    int pageSize;
+    // segmented files only (0 otherwise): the pages per segment file and the
+    // directories segments 1, 2, ... are spread over in turn
+    int segmentPages;
+    int numStripeDirs;
+    char stripeDirs[SM_MAX_STRIPE_DIRS][SM_MAX_PATH_LENGTH];
+    // the pages of the file as of its last sync or close; pages past it were only
+    // preallocated (or never synced) when the file was not closed (0: count the pages
+    // from the file size, as for files written before the count was kept)
+    int numPages;
+} SM_FileHeader;
+
+// one file of a segmented page file; dirty is set by writes and cleared by the sync
+// that covers them, so a sync only touches the segments written since the last one
+typedef struct SM_Segment {
+    int fd;
+    int dirty;
+    off_t physicalSize;
+} SM_Segment;
+
+// the segments of a file; a full table is replaced by a larger copy that keeps the
+// old one as `previous` (freed on close), so readers never need a lock to use it
+// (the segments themselves never move)
+typedef struct SM_SegmentTable {
+    int capacity;
+    struct SM_SegmentTable *previous;
+    SM_Segment *entries[];
+} SM_SegmentTable;
+
+// compressed page files keep their page map in a sidecar file named <fileName>SM_MAP_SUFFIX
+#define SM_MAP_SUFFIX ".map"
+#define SM_MAP_MAGIC "PGZM"
+#define SM_DATA_MAGIC "PGZD"
+// slots for compressed pages are allocated in multiples of this many bytes
+#define SM_SLOT_GRANULE 256
+
+// pages written since the last backup are tracked in a sidecar file named
+// <fileName>SM_CHANGE_SUFFIX once a backup was taken (see backupPageFileIncremental)
+#define SM_CHANGE_SUFFIX ".chg"
+#define SM_CHANGE_MAGIC "SMCHANGE"
+// the most pages a backup copies in one go while holding changeLock
+#define SM_BACKUP_CHUNK 64
+
+// the head of the change file, followed by one bit per page
+typedef struct SM_ChangeHeader {
+    char magic[8];
+    // set by a clean close; a file found without it missed writes (a crash)
+    int clean;
+    int backupPages;
+    int numPages;
+    int unused;
+} SM_ChangeHeader;
+
+// where a compressed page lives: a slot of `capacity` bytes at `offset` holding
+// a 4 byte length followed by the compressed page (offset 0: never written, all zeros)
+typedef struct SM_SlotEntry {
+    int64_t offset;
+    int capacity;
+    int unused;
+} SM_SlotEntry;
+
+// the head of the sidecar map file, followed by one SM_SlotEntry per page
+typedef struct SM_MapHeader {
+    char magic[4];
+    int numPages;
+    int64_t dataEnd;
+    int pageSize;
+    int unused;
+} SM_MapHeader;
+
+// a page file kept in memory (see SM_MEMORY_PREFIX); its pages are shared by every
+// handle opened on it and live until the file is destroyed (or replaced by a new
+// file of that name) and the last handle on it is closed
+typedef struct SM_MemFile {
+    char *name;
+    int pageSize;
+    // the pages (each allocated on its own, so growing never moves one); lock is
+    // taken shared to move pages and exclusively to add them
+    char **pages;
+    int numPages;
+    int capacity;
+    pthread_rwlock_t lock;
+    // handles open on the file, and whether it was taken out of memoryFiles
+    int openCount;
+    bool unlinked;
+    struct SM_MemFile *next;
+} SM_MemFile;
+
+typedef struct SM_Backend SM_Backend;
+
+// the handle's mgmtInfo; pages are moved with pread/pwrite at explicit
+// offsets so there is no shared file position (and no stdio buffer copy),
+// or copied from / to a shared mapping of the file in SM_MODE_MMAP
+typedef struct SM_FileInfo {
+    // where the pages live (see SM_Backend); memFile is set for memory files only
+    const SM_Backend *backend;
+    SM_MemFile *memFile;
+    int fd;
+    SM_FileMode mode;
+    // the file's page size and where its first page starts (0 for headerless files)
+    int pageSize;
+    int headerSize;
+    // buffers (and in SM_MODE_DIRECT also every transfer) must be aligned to this
+    int alignment;
+    // SM_MODE_MMAP only: the mapping covers mapSize bytes and is replaced
+    // (under the write side of mapLock) when the file grows past it
+    pthread_rwlock_t mapLock;
+    char *map;
+    long mapSize;
+    // group commit state: writeSeq counts writes handed to the kernel,
+    // syncedSeq is the last writeSeq known to be durable
+    pthread_mutex_t syncLock;
+    pthread_cond_t syncDone;
+    unsigned long writeSeq;
+    unsigned long syncedSeq;
+    bool syncing;
+    // file growth: the file is extended extentSize bytes at a time, physicalSize is
+    // its current size on disk (totalNumPages only counts the pages handed out)
+    pthread_mutex_t extendLock;
+    long extentSize;
+    off_t physicalSize;
+    // the page count last read from / written to the header (see _saveHeaderPages)
+    int headerPages;
+    // asynchronous requests (created on the first submitRead / submitWrite)
+    AIO_Engine *aio;
+    // SM_MODE_COMPRESSED only: the page map (guarded by extendLock), its capacity,
+    // the end of the data file where new slots go, and the sidecar map file
+    SM_SlotEntry *slots;
+    int slotCapacity;
+    off_t dataEnd;
+    int mapFd;
+    // segmented files only: the header naming the segments (NULL for single files),
+    // the file's name and the open segments (segment 0 is fd, holding the header)
+    SM_FileHeader *layout;
+    char *fileName;
+    SM_SegmentTable *segments;
+    int numSegments;
+    // I/O counters and latency histograms (see getIOStats), updated with relaxed atomics
+    SM_IOStats stats;
+    // readahead of the cursor reads: the last page read through the cursor, the
+    // current window (0 while access is not sequential) and the first page not yet
+    // advised (the last one not yet advised when reading backwards)
+    int cursorPage;
+    int readaheadWindow;
+    int readaheadNext;
+    // online backups: writers hold backupLock shared while they write and a backup
+    // takes it exclusively to start; changeLock guards everything below, except that
+    // writers set bits of changed with atomic ors (the map only grows or is cleared
+    // while backupLock is held exclusively) and look at snapshotPages before locking
+    pthread_rwlock_t backupLock;
+    pthread_mutex_t changeLock;
+    // the pages written since the last backup (a bitmap, empty before the first backup),
+    // whether that is known (not before the first backup or after a crash), the page
+    // count at the last backup and the change file (-1 until a backup was taken)
+    unsigned char *changed;
+    int changedCapacity;
+    bool trackingValid;
+    int backupPages;
+    int changeFd;
+    // a backup running: the snapshot's pages not copied yet (whoever gets to one
+    // first copies it, the backup or a write about to overwrite it), the size of
+    // the snapshot (0 when no backup runs), the backup file and its first error
+    unsigned char *pending;
+    int snapshotPages;
+    int backupFd;
+    RC backupResult;
+} SM_FileInfo;
+
+// a storage backend: how the pages of a file are kept. The handle (cursor, counters,
+// backups, ...) is the same for every backend, the backend creates, opens and closes
+// the storage, moves runs of pages and grows and syncs it. extend is called with
+// extendLock held, sync by the leader of a group sync (see syncPageFile)
+struct SM_Backend {
+    RC (*create)(char *fileName, SM_FileMode mode, SM_FileHeader *header);
+    RC (*open)(char *fileName, SM_FileInfo *info, SM_FileMode mode, int *totalNumPages);
+    RC (*read)(SM_FileInfo *info, int startPage, SM_PageHandle *buffers, int numPages);
+    RC (*write)(SM_FileInfo *info, int startPage, SM_PageHandle *buffers, int numPages);
+    RC (*extend)(SM_FileInfo *info, int oldPages, int numberOfPages);
+    RC (*sync)(SM_FileInfo *info, int totalNumPages);
+    RC (*close)(SM_FileInfo *info, int totalNumPages);
+    RC (*destroy)(char *fileName);
+    bool (*exists)(char *fileName);
+};
+
+// the backends, chosen by the prefix of the file name (see _backendFor)
+extern const SM_Backend fileBackend;
+extern const SM_Backend memoryBackend;
+
+const SM_Backend *_backendFor(char *fileName);
+
+// the memory files by name
+SM_MemFile *memoryFiles = NULL;
+pthread_mutex_t memoryFilesLock = PTHREAD_MUTEX_INITIALIZER;
+
+// the tag of an asynchronous request: its completion and when it was submitted
+typedef struct SM_Request {
+    SM_Completion completion;
+    uint64_t started;
+} SM_Request;
+
+// mode used by openPageFile (see setDefaultFileMode)
+SM_FileMode defaultFileMode = SM_MODE_PREAD;
+
+// helper to get the byte offset of a page in the file
+off_t _pageOffset(SM_FileInfo *info, int pageNum)
+{
+    return info->headerSize + (off_t)pageNum * info->pageSize;
+}
 
-/* manipulating page files */
+// helper to check a page size asked for at creation
+bool _validPageSize(int pageSize)
+{
+    return pageSize >= SM_MIN_PAGE_SIZE && pageSize <= SM_MAX_PAGE_SIZE && pageSize % SM_MIN_PAGE_SIZE == 0;
+}
 
-void initStorageManager(void) { }
+// helper to get a monotonic timestamp in nanoseconds (for the latency histograms)
+uint64_t _now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
 
-typedef enum {
-    SUCCESS,
-    NULL_POINTER,
-    WRITE_ERROR
-} FileOperationStatus;
+// helper to count system calls issued for an operation
+void _countSyscalls(SM_FileInfo *info, SM_IOType type, int count)
+{
+    __atomic_add_fetch(&info->stats.syscalls[type], (uint64_t)count, __ATOMIC_RELAXED);
+}
 
-RC createPageFile(char *fileName) {
-    FILE *fp = fopen(fileName, "w+");
-    FileOperationStatus status;
+// helper to count a finished operation that started at `started` and moved `pages` pages
+void _recordIO(SM_FileHandle *fHandle, SM_IOType type, uint64_t started, int pages, RC result)
+{
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL) return;
+
+    SM_FileInfo *info = (SM_FileInfo *)fHandle->mgmtInfo;
+    SM_IOStats *stats = &(info->stats);
+    uint64_t elapsed = _now() - started;
+
+    // bucket i holds latencies in [2^i, 2^(i+1)) nanoseconds
+    int bucket = (elapsed > 0) ? 63 - __builtin_clzll(elapsed) : 0;
+    if (bucket >= SM_LATENCY_BUCKETS) bucket = SM_LATENCY_BUCKETS - 1;
+
+    __atomic_add_fetch(&stats->operations[type], 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&stats->latency[type][bucket], 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&stats->totalNanos[type], elapsed, __ATOMIC_RELAXED);
+    if (result != RC_OK) {
+        __atomic_add_fetch(&stats->errors[type], 1, __ATOMIC_RELAXED);
+    } else if (pages > 0) {
+        __atomic_add_fetch(&stats->pages[type], (uint64_t)pages, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&stats->bytes[type], (uint64_t)pages * info->pageSize, __ATOMIC_RELAXED);
+    }
+}
 
-    if (fp == NULL)
-        status = NULL_POINTER;
-    else {
-        void *emptyPage = malloc(PAGE_SIZE); 
-        if (emptyPage == NULL) {
-            fclose(fp);
-            return 0;  // assuming you handle memory allocation failure separately
-        }
+// helper to round a size up to a whole number of extents
+off_t _roundToExtent(off_t size, long extentSize)
+{
+    if (size <= 0) size = 1;
+    return ((size + extentSize - 1) / extentSize) * extentSize;
+}
 
-        memset(emptyPage, '\0', PAGE_SIZE);
-        size_t bytesWritten = fwrite(emptyPage, sizeof(char), PAGE_SIZE, fp);
-        fclose(fp);
-        free(emptyPage);
+// helper to check that a buffer can be used for a transfer on the file
+// (only SM_MODE_DIRECT bypasses the page cache and needs aligned buffers)
+bool _isAligned(SM_FileInfo *info, const void *buffer)
+{
+    return info->mode != SM_MODE_DIRECT || ((uintptr_t)buffer % info->alignment) == 0;
+}
 
-        status = (bytesWritten != PAGE_SIZE) ? WRITE_ERROR : SUCCESS;
+// helper to pick the alignment for a file: its block size if that divides a page,
+// otherwise a whole page (which every device block size divides)
+int _getAlignment(int fd)
+{
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_blksize > 0 && st.st_blksize <= PAGE_SIZE && PAGE_SIZE % st.st_blksize == 0) {
+        return (int)st.st_blksize;
     }
+    return PAGE_SIZE;
+}
 
-    switch (status) {
-        case NULL_POINTER:
-            return RC_FILE_NOT_FOUND;
-
-        case WRITE_ERROR:
-            return RC_WRITE_FAILED;
-
-        case SUCCESS:
-            return RC_OK;
+// helper to copy pages between the file mapping and the given buffers
+void _mapCopy(SM_FileInfo *info, int startPage, SM_PageHandle *buffers, int numPages, bool write)
+{
+    pthread_rwlock_rdlock(&info->mapLock);
+    for (int i = 0; i < numPages; i++) {
+        char *page = info->map + _pageOffset(info, startPage + i);
+        if (write) memcpy(page, buffers[i], info->pageSize);
+        else memcpy(buffers[i], page, info->pageSize);
+    }
+    pthread_rwlock_unlock(&info->mapLock);
+}
 
-        default:
-            // Optional: Handle unexpected status
-            return 0;  // assuming there's a general error return code
+// helper to make the mapping cover at least `size` bytes of the file
+// NOTE the caller holds extendLock
+RC _growMap(SM_FileInfo *info, off_t size)
+{
+    if (size <= info->mapSize) return RC_OK;
+
+    off_t newSize = _roundToExtent(size, info->extentSize);
+    pthread_rwlock_wrlock(&info->mapLock);
+    void *map = mremap(info->map, info->mapSize, newSize, MREMAP_MAYMOVE);
+    if (map != MAP_FAILED) {
+        info->map = (char *)map;
+        info->mapSize = newSize;
     }
+    pthread_rwlock_unlock(&info->mapLock);
+    return (map == MAP_FAILED) ? RC_MAP_FAILED : RC_OK;
 }
 
+// helper to read exactly `size` bytes at `offset`, retrying on EINTR and short reads
+// returns the number of bytes read (less than size only at end of file) or -1 on error
+ssize_t _preadFull(int fd, void *buf, size_t size, off_t offset)
+{
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = pread(fd, (char *)buf + done, size - done, offset + done);
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        if (n == 0) break;  // end of file
+        done += n;
+    }
+    return (ssize_t)done;
+}
 
-long _getFileSize(FILE *file)
+// helper to write exactly `size` bytes at `offset`, retrying on EINTR and short writes
+// returns the number of bytes written or -1 on error
+ssize_t _pwriteFull(int fd, const void *buf, size_t size, off_t offset)
 {
-    enum { CHECK_FILE_PTR, CHECK_FTELL_START, DO_FSEEK_END, CHECK_FTELL_END, DO_FSEEK_RESTORE };
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = pwrite(fd, (const char *)buf + done, size - done, offset + done);
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        done += n;
+    }
+    return (ssize_t)done;
+}
 
-    if (file == NULL) {
-        goto error;  // Indicate error if the file pointer is null
+// helper to move a whole iovec array at `offset` with preadv / pwritev, retrying on
+// EINTR and finishing short transfers; returns the bytes moved or -1 on error
+ssize_t _pvecFull(int fd, struct iovec *iov, int iovcnt, off_t offset, bool write)
+{
+    size_t done = 0;
+    while (iovcnt > 0) {
+        ssize_t n = write ? pwritev(fd, iov, iovcnt, offset + done) : preadv(fd, iov, iovcnt, offset + done);
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        if (n == 0) break;  // end of file (reads only)
+        done += n;
+
+        // drop the buffers that were completely moved and trim a partial one
+        while (iovcnt > 0 && (size_t)n >= iov->iov_len) {
+            n -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = (char *)iov->iov_base + n;
+            iov->iov_len -= n;
+        }
     }
+    return (ssize_t)done;
+}
 
-    // Store the current file position to restore it later
-    long current_position = ftell(file);
-    if (current_position == -1) {
-        goto error;  // Return error if ftell fails
+// helper to get the name of a page file's sidecar file ending in `suffix` (the caller frees it)
+char *_sidecarName(const char *fileName, const char *suffix)
+{
+    char *name = (char *)malloc(strlen(fileName) + strlen(suffix) + 1);
+    if (name != NULL) {
+        strcpy(name, fileName);
+        strcat(name, suffix);
     }
+    return name;
+}
 
-    int action = DO_FSEEK_END;
-    switch (action) {
-        case DO_FSEEK_END:
-            if (fseek(file, 0L, SEEK_END) != 0) {
-                goto error;  // Return error if fseek fails
-            }
+// helper to get the name of a page file's sidecar map (the caller frees it)
+char *_mapFileName(const char *fileName)
+{
+    return _sidecarName(fileName, SM_MAP_SUFFIX);
+}
 
-            // Retrieve the current position of the file pointer (now at the end)
-            long size = ftell(file);
-            if (size == -1) {
-                goto error;  // Return error if ftell fails
-            }
+// helper to make the page map hold at least numPages entries (new pages are unwritten)
+// NOTE the caller holds extendLock
+RC _growSlots(SM_FileInfo *info, int numPages)
+{
+    if (numPages <= info->slotCapacity) return RC_OK;
 
-            action = DO_FSEEK_RESTORE;
-            switch (action) {
-                case DO_FSEEK_RESTORE:
-                    if (fseek(file, current_position, SEEK_SET) != 0) {
-                        goto error;  // Return error if fseek fails
-                    }
-                    return size;  // Return the calculated size
+    int capacity = (info->slotCapacity > 0) ? info->slotCapacity : 16;
+    while (capacity < numPages) capacity *= 2;
 
-                default:
-                    goto error;
-            }
+    SM_SlotEntry *slots = (SM_SlotEntry *)realloc(info->slots, sizeof(SM_SlotEntry) * capacity);
+    if (slots == NULL) return RC_ALLOCATION_FAILED;
+    memset(slots + info->slotCapacity, 0, sizeof(SM_SlotEntry) * (capacity - info->slotCapacity));
+    info->slots = slots;
+    info->slotCapacity = capacity;
+    return RC_OK;
+}
 
-        default:
-            goto error;
+// helper to write the in-memory page map to the sidecar file
+RC _saveSlots(SM_FileInfo *info, int numPages)
+{
+    SM_MapHeader header;
+    memcpy(header.magic, SM_MAP_MAGIC, sizeof(header.magic));
+
+    pthread_mutex_lock(&info->extendLock);
+    header.numPages = numPages;
+    header.dataEnd = info->dataEnd;
+    header.pageSize = info->pageSize;
+    header.unused = 0;
+    size_t size = sizeof(SM_SlotEntry) * numPages;
+    ssize_t written = _pwriteFull(info->mapFd, &header, sizeof(header), 0);
+    if (written == sizeof(header)) {
+        written = _pwriteFull(info->mapFd, info->slots, size, sizeof(header));
     }
+    pthread_mutex_unlock(&info->extendLock);
 
-error:
-    return -1;
+    return (written == (ssize_t)size || (size == 0 && written == sizeof(header))) ? RC_OK : RC_WRITE_FAILED;
 }
 
-typedef enum {
-    FILE_SUCCESS,
-    FILE_ERROR
-} FileStatus;
-
-/**
- * Opens a page file and initializes a file handle structure.
- *
- * @param fileName The name of the file to open.
- * @param fHandle Pointer to the file handle structure to initialize.
- * @return Result code indicating success or failure.
- */
-RC openPageFile(char *fileName, SM_FileHandle *fHandle) {
-    // Attempt to open the file in read+write mode
-    FILE *fp = fopen(fileName, "r+");
-    FileStatus status = (fp == NULL) ? FILE_ERROR : FILE_SUCCESS;
+// helper to read a compressed page (pages that were never written read back as zeros)
+RC _readCompressed(SM_FileInfo *info, int pageNum, SM_PageHandle memPage)
+{
+    pthread_mutex_lock(&info->extendLock);
+    SM_SlotEntry entry = info->slots[pageNum];
+    pthread_mutex_unlock(&info->extendLock);
 
-    switch (status) {
-        case FILE_ERROR:
-            // If the file pointer is null, return file not found error
-            return RC_FILE_NOT_FOUND;
+    if (entry.offset == 0) {
+        memset(memPage, '\0', info->pageSize);
+        return RC_OK;
+    }
 
-        case FILE_SUCCESS:
-            // Get the size of the file and calculate the number of pages
-            long fileSize = _getFileSize(fp);
-            if (fileSize == -1) {
-                fclose(fp);  // Close the file if size retrieval failed
-                return RC_FILE_NOT_FOUND;  // Assuming error due to file issues
-            }
+    char *slot = (char *)malloc(entry.capacity);
+    if (slot == NULL) return RC_ALLOCATION_FAILED;
 
-            int totalNumPages = fileSize / PAGE_SIZE;
+    RC result = RC_OK;
+    uint32_t length;
+    ssize_t bytesRead = _preadFull(info->fd, slot, entry.capacity, entry.offset);
+    _countSyscalls(info, SM_IO_READ, 1);
+    if (bytesRead < (ssize_t)sizeof(length)) {
+        free(slot);
+        return RC_READ_FAILED;  // a short slot has no length to look at
+    }
+    memcpy(&length, slot, sizeof(length));
+    if (length + sizeof(length) > (size_t)bytesRead) {
+        result = RC_READ_FAILED;
+    } else if (length == (uint32_t)info->pageSize) {
+        memcpy(memPage, slot + sizeof(length), info->pageSize);  // stored uncompressed
+    } else if (lzDecompress(slot + sizeof(length), (int)length, memPage, info->pageSize) != info->pageSize) {
+        result = RC_READ_FAILED;
+    }
 
-            // Set metadata in the file handle
-            fHandle->fileName = fileName;
-            fHandle->totalNumPages = totalNumPages;
-            fHandle->curPagePos = 0;
-            fHandle->mgmtInfo = (void *)fp;
+    free(slot);
+    return result;
+}
 
-            // Successfully opened the file and initialized the file handle
-            return RC_OK;
+// helper to write a compressed page: the page is rewritten in its slot if it still
+// fits, otherwise it moves to a new slot at the end of the data file
+RC _writeCompressed(SM_FileInfo *info, int pageNum, SM_PageHandle memPage)
+{
+    char *slot = (char *)malloc(sizeof(uint32_t) + info->pageSize);
+    if (slot == NULL) return RC_ALLOCATION_FAILED;
+    int compressed = lzCompress(memPage, info->pageSize, slot + sizeof(uint32_t), info->pageSize - 1);
+
+    // pages that do not shrink are stored as they are
+    uint32_t length = (compressed < 0) ? (uint32_t)info->pageSize : (uint32_t)compressed;
+    if (compressed < 0) memcpy(slot + sizeof(length), memPage, info->pageSize);
+    memcpy(slot, &length, sizeof(length));
+    int needed = (int)(sizeof(length) + length);
+
+    pthread_mutex_lock(&info->extendLock);
+    SM_SlotEntry *entry = &(info->slots[pageNum]);
+    if (entry->offset == 0 || entry->capacity < needed) {
+        entry->capacity = ((needed + SM_SLOT_GRANULE - 1) / SM_SLOT_GRANULE) * SM_SLOT_GRANULE;
+        entry->offset = info->dataEnd;
+        info->dataEnd += entry->capacity;
+    }
+    off_t offset = entry->offset;
+    pthread_mutex_unlock(&info->extendLock);
 
-        default:
-            // Default case should not be reached
-            return 0;  // Fallback error
+    ssize_t written = _pwriteFull(info->fd, slot, needed, offset);
+    _countSyscalls(info, SM_IO_WRITE, 1);
+    free(slot);
+    if (written != needed) {
+        return RC_WRITE_FAILED;
     }
+    __atomic_add_fetch(&info->writeSeq, 1, __ATOMIC_RELEASE);
+    return RC_OK;
 }
 
-RC closePageFile(SM_FileHandle *fHandle) {
-    if (fHandle == NULL || fHandle->mgmtInfo == NULL) {
-        return RC_FILE_NOT_FOUND;  // Validate file handle and management info pointer
+// helper to open the sidecar map of a compressed page file and load it
+// returns RC_FILE_NOT_FOUND if the file has no map (it is not compressed)
+RC _openSlots(SM_FileInfo *info, const char *fileName, int *numPages)
+{
+    char *mapName = _mapFileName(fileName);
+    if (mapName == NULL) return RC_ALLOCATION_FAILED;
+    info->mapFd = open(mapName, O_RDWR);
+    free(mapName);
+    if (info->mapFd == -1) return RC_FILE_NOT_FOUND;
+
+    SM_MapHeader header;
+    if (_preadFull(info->mapFd, &header, sizeof(header), 0) != sizeof(header)
+        || memcmp(header.magic, SM_MAP_MAGIC, sizeof(header.magic)) != 0
+        || !_validPageSize(header.pageSize)
+        || _growSlots(info, header.numPages) != RC_OK) {
+        close(info->mapFd);
+        return RC_READ_FAILED;
     }
 
-    FILE *fp = (FILE *)fHandle->mgmtInfo;
-    if (fclose(fp) == 0) {
-        fHandle->mgmtInfo = NULL;  // Unset the file pointer on successful close
-        return RC_OK;
-    } else {
-        return RC_FILE_NOT_FOUND;  // Use a more appropriate error code for fclose failure
+    size_t size = sizeof(SM_SlotEntry) * header.numPages;
+    if (_preadFull(info->mapFd, info->slots, size, sizeof(header)) != (ssize_t)size) {
+        close(info->mapFd);
+        return RC_READ_FAILED;
     }
+    info->dataEnd = header.dataEnd;
+    info->pageSize = header.pageSize;
+    *numPages = header.numPages;
+    return RC_OK;
 }
 
-RC destroyPageFile(char *fileName) {
-    if (fileName == NULL) {
-        return RC_FILE_NOT_FOUND;  // Return not found if fileName is NULL
-    }
+// helper to get the size of an open file
+off_t _getFileSize(int fd)
+{
+    struct stat st;
 
-    if (remove(fileName) == 0) {
-        return RC_OK;  // File successfully deleted
-    } else {
-        // More precise error checking if needed
-             return RC_FILE_NOT_FOUND;  // No such file
+    // fstat does not move any file position (there is none to restore with pread/pwrite)
+    if (fd == -1 || fstat(fd, &st) != 0) {
+        return -1;
     }
+    return st.st_size;
 }
 
-/* reading blocks from disc */
-
-RC readBlock(int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage) {
-    if (fHandle == NULL || fHandle->mgmtInfo == NULL) {
-        return RC_FILE_NOT_FOUND;  // Checking for valid file handle and file pointer
+// helper to get the name of a segment of a segmented file (the caller frees it):
+// segment 0 is the file itself, segment k is <fileName>.k, in the k-th stripe
+// directory (in turn) if the file has any
+char *_segmentName(const char *fileName, const SM_FileHeader *layout, int segment)
+{
+    if (segment == 0) return strdup(fileName);
+
+    const char *base = fileName;
+    const char *dir = "";
+    if (layout->numStripeDirs > 0) {
+        const char *slash = strrchr(fileName, '/');
+        base = (slash != NULL) ? slash + 1 : fileName;
+        dir = layout->stripeDirs[(segment - 1) % layout->numStripeDirs];
     }
 
-    if (pageNum < 0 || pageNum >= fHandle->totalNumPages) {
-        return RC_READ_NON_EXISTING_PAGE;  // Page number is out of valid range
+    size_t length = strlen(dir) + strlen(base) + 16;
+    char *name = (char *)malloc(length);
+    if (name != NULL) {
+        snprintf(name, length, "%s%s%s.%d", dir, (*dir != '\0') ? "/" : "", base, segment);
     }
+    return name;
+}
+
+// helper to make a newly created file's directory entry durable
+void _syncDirectory(const char *path)
+{
+    char *dir = strdup(path);
+    if (dir == NULL) return;
 
-    FILE *fp = (FILE *)fHandle->mgmtInfo;
-    if (fseek(fp, pageNum * PAGE_SIZE, SEEK_SET) != 0) {
-        return RC_FILE_NOT_FOUND;  // fseek failed, possibly due to an invalid file pointer or other issues
+    char *slash = strrchr(dir, '/');
+    const char *name = (slash == NULL) ? "." : (slash == dir) ? "/" : dir;
+    if (slash != NULL && slash != dir) *slash = '\0';
+
+    int fd = open(name, O_RDONLY | O_DIRECTORY);
+    if (fd != -1) {
+        fsync(fd);
+        close(fd);
     }
+    free(dir);
+}
 
-    size_t bytesRead = fread(memPage, sizeof(char), PAGE_SIZE, fp);
-    if (bytesRead < PAGE_SIZE) {
-        if (feof(fp)) {
-            return RC_READ_NON_EXISTING_PAGE;  // Attempted to read beyond the end of the file
-        } else {
-            return RC_READ_FAILED;  // Partial read due to an error
+// helper to add an open segment file to the end of the segment table
+// NOTE the caller holds extendLock (or is opening the file)
+RC _addSegment(SM_FileInfo *info, int fd, off_t physicalSize)
+{
+    SM_Segment *segment = (SM_Segment *)malloc(sizeof(SM_Segment));
+    if (segment == NULL) return RC_ALLOCATION_FAILED;
+    segment->fd = fd;
+    segment->dirty = 0;
+    segment->physicalSize = physicalSize;
+
+    SM_SegmentTable *table = info->segments;
+    if (table == NULL || info->numSegments == table->capacity) {
+        int capacity = (table != NULL) ? table->capacity * 2 : 16;
+        SM_SegmentTable *larger = (SM_SegmentTable *)malloc(sizeof(SM_SegmentTable) + sizeof(SM_Segment *) * capacity);
+        if (larger == NULL) {
+            free(segment);
+            return RC_ALLOCATION_FAILED;
         }
+        larger->capacity = capacity;
+        larger->previous = table;
+        if (table != NULL) memcpy(larger->entries, table->entries, sizeof(SM_Segment *) * info->numSegments);
+        __atomic_store_n(&info->segments, larger, __ATOMIC_RELEASE);
+        table = larger;
     }
 
-    return RC_OK;  // Successfully read the entire page
+    table->entries[info->numSegments] = segment;
+    __atomic_store_n(&info->numSegments, info->numSegments + 1, __ATOMIC_RELEASE);
+    return RC_OK;
 }
 
-int getBlockPos (SM_FileHandle *fHandle)
+// helper to open the next segment of a segmented file, creating it if asked to
+// returns RC_FILE_NOT_FOUND if the segment does not exist and is not to be created
+RC _openNextSegment(SM_FileInfo *info, bool create)
 {
-    return fHandle->curPagePos;
+    char *name = _segmentName(info->fileName, info->layout, info->numSegments);
+    if (name == NULL) return RC_ALLOCATION_FAILED;
+
+    int flags = O_RDWR | ((info->mode == SM_MODE_DIRECT) ? O_DIRECT : 0) | (create ? O_CREAT : 0);
+    int fd = open(name, flags, 0644);
+    if (fd == -1) {
+        free(name);
+        return (errno == ENOENT) ? RC_FILE_NOT_FOUND : RC_WRITE_FAILED;
+    }
+    if (create) _syncDirectory(name);
+    free(name);
+
+    RC result = _addSegment(info, fd, _getFileSize(fd));
+    if (result != RC_OK) close(fd);
+    return result;
 }
 
-RC readFirstBlock (SM_FileHandle *fHandle, SM_PageHandle memPage)
+// helper to close the segments after the first and free the segment bookkeeping
+void _freeSegments(SM_FileInfo *info)
 {
-    return readBlock(0, fHandle, memPage);
+    for (int i = 1; i < info->numSegments; i++) {
+        close(info->segments->entries[i]->fd);
+    }
+    for (int i = 0; i < info->numSegments; i++) {
+        free(info->segments->entries[i]);
+    }
+    while (info->segments != NULL) {
+        SM_SegmentTable *previous = info->segments->previous;
+        free(info->segments);
+        info->segments = previous;
+    }
+    info->numSegments = 0;
+    free(info->layout);
+    free(info->fileName);
+    info->layout = NULL;
+    info->fileName = NULL;
 }
 
-RC readPreviousBlock(SM_FileHandle *fHandle, SM_PageHandle memPage) {
-    if (fHandle == NULL) {
-        return RC_FILE_NOT_FOUND;  // Handle the case where the file handle is NULL
+// helper to find the file descriptor and offset of a page (a file that is not
+// segmented is its own only segment)
+int _locate(SM_FileInfo *info, int pageNum, off_t *offset)
+{
+    if (info->layout == NULL) {
+        *offset = _pageOffset(info, pageNum);
+        return info->fd;
     }
 
-    int pageNum = fHandle->curPagePos - 1;
-
-    // Check if the calculated page number is valid
-    if (pageNum < 0) {
-        return RC_READ_NON_EXISTING_PAGE;  // Previous page number is out of valid range
-    }
+    int segment = pageNum / info->layout->segmentPages;
+    int index = pageNum % info->layout->segmentPages;
+    SM_SegmentTable *table = __atomic_load_n(&info->segments, __ATOMIC_ACQUIRE);
+    *offset = ((segment == 0) ? info->headerSize : 0) + (off_t)index * info->pageSize;
+    return table->entries[segment]->fd;
+}
 
-    RC result = readBlock(pageNum, fHandle, memPage);
-    if (result == RC_OK) {
-        fHandle->curPagePos = pageNum;  // Update the current page position on successful read
-    }
+// helper to note that the segment holding a page was written and needs the next sync
+// NOTE call it before counting the write in writeSeq so that sync sees the flag
+void _markSegmentDirty(SM_FileInfo *info, int pageNum)
+{
+    if (info->layout == NULL) return;
 
-    return result;
+    SM_SegmentTable *table = __atomic_load_n(&info->segments, __ATOMIC_ACQUIRE);
+    __atomic_store_n(&table->entries[pageNum / info->layout->segmentPages]->dirty, 1, __ATOMIC_RELAXED);
 }
 
-RC readCurrentBlock(SM_FileHandle *fHandle, SM_PageHandle memPage) {
-    if (fHandle == NULL || memPage == NULL || fHandle->mgmtInfo == NULL) {
-        return RC_FILE_NOT_FOUND;  // Validate pointers to ensure they are not NULL
-    }
+// helper to fdatasync the segments written since the last sync
+int _syncSegments(SM_FileInfo *info)
+{
+    int count = __atomic_load_n(&info->numSegments, __ATOMIC_ACQUIRE);
+    SM_SegmentTable *table = __atomic_load_n(&info->segments, __ATOMIC_ACQUIRE);
 
-    if (fHandle->curPagePos < 0 || fHandle->curPagePos >= fHandle->totalNumPages) {
-        return RC_READ_NON_EXISTING_PAGE;  // Validate current page position
+    for (int i = 0; i < count; i++) {
+        SM_Segment *segment = table->entries[i];
+        if (!__atomic_exchange_n(&segment->dirty, 0, __ATOMIC_ACQ_REL)) continue;
+
+        _countSyscalls(info, SM_IO_SYNC, 1);
+        if (fdatasync(segment->fd) != 0) {
+            __atomic_store_n(&segment->dirty, 1, __ATOMIC_RELAXED);  // still to be synced
+            return -1;
+        }
     }
+    return 0;
+}
 
-    return readBlock(fHandle->curPagePos, fHandle, memPage);  // Read the block at the current page position
+// helper to grow a file from `from` to `to` bytes without writing zeros
+int _extendFile(int fd, off_t from, off_t to)
+{
+    int status = fallocate(fd, 0, from, to - from);
+
+    // not every file system can preallocate, a sparse extension still avoids the writes
+    if (status != 0 && (errno == EOPNOTSUPP || errno == ENOSYS)) {
+        status = ftruncate(fd, to);
+    }
+    return status;
 }
 
-RC readNextBlock (SM_FileHandle *fHandle, SM_PageHandle memPage)
+// helper to make a segmented file hold numberOfPages pages: the segments the new
+// pages fall in are created as needed and grown in extents, never past a whole segment
+// NOTE the caller holds extendLock
+RC _growSegments(SM_FileInfo *info, int oldPages, int numberOfPages)
 {
-    // get the next `pageNum`
-    int pageNum = fHandle->curPagePos + 1;
+    int segmentPages = info->layout->segmentPages;
+    int firstSegment = (oldPages > 0) ? (oldPages - 1) / segmentPages : 0;
+    int lastSegment = (numberOfPages - 1) / segmentPages;
+
+    for (int segment = firstSegment; segment <= lastSegment; segment++) {
+        if (segment == info->numSegments) {
+            RC result = _openNextSegment(info, true);
+            if (result != RC_OK) return result;
+        }
 
-    RC result = readBlock(pageNum, fHandle, memPage);
+        SM_Segment *entry = info->segments->entries[segment];
+        off_t header = (segment == 0) ? info->headerSize : 0;
+        int pages = (segment < lastSegment) ? segmentPages : numberOfPages - segment * segmentPages;
+        off_t neededSize = header + (off_t)pages * info->pageSize;
+        if (neededSize <= entry->physicalSize) continue;
 
-    // Using switch case to handle the result
-    switch (result) {
-        case RC_OK:
-            fHandle->curPagePos = pageNum;  // Update `pageNum` on success
-            // Fallthrough to default case to return the result
-        default:
-            return result;  // Return the result of the read operation
+        off_t newSize = _roundToExtent(neededSize, info->extentSize);
+        off_t fullSize = header + (off_t)segmentPages * info->pageSize;
+        if (newSize > fullSize) newSize = fullSize;
+
+        _countSyscalls(info, SM_IO_APPEND, 1);
+        if (_extendFile(entry->fd, entry->physicalSize, newSize) != 0) {
+            return RC_WRITE_FAILED;
+        }
+        entry->physicalSize = newSize;
+        __atomic_store_n(&entry->dirty, 1, __ATOMIC_RELAXED);
     }
+    return RC_OK;
 }
 
-RC readLastBlock(SM_FileHandle *fHandle, SM_PageHandle memPage) {
-    if (fHandle == NULL || memPage == NULL) {
-        return RC_FILE_NOT_FOUND;  // Validate pointers are not NULL
-    }
+// helper to open the segments of a segmented file whose first segment is open,
+// counting its pages (every segment but the last is full)
+RC _openSegments(SM_FileInfo *info, const char *fileName, off_t fileSize, int *totalNumPages)
+{
+    info->fileName = strdup(fileName);
+    if (info->fileName == NULL) return RC_ALLOCATION_FAILED;
 
-    if (fHandle->totalNumPages == 0) {
-        return RC_READ_NON_EXISTING_PAGE;  // Handle empty file scenario
+    RC result = _addSegment(info, info->fd, fileSize);
+    while (result == RC_OK) {
+        result = _openNextSegment(info, false);
     }
+    if (result != RC_FILE_NOT_FOUND) return result;
 
-    int lastPageNum = fHandle->totalNumPages - 1;
-    return readBlock(lastPageNum, fHandle, memPage);  // Read the last block
+    int last = info->numSegments - 1;
+    off_t lastSize = info->segments->entries[last]->physicalSize - ((last == 0) ? info->headerSize : 0);
+    long lastPages = lastSize / info->pageSize;
+    if (lastPages > info->layout->segmentPages) lastPages = info->layout->segmentPages;
+
+    *totalNumPages = last * info->layout->segmentPages + (int)lastPages;
+    return RC_OK;
 }
 
-/* writing blocks to a page file */
+// helper to tell the kernel that pages will be read soon so it reads them in the
+// background (only files read through the page cache benefit)
+void _adviseWillNeed(SM_FileInfo *info, int firstPage, int numPages)
+{
+    if (info->backend != &fileBackend) {
+        return;  // Nothing to bring in
+    }
 
-RC writeBlock(int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage) {
-    if (fHandle == NULL || fHandle->mgmtInfo == NULL) {
-        return RC_FILE_NOT_FOUND;  // Check for valid file handle and file pointer
+    switch (info->mode) {
+        case SM_MODE_PREAD:
+            while (numPages > 0) {
+                // advice covers one segment at a time
+                int count = numPages;
+                if (info->layout != NULL) {
+                    int left = info->layout->segmentPages - firstPage % info->layout->segmentPages;
+                    if (count > left) count = left;
+                }
+                off_t offset;
+                int fd = _locate(info, firstPage, &offset);
+                posix_fadvise(fd, offset, (off_t)count * info->pageSize, POSIX_FADV_WILLNEED);
+                firstPage += count;
+                numPages -= count;
+            }
+            break;
+
+        case SM_MODE_MMAP:
+            pthread_rwlock_rdlock(&info->mapLock);
+            madvise(info->map + _pageOffset(info, firstPage), (size_t)numPages * info->pageSize, MADV_WILLNEED);
+            pthread_rwlock_unlock(&info->mapLock);
+            break;
+
+        default:
+            break;  // O_DIRECT skips the page cache, compressed pages are not laid out in order
     }
+}
 
-    if (pageNum < 0 || pageNum >= fHandle->totalNumPages) {
-        return RC_PAGE_OUT_OF_RANGE;  // Page number is out of valid range
+// helper to follow the cursor reads: once two reads in a row move the same way the
+// pages ahead are advised, in a window that doubles (up to SM_MAX_READAHEAD) as long
+// as the run goes on and is topped up when the reader is half way through it
+void _cursorReadahead(SM_FileInfo *info, int pageNum, int totalNumPages, int direction)
+{
+    if (pageNum != info->cursorPage + direction) {
+        info->cursorPage = pageNum;
+        info->readaheadWindow = 0;  // not (or no longer) sequential
+        return;
     }
+    info->cursorPage = pageNum;
 
-    FILE *fp = (FILE *)fHandle->mgmtInfo;
-    if (fseek(fp, pageNum * PAGE_SIZE, SEEK_SET) != 0) {
-        return RC_FILE_NOT_FOUND;  // fseek failed, possibly due to an invalid file pointer or other issues
+    if (info->readaheadWindow == 0) {
+        info->readaheadWindow = SM_MIN_READAHEAD;
+        info->readaheadNext = pageNum + direction;
     }
 
-    size_t bytesWritten = fwrite(memPage, sizeof(char), PAGE_SIZE, fp);
-    if (bytesWritten != PAGE_SIZE) {
-        fflush(fp);  // Ensure all I/O operations are flushed in case of partial write
-        return RC_WRITE_FAILED;  // Partial write due to an error
+    // pages already advised ahead of the reader
+    int ahead = (info->readaheadNext - pageNum) * direction;
+    if (ahead > info->readaheadWindow / 2) return;
+
+    int first = info->readaheadNext;
+    int count = info->readaheadWindow;
+    if (direction < 0) {
+        first = info->readaheadNext - count + 1;
+        if (first < 0) {
+            count += first;
+            first = 0;
+        }
+    } else if (first + count > totalNumPages) {
+        count = totalNumPages - first;
     }
 
-    fflush(fp);  // Flush the output buffer to ensure all data is written to disk
-    return RC_OK;  // Successfully wrote the entire page
+    if (count > 0) {
+        _adviseWillNeed(info, first, count);
+        info->readaheadNext += count * direction;
+    }
+    if (info->readaheadWindow < SM_MAX_READAHEAD) {
+        info->readaheadWindow *= 2;
+    }
 }
 
-RC writeCurrentBlock (SM_FileHandle *fHandle, SM_PageHandle memPage)
+// helper to move `numPages` adjacent pages starting at `startPage` from / to the
+// given buffers, using one preadv / pwritev per IOV_MAX pages
+RC _moveRun(SM_FileInfo *info, int startPage, SM_PageHandle *buffers, int numPages, bool write)
 {
-    return writeBlock(fHandle->curPagePos, fHandle, memPage);
-}
-
+    struct iovec iov[IOV_MAX];
+    int moved = 0;
+
+    switch (info->mode) {
+        case SM_MODE_MMAP:
+            // no syscall at all, the kernel faults the pages in (with readahead)
+            _mapCopy(info, startPage, buffers, numPages, write);
+            moved = numPages;
+            break;
+
+        case SM_MODE_COMPRESSED:
+            // every page has its own slot, so they are moved one by one
+            for (; moved < numPages; moved++) {
+                RC result = write ? _writeCompressed(info, startPage + moved, buffers[moved])
+                                  : _readCompressed(info, startPage + moved, buffers[moved]);
+                if (result != RC_OK) return result;
+            }
+            break;
 
-RC appendEmptyBlock(SM_FileHandle *fHandle) {
-    if (fHandle == NULL || fHandle->mgmtInfo == NULL) {
-        return RC_FILE_NOT_FOUND;  // Validate file handle and management info pointer
+        default:
+            break;
     }
 
-    FILE *fp = (FILE *)fHandle->mgmtInfo;
-    if (fseek(fp, 0, SEEK_END) != 0) {
-        return RC_SEEK_FAILED;  // More accurate error code for fseek failure
-    }
+    while (moved < numPages) {
+        int count = numPages - moved;
+        if (count > IOV_MAX) count = IOV_MAX;
 
-    void *emptyPage = malloc(PAGE_SIZE);
-    if (emptyPage == NULL) {
-        return RC_ALLOCATION_FAILED;  // Handle memory allocation failure
-    }
+        // one transfer cannot go past the end of a segment
+        if (info->layout != NULL) {
+            int left = info->layout->segmentPages - (startPage + moved) % info->layout->segmentPages;
+            if (count > left) count = left;
+        }
 
-    memset(emptyPage, '\0', PAGE_SIZE);
-    size_t bytesWritten = fwrite(emptyPage, sizeof(char), PAGE_SIZE, fp);
-    free(emptyPage);  // Ensure memory is freed in all cases
+        for (int i = 0; i < count; i++) {
+            if (!_isAligned(info, buffers[moved + i])) {
+                return RC_IO_MISALIGNED;
+            }
+            iov[i].iov_base = buffers[moved + i];
+            iov[i].iov_len = info->pageSize;
+        }
 
-    if (bytesWritten != PAGE_SIZE) {
-        fflush(fp);  // Flush any written data to handle partial writes
-        return RC_WRITE_FAILED;
+        off_t offset;
+        int fd = _locate(info, startPage + moved, &offset);
+        ssize_t bytes = _pvecFull(fd, iov, count, offset, write);
+        _countSyscalls(info, write ? SM_IO_WRITE : SM_IO_READ, 1);
+        if (bytes == -1) {
+            return write ? RC_WRITE_FAILED : RC_READ_FAILED;
+        }
+        if (bytes != (ssize_t)count * info->pageSize) {
+            return write ? RC_WRITE_FAILED : RC_READ_NON_EXISTING_PAGE;
+        }
+        if (write) {
+            _markSegmentDirty(info, startPage + moved);
+        }
+        moved += count;
     }
 
-    fflush(fp);  // Ensure all data is written to disk
-    fHandle->totalNumPages++;  // Update the file metadata
+    if (write) {
+        __atomic_add_fetch(&info->writeSeq, 1, __ATOMIC_RELEASE);
+    }
     return RC_OK;
 }
 
-RC ensureCapacity(int numberOfPages, SM_FileHandle *fHandle) {
-    if (fHandle == NULL || fHandle->mgmtInfo == NULL) {
-        return RC_FILE_NOT_FOUND;  // Check for valid file handle and file pointer
-    }
+// the file backend's reads and writes
+RC _fileRead(SM_FileInfo *info, int startPage, SM_PageHandle *buffers, int numPages)
+{
+    return _moveRun(info, startPage, buffers, numPages, false);
+}
 
-    while (fHandle->totalNumPages < numberOfPages) {
-        RC result = appendEmptyBlock(fHandle);
-        if (result != RC_OK) {
-            return result;  // Return any errors encountered during the append operation
-        }
-    }
-    return RC_OK;  // Successfully ensured the capacity
-}
\ No newline at end of file
+RC _fileWrite(SM_FileInfo *info, int startPage, SM_PageHandle *buffers, int numPages)
+{
+    return _moveRun(info, startPage, buffers, numPages, true);
+}
+
+// helper to read the page size from a file's header; files without a header
+// are read as they always were, PAGE_SIZE pages from the start of the file
+RC _readFileHeader(SM_FileInfo *info, off_t fileSize)
+{
+    info->pageSize = PAGE_SIZE;
+    info->headerSize = 0;
+    if (fileSize < SM_HEADER_SIZE) return RC_OK;
+
+    // a whole aligned block, so the read also works on an O_DIRECT descriptor
+    void *block;
+    if (posix_memalign(&block, SM_HEADER_SIZE, SM_HEADER_SIZE) != 0) return RC_ALLOCATION_FAILED;
+
+    RC result = RC_OK;
+    SM_FileHeader *header = (SM_FileHeader *)block;
+    if (_preadFull(info->fd, block, SM_HEADER_SIZE, 0) != SM_HEADER_SIZE) {
+        result = RC_READ_FAILED;
+    } else if (memcmp(header->magic, SM_FILE_MAGIC, sizeof(header->magic)) == 0) {
+        if (header->version != SM_FILE_VERSION || !_validPageSize(header->pageSize) || header->segmentPages < 0
+            || header->numStripeDirs < 0 || header->numStripeDirs > SM_MAX_STRIPE_DIRS) {
+            result = RC_READ_FAILED;
+        } else {
+            info->pageSize = header->pageSize;
+            info->headerSize = SM_HEADER_SIZE;
+            info->headerPages = (header->numPages > 0) ? header->numPages : 0;
+
+            // a segmented file keeps its layout to find the other segments
+            if (header->segmentPages > 0) {
+                info->layout = (SM_FileHeader *)malloc(sizeof(SM_FileHeader));
+                if (info->layout == NULL) {
+                    result = RC_ALLOCATION_FAILED;
+                } else {
+                    memcpy(info->layout, header, sizeof(SM_FileHeader));
+                    for (int i = 0; i < SM_MAX_STRIPE_DIRS; i++) {
+                        info->layout->stripeDirs[i][SM_MAX_PATH_LENGTH - 1] = '\0';
+                    }
+                }
+            }
+        }
+    }
+    free(block);
+    return result;
+}
+
+// helper to record the page count in the header of a file that has one, so that a
+// file reopened after a crash does not count its preallocated tail as pages
+// NOTE the caller holds syncing (see syncPageFile) or is closing the file
+RC _saveHeaderPages(SM_FileInfo *info, int totalNumPages)
+{
+    if (info->headerSize == 0 || info->headerPages == totalNumPages) return RC_OK;
+
+    // the header is rewritten as a whole aligned block (the file may be O_DIRECT)
+    void *block;
+    if (posix_memalign(&block, SM_HEADER_SIZE, SM_HEADER_SIZE) != 0) return RC_ALLOCATION_FAILED;
+
+    RC result = RC_WRITE_FAILED;
+    if (_preadFull(info->fd, block, SM_HEADER_SIZE, 0) == SM_HEADER_SIZE) {
+        ((SM_FileHeader *)block)->numPages = totalNumPages;
+        if (_pwriteFull(info->fd, block, SM_HEADER_SIZE, 0) == SM_HEADER_SIZE) {
+            _markSegmentDirty(info, 0);
+            info->headerPages = totalNumPages;
+            result = RC_OK;
+        }
+    }
+    _countSyscalls(info, SM_IO_WRITE, 2);
+    free(block);
+    return result;
+}
+
+// helper to remove the segments after the first of a segmented file (if it is one)
+void _removeSegments(const char *fileName)
+{
+    int fd = open(fileName, O_RDONLY);
+    if (fd == -1) return;
+
+    SM_FileHeader *header = (SM_FileHeader *)malloc(sizeof(SM_FileHeader));
+    if (header != NULL && _preadFull(fd, header, sizeof(SM_FileHeader), 0) == sizeof(SM_FileHeader)
+        && memcmp(header->magic, SM_FILE_MAGIC, sizeof(header->magic)) == 0 && header->segmentPages > 0
+        && header->numStripeDirs >= 0 && header->numStripeDirs <= SM_MAX_STRIPE_DIRS) {
+        for (int i = 0; i < SM_MAX_STRIPE_DIRS; i++) {
+            header->stripeDirs[i][SM_MAX_PATH_LENGTH - 1] = '\0';
+        }
+
+        // segments are numbered without gaps, the first missing one ends them
+        for (int segment = 1; ; segment++) {
+            char *name = _segmentName(fileName, header, segment);
+            int status = (name != NULL) ? unlink(name) : -1;
+            free(name);
+            if (status != 0) break;
+        }
+    }
+    free(header);
+    close(fd);
+}
+
+// qsort comparator ordering a page list by page number
+int _comparePageIO(const void *a, const void *b)
+{
+    int pa = ((const SM_PageIO *)a)->pageNum;
+    int pb = ((const SM_PageIO *)b)->pageNum;
+    return (pa > pb) - (pa < pb);
+}
+
+// helper to make a page bitmap cover at least numPages pages (new bits are clear)
+RC _growBitmap(unsigned char **bits, int *capacity, int numPages)
+{
+    if (numPages <= *capacity) return RC_OK;
+
+    int newCapacity = (*capacity > 0) ? *capacity : 1024;
+    while (newCapacity < numPages) newCapacity *= 2;
+    unsigned char *grown = (unsigned char *)realloc(*bits, newCapacity / 8);
+    if (grown == NULL) return RC_ALLOCATION_FAILED;
+    memset(grown + *capacity / 8, 0, (newCapacity - *capacity) / 8);
+    *bits = grown;
+    *capacity = newCapacity;
+    return RC_OK;
+}
+
+// helper to write the change file; clean is only set by a close, so a file opened
+// again after a crash is known to have missed writes
+// NOTE the caller holds changeLock
+RC _saveChanges(SM_FileInfo *info, int numPages, bool clean)
+{
+    SM_ChangeHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SM_CHANGE_MAGIC, sizeof(header.magic));
+    header.clean = clean && info->trackingValid;
+    header.backupPages = info->backupPages;
+    header.numPages = numPages;
+
+    // only a close writes the map, and only then can it grow here (writers may be using it)
+    size_t bitmapSize = (numPages + 7) / 8;
+    if (clean && _growBitmap(&info->changed, &info->changedCapacity, numPages) != RC_OK) return RC_ALLOCATION_FAILED;
+    if (_pwriteFull(info->changeFd, &header, sizeof(header), 0) != sizeof(header)
+        || (clean && _pwriteFull(info->changeFd, info->changed, bitmapSize, sizeof(header)) != (ssize_t)bitmapSize)
+        || fdatasync(info->changeFd) != 0) {
+        return RC_WRITE_FAILED;
+    }
+    return RC_OK;
+}
+
+// helper to pick up the pages written since the last backup from the change file
+// (if a backup was ever taken) and mark it in use until the file is closed again
+RC _openChanges(SM_FileInfo *info, const char *fileName, int numPages)
+{
+    char *name = _sidecarName(fileName, SM_CHANGE_SUFFIX);
+    if (name == NULL) return RC_ALLOCATION_FAILED;
+    info->changeFd = open(name, O_RDWR);
+    free(name);
+    if (info->changeFd == -1) return RC_OK;  // never backed up
+
+    SM_ChangeHeader header;
+    if (_preadFull(info->changeFd, &header, sizeof(header), 0) == sizeof(header)
+        && memcmp(header.magic, SM_CHANGE_MAGIC, sizeof(header.magic)) == 0 && header.clean
+        && header.numPages >= 0 && header.backupPages >= 0
+        && _growBitmap(&info->changed, &info->changedCapacity,
+                       (header.numPages > header.backupPages) ? header.numPages : header.backupPages) == RC_OK) {
+        size_t bitmapSize = (header.numPages + 7) / 8;
+        if (_preadFull(info->changeFd, info->changed, bitmapSize, sizeof(header)) == (ssize_t)bitmapSize) {
+            info->trackingValid = true;
+            info->backupPages = header.backupPages;
+        }
+    }
+    return _saveChanges(info, numPages, false);
+}
+
+// helper to copy `numPages` pages starting at `firstPage` to the same place in the
+// backup file: with copy_file_range where the pages lie in the file as they are
+// (the kernel copies them without a trip through user space), with reads and
+// writes through `buffer` otherwise; copy_file_range reads through the page cache,
+// which O_DIRECT writes bypass, so SM_MODE_DIRECT files are always read directly
+RC _copyToBackup(SM_FileInfo *info, int firstPage, int numPages, char *buffer)
+{
+    while (numPages > 0) {
+        int count = numPages;
+        off_t target = SM_HEADER_SIZE + (off_t)firstPage * info->pageSize;
+
+        if (info->mode == SM_MODE_COMPRESSED || info->backend != &fileBackend) {
+            // pages without a fixed place in a file are read one by one
+            count = 1;
+            if (info->backend->read(info, firstPage, &buffer, 1) != RC_OK) return RC_READ_FAILED;
+            if (_pwriteFull(info->backupFd, buffer, info->pageSize, target) != info->pageSize) return RC_WRITE_FAILED;
+        } else {
+            // a run is copied one segment at a time
+            if (info->layout != NULL) {
+                int left = info->layout->segmentPages - firstPage % info->layout->segmentPages;
+                if (count > left) count = left;
+            }
+            off_t source;
+            int fd = _locate(info, firstPage, &source);
+            size_t length = (size_t)count * info->pageSize;
+            while (length > 0) {
+                ssize_t copied = (info->mode == SM_MODE_DIRECT) ? 0
+                    : copy_file_range(fd, &source, info->backupFd, &target, length, 0);
+                if (copied > 0) {
+                    length -= copied;
+                    continue;
+                }
+                if (copied == -1 && errno == EINTR) continue;
+
+                // not possible between these files (e.g. across file systems)
+                size_t chunk = (length < (size_t)info->pageSize) ? length : (size_t)info->pageSize;
+                if (_preadFull(fd, buffer, chunk, source) != (ssize_t)chunk
+                    || _pwriteFull(info->backupFd, buffer, chunk, target) != (ssize_t)chunk) {
+                    return RC_WRITE_FAILED;
+                }
+                source += chunk;
+                target += chunk;
+                length -= chunk;
+            }
+        }
+        firstPage += count;
+        numPages -= count;
+    }
+    return RC_OK;
+}
+
+// helper called by every write before it changes pages: the pages are noted as
+// changed for the next incremental backup and, while a backup runs, the ones it
+// has not copied yet are copied first (so it gets them as they were when it started)
+// NOTE the caller holds backupLock shared until its write is done
+RC _trackWrite(SM_FileInfo *info, int firstPage, int numPages)
+{
+    // pages past the map were added since the last backup, which always copies those
+    // (before the first backup the map is empty and nothing is noted at all)
+    int end = (firstPage + numPages < info->changedCapacity) ? firstPage + numPages : info->changedCapacity;
+    for (int page = firstPage; page < end; page++) {
+        unsigned char bit = (unsigned char)(1 << (page % 8));
+        if (!(__atomic_load_n(&info->changed[page / 8], __ATOMIC_RELAXED) & bit)) {
+            __atomic_fetch_or(&info->changed[page / 8], bit, __ATOMIC_RELAXED);
+        }
+    }
+
+    // only a running backup needs the lock; one that started before our write
+    // published its snapshot under backupLock, one that is ending is checked again
+    if (__atomic_load_n(&info->snapshotPages, __ATOMIC_RELAXED) == 0) return RC_OK;
+
+    RC result = RC_OK;
+    pthread_mutex_lock(&info->changeLock);
+    if (info->snapshotPages > 0) {
+        char *buffer = NULL;
+        for (int page = firstPage; page < firstPage + numPages && page < info->snapshotPages; page++) {
+            if (!(info->pending[page / 8] & (1 << (page % 8)))) continue;
+            if (buffer == NULL && posix_memalign((void **)&buffer, info->alignment, info->pageSize) != 0) {
+                result = RC_ALLOCATION_FAILED;
+                break;
+            }
+            RC copied = _copyToBackup(info, page, 1, buffer);
+            if (copied != RC_OK && info->backupResult == RC_OK) info->backupResult = copied;
+            info->pending[page / 8] &= (unsigned char)~(1 << (page % 8));
+        }
+        free(buffer);
+    }
+    pthread_mutex_unlock(&info->changeLock);
+    return result;
+}
+
+// helper to take a backup of the pages in `copy` (a bitmap over numPages pages, which
+// the backup consumes) into the open backup file, consistent as of this call
+// NOTE the caller holds backupLock exclusively and got the pages from the change map
+RC _runBackup(SM_FileHandle *fHandle, int backupFd, unsigned char *copy, int numPages, int *pagesCopied)
+{
+    SM_FileInfo *info = (SM_FileInfo *)fHandle->mgmtInfo;
+    char *buffer;
+    if (posix_memalign((void **)&buffer, info->alignment, info->pageSize) != 0) {
+        pthread_rwlock_unlock(&info->backupLock);
+        return RC_ALLOCATION_FAILED;
+    }
+
+    // the snapshot starts here: writes from now on copy the pages they overwrite first
+    pthread_mutex_lock(&info->changeLock);
+    info->pending = copy;
+    info->snapshotPages = numPages;
+    info->backupFd = backupFd;
+    info->backupResult = RC_OK;
+    pthread_mutex_unlock(&info->changeLock);
+    pthread_rwlock_unlock(&info->backupLock);
+
+    int copied = 0;
+    for (int start = 0; start < numPages; start += SM_BACKUP_CHUNK) {
+        pthread_mutex_lock(&info->changeLock);
+        int end = (start + SM_BACKUP_CHUNK < numPages) ? start + SM_BACKUP_CHUNK : numPages;
+        for (int page = start; page < end && info->backupResult == RC_OK; page++) {
+            if (!(copy[page / 8] & (1 << (page % 8)))) continue;
+
+            // copy the whole run of pending pages from here
+            int run = 1;
+            while (page + run < end && (copy[(page + run) / 8] & (1 << ((page + run) % 8)))) run++;
+            info->backupResult = _copyToBackup(info, page, run, buffer);
+            for (int i = page; i < page + run; i++) {
+                copy[i / 8] &= (unsigned char)~(1 << (i % 8));
+            }
+            copied += run;
+            page += run - 1;
+        }
+        pthread_mutex_unlock(&info->changeLock);
+    }
+
+    pthread_mutex_lock(&info->changeLock);
+    RC result = info->backupResult;
+    info->pending = NULL;
+    __atomic_store_n(&info->snapshotPages, 0, __ATOMIC_RELAXED);
+    info->backupFd = -1;
+    pthread_mutex_unlock(&info->changeLock);
+
+    // pages copied by writers count as well
+    if (pagesCopied != NULL) *pagesCopied = copied;
+    free(buffer);
+
+    if (result == RC_OK && (ftruncate(backupFd, SM_HEADER_SIZE + (off_t)numPages * info->pageSize) != 0
+                            || fdatasync(backupFd) != 0)) {
+        result = RC_WRITE_FAILED;
+    }
+    return result;
+}
+
+/* manipulating page files */
+
+void initStorageManager(void) { }
+
+typedef enum {
+    SUCCESS,
+    NULL_POINTER,
+    WRITE_ERROR
+} FileOperationStatus;
+
+RC _createPageFile(char *fileName, SM_FileMode mode, SM_FileHeader *header);
+
+// helper to fill in the header of a file that is not segmented
+void _initHeader(SM_FileHeader *header, int pageSize)
+{
+    memset(header, 0, sizeof(SM_FileHeader));
+    memcpy(header->magic, SM_FILE_MAGIC, sizeof(header->magic));
+    header->version = SM_FILE_VERSION;
+    header->pageSize = pageSize;
+}
+
+RC createPageFile(char *fileName) {
+    SM_FileHeader header;
+    _initHeader(&header, PAGE_SIZE);
+    return _createPageFile(fileName, defaultFileMode, &header);
+}
+
+/**
+ * Creates a page file holding one empty page.
+ *
+ * With SM_MODE_COMPRESSED the file is created in the compressed format: pages are
+ * compressed on write into variable-size slots and a sidecar <fileName>.map records
+ * where each page lives. openPageFile recognizes such files by their map. Any other
+ * mode creates a plain page file.
+ *
+ * @param fileName The name of the file to create.
+ * @param mode The mode the file is meant for.
+ * @return Result code indicating success or failure.
+ */
+RC createPageFileWithMode(char *fileName, SM_FileMode mode) {
+    SM_FileHeader header;
+    _initHeader(&header, PAGE_SIZE);
+    return _createPageFile(fileName, mode, &header);
+}
+
+/**
+ * Creates a page file with its own page size.
+ *
+ * The size is recorded in the file's header and used by every handle opened on the
+ * file (see getPageSize), so it only has to be chosen once. Large pages suit tables
+ * that are mostly scanned, small ones tables with scattered single-record access.
+ *
+ * @param fileName The name of the file to create.
+ * @param pageSize A multiple of SM_MIN_PAGE_SIZE up to SM_MAX_PAGE_SIZE.
+ * @return Result code indicating success or failure (RC_IM_CONFIG_ERROR for a bad size).
+ */
+RC createPageFileWithSize(char *fileName, int pageSize) {
+    SM_FileHeader header;
+    _initHeader(&header, pageSize);
+    return _createPageFile(fileName, defaultFileMode, &header);
+}
+
+/**
+ * Creates a page file split into segment files of segmentPages pages each.
+ *
+ * The file named fileName is the first segment and holds the header; segment k is
+ * <fileName>.k, created when the file grows into it. With stripe directories the
+ * segments after the first go to stripeDirs[0], stripeDirs[1], ... in turn, so one
+ * file's I/O is spread over several file systems or devices. The layout is recorded
+ * in the header, openPageFile finds the segments again by itself.
+ *
+ * @param fileName The name of the file (and its first segment) to create.
+ * @param pageSize The page size, as for createPageFileWithSize.
+ * @param segmentPages The number of pages per segment file.
+ * @param stripeDirs Directories for the segments after the first (may be NULL).
+ * @param numStripeDirs The number of stripe directories, at most SM_MAX_STRIPE_DIRS.
+ * @return Result code indicating success or failure (RC_IM_CONFIG_ERROR for a bad layout).
+ */
+RC createSegmentedPageFile(char *fileName, int pageSize, int segmentPages, char **stripeDirs, int numStripeDirs) {
+    if (segmentPages <= 0 || numStripeDirs < 0 || numStripeDirs > SM_MAX_STRIPE_DIRS
+        || (numStripeDirs > 0 && stripeDirs == NULL)) {
+        return RC_IM_CONFIG_ERROR;
+    }
+
+    SM_FileHeader header;
+    _initHeader(&header, pageSize);
+    header.segmentPages = segmentPages;
+    header.numStripeDirs = numStripeDirs;
+    for (int i = 0; i < numStripeDirs; i++) {
+        if (stripeDirs[i] == NULL || strlen(stripeDirs[i]) >= SM_MAX_PATH_LENGTH) {
+            return RC_IM_CONFIG_ERROR;
+        }
+        strcpy(header.stripeDirs[i], stripeDirs[i]);
+    }
+    return _createPageFile(fileName, defaultFileMode, &header);
+}
+
+// helper to create the files of an empty compressed page file: a data file holding only
+// its magic (so no slot starts at offset 0) and a map with one unwritten page
+FileOperationStatus _createCompressed(int fd, char *fileName, int pageSize)
+{
+    char *mapName = _mapFileName(fileName);
+    if (mapName == NULL) return WRITE_ERROR;
+    int mapFd = open(mapName, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    free(mapName);
+    if (mapFd == -1) return NULL_POINTER;
+
+    SM_MapHeader header;
+    SM_SlotEntry entry;
+    memcpy(header.magic, SM_MAP_MAGIC, sizeof(header.magic));
+    header.numPages = 1;
+    header.dataEnd = SM_SLOT_GRANULE;
+    header.pageSize = pageSize;
+    header.unused = 0;
+    memset(&entry, 0, sizeof(entry));
+
+    bool ok = _pwriteFull(fd, SM_DATA_MAGIC, strlen(SM_DATA_MAGIC), 0) == (ssize_t)strlen(SM_DATA_MAGIC)
+        && _pwriteFull(mapFd, &header, sizeof(header), 0) == sizeof(header)
+        && _pwriteFull(mapFd, &entry, sizeof(entry), sizeof(header)) == sizeof(entry);
+    close(mapFd);
+    return ok ? SUCCESS : WRITE_ERROR;
+}
+
+// shared body of the createPageFile variants
+RC _createPageFile(char *fileName, SM_FileMode mode, SM_FileHeader *header) {
+    if (!_validPageSize(header->pageSize) || (mode == SM_MODE_COMPRESSED && header->segmentPages > 0)) {
+        return RC_IM_CONFIG_ERROR;  // Compressed files are never segmented
+    }
+    return _backendFor(fileName)->create(fileName, mode, header);
+}
+
+// the file backend's create: the header and an empty first page (or an empty
+// compressed file)
+RC _fileCreate(char *fileName, SM_FileMode mode, SM_FileHeader *header) {
+    int pageSize = header->pageSize;
+
+    // the segments of a file created earlier under this name would be taken for ours
+    _removeSegments(fileName);
+
+    int fd = open(fileName, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    FileOperationStatus status;
+
+    if (fd == -1)
+        status = NULL_POINTER;
+    else if (mode == SM_MODE_COMPRESSED) {
+        status = _createCompressed(fd, fileName, pageSize);
+        close(fd);
+    }
+    else {
+        // a plain file may still have a map left over from an earlier compressed one
+        char *mapName = _mapFileName(fileName);
+        if (mapName != NULL) {
+            unlink(mapName);
+            free(mapName);
+        }
+
+        // the header followed by the empty first page
+        ssize_t fileSize = SM_HEADER_SIZE + pageSize;
+        char *emptyPage = (char *)calloc(1, fileSize);
+        if (emptyPage == NULL) {
+            close(fd);
+            return RC_ALLOCATION_FAILED;
+        }
+
+        memcpy(emptyPage, header, sizeof(SM_FileHeader));
+        ((SM_FileHeader *)emptyPage)->numPages = 1;
+        ssize_t bytesWritten = _pwriteFull(fd, emptyPage, fileSize, 0);
+        close(fd);
+        free(emptyPage);
+
+        status = (bytesWritten != fileSize) ? WRITE_ERROR : SUCCESS;
+    }
+
+    switch (status) {
+        case NULL_POINTER:
+            return RC_FILE_NOT_FOUND;
+
+        case WRITE_ERROR:
+            return RC_WRITE_FAILED;
+
+        case SUCCESS:
+            return RC_OK;
+
+        default:
+            // Optional: Handle unexpected status
+            return 0;  // assuming there's a general error return code
+    }
+}
+
+
+typedef enum {
+    FILE_SUCCESS,
+    FILE_ERROR
+} FileStatus;
+
+// helper to set up the handle state of a file about to be opened (nothing open yet)
+SM_FileInfo *_newFileInfo(const SM_Backend *backend, SM_FileMode mode)
+{
+    SM_FileInfo *info = (SM_FileInfo *)malloc(sizeof(SM_FileInfo));
+    if (info == NULL) {
+        return NULL;
+    }
+    info->backend = backend;
+    info->memFile = NULL;
+    info->fd = -1;
+    info->mode = mode;
+    info->pageSize = PAGE_SIZE;
+    info->headerSize = 0;
+    info->alignment = PAGE_SIZE;
+    pthread_rwlock_init(&info->mapLock, NULL);
+    info->map = NULL;
+    info->mapSize = 0;
+    pthread_mutex_init(&info->syncLock, NULL);
+    pthread_cond_init(&info->syncDone, NULL);
+    info->writeSeq = 0;
+    info->syncedSeq = 0;
+    info->syncing = false;
+    pthread_mutex_init(&info->extendLock, NULL);
+    info->extentSize = SM_DEFAULT_EXTENT_SIZE;
+    info->physicalSize = 0;
+    info->headerPages = 0;
+    info->aio = NULL;
+    info->slots = NULL;
+    info->slotCapacity = 0;
+    info->dataEnd = 0;
+    info->mapFd = -1;
+    info->layout = NULL;
+    info->fileName = NULL;
+    info->segments = NULL;
+    info->numSegments = 0;
+    memset(&info->stats, 0, sizeof(SM_IOStats));
+    info->cursorPage = -1;
+    info->readaheadWindow = 0;
+    info->readaheadNext = 0;
+    pthread_rwlock_init(&info->backupLock, NULL);
+    pthread_mutex_init(&info->changeLock, NULL);
+    info->changed = NULL;
+    info->changedCapacity = 0;
+    info->trackingValid = false;
+    info->backupPages = 0;
+    info->changeFd = -1;
+    info->pending = NULL;
+    info->snapshotPages = 0;
+    info->backupFd = -1;
+    info->backupResult = RC_OK;
+    return info;
+}
+
+// helper to free the handle state once its storage is closed
+void _freeFileInfo(SM_FileInfo *info)
+{
+    free(info->changed);
+    pthread_rwlock_destroy(&info->backupLock);
+    pthread_mutex_destroy(&info->changeLock);
+    pthread_rwlock_destroy(&info->mapLock);
+    pthread_mutex_destroy(&info->extendLock);
+    pthread_cond_destroy(&info->syncDone);
+    pthread_mutex_destroy(&info->syncLock);
+    free(info);
+}
+
+// the file backend's open: the file (or its segments, or its page map) is opened in
+// the mode asked for and its pages counted
+RC _fileOpen(char *fileName, SM_FileInfo *info, SM_FileMode mode, int *numPages) {
+    // Attempt to open the file in read+write mode (bypassing the page cache in SM_MODE_DIRECT)
+    int fd = open(fileName, (mode == SM_MODE_DIRECT) ? (O_RDWR | O_DIRECT) : O_RDWR);
+    FileStatus status = (fd == -1) ? FILE_ERROR : FILE_SUCCESS;
+
+    switch (status) {
+        case FILE_ERROR:
+            // If the file could not be opened, return file not found error
+            // (or a config error if it exists but its file system cannot do O_DIRECT)
+            return (mode == SM_MODE_DIRECT && errno == EINVAL) ? RC_IM_CONFIG_ERROR : RC_FILE_NOT_FOUND;
+
+        case FILE_SUCCESS:
+            // Get the size of the file and calculate the number of pages
+            off_t fileSize = _getFileSize(fd);
+            if (fileSize == -1) {
+                close(fd);  // Close the file if size retrieval failed
+                return RC_FILE_NOT_FOUND;  // Assuming error due to file issues
+            }
+
+            info->fd = fd;
+            info->alignment = _getAlignment(fd);
+            info->physicalSize = fileSize;
+
+            // a file with a page map is compressed whatever mode was asked for
+            int totalNumPages = 0;
+            RC slotResult = _openSlots(info, fileName, &totalNumPages);
+            if (slotResult == RC_FILE_NOT_FOUND && mode != SM_MODE_COMPRESSED) {
+                slotResult = _readFileHeader(info, fileSize);
+                if (slotResult == RC_OK && info->layout != NULL) {
+                    // a mapping covers a single file, segmented files are read with pread
+                    if (mode == SM_MODE_MMAP) mode = info->mode = SM_MODE_PREAD;
+                    slotResult = _openSegments(info, fileName, fileSize, &totalNumPages);
+                } else if (slotResult == RC_OK) {
+                    totalNumPages = (fileSize - info->headerSize) / info->pageSize;
+                }
+
+                // past the recorded count lies what a crash left of the last extent
+                if (slotResult == RC_OK && info->headerPages > 0 && info->headerPages < totalNumPages) {
+                    totalNumPages = info->headerPages;
+                }
+                if (slotResult == RC_OK) {
+                    slotResult = RC_FILE_NOT_FOUND;  // a plain file
+                }
+            }
+            if (slotResult == RC_OK) {
+                // slots are not page aligned, so O_DIRECT cannot be kept
+                if (mode == SM_MODE_DIRECT) fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_DIRECT);
+                mode = info->mode = SM_MODE_COMPRESSED;
+            } else if (slotResult != RC_FILE_NOT_FOUND || mode == SM_MODE_COMPRESSED) {
+                _freeSegments(info);
+                close(fd);
+                free(info->slots);
+                return (slotResult == RC_FILE_NOT_FOUND) ? RC_IM_CONFIG_ERROR : slotResult;
+            }
+
+            if (mode == SM_MODE_MMAP) {
+                // map whole extents so most growth does not need a remap
+                off_t mapSize = _roundToExtent(fileSize, info->extentSize);
+                void *map = mmap(NULL, mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+                if (map == MAP_FAILED) {
+                    close(fd);
+                    return RC_MAP_FAILED;
+                }
+                info->map = (char *)map;
+                info->mapSize = mapSize;
+            }
+
+            // pick up the change tracking of a file that was backed up before
+            RC changeResult = _openChanges(info, fileName, totalNumPages);
+            if (changeResult != RC_OK) {
+                if (info->changeFd != -1) close(info->changeFd);
+                info->changeFd = -1;  // tracked in memory only, the next incremental backup is a full one
+            }
+
+            *numPages = totalNumPages;
+            return RC_OK;
+
+        default:
+            // Default case should not be reached
+            return 0;  // Fallback error
+    }
+}
+
+/**
+ * Opens a page file and initializes a file handle structure.
+ *
+ * Uses the mode set with setDefaultFileMode (SM_MODE_PREAD unless changed).
+ *
+ * @param fileName The name of the file to open.
+ * @param fHandle Pointer to the file handle structure to initialize.
+ * @return Result code indicating success or failure.
+ */
+RC openPageFile(char *fileName, SM_FileHandle *fHandle) {
+    return openPageFileWithMode(fileName, fHandle, defaultFileMode);
+}
+
+/**
+ * Opens a page file with an explicit I/O mode.
+ *
+ * SM_MODE_PREAD moves pages with pread / pwrite. SM_MODE_MMAP maps the file
+ * and serves reads and writes as copies from / to the mapping, which suits
+ * read-mostly files that fit in memory. SM_MODE_DIRECT opens the file with
+ * O_DIRECT so pages are not cached a second time by the kernel; every buffer
+ * passed in must then be aligned to getPageFileAlignment (else RC_IO_MISALIGNED).
+ * A file created in the compressed format is always opened as SM_MODE_COMPRESSED.
+ *
+ * @param fileName The name of the file to open.
+ * @param fHandle Pointer to the file handle structure to initialize.
+ * @param mode How pages are moved between the file and memory.
+ * @return Result code indicating success or failure.
+ */
+RC openPageFileWithMode(char *fileName, SM_FileHandle *fHandle, SM_FileMode mode) {
+    SM_FileInfo *info = _newFileInfo(_backendFor(fileName), mode);
+    if (info == NULL) {
+        return RC_ALLOCATION_FAILED;
+    }
+
+    int totalNumPages = 0;
+    RC result = info->backend->open(fileName, info, mode, &totalNumPages);
+    if (result != RC_OK) {
+        _freeFileInfo(info);
+        return result;
+    }
+
+    // Set metadata in the file handle
+    fHandle->fileName = fileName;
+    fHandle->totalNumPages = totalNumPages;
+    fHandle->curPagePos = 0;
+    fHandle->mgmtInfo = (void *)info;
+
+    // Successfully opened the file and initialized the file handle
+    return RC_OK;
+}
+
+// the alignment buffers for this file should have (required in SM_MODE_DIRECT)
+int getPageFileAlignment(SM_FileHandle *fHandle)
+{
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL) {
+        return PAGE_SIZE;  // Safe for any file
+    }
+    return ((SM_FileInfo *)fHandle->mgmtInfo)->alignment;
+}
+
+// the page size of an open file (PAGE_SIZE for files created without one)
+int getPageSize(SM_FileHandle *fHandle)
+{
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL) {
+        return PAGE_SIZE;
+    }
+    return ((SM_FileInfo *)fHandle->mgmtInfo)->pageSize;
+}
+
+// set the mode openPageFile uses from now on (the buffer and record managers open through it)
+void setDefaultFileMode(SM_FileMode mode)
+{
+    defaultFileMode = mode;
+}
+
+// the file backend's close: the page map or the size of the file is brought up to
+// date and the file closed
+RC _fileClose(SM_FileInfo *info, int totalNumPages) {
+    // the mapping has to go before the file shrinks under it
+    if (info->map != NULL) {
+        munmap(info->map, info->mapSize);
+        info->map = NULL;
+    }
+
+    // the page count for the next open (a file with a header only)
+    RC headerResult = _saveHeaderPages(info, totalNumPages);
+
+    // a compressed file keeps its page map next to it
+    if (info->mode == SM_MODE_COMPRESSED) {
+        RC result = _saveSlots(info, totalNumPages);
+        close(info->mapFd);
+        free(info->slots);
+        info->mapFd = -1;
+        info->slots = NULL;
+        if (result != RC_OK) {
+            close(info->fd);
+            return result;
+        }
+    }
+
+    // the same for the last segment of a segmented file (the others are full)
+    else if (info->layout != NULL) {
+        int segmentPages = info->layout->segmentPages;
+        int last = (totalNumPages > 0) ? (totalNumPages - 1) / segmentPages : 0;
+        SM_Segment *segment = info->segments->entries[last];
+        off_t size = ((last == 0) ? info->headerSize : 0) + (off_t)(totalNumPages - last * segmentPages) * info->pageSize;
+        if (segment->physicalSize > size && ftruncate(segment->fd, size) != 0 && headerResult == RC_OK) {
+            headerResult = RC_WRITE_FAILED;  // the segments are closed all the same
+        }
+        _freeSegments(info);
+    }
+
+    // give back the preallocated tail so the file size matches its pages again (the
+    // file is closed either way, the header keeps a tail left over out of the count)
+    else if (info->physicalSize > _pageOffset(info, totalNumPages)
+             && ftruncate(info->fd, _pageOffset(info, totalNumPages)) != 0) {
+        if (headerResult == RC_OK) headerResult = RC_WRITE_FAILED;
+    }
+
+    RC result = (close(info->fd) == 0) ? RC_OK : RC_FILE_NOT_FOUND;
+    return (headerResult != RC_OK) ? headerResult : result;
+}
+
+RC closePageFile(SM_FileHandle *fHandle) {
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL) {
+        return RC_FILE_NOT_FOUND;  // Validate file handle and management info pointer
+    }
+
+    SM_FileInfo *info = (SM_FileInfo *)fHandle->mgmtInfo;
+
+    // let asynchronous requests finish (their completions are dropped)
+    if (info->aio != NULL) {
+        aioDestroy(info->aio);
+        info->aio = NULL;
+    }
+
+    // keep the pages written since the last backup for the next one
+    RC changeResult = RC_OK;
+    if (info->changeFd != -1) {
+        changeResult = _saveChanges(info, fHandle->totalNumPages, true);
+        close(info->changeFd);
+        info->changeFd = -1;
+    }
+
+    // the backend lets go of the storage even when it reports an error, so the handle
+    // is closed either way
+    RC result = info->backend->close(info, fHandle->totalNumPages);
+    _freeFileInfo(info);
+    fHandle->mgmtInfo = NULL;  // Unset the file info
+    return (result != RC_OK) ? result : changeResult;
+}
+
+RC destroyPageFile(char *fileName) {
+    if (fileName == NULL) {
+        return RC_FILE_NOT_FOUND;  // Return not found if fileName is NULL
+    }
+    return _backendFor(fileName)->destroy(fileName);
+}
+
+// whether a page file of that name exists (on disk, or in memory for SM_MEMORY_PREFIX names)
+bool pageFileExists(char *fileName)
+{
+    return fileName != NULL && _backendFor(fileName)->exists(fileName);
+}
+
+// the file backend's destroy: the file and everything kept next to it
+RC _fileDestroy(char *fileName) {
+    // the other segments of a segmented file go first, their names are in its header
+    _removeSegments(fileName);
+
+    if (remove(fileName) == 0) {
+        // remove the page map of a compressed file and the change file as well
+        char *mapName = _mapFileName(fileName);
+        if (mapName != NULL) {
+            unlink(mapName);
+            free(mapName);
+        }
+        char *changeName = _sidecarName(fileName, SM_CHANGE_SUFFIX);
+        if (changeName != NULL) {
+            unlink(changeName);
+            free(changeName);
+        }
+        return RC_OK;  // File successfully deleted
+    } else {
+        // More precise error checking if needed
+             return RC_FILE_NOT_FOUND;  // No such file
+    }
+}
+
+bool _fileExists(char *fileName)
+{
+    return access(fileName, F_OK) == 0;
+}
+
+/* reading blocks from disc */
+
+// body of readBlock (which times it)
+RC _readBlock(int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage) {
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL) {
+        return RC_FILE_NOT_FOUND;  // Checking for valid file handle and file info
+    }
+
+    if (pageNum < 0 || pageNum >= fHandle->totalNumPages) {
+        return RC_READ_NON_EXISTING_PAGE;  // Page number is out of valid range
+    }
+
+    SM_FileInfo *info = (SM_FileInfo *)fHandle->mgmtInfo;
+    return info->backend->read(info, pageNum, &memPage, 1);
+}
+
+RC readBlock(int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage) {
+    uint64_t started = _now();
+    RC result = _readBlock(pageNum, fHandle, memPage);
+    _recordIO(fHandle, SM_IO_READ, started, 1, result);
+    return result;
+}
+
+int getBlockPos (SM_FileHandle *fHandle)
+{
+    return fHandle->curPagePos;
+}
+
+RC readFirstBlock (SM_FileHandle *fHandle, SM_PageHandle memPage)
+{
+    return readBlock(0, fHandle, memPage);
+}
+
+RC readPreviousBlock(SM_FileHandle *fHandle, SM_PageHandle memPage) {
+    if (fHandle == NULL) {
+        return RC_FILE_NOT_FOUND;  // Handle the case where the file handle is NULL
+    }
+
+    int pageNum = fHandle->curPagePos - 1;
+
+    // Check if the calculated page number is valid
+    if (pageNum < 0) {
+        return RC_READ_NON_EXISTING_PAGE;  // Previous page number is out of valid range
+    }
+
+    // a backward scan gets the pages before it read ahead
+    if (fHandle->mgmtInfo != NULL) {
+        _cursorReadahead((SM_FileInfo *)fHandle->mgmtInfo, pageNum, fHandle->totalNumPages, -1);
+    }
+
+    RC result = readBlock(pageNum, fHandle, memPage);
+    if (result == RC_OK) {
+        fHandle->curPagePos = pageNum;  // Update the current page position on successful read
+    }
+
+    return result;
+}
+
+RC readCurrentBlock(SM_FileHandle *fHandle, SM_PageHandle memPage) {
+    if (fHandle == NULL || memPage == NULL || fHandle->mgmtInfo == NULL) {
+        return RC_FILE_NOT_FOUND;  // Validate pointers to ensure they are not NULL
+    }
+
+    if (fHandle->curPagePos < 0 || fHandle->curPagePos >= fHandle->totalNumPages) {
+        return RC_READ_NON_EXISTING_PAGE;  // Validate current page position
+    }
+
+    return readBlock(fHandle->curPagePos, fHandle, memPage);  // Read the block at the current page position
+}
+
+RC readNextBlock (SM_FileHandle *fHandle, SM_PageHandle memPage)
+{
+    // get the next `pageNum`
+    int pageNum = fHandle->curPagePos + 1;
+
+    // a forward scan gets the pages after it read ahead
+    if (fHandle->mgmtInfo != NULL && pageNum < fHandle->totalNumPages) {
+        _cursorReadahead((SM_FileInfo *)fHandle->mgmtInfo, pageNum, fHandle->totalNumPages, 1);
+    }
+
+    RC result = readBlock(pageNum, fHandle, memPage);
+
+    // Using switch case to handle the result
+    switch (result) {
+        case RC_OK:
+            fHandle->curPagePos = pageNum;  // Update `pageNum` on success
+            // Fallthrough to default case to return the result
+        default:
+            return result;  // Return the result of the read operation
+    }
+}
+
+RC readLastBlock(SM_FileHandle *fHandle, SM_PageHandle memPage) {
+    if (fHandle == NULL || memPage == NULL) {
+        return RC_FILE_NOT_FOUND;  // Validate pointers are not NULL
+    }
+
+    if (fHandle->totalNumPages == 0) {
+        return RC_READ_NON_EXISTING_PAGE;  // Handle empty file scenario
+    }
+
+    int lastPageNum = fHandle->totalNumPages - 1;
+    return readBlock(lastPageNum, fHandle, memPage);  // Read the last block
+}
+
+/* moving several blocks per call */
+
+// shared body of readBlocks / writeBlocks: memPages holds numPages pages back to back
+RC _moveBlocks(int startPage, int numPages, SM_FileHandle *fHandle, SM_PageHandle memPages, bool write)
+{
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL) {
+        return RC_FILE_NOT_FOUND;  // Check for valid file handle and file info
+    }
+
+    if (numPages < 0 || startPage < 0 || startPage > fHandle->totalNumPages - numPages) {
+        return write ? RC_PAGE_OUT_OF_RANGE : RC_READ_NON_EXISTING_PAGE;  // Run is out of valid range
+    }
+
+    SM_PageHandle *buffers = (SM_PageHandle *)malloc(sizeof(SM_PageHandle) * (numPages > 0 ? numPages : 1));
+    if (buffers == NULL) {
+        return RC_ALLOCATION_FAILED;
+    }
+    SM_FileInfo *info = (SM_FileInfo *)fHandle->mgmtInfo;
+    for (int i = 0; i < numPages; i++) {
+        buffers[i] = memPages + (long)i * info->pageSize;
+    }
+
+    uint64_t started = _now();
+    RC result = RC_OK;
+    if (write) {
+        pthread_rwlock_rdlock(&info->backupLock);
+        result = _trackWrite(info, startPage, numPages);
+    }
+    if (result == RC_OK) result = write ? info->backend->write(info, startPage, buffers, numPages)
+                                        : info->backend->read(info, startPage, buffers, numPages);
+    if (write) pthread_rwlock_unlock(&info->backupLock);
+    _recordIO(fHandle, write ? SM_IO_WRITE : SM_IO_READ, started, numPages, result);
+    free(buffers);
+    return result;
+}
+
+// shared body of readBlockList / writeBlockList: the list is moved in page order and
+// every run of adjacent page numbers goes through a single preadv / pwritev
+RC _moveBlockList(SM_PageIO *pages, int numPages, SM_FileHandle *fHandle, bool write)
+{
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL) {
+        return RC_FILE_NOT_FOUND;  // Check for valid file handle and file info
+    }
+
+    for (int i = 0; i < numPages; i++) {
+        if (pages[i].pageNum < 0 || pages[i].pageNum >= fHandle->totalNumPages) {
+            return write ? RC_PAGE_OUT_OF_RANGE : RC_READ_NON_EXISTING_PAGE;
+        }
+    }
+
+    // sort a copy so the caller's list keeps its order
+    SM_PageIO *sorted = (SM_PageIO *)malloc(sizeof(SM_PageIO) * (numPages > 0 ? numPages : 1));
+    SM_PageHandle *buffers = (SM_PageHandle *)malloc(sizeof(SM_PageHandle) * (numPages > 0 ? numPages : 1));
+    if (sorted == NULL || buffers == NULL) {
+        free(sorted);
+        free(buffers);
+        return RC_ALLOCATION_FAILED;
+    }
+    memcpy(sorted, pages, sizeof(SM_PageIO) * numPages);
+    qsort(sorted, numPages, sizeof(SM_PageIO), _comparePageIO);
+
+    SM_FileInfo *info = (SM_FileInfo *)fHandle->mgmtInfo;
+    uint64_t started = _now();
+    RC result = RC_OK;
+    int runStart = 0;
+    if (write) pthread_rwlock_rdlock(&info->backupLock);
+    while (runStart < numPages && result == RC_OK) {
+        int runLength = 1;
+        buffers[0] = sorted[runStart].memPage;
+        while (runStart + runLength < numPages
+               && sorted[runStart + runLength].pageNum == sorted[runStart].pageNum + runLength) {
+            buffers[runLength] = sorted[runStart + runLength].memPage;
+            runLength++;
+        }
+
+        if (write) result = _trackWrite(info, sorted[runStart].pageNum, runLength);
+        if (result == RC_OK) result = write ? info->backend->write(info, sorted[runStart].pageNum, buffers, runLength)
+                                            : info->backend->read(info, sorted[runStart].pageNum, buffers, runLength);
+        runStart += runLength;
+    }
+    if (write) pthread_rwlock_unlock(&info->backupLock);
+    _recordIO(fHandle, write ? SM_IO_WRITE : SM_IO_READ, started, numPages, result);
+
+    free(sorted);
+    free(buffers);
+    return result;
+}
+
+RC readBlocks(int startPage, int numPages, SM_FileHandle *fHandle, SM_PageHandle memPages)
+{
+    return _moveBlocks(startPage, numPages, fHandle, memPages, false);
+}
+
+RC writeBlocks(int startPage, int numPages, SM_FileHandle *fHandle, SM_PageHandle memPages)
+{
+    return _moveBlocks(startPage, numPages, fHandle, memPages, true);
+}
+
+RC readBlockList(SM_PageIO *pages, int numPages, SM_FileHandle *fHandle)
+{
+    return _moveBlockList(pages, numPages, fHandle, false);
+}
+
+RC writeBlockList(SM_PageIO *pages, int numPages, SM_FileHandle *fHandle)
+{
+    return _moveBlockList(pages, numPages, fHandle, true);
+}
+
+/* writing blocks to a page file */
+
+// body of writeBlock (which times it)
+RC _writeBlock(int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage) {
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL) {
+        return RC_FILE_NOT_FOUND;  // Check for valid file handle and file info
+    }
+
+    if (pageNum < 0 || pageNum >= fHandle->totalNumPages) {
+        return RC_PAGE_OUT_OF_RANGE;  // Page number is out of valid range
+    }
+
+    SM_FileInfo *info = (SM_FileInfo *)fHandle->mgmtInfo;
+    return info->backend->write(info, pageNum, &memPage, 1);
+}
+
+RC writeBlock(int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage) {
+    uint64_t started = _now();
+    SM_FileInfo *info = (fHandle != NULL) ? (SM_FileInfo *)fHandle->mgmtInfo : NULL;
+    RC result = RC_OK;
+    if (info != NULL && pageNum >= 0 && pageNum < fHandle->totalNumPages) {
+        pthread_rwlock_rdlock(&info->backupLock);
+        result = _trackWrite(info, pageNum, 1);
+    }
+    if (result == RC_OK) result = _writeBlock(pageNum, fHandle, memPage);
+    if (info != NULL && pageNum >= 0 && pageNum < fHandle->totalNumPages) pthread_rwlock_unlock(&info->backupLock);
+    _recordIO(fHandle, SM_IO_WRITE, started, 1, result);
+    return result;
+}
+
+RC writeCurrentBlock (SM_FileHandle *fHandle, SM_PageHandle memPage)
+{
+    return writeBlock(fHandle->curPagePos, fHandle, memPage);
+}
+
+
+RC appendEmptyBlock(SM_FileHandle *fHandle) {
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL) {
+        return RC_FILE_NOT_FOUND;  // Validate file handle and management info pointer
+    }
+
+    // the new page is zero-filled by the file system, nothing has to be written
+    return ensureCapacity(fHandle->totalNumPages + 1, fHandle);
+}
+
+// the file backend's growth (see ensureCapacity)
+RC _fileExtend(SM_FileInfo *info, int oldPages, int numberOfPages) {
+    RC result = RC_OK;
+    if (info->mode == SM_MODE_COMPRESSED) {
+        // compressed pages only get a slot once written, growing just extends the map
+        result = _growSlots(info, numberOfPages);
+    }
+    else if (info->layout != NULL) {
+        result = _growSegments(info, oldPages, numberOfPages);
+        if (result == RC_OK) {
+            __atomic_add_fetch(&info->writeSeq, 1, __ATOMIC_RELEASE);
+        }
+    }
+    else {
+        off_t neededSize = _pageOffset(info, numberOfPages);
+
+        if (neededSize > info->physicalSize) {
+            // round the new size up to a whole number of extents
+            off_t newSize = _roundToExtent(neededSize, info->extentSize);
+            int status = _extendFile(info->fd, info->physicalSize, newSize);
+            _countSyscalls(info, SM_IO_APPEND, 1);
+
+            if (status == 0) {
+                info->physicalSize = newSize;
+                __atomic_add_fetch(&info->writeSeq, 1, __ATOMIC_RELEASE);
+            } else {
+                result = RC_WRITE_FAILED;
+            }
+        }
+
+        // extend the mapping along with the file
+        if (result == RC_OK && info->mode == SM_MODE_MMAP) {
+            result = _growMap(info, info->physicalSize);
+        }
+    }
+    return result;
+}
+
+/**
+ * Makes sure the file holds at least numberOfPages pages.
+ *
+ * The file is grown in whole extents (see setExtentSize) with fallocate, so a
+ * run of single page growths costs one syscall per extent and no zero-fill
+ * writes. Pages past the old end read back as zeros. The unused tail of the
+ * last extent is trimmed again by closePageFile. A segmented file gets new
+ * segment files as it grows into them.
+ *
+ * @param numberOfPages The number of pages the file should hold.
+ * @param fHandle The file handle to grow.
+ * @return RC_OK on success, RC_WRITE_FAILED if the file could not be grown.
+ */
+RC ensureCapacity(int numberOfPages, SM_FileHandle *fHandle) {
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL) {
+        return RC_FILE_NOT_FOUND;  // Check for valid file handle and file info
+    }
+
+    SM_FileInfo *info = (SM_FileInfo *)fHandle->mgmtInfo;
+    RC result = RC_OK;
+    uint64_t started = _now();
+
+    pthread_mutex_lock(&info->extendLock);
+    int oldPages = fHandle->totalNumPages;
+    if (oldPages < numberOfPages) {
+        result = info->backend->extend(info, oldPages, numberOfPages);
+        if (result == RC_OK) {
+            fHandle->totalNumPages = numberOfPages;  // Pages are handed out without touching the disk
+        }
+    }
+    pthread_mutex_unlock(&info->extendLock);
+
+    // only growth counts as an append
+    if (oldPages < numberOfPages) {
+        _recordIO(fHandle, SM_IO_APPEND, started, numberOfPages - oldPages, result);
+    }
+    return result;  // Successfully ensured the capacity
+}
+
+/**
+ * Sets how many bytes ensureCapacity grows the file by at a time.
+ *
+ * @param extentSize The extent in bytes, rounded up to whole pages; must be
+ *                   between one page and SM_MAX_EXTENT_SIZE.
+ * @param fHandle The file handle to configure.
+ * @return RC_OK on success, RC_PAGE_OUT_OF_RANGE for an invalid extent.
+ */
+RC setExtentSize(long extentSize, SM_FileHandle *fHandle) {
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL) {
+        return RC_FILE_NOT_FOUND;  // Check for valid file handle and file info
+    }
+
+    if (extentSize <= 0 || extentSize > SM_MAX_EXTENT_SIZE) {
+        return RC_PAGE_OUT_OF_RANGE;
+    }
+
+    SM_FileInfo *info = (SM_FileInfo *)fHandle->mgmtInfo;
+    pthread_mutex_lock(&info->extendLock);
+    info->extentSize = ((extentSize + info->pageSize - 1) / info->pageSize) * info->pageSize;
+    pthread_mutex_unlock(&info->extendLock);
+    return RC_OK;
+}
+
+/* durability */
+
+// the file backend's sync: msync of the mapping in SM_MODE_MMAP, fdatasync otherwise
+RC _fileSync(SM_FileInfo *info, int totalNumPages) {
+    // the page count goes to disk with the pages it covers
+    if (_saveHeaderPages(info, totalNumPages) != RC_OK) return RC_SYNC_FAILED;
+
+    int status;
+    switch (info->mode) {
+        case SM_MODE_MMAP:
+            pthread_rwlock_rdlock(&info->mapLock);
+            status = msync(info->map, info->physicalSize, MS_SYNC);
+            pthread_rwlock_unlock(&info->mapLock);
+            _countSyscalls(info, SM_IO_SYNC, 1);
+            break;
+
+        case SM_MODE_COMPRESSED:
+            // the data first, then the map that points into it
+            status = fdatasync(info->fd);
+            if (status == 0) status = (_saveSlots(info, totalNumPages) == RC_OK) ? fdatasync(info->mapFd) : -1;
+            _countSyscalls(info, SM_IO_SYNC, 2);
+            break;
+
+        default:
+            if (info->layout != NULL) {
+                status = _syncSegments(info);  // counts its own calls
+            } else {
+                status = fdatasync(info->fd);
+                _countSyscalls(info, SM_IO_SYNC, 1);
+            }
+            break;
+    }
+    return (status == 0) ? RC_OK : RC_SYNC_FAILED;
+}
+
+/**
+ * Makes every write issued on the handle before this call durable.
+ *
+ * Writes are only handed to the kernel by writeBlock / appendEmptyBlock, this is
+ * the barrier (msync of the mapping in SM_MODE_MMAP, fdatasync otherwise). Concurrent callers are grouped: one caller (the leader) issues a
+ * single fdatasync covering everything written so far while the others wait on it,
+ * and a caller whose writes are already covered by a finished sync returns at once.
+ *
+ * @param fHandle The file handle to sync.
+ * @return RC_OK once the writes are durable, RC_SYNC_FAILED if the sync failed.
+ */
+RC syncPageFile(SM_FileHandle *fHandle) {
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL) {
+        return RC_FILE_NOT_FOUND;  // Check for valid file handle and file info
+    }
+
+    SM_FileInfo *info = (SM_FileInfo *)fHandle->mgmtInfo;
+    unsigned long target = __atomic_load_n(&info->writeSeq, __ATOMIC_ACQUIRE);
+    RC result = RC_OK;
+    uint64_t started = _now();
+
+    pthread_mutex_lock(&info->syncLock);
+    while (info->syncedSeq < target) {
+        if (info->syncing) {
+            // another caller is syncing, its sync may already cover our writes
+            pthread_cond_wait(&info->syncDone, &info->syncLock);
+            continue;
+        }
+
+        // become the leader and sync everything written up to now
+        unsigned long covered = __atomic_load_n(&info->writeSeq, __ATOMIC_ACQUIRE);
+        info->syncing = true;
+        pthread_mutex_unlock(&info->syncLock);
+
+        RC status = info->backend->sync(info, fHandle->totalNumPages);
+
+        pthread_mutex_lock(&info->syncLock);
+        info->syncing = false;
+        if (status == RC_OK && covered > info->syncedSeq) {
+            info->syncedSeq = covered;
+        }
+        pthread_cond_broadcast(&info->syncDone);
+        if (status != RC_OK) {
+            result = status;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&info->syncLock);
+
+    // every call counts, so the syscall count shows how well syncs were grouped
+    _recordIO(fHandle, SM_IO_SYNC, started, 0, result);
+    return result;
+}
+
+/* asynchronous reads and writes */
+
+// helper to queue one asynchronous page transfer, creating the engine on first use
+RC _submitPage(int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage, void *userData, bool write)
+{
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL) {
+        return RC_FILE_NOT_FOUND;  // Check for valid file handle and file info
+    }
+
+    if (pageNum < 0 || pageNum >= fHandle->totalNumPages) {
+        return write ? RC_PAGE_OUT_OF_RANGE : RC_READ_NON_EXISTING_PAGE;  // Page number is out of valid range
+    }
+
+    SM_FileInfo *info = (SM_FileInfo *)fHandle->mgmtInfo;
+    if (!_isAligned(info, memPage)) {
+        return RC_IO_MISALIGNED;  // O_DIRECT transfers need an aligned buffer
+    }
+
+    if (info->mode == SM_MODE_COMPRESSED || info->backend != &fileBackend) {
+        return RC_IM_CONFIG_ERROR;  // Compressed pages have no fixed place in the file to transfer to, memory pages no I/O to overlap
+    }
+
+    pthread_mutex_lock(&info->extendLock);
+    if (info->aio == NULL) {
+        info->aio = aioCreate(SM_ASYNC_DEPTH);
+    }
+    pthread_mutex_unlock(&info->extendLock);
+    if (info->aio == NULL) {
+        return RC_ALLOCATION_FAILED;
+    }
+
+    // the request (with its completion) doubles as the tag
+    SM_Request *request = (SM_Request *)malloc(sizeof(SM_Request));
+    if (request == NULL) {
+        return RC_ALLOCATION_FAILED;
+    }
+    request->started = _now();
+    SM_Completion *completion = &(request->completion);
+    completion->pageNum = pageNum;
+    completion->memPage = memPage;
+    completion->write = write;
+    completion->result = RC_OK;
+    completion->userData = userData;
+
+    // the fd shares the page cache with the mapping, so this also works in SM_MODE_MMAP;
+    // a write is tracked for backups when it is submitted (a backup starting later
+    // waits for it to finish)
+    off_t offset;
+    int fd = _locate(info, pageNum, &offset);
+    RC result = RC_OK;
+    if (write) {
+        pthread_rwlock_rdlock(&info->backupLock);
+        result = _trackWrite(info, pageNum, 1);
+    }
+    if (result == RC_OK && aioSubmit(info->aio, fd, memPage, info->pageSize, offset, write, request) != 0) {
+        result = write ? RC_WRITE_FAILED : RC_READ_FAILED;
+    }
+    if (write) pthread_rwlock_unlock(&info->backupLock);
+    if (result != RC_OK) {
+        free(request);
+        return result;
+    }
+    _countSyscalls(info, write ? SM_IO_WRITE : SM_IO_READ, 1);
+    return RC_OK;
+}
+
+/**
+ * Queues an asynchronous read of a page into memPage.
+ *
+ * The buffer must stay untouched until the request shows up in pollCompletions.
+ * Requests run on io_uring when the kernel allows it, otherwise on a small pool
+ * of I/O threads.
+ *
+ * @param pageNum The page to read.
+ * @param fHandle The file handle to read from.
+ * @param memPage The buffer the page is read into.
+ * @param userData Handed back unchanged with the completion.
+ * @return RC_OK if the request was queued.
+ */
+RC submitRead(int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage, void *userData)
+{
+    return _submitPage(pageNum, fHandle, memPage, userData, false);
+}
+
+/**
+ * Queues an asynchronous write of memPage to a page (see submitRead).
+ *
+ * Like writeBlock, the write is only durable after a later syncPageFile.
+ */
+RC submitWrite(int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage, void *userData)
+{
+    return _submitPage(pageNum, fHandle, memPage, userData, true);
+}
+
+/**
+ * Collects finished asynchronous requests.
+ *
+ * @param fHandle The file handle the requests were submitted on.
+ * @param completions Receives up to maxCompletions finished requests, oldest first.
+ * @param maxCompletions The size of the completions array.
+ * @param minCompletions Wait until at least this many are available (or none are in flight).
+ * @return The number of completions written.
+ */
+int pollCompletions(SM_FileHandle *fHandle, SM_Completion *completions, int maxCompletions, int minCompletions)
+{
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL || maxCompletions <= 0) {
+        return 0;
+    }
+
+    SM_FileInfo *info = (SM_FileInfo *)fHandle->mgmtInfo;
+    if (info->aio == NULL) {
+        return 0;  // Nothing was ever submitted
+    }
+
+    AIO_Completion *finished = (AIO_Completion *)malloc(sizeof(AIO_Completion) * maxCompletions);
+    if (finished == NULL) {
+        return 0;
+    }
+
+    int count = aioPoll(info->aio, finished, maxCompletions, minCompletions);
+    for (int i = 0; i < count; i++) {
+        SM_Request *request = (SM_Request *)finished[i].tag;
+        SM_Completion *completion = &(request->completion);
+
+        if (finished[i].result < 0) {
+            completion->result = completion->write ? RC_WRITE_FAILED : RC_READ_FAILED;
+        } else if (finished[i].result < info->pageSize) {
+            // the kernel may stop short, move the rest of the page synchronously
+            long done = finished[i].result;
+            off_t offset;
+            int fd = _locate(info, completion->pageNum, &offset);
+            ssize_t rest = completion->write
+                ? _pwriteFull(fd, completion->memPage + done, info->pageSize - done, offset + done)
+                : _preadFull(fd, completion->memPage + done, info->pageSize - done, offset + done);
+            _countSyscalls(info, completion->write ? SM_IO_WRITE : SM_IO_READ, 1);
+            if (rest != info->pageSize - done) {
+                completion->result = completion->write ? RC_WRITE_FAILED : RC_READ_NON_EXISTING_PAGE;
+            }
+        }
+
+        // a finished write now counts for the next syncPageFile
+        if (completion->write && completion->result == RC_OK) {
+            _markSegmentDirty(info, completion->pageNum);
+            __atomic_add_fetch(&info->writeSeq, 1, __ATOMIC_RELEASE);
+        }
+
+        // timed from submission, so the histogram includes time spent queued
+        _recordIO(fHandle, completion->write ? SM_IO_WRITE : SM_IO_READ, request->started, 1, completion->result);
+
+        completions[i] = *completion;
+        free(request);
+    }
+
+    free(finished);
+    return count;
+}
+
+/* online backups */
+
+// shared body of backupPageFile / backupPageFileIncremental
+RC _backup(SM_FileHandle *fHandle, char *backupName, bool incremental, int *pagesCopied)
+{
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL || backupName == NULL) {
+        return RC_FILE_NOT_FOUND;
+    }
+    SM_FileInfo *info = (SM_FileInfo *)fHandle->mgmtInfo;
+
+    // an incremental backup brings the backup file made last up to date
+    int backupFd = -1;
+    bool full = !incremental;
+    if (incremental) {
+        backupFd = open(backupName, O_RDWR);
+        SM_FileHeader *header = (SM_FileHeader *)malloc(sizeof(SM_FileHeader));
+        bool matches = (backupFd != -1 && header != NULL
+                        && _preadFull(backupFd, header, sizeof(SM_FileHeader), 0) == sizeof(SM_FileHeader)
+                        && memcmp(header->magic, SM_FILE_MAGIC, sizeof(header->magic)) == 0
+                        && header->pageSize == info->pageSize && header->segmentPages == 0);
+        free(header);
+        if (!matches) {
+            if (backupFd != -1) close(backupFd);
+            return RC_IM_CONFIG_ERROR;  // not a backup of this file
+        }
+    } else {
+        SM_FileHeader header;
+        _initHeader(&header, info->pageSize);
+        char *block = (char *)calloc(1, SM_HEADER_SIZE);
+        backupFd = open(backupName, O_RDWR | O_CREAT | O_TRUNC, 0644);
+        bool written = (block != NULL && backupFd != -1);
+        if (written) {
+            memcpy(block, &header, sizeof(header));
+            written = (_pwriteFull(backupFd, block, SM_HEADER_SIZE, 0) == SM_HEADER_SIZE);
+        }
+        free(block);
+        if (!written) {
+            if (backupFd != -1) close(backupFd);
+            return RC_WRITE_FAILED;
+        }
+    }
+
+    // wait for the writes under way (asynchronous ones included) and take the pages
+    // to copy: the ones written since the last backup plus the ones added since,
+    // or every page if that is not known
+    pthread_rwlock_wrlock(&info->backupLock);
+    if (info->aio != NULL) aioDrain(info->aio);
+
+    int numPages = fHandle->totalNumPages;
+    unsigned char *copy = (unsigned char *)calloc((numPages + 7) / 8 + 1, 1);
+    pthread_mutex_lock(&info->changeLock);
+    RC result = (copy == NULL) ? RC_ALLOCATION_FAILED : _growBitmap(&info->changed, &info->changedCapacity, numPages);
+    if (result == RC_OK) {
+        if (!info->trackingValid) full = true;
+        for (int page = 0; page < numPages; page++) {
+            if (full || page >= info->backupPages || (info->changed[page / 8] & (1 << (page % 8)))) {
+                copy[page / 8] |= (unsigned char)(1 << (page % 8));
+            }
+        }
+        // writes from now on belong to the next backup
+        memset(info->changed, 0, info->changedCapacity / 8);
+    }
+    unsigned char *taken = NULL;
+    if (result == RC_OK) {
+        taken = (unsigned char *)malloc((numPages + 7) / 8 + 1);
+        if (taken == NULL) result = RC_ALLOCATION_FAILED;
+        else memcpy(taken, copy, (numPages + 7) / 8 + 1);
+    }
+    pthread_mutex_unlock(&info->changeLock);
+    if (result != RC_OK) {
+        pthread_rwlock_unlock(&info->backupLock);
+        free(copy);
+        close(backupFd);
+        return result;
+    }
+
+    // _runBackup releases backupLock once the snapshot is set up
+    result = _runBackup(fHandle, backupFd, copy, numPages, pagesCopied);
+    if (result == RC_OK) {
+        // the backup holds `numPages` pages now, whatever count it had saved before
+        if (_pwriteFull(backupFd, &numPages, sizeof(numPages), offsetof(SM_FileHeader, numPages)) != sizeof(numPages)) {
+            result = RC_WRITE_FAILED;
+        }
+    }
+    close(backupFd);
+    free(copy);
+
+    pthread_mutex_lock(&info->changeLock);
+    if (result == RC_OK) {
+        info->trackingValid = true;
+        info->backupPages = numPages;
+
+        // from now on the changes of a file on disk are kept across closes
+        if (info->changeFd == -1 && info->backend == &fileBackend) {
+            char *name = _sidecarName(fHandle->fileName, SM_CHANGE_SUFFIX);
+            info->changeFd = (name != NULL) ? open(name, O_RDWR | O_CREAT, 0644) : -1;
+            free(name);
+        }
+        if (info->backend == &fileBackend
+            && (info->changeFd == -1 || _saveChanges(info, fHandle->totalNumPages, false) != RC_OK)) {
+            result = RC_WRITE_FAILED;
+        }
+    } else {
+        // the pages that were not backed up still have to go into the next backup
+        for (int i = 0; i < (numPages + 7) / 8; i++) __atomic_fetch_or(&info->changed[i], taken[i], __ATOMIC_RELAXED);
+    }
+    pthread_mutex_unlock(&info->changeLock);
+    free(taken);
+    return result;
+}
+
+/**
+ * Writes a backup of an open file while it stays in use.
+ *
+ * The backup is a plain page file (no segments, uncompressed) holding the pages as
+ * they were when the call started: writes made meanwhile go ahead, but first copy
+ * the pages they overwrite to the backup if it has not got them yet. Pages are
+ * copied with copy_file_range where the file system allows it.
+ *
+ * From the first backup on, the pages written since the last backup are kept in
+ * <fileName>.chg so that backupPageFileIncremental can copy only those.
+ *
+ * @param fHandle The file handle of the file to back up.
+ * @param backupName The backup file to write (replaced if it exists).
+ * @return RC_OK on success, RC_WRITE_FAILED if the backup could not be written.
+ */
+RC backupPageFile(SM_FileHandle *fHandle, char *backupName) {
+    return _backup(fHandle, backupName, false, NULL);
+}
+
+/**
+ * Brings the backup written last up to date with an open file.
+ *
+ * Copies the pages written since the last backup (full or incremental) and the pages
+ * added since, the same way backupPageFile does; the backup is shrunk if the file
+ * shrank. If the changes are not known - no backup was taken since the file was
+ * created, or it was not closed cleanly since (for a file in memory: since it was
+ * opened) - every page is copied. The backup is only consistent again once the call
+ * returns.
+ *
+ * @param fHandle The file handle of the file to back up.
+ * @param backupName The backup file written by the last backup of this file.
+ * @param pagesCopied Receives the number of pages copied (may be NULL).
+ * @return RC_OK on success, RC_IM_CONFIG_ERROR if backupName is not a backup with the file's page size.
+ */
+RC backupPageFileIncremental(SM_FileHandle *fHandle, char *backupName, int *pagesCopied) {
+    return _backup(fHandle, backupName, true, pagesCopied);
+}
+
+/* instrumentation */
+
+/**
+ * Takes a snapshot of the I/O counters and latency histograms of an open file.
+ *
+ * Every read, write, append (file growth) and sync on the handle is counted with
+ * the pages and bytes it moved, the system calls it issued and its latency. An
+ * operation issuing many calls per page points at the access pattern, a shifted
+ * latency histogram at the device. Asynchronous requests are timed from submission
+ * to the pollCompletions that collects them.
+ *
+ * @param fHandle The file handle to read the counters of.
+ * @param stats Receives the snapshot.
+ * @return RC_OK on success.
+ */
+RC getIOStats(SM_FileHandle *fHandle, SM_IOStats *stats) {
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL || stats == NULL) {
+        return RC_FILE_NOT_FOUND;  // Check for valid file handle and file info
+    }
+
+    // the counters are read one by one, each is exact but they may be a few operations apart
+    uint64_t *from = (uint64_t *)&(((SM_FileInfo *)fHandle->mgmtInfo)->stats);
+    uint64_t *to = (uint64_t *)stats;
+    for (size_t i = 0; i < sizeof(SM_IOStats) / sizeof(uint64_t); i++) {
+        to[i] = __atomic_load_n(&from[i], __ATOMIC_RELAXED);
+    }
+    return RC_OK;
+}
+
+// start counting from zero again (for example at the start of a benchmark run)
+RC resetIOStats(SM_FileHandle *fHandle) {
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL) {
+        return RC_FILE_NOT_FOUND;  // Check for valid file handle and file info
+    }
+
+    uint64_t *counters = (uint64_t *)&(((SM_FileInfo *)fHandle->mgmtInfo)->stats);
+    for (size_t i = 0; i < sizeof(SM_IOStats) / sizeof(uint64_t); i++) {
+        __atomic_store_n(&counters[i], 0, __ATOMIC_RELAXED);
+    }
+    return RC_OK;
+}
+
+// the latency (upper bound of its bucket, in nanoseconds) that `percentile` percent
+// of the operations of a type stayed under, 0 if there were none
+uint64_t getIOLatencyPercentile(SM_IOStats *stats, SM_IOType type, double percentile) {
+    uint64_t total = 0;
+    for (int i = 0; i < SM_LATENCY_BUCKETS; i++) {
+        total += stats->latency[type][i];
+    }
+    if (total == 0) return 0;
+
+    uint64_t rank = (uint64_t)(total * percentile / 100.0);
+    if (rank == 0) rank = 1;
+    if (rank > total) rank = total;
+
+    uint64_t seen = 0;
+    for (int i = 0; i < SM_LATENCY_BUCKETS; i++) {
+        seen += stats->latency[type][i];
+        if (seen >= rank) return 2ULL << i;
+    }
+    return 2ULL << (SM_LATENCY_BUCKETS - 1);
+}
+
+/* storage backends */
+
+// helper to find a memory file by name (the caller holds memoryFilesLock)
+SM_MemFile *_findMemFile(char *fileName)
+{
+    for (SM_MemFile *file = memoryFiles; file != NULL; file = file->next) {
+        if (strcmp(file->name, fileName) == 0) return file;
+    }
+    return NULL;
+}
+
+// helper to free a memory file once it is unlinked and no handle is open on it
+// (the caller holds memoryFilesLock)
+void _releaseMemFile(SM_MemFile *file)
+{
+    if (!file->unlinked || file->openCount > 0) return;
+
+    for (int i = 0; i < file->numPages; i++) {
+        free(file->pages[i]);
+    }
+    free(file->pages);
+    pthread_rwlock_destroy(&file->lock);
+    free(file->name);
+    free(file);
+}
+
+// helper to take a memory file out of memoryFiles (the caller holds memoryFilesLock)
+void _unlinkMemFile(SM_MemFile *file)
+{
+    for (SM_MemFile **link = &memoryFiles; *link != NULL; link = &(*link)->next) {
+        if (*link == file) {
+            *link = file->next;
+            break;
+        }
+    }
+    file->unlinked = true;
+    _releaseMemFile(file);
+}
+
+// helper to add zeroed pages to a memory file up to numPages
+// (the caller holds the file's lock exclusively)
+RC _growMemFile(SM_MemFile *file, int numPages)
+{
+    if (numPages > file->capacity) {
+        int capacity = (file->capacity > 0) ? file->capacity : 16;
+        while (capacity < numPages) capacity *= 2;
+        char **pages = (char **)realloc(file->pages, sizeof(char *) * capacity);
+        if (pages == NULL) return RC_ALLOCATION_FAILED;
+        file->pages = pages;
+        file->capacity = capacity;
+    }
+    while (file->numPages < numPages) {
+        file->pages[file->numPages] = (char *)calloc(1, file->pageSize);
+        if (file->pages[file->numPages] == NULL) return RC_ALLOCATION_FAILED;
+        file->numPages++;
+    }
+    return RC_OK;
+}
+
+// the memory backend's create: a file of one empty page, replacing any memory file of
+// that name (handles still open on that one keep it until they are closed); the mode
+// and the segment layout only matter on disk
+RC _memCreate(char *fileName, SM_FileMode mode, SM_FileHeader *header)
+{
+    (void)mode;
+    SM_MemFile *file = (SM_MemFile *)calloc(1, sizeof(SM_MemFile));
+    if (file == NULL || (file->name = strdup(fileName)) == NULL) {
+        free(file);
+        return RC_ALLOCATION_FAILED;
+    }
+    file->pageSize = header->pageSize;
+    pthread_rwlock_init(&file->lock, NULL);
+    if (_growMemFile(file, 1) != RC_OK) {
+        file->unlinked = true;
+        _releaseMemFile(file);
+        return RC_ALLOCATION_FAILED;
+    }
+
+    pthread_mutex_lock(&memoryFilesLock);
+    SM_MemFile *old = _findMemFile(fileName);
+    if (old != NULL) _unlinkMemFile(old);
+    file->next = memoryFiles;
+    memoryFiles = file;
+    pthread_mutex_unlock(&memoryFilesLock);
+    return RC_OK;
+}
+
+RC _memOpen(char *fileName, SM_FileInfo *info, SM_FileMode mode, int *totalNumPages)
+{
+    (void)mode;
+    pthread_mutex_lock(&memoryFilesLock);
+    SM_MemFile *file = _findMemFile(fileName);
+    if (file != NULL) file->openCount++;
+    pthread_mutex_unlock(&memoryFilesLock);
+    if (file == NULL) return RC_FILE_NOT_FOUND;
+
+    // no file system, so no alignment and no mode to speak of
+    info->memFile = file;
+    info->mode = SM_MODE_PREAD;
+    info->pageSize = file->pageSize;
+    info->alignment = sizeof(void *);
+    pthread_rwlock_rdlock(&file->lock);
+    *totalNumPages = file->numPages;
+    pthread_rwlock_unlock(&file->lock);
+    return RC_OK;
+}
+
+// the memory backend's reads and writes: copies from / to the pages
+RC _memMove(SM_FileInfo *info, int startPage, SM_PageHandle *buffers, int numPages, bool write)
+{
+    SM_MemFile *file = info->memFile;
+    RC result = RC_OK;
+    pthread_rwlock_rdlock(&file->lock);
+    if (startPage + numPages > file->numPages) {
+        result = write ? RC_WRITE_FAILED : RC_READ_NON_EXISTING_PAGE;
+    } else {
+        for (int i = 0; i < numPages; i++) {
+            if (write) memcpy(file->pages[startPage + i], buffers[i], file->pageSize);
+            else memcpy(buffers[i], file->pages[startPage + i], file->pageSize);
+        }
+    }
+    pthread_rwlock_unlock(&file->lock);
+    return result;
+}
+
+RC _memRead(SM_FileInfo *info, int startPage, SM_PageHandle *buffers, int numPages)
+{
+    return _memMove(info, startPage, buffers, numPages, false);
+}
+
+RC _memWrite(SM_FileInfo *info, int startPage, SM_PageHandle *buffers, int numPages)
+{
+    return _memMove(info, startPage, buffers, numPages, true);
+}
+
+RC _memExtend(SM_FileInfo *info, int oldPages, int numberOfPages)
+{
+    (void)oldPages;
+    pthread_rwlock_wrlock(&info->memFile->lock);
+    RC result = _growMemFile(info->memFile, numberOfPages);
+    pthread_rwlock_unlock(&info->memFile->lock);
+    return result;
+}
+
+// nothing to make durable
+RC _memSync(SM_FileInfo *info, int totalNumPages)
+{
+    (void)info;
+    (void)totalNumPages;
+    return RC_OK;
+}
+
+RC _memClose(SM_FileInfo *info, int totalNumPages)
+{
+    (void)totalNumPages;
+    pthread_mutex_lock(&memoryFilesLock);
+    info->memFile->openCount--;
+    _releaseMemFile(info->memFile);
+    pthread_mutex_unlock(&memoryFilesLock);
+    info->memFile = NULL;
+    return RC_OK;
+}
+
+RC _memDestroy(char *fileName)
+{
+    pthread_mutex_lock(&memoryFilesLock);
+    SM_MemFile *file = _findMemFile(fileName);
+    if (file != NULL) _unlinkMemFile(file);
+    pthread_mutex_unlock(&memoryFilesLock);
+    return (file != NULL) ? RC_OK : RC_FILE_NOT_FOUND;
+}
+
+bool _memExists(char *fileName)
+{
+    pthread_mutex_lock(&memoryFilesLock);
+    bool exists = (_findMemFile(fileName) != NULL);
+    pthread_mutex_unlock(&memoryFilesLock);
+    return exists;
+}
+
+const SM_Backend fileBackend = {
+    _fileCreate, _fileOpen, _fileRead, _fileWrite, _fileExtend, _fileSync, _fileClose, _fileDestroy, _fileExists
+};
+
+const SM_Backend memoryBackend = {
+    _memCreate, _memOpen, _memRead, _memWrite, _memExtend, _memSync, _memClose, _memDestroy, _memExists
+};
+
+// helper to pick the backend of a file: names starting with SM_MEMORY_PREFIX are
+// kept in memory, everything else is a file on disk
+const SM_Backend *_backendFor(char *fileName)
+{
+    if (fileName != NULL && strncmp(fileName, SM_MEMORY_PREFIX, strlen(SM_MEMORY_PREFIX)) == 0) {
+        return &memoryBackend;
+    }
+    return &fileBackend;
+}
@@ -2,12 +2,41 @@
 #define STORAGE_MGR_H
 
 #include "dberror.h"
+#include "dt.h"
+
+#include <stdint.h>
+
+/* page sizes a file can be created with (see createPageFileWithSize) */
+#define SM_MIN_PAGE_SIZE PAGE_SIZE
+#define SM_MAX_PAGE_SIZE (64 * 1024)
+
+/* segmented files (see createSegmentedPageFile): directories their segments can be
+   spread over and the longest directory name */
+#define SM_MAX_STRIPE_DIRS 8
+#define SM_MAX_PATH_LENGTH 256
+
+/* files are grown in extents of this many bytes (see setExtentSize) */
+#define SM_DEFAULT_EXTENT_SIZE (1024 * 1024)
+#define SM_MAX_EXTENT_SIZE (64 * 1024 * 1024)
+
+/* readahead window of readNextBlock / readPreviousBlock, in pages */
+#define SM_MIN_READAHEAD 4
+#define SM_MAX_READAHEAD 256
+
+/* page files whose name starts with this are kept in memory instead of on disk
+   (e.g. "mem:scratch"); they live until destroyPageFile or the end of the process */
+#define SM_MEMORY_PREFIX "mem:"
+
+/* asynchronous requests that can be in flight per file */
+#define SM_ASYNC_DEPTH 64
 
 /************************************************************
  *                    handle data structures                *
  ************************************************************/
 typedef struct SM_FileHandle {
 	char *fileName;
+	// page numbers are ints (up to 2^31 - 1 pages, 8 TB of 4 KB pages); only the
+	// byte offsets computed from them are 64-bit
 	int totalNumPages;
 	int curPagePos;
 	void *mgmtInfo;
@@ -15,15 +44,69 @@ typedef struct SM_FileHandle {
 
 typedef char* SM_PageHandle;
 
+// how an open page file moves pages between disk and memory
+typedef enum SM_FileMode {
+	SM_MODE_PREAD = 0,	// pread / pwrite on the file descriptor
+	SM_MODE_MMAP = 1,	// memcpy from / to a shared mapping of the file
+	SM_MODE_DIRECT = 2,	// pread / pwrite with O_DIRECT (buffers must be aligned)
+	SM_MODE_COMPRESSED = 3	// pages compressed into variable-size slots (see createPageFileWithMode)
+} SM_FileMode;
+
+// one entry of a scatter-gather page list (see readBlockList / writeBlockList)
+typedef struct SM_PageIO {
+	int pageNum;
+	SM_PageHandle memPage;
+} SM_PageIO;
+
+// a finished asynchronous request (see submitRead / submitWrite / pollCompletions)
+typedef struct SM_Completion {
+	int pageNum;
+	SM_PageHandle memPage;
+	bool write;
+	RC result;
+	void *userData;
+} SM_Completion;
+
+// the kinds of operation counted per open file (see getIOStats)
+typedef enum SM_IOType {
+	SM_IO_READ = 0,		// readBlock and the other reads, asynchronous reads
+	SM_IO_WRITE = 1,	// writeBlock and the other writes, asynchronous writes
+	SM_IO_APPEND = 2,	// file growth (appendEmptyBlock / ensureCapacity)
+	SM_IO_SYNC = 3		// syncPageFile
+} SM_IOType;
+
+#define SM_IO_NUM_TYPES 4
+/* latency histogram buckets: bucket i counts operations that took [2^i, 2^(i+1)) ns */
+#define SM_LATENCY_BUCKETS 40
+
+// a snapshot of a file's I/O counters, each indexed by SM_IOType
+typedef struct SM_IOStats {
+	uint64_t operations[SM_IO_NUM_TYPES];	// calls (a sync call counts even if another call's sync covered it)
+	uint64_t pages[SM_IO_NUM_TYPES];	// pages read, written or appended
+	uint64_t bytes[SM_IO_NUM_TYPES];
+	uint64_t syscalls[SM_IO_NUM_TYPES];	// system calls (or asynchronous requests) issued
+	uint64_t errors[SM_IO_NUM_TYPES];	// calls that failed
+	uint64_t totalNanos[SM_IO_NUM_TYPES];
+	uint64_t latency[SM_IO_NUM_TYPES][SM_LATENCY_BUCKETS];
+} SM_IOStats;
+
 /************************************************************
  *                    interface                             *
  ************************************************************/
 /* manipulating page files */
 extern void initStorageManager (void);
 extern RC createPageFile (char *fileName);
+extern RC createPageFileWithMode (char *fileName, SM_FileMode mode);
+extern RC createPageFileWithSize (char *fileName, int pageSize);
+extern RC createSegmentedPageFile (char *fileName, int pageSize, int segmentPages, char **stripeDirs, int numStripeDirs);
 extern RC openPageFile (char *fileName, SM_FileHandle *fHandle);
+extern RC openPageFileWithMode (char *fileName, SM_FileHandle *fHandle, SM_FileMode mode);
+extern void setDefaultFileMode (SM_FileMode mode);
+extern int getPageFileAlignment (SM_FileHandle *fHandle);
+extern int getPageSize (SM_FileHandle *fHandle);
 extern RC closePageFile (SM_FileHandle *fHandle);
 extern RC destroyPageFile (char *fileName);
+extern bool pageFileExists (char *fileName);
 
 /* reading blocks from disc */
 extern RC readBlock (int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage);
@@ -34,10 +117,35 @@ extern RC readCurrentBlock (SM_FileHandle *fHandle, SM_PageHandle memPage);
 extern RC readNextBlock (SM_FileHandle *fHandle, SM_PageHandle memPage);
 extern RC readLastBlock (SM_FileHandle *fHandle, SM_PageHandle memPage);
 
+/* moving several blocks per call (adjacent pages are moved with one syscall) */
+extern RC readBlocks (int startPage, int numPages, SM_FileHandle *fHandle, SM_PageHandle memPages);
+extern RC writeBlocks (int startPage, int numPages, SM_FileHandle *fHandle, SM_PageHandle memPages);
+extern RC readBlockList (SM_PageIO *pages, int numPages, SM_FileHandle *fHandle);
+extern RC writeBlockList (SM_PageIO *pages, int numPages, SM_FileHandle *fHandle);
+
 /* writing blocks to a page file */
 extern RC writeBlock (int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage);
 extern RC writeCurrentBlock (SM_FileHandle *fHandle, SM_PageHandle memPage);
 extern RC appendEmptyBlock (SM_FileHandle *fHandle);
 extern RC ensureCapacity (int numberOfPages, SM_FileHandle *fHandle);
+extern RC setExtentSize (long extentSize, SM_FileHandle *fHandle);
+
+/* asynchronous reads and writes (completed requests are collected with pollCompletions) */
+extern RC submitRead (int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage, void *userData);
+extern RC submitWrite (int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage, void *userData);
+extern int pollCompletions (SM_FileHandle *fHandle, SM_Completion *completions, int maxCompletions, int minCompletions);
+
+/* making writes durable (writes are not synced until this is called) */
+extern RC syncPageFile (SM_FileHandle *fHandle);
+
+/* online backups: a consistent copy of the file taken while it is written
+   (an incremental backup only copies the pages written since the last backup) */
+extern RC backupPageFile (SM_FileHandle *fHandle, char *backupName);
+extern RC backupPageFileIncremental (SM_FileHandle *fHandle, char *backupName, int *pagesCopied);
+
+/* instrumentation */
+extern RC getIOStats (SM_FileHandle *fHandle, SM_IOStats *stats);
+extern RC resetIOStats (SM_FileHandle *fHandle);
+extern uint64_t getIOLatencyPercentile (SM_IOStats *stats, SM_IOType type, double percentile);
 
 #endif
@@ -0,0 +1,1407 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+#include "buffer_mgr.h"
+#include "buffer_mgr_stat.h"
+#include "storage_mgr.h"
+#include "dberror.h"
+#include "test_helper.h"
+
+// var to store the current test's name
+char *testName;
+
+// check whether two the content of a buffer pool is the same as an expected content
+// (given in the format produced by sprintPoolContent)
+#define ASSERT_EQUALS_POOL(expected,bm,message)			        \
+		do {									\
+			char *real;								\
+			char *_exp = (char *) (expected);                                   \
+			real = sprintPoolContent(bm);					\
+			if (strcmp((_exp),(real)) != 0)					\
+			{									\
+				printf("[%s-%s-L%i-%s] FAILED: expected <%s> but was <%s>: %s\n",TEST_INFO, _exp, real, message); \
+				free(real);							\
+				exit(1);							\
+			}									\
+			printf("[%s-%s-L%i-%s] OK: expected <%s> and was <%s>: %s\n",TEST_INFO, _exp, real, message); \
+			free(real);								\
+		} while(0)
+
+/* test output files */
+#define TESTPF "test_buffer_pool.bin"
+#define TESTMEM "mem:test_buffer_pool"
+
+/* threads pinning pages of one pool at once, the pins each makes, the pages pinned and
+   the frames they share: twice the threads, so the pages being read ahead never leave
+   a pin without a frame */
+#define PIN_THREADS 8
+#define PINS_PER_THREAD 2000
+#define PIN_PAGES 64
+#define PIN_FRAMES 16
+
+/* a thread of testHitsBesideMisses changing a page in the pool while the pool lock is
+   held (by forcePage, which makes the log durable under it); done once it unpinned the
+   page, doneInTime if that was before HELD_LOCK_WAIT_MS passed */
+#define HELD_LOCK_WAIT_MS 5000
+typedef struct LockedPoolPin {
+	BM_BufferPool *bm;
+	PageNumber pageNum;
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t doneSignal;
+	bool done;
+	bool doneInTime;
+} LockedPoolPin;
+
+/* a page another thread unpins for testHitsBesideMisses, and what unpinPage returned */
+typedef struct PinHandOver {
+	BM_BufferPool *bm;
+	BM_PageHandle *page;
+	RC result;
+} PinHandOver;
+
+/* optimistic reads testOptimisticReads makes while a thread rewrites the page */
+#define OPTIMISTIC_READS 20000
+
+/* the thread of testOptimisticReads rewriting page 5 until it is stopped */
+typedef struct PageRewriter {
+	BM_BufferPool *bm;
+	volatile bool stop;
+} PageRewriter;
+
+/* how long testCleaner waits for the cleaner at most, in milliseconds */
+#define CLEANER_WAIT_MS 5000
+
+/* the page testCleaner changes when the cleaner makes the log durable for it, i.e.
+   after it took the page and before it wrote it (once, counted in calls) */
+typedef struct CleanerRace {
+	BM_BufferPool *bm;
+	PageNumber pageNum;
+	int calls;
+} CleanerRace;
+
+/* a thread of testConcurrentPins; counts how often it increased each page's counter */
+typedef struct PinWorker {
+	BM_BufferPool *bm;
+	unsigned int seed;
+	int increments[PIN_PAGES];
+} PinWorker;
+
+// test and helper methods
+static void testAlignedFrames (void);
+static void testWriteBack (void);
+static void testFailedForce (void);
+static void testLargePages (void);
+static void testReadAhead (void);
+static void testMemoryFile (void);
+static void testCLOCK (void);
+static void testLRUK (void);
+static void testLFU (void);
+static void testLRU (void);
+static void testARC (void);
+static void test2Q (void);
+static void testDirectPageTable (void);
+static void testConcurrentPins (void);
+static void testHitsBesideMisses (void);
+static void testOptimisticReads (void);
+static void testCleaner (void);
+
+static void createDummyPages(char *fileName, int num);
+static void checkDummyPages(BM_BufferPool *bm, int num);
+static void pinAndUnpin(BM_BufferPool *bm, PageNumber pageNum);
+static void changePage(BM_BufferPool *bm, PageNumber pageNum);
+static int waitForWrites(BM_BufferPool *bm, int numWrites);
+static int countDirty(BM_BufferPool *bm);
+static int pageFileFd(char *fileName);
+static bool pageDirty(BM_BufferPool *bm, PageNumber pageNum);
+static void *pinWorker(void *arg);
+static void *pageRewriter(void *arg);
+static RC pinWhileFlushing(void *logData, uint64_t lsn);
+static RC changeWhileCleaning(void *logData, uint64_t lsn);
+static void *lockedPoolPinner(void *arg);
+static void *unpinFromThread(void *arg);
+
+// main method
+int
+main (void)
+{
+	initStorageManager();
+	testName = "";
+
+	testAlignedFrames();
+	testWriteBack();
+	testFailedForce();
+	testLargePages();
+	testReadAhead();
+	testMemoryFile();
+	testCLOCK();
+	testLRUK();
+	testLFU();
+	testLRU();
+	testARC();
+	test2Q();
+	testDirectPageTable();
+	testConcurrentPins();
+	testHitsBesideMisses();
+	testOptimisticReads();
+	testCleaner();
+
+	return 0;
+}
+
+// pages of a pool on an O_DIRECT file are read and written straight from its frames
+void
+testAlignedFrames (void)
+{
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	SM_FileHandle fh;
+	int i, alignment;
+
+	testName = "Frames of a pool on an O_DIRECT file are aligned";
+
+	createDummyPages(TESTPF, 20);
+	TEST_CHECK(openPageFileWithMode(TESTPF, &fh, SM_MODE_DIRECT));
+	alignment = getPageFileAlignment(&fh);
+	TEST_CHECK(closePageFile(&fh));
+
+	// the pool opens its file with the default mode
+	setDefaultFileMode(SM_MODE_DIRECT);
+	TEST_CHECK(initBufferPool(bm, TESTPF, 3, RS_FIFO, NULL));
+	setDefaultFileMode(SM_MODE_PREAD);
+
+	for (i = 0; i < 5; i++)
+	{
+		TEST_CHECK(pinPage(bm, h, i));
+		ASSERT_TRUE(((uintptr_t) h->data) % alignment == 0, "frame data aligned for O_DIRECT");
+		sprintf(h->data, "%s-%i", "Changed", i);
+		TEST_CHECK(markDirty(bm, h));
+		TEST_CHECK(unpinPage(bm, h));
+	}
+
+	// the changed pages were written back with O_DIRECT when they were evicted
+	checkDummyPages(bm, 2);
+	TEST_CHECK(shutdownBufferPool(bm));
+
+	TEST_CHECK(initBufferPool(bm, TESTPF, 3, RS_FIFO, NULL));
+	for (i = 0; i < 5; i++)
+	{
+		TEST_CHECK(pinPage(bm, h, i));
+		char expected[64];
+		sprintf(expected, "%s-%i", "Changed", i);
+		ASSERT_EQUALS_STRING(expected, h->data, "reading back changed page");
+		TEST_CHECK(unpinPage(bm, h));
+	}
+	TEST_CHECK(shutdownBufferPool(bm));
+
+	TEST_CHECK(destroyPageFile(TESTPF));
+	free(bm);
+	free(h);
+	TEST_DONE();
+}
+
+// a dirty page is written back while the page replacing it is read, and pinning it
+// again waits for that write
+void
+testWriteBack (void)
+{
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	int i;
+
+	testName = "Evicted pages are written back";
+
+	createDummyPages(TESTPF, 10);
+	TEST_CHECK(initBufferPool(bm, TESTPF, 1, RS_FIFO, NULL));
+
+	// a pool of one frame evicts the page just changed on every pin
+	for (i = 0; i < 10; i++)
+	{
+		TEST_CHECK(pinPage(bm, h, i));
+		sprintf(h->data, "%s-%i", "Changed", i);
+		TEST_CHECK(markDirty(bm, h));
+		TEST_CHECK(unpinPage(bm, h));
+	}
+	ASSERT_EQUALS_INT(9, getNumWriteIO(bm), "every evicted page written");
+	checkDummyPages(bm, 10);
+	ASSERT_EQUALS_INT(20, getNumReadIO(bm), "every page read twice");
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile(TESTPF));
+	free(bm);
+	free(h);
+	TEST_DONE();
+}
+
+// a page that failed to be forced stays dirty, and recovery still starts at its change
+void
+testFailedForce (void)
+{
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	uint64_t redoLSN;
+	int fd, savedFd, readOnlyFd;
+
+	testName = "Failed forces keep pages dirty";
+
+	createDummyPages(TESTPF, 4);
+	TEST_CHECK(initBufferPool(bm, TESTPF, 4, RS_FIFO, NULL));
+	TEST_CHECK(pinPage(bm, h, 2));
+	sprintf(h->data, "%s-%i", "Changed", 2);
+	TEST_CHECK(markDirtyLSN(bm, h, 5));
+	TEST_CHECK(unpinPage(bm, h));
+
+	// the pool's descriptor is swapped for a read-only one, so the write fails
+	fd = pageFileFd(TESTPF);
+	ASSERT_TRUE(fd >= 0, "the pool's page file is open");
+	savedFd = dup(fd);
+	readOnlyFd = open(TESTPF, O_RDONLY);
+	ASSERT_TRUE(savedFd >= 0 && readOnlyFd >= 0 && dup2(readOnlyFd, fd) == fd, "descriptor swapped");
+	ASSERT_ERROR(forcePage(bm, h), "force of a page that cannot be written");
+	ASSERT_EQUALS_INT(0, getNumWriteIO(bm), "no write counted");
+	ASSERT_TRUE(pageDirty(bm, 2), "page still dirty");
+	TEST_CHECK(getCheckpointLSN(bm, &redoLSN));
+	ASSERT_TRUE(redoLSN == 5, "recovery starts at the change");
+
+	// once the file can be written again, the force goes through
+	ASSERT_TRUE(dup2(savedFd, fd) == fd, "descriptor restored");
+	close(savedFd);
+	close(readOnlyFd);
+	TEST_CHECK(forcePage(bm, h));
+	ASSERT_EQUALS_INT(1, getNumWriteIO(bm), "page written");
+	ASSERT_TRUE(!pageDirty(bm, 2), "page clean");
+	TEST_CHECK(getCheckpointLSN(bm, &redoLSN));
+	ASSERT_TRUE(redoLSN == 0, "nothing left to recover");
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile(TESTPF));
+	free(bm);
+	free(h);
+	TEST_DONE();
+}
+
+// a pool takes the page size of its file
+void
+testLargePages (void)
+{
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	int pageSize = 4 * PAGE_SIZE;
+	int i;
+
+	testName = "Pools on files with large pages";
+
+	TEST_CHECK(createPageFileWithSize(TESTPF, pageSize));
+	TEST_CHECK(initBufferPool(bm, TESTPF, 2, RS_FIFO, NULL));
+	ASSERT_EQUALS_INT(pageSize, getPoolPageSize(bm), "the pool's page size is the file's");
+
+	// the last bytes of each page make it to disk and back
+	for (i = 0; i < 5; i++)
+	{
+		TEST_CHECK(pinPage(bm, h, i));
+		memset(h->data, 'a' + i, pageSize);
+		TEST_CHECK(markDirty(bm, h));
+		TEST_CHECK(unpinPage(bm, h));
+	}
+	TEST_CHECK(shutdownBufferPool(bm));
+
+	TEST_CHECK(initBufferPool(bm, TESTPF, 2, RS_FIFO, NULL));
+	for (i = 0; i < 5; i++)
+	{
+		TEST_CHECK(pinPage(bm, h, i));
+		ASSERT_TRUE(h->data[0] == 'a' + i && h->data[pageSize - 1] == 'a' + i, "large page kept whole");
+		TEST_CHECK(unpinPage(bm, h));
+	}
+	TEST_CHECK(shutdownBufferPool(bm));
+
+	TEST_CHECK(destroyPageFile(TESTPF));
+	free(bm);
+	free(h);
+	TEST_DONE();
+}
+
+// sequential pins have the pages after them read ahead, other pins do not
+void
+testReadAhead (void)
+{
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	BM_PageHandle handles[8];
+	PageNumber *frameContent;
+	int i, ahead, inPool;
+
+	testName = "Sequential pins read ahead";
+
+	createDummyPages(TESTPF, 64);
+
+	// scattered pins read only what they pin
+	TEST_CHECK(initBufferPool(bm, TESTPF, 16, RS_FIFO, NULL));
+	TEST_CHECK(pinPage(bm, h, 40));
+	TEST_CHECK(unpinPage(bm, h));
+	TEST_CHECK(pinPage(bm, h, 20));
+	TEST_CHECK(unpinPage(bm, h));
+	TEST_CHECK(pinPage(bm, h, 30));
+	TEST_CHECK(unpinPage(bm, h));
+	ASSERT_EQUALS_POOL("[40 0],[20 0],[30 0],[-1 0],[-1 0],[-1 0],[-1 0],[-1 0],[-1 0],[-1 0],[-1 0],[-1 0],[-1 0],[-1 0],[-1 0],[-1 0]", bm, "only the pinned pages");
+	ASSERT_EQUALS_INT(3, getNumReadIO(bm), "one read per pin");
+	TEST_CHECK(shutdownBufferPool(bm));
+
+	// a scan finds the pages after the one it pins in the pool already
+	TEST_CHECK(initBufferPool(bm, TESTPF, 16, RS_FIFO, NULL));
+	for (i = 0; i < 4; i++)
+	{
+		TEST_CHECK(pinPage(bm, h, i));
+		TEST_CHECK(unpinPage(bm, h));
+	}
+	frameContent = getFrameContents(bm);
+	ahead = 0;
+	for (i = 0; i < 16; i++)
+		if (frameContent[i] > 3)
+			ahead++;
+	free(frameContent);
+	ASSERT_TRUE(ahead > 0, "pages after the scan read ahead");
+
+	// the pages read ahead are the right ones, and each was read once
+	for (i = 4; i < 12; i++)
+	{
+		TEST_CHECK(pinPage(bm, h, i));
+		char expected[64];
+		sprintf(expected, "%s-%i", "Page", i);
+		ASSERT_EQUALS_STRING(expected, h->data, "page read ahead");
+		TEST_CHECK(unpinPage(bm, h));
+	}
+	frameContent = getFrameContents(bm);
+	inPool = 0;
+	for (i = 0; i < 16; i++)
+		if (frameContent[i] != NO_PAGE)
+			inPool++;
+	free(frameContent);
+	ASSERT_TRUE(inPool > 12 && getNumReadIO(bm) <= inPool, "no page read twice, more read than pinned");
+	TEST_CHECK(shutdownBufferPool(bm));
+
+	// frames still being read ahead are given to pins once no other frame is free
+	TEST_CHECK(initBufferPool(bm, TESTPF, 8, RS_FIFO, NULL));
+	for (i = 0; i < 8; i++)
+		TEST_CHECK(pinPage(bm, &handles[i], i * 7));
+	for (i = 0; i < 8; i++)
+	{
+		char expected[64];
+		sprintf(expected, "%s-%i", "Page", i * 7);
+		ASSERT_EQUALS_STRING(expected, handles[i].data, "every frame pinned");
+	}
+	for (i = 0; i < 8; i++)
+		TEST_CHECK(unpinPage(bm, &handles[i]));
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile(TESTPF));
+	free(bm);
+	free(h);
+	TEST_DONE();
+}
+
+// a pool works the same on a file kept in memory
+void
+testMemoryFile (void)
+{
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	int i;
+
+	testName = "Pools on files in memory";
+
+	createDummyPages(TESTMEM, 10);
+	TEST_CHECK(initBufferPool(bm, TESTMEM, 3, RS_FIFO, NULL));
+	for (i = 0; i < 10; i++)
+	{
+		TEST_CHECK(pinPage(bm, h, i));
+		sprintf(h->data, "%s-%i", "Changed", i);
+		TEST_CHECK(markDirty(bm, h));
+		TEST_CHECK(unpinPage(bm, h));
+	}
+	ASSERT_EQUALS_INT(7, getNumWriteIO(bm), "evicted pages written to memory");
+	TEST_CHECK(shutdownBufferPool(bm));
+	ASSERT_TRUE(access(TESTMEM, F_OK) != 0, "nothing written to disk");
+
+	// the pages are there for the next pool
+	TEST_CHECK(initBufferPool(bm, TESTMEM, 3, RS_FIFO, NULL));
+	checkDummyPages(bm, 10);
+	TEST_CHECK(shutdownBufferPool(bm));
+
+	TEST_CHECK(destroyPageFile(TESTMEM));
+	ASSERT_ERROR(initBufferPool(bm, TESTMEM, 3, RS_FIFO, NULL), "no pool on a destroyed memory file");
+	free(bm);
+	free(h);
+	TEST_DONE();
+}
+
+// CLOCK gives every page pinned since the hand last passed it a second chance, and
+// passes over pinned pages
+void
+testCLOCK (void)
+{
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	int i;
+
+	testName = "Testing CLOCK page replacement";
+
+	createDummyPages(TESTPF, 100);
+	TEST_CHECK(initBufferPool(bm, TESTPF, 3, RS_CLOCK, NULL));
+
+	for (i = 1; i <= 3; i++)
+		pinAndUnpin(bm, i * 10);
+	ASSERT_EQUALS_POOL("[10 0],[20 0],[30 0]", bm, "pool filled");
+
+	// every page was pinned since it came in, so the hand goes round once and takes the first
+	pinAndUnpin(bm, 40);
+	ASSERT_EQUALS_POOL("[40 0],[20 0],[30 0]", bm, "every page had a second chance");
+
+	// 20 is pinned again before the hand comes by, 30 is not
+	pinAndUnpin(bm, 20);
+	pinAndUnpin(bm, 50);
+	ASSERT_EQUALS_POOL("[40 0],[20 0],[50 0]", bm, "page pinned again kept");
+	pinAndUnpin(bm, 60);
+	ASSERT_EQUALS_POOL("[40 0],[60 0],[50 0]", bm, "second chance used up");
+
+	// a pinned page is passed over
+	TEST_CHECK(pinPage(bm, h, 50));
+	pinAndUnpin(bm, 70);
+	ASSERT_EQUALS_POOL("[70 0],[60 0],[50 1]", bm, "pinned page passed over");
+	TEST_CHECK(unpinPage(bm, h));
+
+	ASSERT_EQUALS_INT(7, getNumReadIO(bm), "one read per page brought in");
+	ASSERT_EQUALS_INT(0, getNumWriteIO(bm), "no page written");
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile(TESTPF));
+	free(bm);
+	free(h);
+	TEST_DONE();
+}
+
+// LRU-K evicts the page whose K-th most recent reference lies furthest back; pins close
+// together count as one reference
+void
+testLRUK (void)
+{
+	BM_BufferPool *bm = MAKE_POOL();
+	int k, i;
+
+	testName = "Testing LRU-K page replacement";
+
+	createDummyPages(TESTPF, 100);
+
+	// 10 is referenced twice, 20 and 30 once (20's pins come in a burst); 10 is the
+	// least recently used page, but the only one with a second reference
+	for (k = 1; k <= 2; k++)
+	{
+		TEST_CHECK(initBufferPool(bm, TESTPF, 3, RS_LRU_K, &k));
+		pinAndUnpin(bm, 10);
+		for (i = 0; i < 20; i++)
+			pinAndUnpin(bm, 20);
+		pinAndUnpin(bm, 10);
+		pinAndUnpin(bm, 30);
+		pinAndUnpin(bm, 20);
+		ASSERT_EQUALS_POOL("[10 0],[30 0],[20 0]", bm, "pool filled");
+
+		pinAndUnpin(bm, 40);
+		if (k == 1)
+			ASSERT_EQUALS_POOL("[40 0],[30 0],[20 0]", bm, "LRU-1 evicts the least recently used page");
+		else
+			ASSERT_EQUALS_POOL("[10 0],[40 0],[20 0]", bm, "LRU-2 evicts the least recently used page referenced once");
+
+		// then the other page referenced once
+		pinAndUnpin(bm, 50);
+		if (k == 2)
+			ASSERT_EQUALS_POOL("[10 0],[40 0],[50 0]", bm, "page referenced twice kept");
+		ASSERT_EQUALS_INT(5, getNumReadIO(bm), "one read per page brought in");
+		TEST_CHECK(shutdownBufferPool(bm));
+	}
+
+	// K defaults to 2 and ranges from 1 to 8
+	TEST_CHECK(initBufferPool(bm, TESTPF, 3, RS_LRU_K, NULL));
+	TEST_CHECK(shutdownBufferPool(bm));
+	k = 0;
+	ASSERT_EQUALS_INT(RC_IM_CONFIG_ERROR, initBufferPool(bm, TESTPF, 3, RS_LRU_K, &k), "K of 0 refused");
+	k = 9;
+	ASSERT_EQUALS_INT(RC_IM_CONFIG_ERROR, initBufferPool(bm, TESTPF, 3, RS_LRU_K, &k), "K of 9 refused");
+
+	TEST_CHECK(destroyPageFile(TESTPF));
+	free(bm);
+	TEST_DONE();
+}
+
+// LFU evicts the least recently used of the pages pinned least often; the counts are
+// halved after every 8 pins per frame, so pages pinned often long ago go too
+void
+testLFU (void)
+{
+	BM_BufferPool *bm = MAKE_POOL();
+	int i;
+
+	testName = "Testing LFU page replacement";
+
+	createDummyPages(TESTPF, 100);
+
+	TEST_CHECK(initBufferPool(bm, TESTPF, 3, RS_LFU, NULL));
+	for (i = 0; i < 3; i++)
+		pinAndUnpin(bm, 10);
+	pinAndUnpin(bm, 20);
+	pinAndUnpin(bm, 20);
+	pinAndUnpin(bm, 30);
+	ASSERT_EQUALS_POOL("[10 0],[20 0],[30 0]", bm, "pool filled");
+
+	pinAndUnpin(bm, 40);
+	ASSERT_EQUALS_POOL("[10 0],[20 0],[40 0]", bm, "page pinned once evicted");
+	pinAndUnpin(bm, 50);
+	ASSERT_EQUALS_POOL("[10 0],[20 0],[50 0]", bm, "new page evicted before pages pinned more");
+	pinAndUnpin(bm, 60);
+	ASSERT_EQUALS_POOL("[10 0],[20 0],[60 0]", bm, "pages pinned more kept");
+	ASSERT_EQUALS_INT(6, getNumReadIO(bm), "one read per page brought in");
+	TEST_CHECK(shutdownBufferPool(bm));
+
+	// 10 is pinned 20 times, then 20 until the counts were halved three times (after 72
+	// pins), then 30 three times: 10's count is down to 2, below 30's
+	TEST_CHECK(initBufferPool(bm, TESTPF, 3, RS_LFU, NULL));
+	for (i = 0; i < 20; i++)
+		pinAndUnpin(bm, 10);
+	for (i = 0; i < 52; i++)
+		pinAndUnpin(bm, 20);
+	for (i = 0; i < 3; i++)
+		pinAndUnpin(bm, 30);
+	pinAndUnpin(bm, 40);
+	ASSERT_EQUALS_POOL("[40 0],[20 0],[30 0]", bm, "page pinned often long ago evicted");
+	TEST_CHECK(shutdownBufferPool(bm));
+
+	TEST_CHECK(destroyPageFile(TESTPF));
+	free(bm);
+	TEST_DONE();
+}
+
+// LRU evicts the page unpinned longest ago, passing over pinned pages
+void
+testLRU (void)
+{
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	PageNumber *frameContent;
+	int i, j;
+
+	testName = "Testing LRU page replacement";
+
+	createDummyPages(TESTPF, 100);
+	TEST_CHECK(initBufferPool(bm, TESTPF, 3, RS_LRU, NULL));
+
+	for (i = 1; i <= 3; i++)
+		pinAndUnpin(bm, i * 10);
+	pinAndUnpin(bm, 10);
+	pinAndUnpin(bm, 40);
+	ASSERT_EQUALS_POOL("[10 0],[40 0],[30 0]", bm, "least recently used page evicted");
+	pinAndUnpin(bm, 50);
+	ASSERT_EQUALS_POOL("[10 0],[40 0],[50 0]", bm, "next least recently used page evicted");
+
+	// a pinned page keeps its frame however long ago it was pinned
+	TEST_CHECK(pinPage(bm, h, 10));
+	pinAndUnpin(bm, 60);
+	pinAndUnpin(bm, 70);
+	ASSERT_EQUALS_POOL("[10 1],[60 0],[70 0]", bm, "pinned page passed over");
+	TEST_CHECK(unpinPage(bm, h));
+
+	// unpinned, it is the least recently used page again
+	pinAndUnpin(bm, 60);
+	pinAndUnpin(bm, 70);
+	pinAndUnpin(bm, 80);
+	ASSERT_EQUALS_POOL("[80 0],[60 0],[70 0]", bm, "unpinned page evicted");
+	ASSERT_EQUALS_INT(8, getNumReadIO(bm), "one read per page brought in");
+	TEST_CHECK(shutdownBufferPool(bm));
+
+	// in a larger pool the last pages pinned are the ones in it
+	TEST_CHECK(initBufferPool(bm, TESTPF, 10, RS_LRU, NULL));
+	for (i = 0; i < 100; i++)
+		pinAndUnpin(bm, (i * 37) % 100);
+	frameContent = getFrameContents(bm);
+	for (i = 0; i < 10; i++)
+	{
+		bool recent = false;
+		for (j = 90; j < 100; j++)
+			if (frameContent[i] == (j * 37) % 100)
+				recent = true;
+		ASSERT_TRUE(recent, "page among the last ten pinned");
+	}
+	free(frameContent);
+	TEST_CHECK(shutdownBufferPool(bm));
+
+	TEST_CHECK(destroyPageFile(TESTPF));
+	free(bm);
+	free(h);
+	TEST_DONE();
+}
+
+// ARC keeps pages pinned more than once while a scan goes by; pinning a page again soon
+// after its eviction gives more of the pool to the list it was evicted from
+void
+testARC (void)
+{
+	BM_BufferPool *bm = MAKE_POOL();
+	int i;
+
+	testName = "Testing ARC page replacement";
+
+	createDummyPages(TESTPF, 100);
+	TEST_CHECK(initBufferPool(bm, TESTPF, 4, RS_ARC, NULL));
+
+	pinAndUnpin(bm, 10);
+	pinAndUnpin(bm, 10);
+	pinAndUnpin(bm, 20);
+	pinAndUnpin(bm, 20);
+
+	// the scan's pages are pinned once, so they evict one another
+	for (i = 30; i <= 60; i += 10)
+		pinAndUnpin(bm, i);
+	ASSERT_EQUALS_POOL("[10 0],[20 0],[50 0],[60 0]", bm, "pages pinned twice kept during a scan");
+
+	// 30 was evicted recently: it comes back as a page pinned more than once, and pages
+	// pinned once get another frame, taken from the least recently used of the others
+	pinAndUnpin(bm, 30);
+	ASSERT_EQUALS_POOL("[10 0],[20 0],[30 0],[60 0]", bm, "page evicted recently brought back");
+	pinAndUnpin(bm, 70);
+	ASSERT_EQUALS_POOL("[70 0],[20 0],[30 0],[60 0]", bm, "pages pinned once got more of the pool");
+	pinAndUnpin(bm, 80);
+	ASSERT_EQUALS_POOL("[70 0],[20 0],[30 0],[80 0]", bm, "pages pinned once evict one another again");
+
+	// 10 was evicted recently as well, which gives the frame back
+	pinAndUnpin(bm, 10);
+	ASSERT_EQUALS_POOL("[10 0],[20 0],[30 0],[80 0]", bm, "pages pinned more than once got the frame back");
+	ASSERT_EQUALS_INT(10, getNumReadIO(bm), "one read per page brought in");
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile(TESTPF));
+	free(bm);
+	TEST_DONE();
+}
+
+// 2Q evicts pages pinned only since they came in first (in the order they came in); a
+// page pinned again after that is kept in LRU order with the pages used often
+void
+test2Q (void)
+{
+	BM_BufferPool *bm = MAKE_POOL();
+	int i;
+
+	testName = "Testing 2Q page replacement";
+
+	createDummyPages(TESTPF, 100);
+	TEST_CHECK(initBufferPool(bm, TESTPF, 4, RS_2Q, NULL));
+
+	for (i = 10; i <= 40; i += 10)
+		pinAndUnpin(bm, i);
+	pinAndUnpin(bm, 20);  // still in its first stay, so no different from the others
+	pinAndUnpin(bm, 50);
+	ASSERT_EQUALS_POOL("[50 0],[20 0],[30 0],[40 0]", bm, "first page in evicted");
+
+	// 10 is pinned again after leaving the pool, so it stays while new pages go by
+	pinAndUnpin(bm, 10);
+	ASSERT_EQUALS_POOL("[50 0],[10 0],[30 0],[40 0]", bm, "page pinned again after its eviction brought back");
+	for (i = 60; i <= 80; i += 10)
+		pinAndUnpin(bm, i);
+	ASSERT_EQUALS_POOL("[80 0],[10 0],[60 0],[70 0]", bm, "page pinned again kept during a scan");
+	ASSERT_EQUALS_INT(9, getNumReadIO(bm), "one read per page brought in");
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile(TESTPF));
+	free(bm);
+	TEST_DONE();
+}
+
+// pools finding their pages through the direct page table behave like pools using the
+// hash table, for every strategy and page numbers over several of its chunks
+void
+testDirectPageTable (void)
+{
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	BM_PoolOptions options;
+	ReplacementStrategy strategy;
+	int reads[2], writes[2];
+	char *content[2];
+	char expected[64];
+	bool changed[2500], right;
+	int direct, step, page;
+
+	testName = "Pools with a direct page table";
+
+	for (strategy = RS_FIFO; strategy <= RS_2Q; strategy++)
+	{
+		for (direct = 0; direct < 2; direct++)
+		{
+			createDummyPages(TESTPF, 2500);
+			memset(&options, 0, sizeof(options));
+			options.directPageTable = direct;
+			TEST_CHECK(initBufferPoolWithOptions(bm, TESTPF, 16, strategy, NULL, &options));
+
+			// scattered pins over the whole file mixed with a small hot set
+			memset(changed, 0, sizeof(changed));
+			right = true;
+			for (step = 0; step < 3000; step++)
+			{
+				page = (step % 3 == 0) ? step % 40 : (step * 7919) % 2500;
+				TEST_CHECK(pinPage(bm, h, page));
+				sprintf(expected, "%s-%i", changed[page] ? "Changed" : "Page", page);
+				if (strcmp(expected, h->data) != 0)
+					right = false;
+				if (step % 5 == 0)
+				{
+					sprintf(h->data, "%s-%i", "Changed", page);
+					changed[page] = true;
+					TEST_CHECK(markDirty(bm, h));
+				}
+				TEST_CHECK(unpinPage(bm, h));
+			}
+			ASSERT_TRUE(right, "every page pinned holds what was written to it");
+
+			reads[direct] = getNumReadIO(bm);
+			writes[direct] = getNumWriteIO(bm);
+			content[direct] = sprintPoolContent(bm);
+			TEST_CHECK(shutdownBufferPool(bm));
+			TEST_CHECK(destroyPageFile(TESTPF));
+		}
+		ASSERT_EQUALS_INT(reads[0], reads[1], "same reads with both page tables");
+		ASSERT_EQUALS_INT(writes[0], writes[1], "same writes with both page tables");
+		ASSERT_EQUALS_STRING(content[0], content[1], "same pages in the pool with both page tables");
+		free(content[0]);
+		free(content[1]);
+	}
+
+	// pages past the end of the file are added to it, and to the table
+	createDummyPages(TESTPF, 10);
+	memset(&options, 0, sizeof(options));
+	options.directPageTable = true;
+	TEST_CHECK(initBufferPoolWithOptions(bm, TESTPF, 4, RS_LRU, NULL, &options));
+	TEST_CHECK(pinPage(bm, h, 5000));
+	ASSERT_EQUALS_STRING("", h->data, "page past the end is empty");
+	sprintf(h->data, "%s-%i", "Changed", 5000);
+	TEST_CHECK(markDirty(bm, h));
+	TEST_CHECK(unpinPage(bm, h));
+	TEST_CHECK(pinPage(bm, h, 5000));
+	ASSERT_EQUALS_STRING("Changed-5000", h->data, "page past the end found again");
+	TEST_CHECK(unpinPage(bm, h));
+	ASSERT_EQUALS_INT(1, getNumReadIO(bm), "page past the end read once");
+	TEST_CHECK(shutdownBufferPool(bm));
+
+	TEST_CHECK(destroyPageFile(TESTPF));
+	free(bm);
+	free(h);
+	TEST_DONE();
+}
+
+// threads pinning pages of a pool smaller than their working set lose no change: each
+// increases a counter in the pages it pins for writing and checks pages it pins for reading
+void
+testConcurrentPins (void)
+{
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	PinWorker workers[PIN_THREADS];
+	pthread_t threads[PIN_THREADS];
+	ReplacementStrategy strategy;
+	int *fixCounts;
+	int i, page, expected, counter;
+	bool pinned, right;
+
+	testName = "Pins from several threads at once";
+
+	for (strategy = RS_FIFO; strategy <= RS_2Q; strategy++)
+	{
+		createDummyPages(TESTPF, PIN_PAGES);
+		TEST_CHECK(initBufferPool(bm, TESTPF, PIN_FRAMES, strategy, NULL));
+
+		for (i = 0; i < PIN_THREADS; i++)
+		{
+			memset(&workers[i], 0, sizeof(PinWorker));
+			workers[i].bm = bm;
+			workers[i].seed = i + 1;
+			ASSERT_TRUE(pthread_create(&threads[i], NULL, pinWorker, &workers[i]) == 0, "thread started");
+		}
+		for (i = 0; i < PIN_THREADS; i++)
+			pthread_join(threads[i], NULL);
+
+		fixCounts = getFixCounts(bm);
+		pinned = false;
+		for (i = 0; i < PIN_FRAMES; i++)
+			if (fixCounts[i] != 0)
+				pinned = true;
+		free(fixCounts);
+		ASSERT_TRUE(!pinned, "every pin undone");
+		TEST_CHECK(shutdownBufferPool(bm));
+
+		// the counters on disk add up to the increments of all threads
+		TEST_CHECK(initBufferPool(bm, TESTPF, PIN_FRAMES, strategy, NULL));
+		right = true;
+		for (page = 0; page < PIN_PAGES; page++)
+		{
+			expected = 0;
+			for (i = 0; i < PIN_THREADS; i++)
+				expected += workers[i].increments[page];
+			TEST_CHECK(pinPage(bm, h, page));
+			memcpy(&counter, h->data + 64, sizeof(int));
+			if (counter != expected)
+				right = false;
+			TEST_CHECK(unpinPage(bm, h));
+		}
+		ASSERT_TRUE(right, "no increment lost");
+		TEST_CHECK(shutdownBufferPool(bm));
+		TEST_CHECK(destroyPageFile(TESTPF));
+	}
+
+	free(bm);
+	free(h);
+	TEST_DONE();
+}
+
+// pins of pages in the pool, unpins and dirty marks do not wait for the pool lock, and a
+// pin can be given up by another thread
+void
+testHitsBesideMisses (void)
+{
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	LockedPoolPin pin;
+	PinHandOver handOver;
+	pthread_t thread;
+	int *fixCounts;
+	int i;
+	bool pinned;
+
+	testName = "Hits while the pool lock is held";
+
+	createDummyPages(TESTPF, 4);
+	TEST_CHECK(initBufferPool(bm, TESTPF, 4, RS_LRU, NULL));
+	pinAndUnpin(bm, 1);
+	TEST_CHECK(pinPage(bm, h, 2));
+	TEST_CHECK(markDirtyLSN(bm, h, 7));
+	TEST_CHECK(unpinPage(bm, h));
+
+	// forcing page 2 makes the log durable with the pool lock held; page 1 is changed
+	// from another thread meanwhile
+	memset(&pin, 0, sizeof(LockedPoolPin));
+	pin.bm = bm;
+	pin.pageNum = 1;
+	pthread_mutex_init(&pin.lock, NULL);
+	pthread_cond_init(&pin.doneSignal, NULL);
+	setFlushLog(bm, pinWhileFlushing, &pin);
+	TEST_CHECK(forcePage(bm, h));
+	pthread_join(pin.thread, NULL);
+	setFlushLog(bm, NULL, NULL);
+	ASSERT_TRUE(pin.doneInTime, "page pinned, changed and unpinned while the pool lock was held");
+	ASSERT_TRUE(pageDirty(bm, 1) && !pageDirty(bm, 2), "the change is marked, the forced page written");
+	ASSERT_EQUALS_INT(2, getNumReadIO(bm), "no page read again");
+	pthread_mutex_destroy(&pin.lock);
+	pthread_cond_destroy(&pin.doneSignal);
+
+	// a page pinned for writing by this thread is unpinned by another one, after which it
+	// can be pinned for writing again
+	TEST_CHECK(pinPageWithIntent(bm, h, 3, BM_PIN_WRITE));
+	handOver.bm = bm;
+	handOver.page = h;
+	ASSERT_TRUE(pthread_create(&thread, NULL, unpinFromThread, &handOver) == 0, "thread started");
+	pthread_join(thread, NULL);
+	TEST_CHECK(handOver.result);
+	TEST_CHECK(pinPageWithIntent(bm, h, 3, BM_PIN_WRITE));
+	TEST_CHECK(unpinPage(bm, h));
+	fixCounts = getFixCounts(bm);
+	pinned = false;
+	for (i = 0; i < 4; i++)
+		if (fixCounts[i] != 0)
+			pinned = true;
+	free(fixCounts);
+	ASSERT_TRUE(!pinned, "every pin undone");
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(initBufferPool(bm, TESTPF, 4, RS_LRU, NULL));
+	TEST_CHECK(pinPage(bm, h, 1));
+	ASSERT_EQUALS_STRING("Changed-1", h->data, "change made while the pool lock was held on disk");
+	TEST_CHECK(unpinPage(bm, h));
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile(TESTPF));
+	free(bm);
+	free(h);
+	TEST_DONE();
+}
+
+// pages read without pinning them count only if no change or eviction ran meanwhile
+void
+testOptimisticReads (void)
+{
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	BM_OptimisticRead read;
+	PageRewriter rewriter;
+	pthread_t writer;
+	char copy[PAGE_SIZE];
+	int i, j, validated = 0;
+	bool torn = false;
+
+	testName = "Optimistic reads";
+
+	createDummyPages(TESTPF, 10);
+	TEST_CHECK(initBufferPool(bm, TESTPF, 3, RS_LRU, NULL));
+
+	// only pages in the pool can be read this way
+	ASSERT_EQUALS_INT(RC_IM_KEY_NOT_FOUND, beginOptimisticRead(bm, 1, &read), "page not in the pool");
+	for (i = 1; i <= 3; i++)
+		pinAndUnpin(bm, i);
+	TEST_CHECK(beginOptimisticRead(bm, 1, &read));
+	ASSERT_EQUALS_STRING("Page-1", read.page.data, "page read without pinning it");
+	ASSERT_TRUE(validateOptimisticRead(bm, &read), "read with nothing running alongside is valid");
+
+	// the read is no reference: 1 is still the least recently used page
+	pinAndUnpin(bm, 4);
+	ASSERT_EQUALS_POOL("[4 0],[2 0],[3 0]", bm, "optimistic read did not keep the page");
+	ASSERT_TRUE(!validateOptimisticRead(bm, &read), "read of an evicted page is invalid");
+	ASSERT_EQUALS_INT(4, getNumReadIO(bm), "optimistic read did no I/O");
+
+	// a change by a write pin invalidates reads, and no read begins while it is pinned
+	TEST_CHECK(beginOptimisticRead(bm, 2, &read));
+	TEST_CHECK(pinPageWithIntent(bm, h, 2, BM_PIN_WRITE));
+	ASSERT_EQUALS_INT(RC_IM_KEY_NOT_FOUND, beginOptimisticRead(bm, 2, &read), "page pinned for writing");
+	sprintf(h->data, "%s-%i", "Changed", 2);
+	TEST_CHECK(markDirty(bm, h));
+	TEST_CHECK(unpinPage(bm, h));
+	ASSERT_TRUE(!validateOptimisticRead(bm, &read), "read alongside a write pin is invalid");
+	TEST_CHECK(beginOptimisticRead(bm, 2, &read));
+	ASSERT_EQUALS_STRING("Changed-2", read.page.data, "change seen by the next read");
+	ASSERT_TRUE(validateOptimisticRead(bm, &read), "read after the change is valid");
+
+	// so does a change bracketed under a read pin
+	TEST_CHECK(pinPage(bm, h, 3));
+	TEST_CHECK(beginOptimisticRead(bm, 3, &read));
+	TEST_CHECK(beginPageChange(bm, h));
+	ASSERT_EQUALS_INT(RC_IM_KEY_NOT_FOUND, beginOptimisticRead(bm, 3, &read), "page being changed");
+	sprintf(h->data, "%s-%i", "Changed", 3);
+	TEST_CHECK(endPageChange(bm, h));
+	TEST_CHECK(markDirty(bm, h));
+	TEST_CHECK(unpinPage(bm, h));
+	ASSERT_TRUE(!validateOptimisticRead(bm, &read), "read alongside a bracketed change is invalid");
+	TEST_CHECK(shutdownBufferPool(bm));
+
+	// a thread keeps rewriting a page with one byte value, half of it at a time, every
+	// other turn; every read that is valid saw one value only (both sides yield halfway,
+	// so reads and writes overlap even on one CPU)
+	TEST_CHECK(initBufferPool(bm, TESTPF, 3, RS_LRU, NULL));
+	TEST_CHECK(pinPageWithIntent(bm, h, 5, BM_PIN_WRITE));
+	memset(h->data, 'z', PAGE_SIZE);
+	TEST_CHECK(markDirty(bm, h));
+	TEST_CHECK(unpinPage(bm, h));
+	rewriter.bm = bm;
+	rewriter.stop = false;
+	ASSERT_TRUE(pthread_create(&writer, NULL, pageRewriter, &rewriter) == 0, "writer started");
+	for (i = 0; i < OPTIMISTIC_READS; i++)
+	{
+		if (beginOptimisticRead(bm, 5, &read) != RC_OK)
+			continue;
+		sched_yield();
+		memcpy(copy, read.page.data, PAGE_SIZE);
+		if (!validateOptimisticRead(bm, &read))
+			continue;
+		validated++;
+		for (j = 1; j < PAGE_SIZE; j++)
+			if (copy[j] != copy[0])
+				torn = true;
+	}
+	rewriter.stop = true;
+	pthread_join(writer, NULL);
+	ASSERT_TRUE(validated > 0, "some reads valid");
+	ASSERT_TRUE(!torn, "no valid read saw a page half written");
+	TEST_CHECK(shutdownBufferPool(bm));
+
+	TEST_CHECK(destroyPageFile(TESTPF));
+	free(bm);
+	free(h);
+	TEST_DONE();
+}
+
+// the cleaner writes dirty pages back in the background, the oldest first, until the
+// reserve of clean frames is kept and few enough frames are dirty
+void
+testCleaner (void)
+{
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	BM_PageHandle handles[8];
+	BM_PoolOptions options;
+	CleanerRace race;
+	int i;
+
+	testName = "Background cleaning";
+
+	createDummyPages(TESTPF, 100);
+	memset(&options, 0, sizeof(options));
+	options.cleanReserve = 9;
+	ASSERT_EQUALS_INT(RC_IM_CONFIG_ERROR, initBufferPoolWithOptions(bm, TESTPF, 8, RS_LRU, NULL, &options), "reserve larger than the pool refused");
+
+	// 8 dirty frames and a reserve of 4: the 4 changed first are written, no more (the
+	// pages stay pinned until all are dirty, so the cleaner never sees empty frames)
+	options.cleanReserve = 4;
+	TEST_CHECK(initBufferPoolWithOptions(bm, TESTPF, 8, RS_LRU, NULL, &options));
+	for (i = 0; i < 8; i++)
+	{
+		TEST_CHECK(pinPage(bm, &handles[i], i * 10));
+		sprintf(handles[i].data, "%s-%i", "Changed", i * 10);
+		TEST_CHECK(markDirty(bm, &handles[i]));
+	}
+	for (i = 0; i < 8; i++)
+		TEST_CHECK(unpinPage(bm, &handles[i]));
+	ASSERT_EQUALS_INT(4, waitForWrites(bm, 4), "reserve cleaned without an eviction");
+	usleep(300 * 1000);
+	ASSERT_EQUALS_INT(4, getNumWriteIO(bm), "nothing written past the reserve");
+	ASSERT_TRUE(!pageDirty(bm, 0) && !pageDirty(bm, 30) && pageDirty(bm, 40) && pageDirty(bm, 70), "oldest pages written first");
+
+	// a pinned page is not written, even when it is the oldest
+	TEST_CHECK(pinPage(bm, h, 40));
+	changePage(bm, 0);
+	ASSERT_EQUALS_INT(5, waitForWrites(bm, 5), "page changed again written");
+	usleep(300 * 1000);
+	ASSERT_TRUE(pageDirty(bm, 40) && !pageDirty(bm, 50), "pinned page passed over");
+	TEST_CHECK(unpinPage(bm, h));
+
+	// misses find clean frames, and the cleaner keeps the reserve up as they take them
+	for (i = 0; i < 8; i++)
+		pinAndUnpin(bm, 81 + i);
+	ASSERT_TRUE(waitForWrites(bm, 9) >= 9 && countDirty(bm) == 0, "every changed page written");
+	TEST_CHECK(shutdownBufferPool(bm));
+
+	// a limit on the pages written a second spaces out the cleaner's batches, as long as
+	// the reserve is kept: once 7 of the 8 dirty pages are written, 4 more pages changed
+	// wait at least 1/5 s for the next batch
+	memset(&options, 0, sizeof(options));
+	options.cleanReserve = 2;
+	options.cleanDirtyPercent = 10;
+	options.cleanPagesPerSecond = 5;
+	TEST_CHECK(initBufferPoolWithOptions(bm, TESTPF, 16, RS_LRU, NULL, &options));
+	for (i = 0; i < 8; i++)
+		pinAndUnpin(bm, 50 + i * 3);
+	for (i = 0; i < 8; i++)
+		changePage(bm, 1 + i * 3);
+	ASSERT_EQUALS_INT(7, waitForWrites(bm, 7), "dirty pages over the share written");
+	for (i = 0; i < 4; i++)
+		changePage(bm, 50 + i * 3);
+	usleep(100 * 1000);
+	ASSERT_EQUALS_INT(7, getNumWriteIO(bm), "next batch held back");
+	ASSERT_TRUE(waitForWrites(bm, 11) >= 11, "next batch written later");
+	TEST_CHECK(shutdownBufferPool(bm));
+
+	// the pages written hold their changes
+	TEST_CHECK(initBufferPool(bm, TESTPF, 4, RS_FIFO, NULL));
+	for (i = 0; i < 8; i++)
+	{
+		TEST_CHECK(pinPage(bm, h, i * 10));
+		char expected[64];
+		sprintf(expected, "%s-%i", "Changed", i * 10);
+		ASSERT_EQUALS_STRING(expected, h->data, "written page holds its change");
+		TEST_CHECK(unpinPage(bm, h));
+	}
+	TEST_CHECK(shutdownBufferPool(bm));
+
+	// a page changed (with a plain markDirty) while the cleaner writes it stays dirty, and
+	// is written again
+	memset(&options, 0, sizeof(options));
+	options.cleanReserve = 1;
+	options.cleanDirtyPercent = 10;
+	TEST_CHECK(initBufferPoolWithOptions(bm, TESTPF, 8, RS_LRU, NULL, &options));
+	race.bm = bm;
+	race.pageNum = 3;
+	race.calls = 0;
+	setFlushLog(bm, changeWhileCleaning, &race);
+	TEST_CHECK(pinPage(bm, h, 3));
+	sprintf(h->data, "%s-%i", "Logged", 3);
+	TEST_CHECK(markDirtyLSN(bm, h, 9));
+	TEST_CHECK(unpinPage(bm, h));
+	ASSERT_EQUALS_INT(2, waitForWrites(bm, 2), "page changed during its write written again");
+	ASSERT_TRUE(race.calls >= 2 && !pageDirty(bm, 3), "page clean after the second write");
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(initBufferPool(bm, TESTPF, 8, RS_LRU, NULL));
+	TEST_CHECK(pinPage(bm, h, 3));
+	ASSERT_EQUALS_STRING("Changed-3", h->data, "change made during the write on disk");
+	TEST_CHECK(unpinPage(bm, h));
+	TEST_CHECK(shutdownBufferPool(bm));
+
+	TEST_CHECK(destroyPageFile(TESTPF));
+	free(bm);
+	free(h);
+	TEST_DONE();
+}
+
+void
+createDummyPages(char *fileName, int num)
+{
+	int i;
+	SM_FileHandle fh;
+	SM_PageHandle ph = (SM_PageHandle) calloc(1, PAGE_SIZE);
+
+	TEST_CHECK(createPageFile(fileName));
+	TEST_CHECK(openPageFile(fileName, &fh));
+	TEST_CHECK(ensureCapacity(num, &fh));
+	for (i = 0; i < num; i++)
+	{
+		memset(ph, 0, PAGE_SIZE);
+		sprintf(ph, "%s-%i", "Page", i);
+		TEST_CHECK(writeBlock(i, &fh, ph));
+	}
+	TEST_CHECK(closePageFile(&fh));
+	free(ph);
+}
+
+void
+checkDummyPages(BM_BufferPool *bm, int num)
+{
+	int i;
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	char *expected = malloc(sizeof(char) * 512);
+
+	for (i = 0; i < num; i++)
+	{
+		TEST_CHECK(pinPage(bm, h, i));
+
+		sprintf(expected, "%s-%i", "Changed", i);
+		ASSERT_EQUALS_STRING(expected, h->data, "reading back dummy page content");
+
+		TEST_CHECK(unpinPage(bm,h));
+	}
+
+	free(expected);
+	free(h);
+}
+
+// helper for testConcurrentPins: pins random pages, every other one for writing to
+// increase its counter (kept after the page's "Page-i" text)
+void *
+pinWorker(void *arg)
+{
+	PinWorker *worker = (PinWorker *) arg;
+	BM_PageHandle h;
+	char expected[64];
+	int i, page, counter;
+
+	for (i = 0; i < PINS_PER_THREAD; i++)
+	{
+		page = rand_r(&(worker->seed)) % PIN_PAGES;
+		if (i % 2 == 0)
+		{
+			if (pinPageWithIntent(worker->bm, &h, page, BM_PIN_WRITE) != RC_OK)
+				break;
+			memcpy(&counter, h.data + 64, sizeof(int));
+			counter++;
+			memcpy(h.data + 64, &counter, sizeof(int));
+			worker->increments[page]++;
+			if (markDirty(worker->bm, &h) != RC_OK)
+				break;
+		}
+		else
+		{
+			if (pinPage(worker->bm, &h, page) != RC_OK)
+				break;
+			sprintf(expected, "%s-%i", "Page", page);
+			if (h.pageNum != page || strcmp(expected, h.data) != 0)
+				break;
+		}
+		if (unpinPage(worker->bm, &h) != RC_OK)
+			break;
+	}
+	if (i < PINS_PER_THREAD)
+	{
+		printf("[%s-%s-L%i-%s] FAILED: pin %i of page %i\n", TEST_INFO, i, page);
+		exit(1);
+	}
+	return NULL;
+}
+
+// helper for testHitsBesideMisses, called with the pool lock held: has another thread
+// change a page in the pool and waits for it (HELD_LOCK_WAIT_MS at most)
+RC
+pinWhileFlushing(void *logData, uint64_t lsn)
+{
+	LockedPoolPin *pin = (LockedPoolPin *) logData;
+	uint64_t deadline;
+	struct timespec now, until;
+
+	if (pthread_create(&pin->thread, NULL, lockedPoolPinner, pin) != 0)
+		return RC_WRITE_FAILED;
+	clock_gettime(CLOCK_REALTIME, &now);
+	deadline = (uint64_t) now.tv_sec * 1000000000 + (uint64_t) now.tv_nsec + (uint64_t) HELD_LOCK_WAIT_MS * 1000000;
+	until.tv_sec = (time_t) (deadline / 1000000000);
+	until.tv_nsec = (long) (deadline % 1000000000);
+
+	pthread_mutex_lock(&pin->lock);
+	while (!pin->done && pthread_cond_timedwait(&pin->doneSignal, &pin->lock, &until) == 0)
+		;
+	pin->doneInTime = pin->done;
+	pthread_mutex_unlock(&pin->lock);
+	return RC_OK;
+}
+
+// helper for testCleaner, called by the cleaner with the page taken but not written yet:
+// changes it the first time
+RC
+changeWhileCleaning(void *logData, uint64_t lsn)
+{
+	CleanerRace *race = (CleanerRace *) logData;
+
+	if (race->calls++ == 0)
+		changePage(race->bm, race->pageNum);
+	return RC_OK;
+}
+
+// helper for testHitsBesideMisses: changes the page and says so
+void *
+lockedPoolPinner(void *arg)
+{
+	LockedPoolPin *pin = (LockedPoolPin *) arg;
+
+	changePage(pin->bm, pin->pageNum);
+	pthread_mutex_lock(&pin->lock);
+	pin->done = true;
+	pthread_cond_signal(&pin->doneSignal);
+	pthread_mutex_unlock(&pin->lock);
+	return NULL;
+}
+
+// helper for testHitsBesideMisses: unpins a page another thread pinned
+void *
+unpinFromThread(void *arg)
+{
+	PinHandOver *handOver = (PinHandOver *) arg;
+
+	handOver->result = unpinPage(handOver->bm, handOver->page);
+	return NULL;
+}
+
+// helper to change a page to "Changed-<pageNum>"
+void
+changePage(BM_BufferPool *bm, PageNumber pageNum)
+{
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+
+	TEST_CHECK(pinPage(bm, h, pageNum));
+	sprintf(h->data, "%s-%i", "Changed", pageNum);
+	TEST_CHECK(markDirty(bm, h));
+	TEST_CHECK(unpinPage(bm, h));
+
+	free(h);
+}
+
+// helper to wait until a pool wrote numWrites pages (or CLEANER_WAIT_MS passed); returns
+// the pages it wrote
+int
+waitForWrites(BM_BufferPool *bm, int numWrites)
+{
+	int waited;
+
+	for (waited = 0; waited < CLEANER_WAIT_MS && getNumWriteIO(bm) < numWrites; waited += 10)
+		usleep(10 * 1000);
+	return getNumWriteIO(bm);
+}
+
+// helper to count the dirty frames of a pool
+int
+countDirty(BM_BufferPool *bm)
+{
+	bool *dirtyFlags = getDirtyFlags(bm);
+	int i, count = 0;
+
+	for (i = 0; i < bm->numPages; i++)
+		if (dirtyFlags[i])
+			count++;
+	free(dirtyFlags);
+	return count;
+}
+
+// helper to find the descriptor a pool reads and writes a page file through (-1 if
+// the file is not open)
+int
+pageFileFd(char *fileName)
+{
+	char path[PATH_MAX], link[64], target[PATH_MAX];
+	int fd;
+
+	if (realpath(fileName, path) == NULL)
+		return -1;
+	for (fd = 3; fd < 1024; fd++)
+	{
+		sprintf(link, "/proc/self/fd/%i", fd);
+		ssize_t length = readlink(link, target, sizeof(target) - 1);
+		if (length < 0)
+			continue;
+		target[length] = '\0';
+		if (strcmp(target, path) == 0)
+			return fd;
+	}
+	return -1;
+}
+
+// helper to check whether a page is in a dirty frame of a pool
+bool
+pageDirty(BM_BufferPool *bm, PageNumber pageNum)
+{
+	PageNumber *frameContent = getFrameContents(bm);
+	bool *dirtyFlags = getDirtyFlags(bm);
+	bool dirty = false;
+	int i;
+
+	for (i = 0; i < bm->numPages; i++)
+		if (frameContent[i] == pageNum)
+			dirty = dirtyFlags[i];
+	free(frameContent);
+	free(dirtyFlags);
+	return dirty;
+}
+
+// helper for testOptimisticReads: fills page 5 with one byte value after another, a
+// turn without writing between any two
+void *
+pageRewriter(void *arg)
+{
+	PageRewriter *rewriter = (PageRewriter *) arg;
+	BM_PageHandle h;
+	int turn = 0;
+	char byte;
+
+	while (!rewriter->stop)
+	{
+		if (turn++ % 2 == 0)
+		{
+			sched_yield();
+			continue;
+		}
+		if (pinPageWithIntent(rewriter->bm, &h, 5, BM_PIN_WRITE) != RC_OK)
+		{
+			printf("[%s-%s-L%i-%s] FAILED: write pin of page 5\n", TEST_INFO);
+			exit(1);
+		}
+		byte = 'a' + turn % 26;
+		memset(h.data, byte, PAGE_SIZE / 2);
+		sched_yield();
+		memset(h.data + PAGE_SIZE / 2, byte, PAGE_SIZE / 2);
+		markDirty(rewriter->bm, &h);
+		unpinPage(rewriter->bm, &h);
+	}
+	return NULL;
+}
+
+void
+pinAndUnpin(BM_BufferPool *bm, PageNumber pageNum)
+{
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+
+	TEST_CHECK(pinPage(bm, h, pageNum));
+	TEST_CHECK(unpinPage(bm, h));
+
+	free(h);
+}
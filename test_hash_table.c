@@ -0,0 +1,220 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "hash_table.h"
+#include "dberror.h"
+#include "test_helper.h"
+
+// test name
+char *testName;
+
+/* keys of the model checks range over [-MODEL_KEYS/2, MODEL_KEYS/2) */
+#define MODEL_KEYS 4096
+#define MODEL_STEPS 200000
+
+/* prototypes for test functions */
+static void testSetGetRemove(void);
+static void testGrowth(void);
+static void testRemovalShifts(void);
+static void testAgainstModel(void);
+
+/* prototypes for helpers */
+static bool holdsExactly(HT_TableHandle *ht, int *values, bool *present, int numKeys, int firstKey);
+
+/* main function running all tests */
+int
+main (void)
+{
+	testName = "";
+
+	testSetGetRemove();
+	testGrowth();
+	testRemovalShifts();
+	testAgainstModel();
+
+	return 0;
+}
+
+/* Keys are found until they are removed; setting a key again overwrites its value */
+void
+testSetGetRemove(void)
+{
+	HT_TableHandle ht;
+	int value;
+
+	testName = "test setting, getting and removing keys";
+
+	TEST_CHECK(initHashTable(&ht, 8));
+	ASSERT_TRUE(getValue(&ht, 5, &value) == 1, "missing key not found in an empty table");
+
+	TEST_CHECK(setValue(&ht, 5, 50));
+	TEST_CHECK(setValue(&ht, -7, 70));
+	TEST_CHECK(setValue(&ht, 0, 0));
+	TEST_CHECK(getValue(&ht, 5, &value));
+	ASSERT_EQUALS_INT(50, value, "value of the key");
+	TEST_CHECK(getValue(&ht, -7, &value));
+	ASSERT_EQUALS_INT(70, value, "value of the negative key");
+	TEST_CHECK(getValue(&ht, 0, &value));
+	ASSERT_EQUALS_INT(0, value, "value of the zero key");
+	ASSERT_TRUE(getValue(&ht, 6, &value) == 1, "missing key not found");
+
+	TEST_CHECK(setValue(&ht, 5, 55));
+	TEST_CHECK(getValue(&ht, 5, &value));
+	ASSERT_EQUALS_INT(55, value, "value overwritten");
+
+	TEST_CHECK(removePair(&ht, 5));
+	ASSERT_TRUE(getValue(&ht, 5, &value) == 1, "removed key not found");
+	ASSERT_TRUE(removePair(&ht, 5) == 1, "removed key cannot be removed again");
+	TEST_CHECK(getValue(&ht, -7, &value));
+
+	TEST_CHECK(setValue(&ht, 5, 500));
+	TEST_CHECK(getValue(&ht, 5, &value));
+	ASSERT_EQUALS_INT(500, value, "value of the key added again");
+
+	freeHashTable(&ht);
+	ASSERT_TRUE(ht.mgmt == NULL, "table freed");
+
+	TEST_DONE();
+}
+
+/* The table starts with room for the keys expected and grows past them */
+void
+testGrowth(void)
+{
+	HT_TableHandle ht;
+	int i, value, size;
+	bool found = true;
+
+	testName = "test growing tables";
+
+	TEST_CHECK(initHashTable(&ht, 1000));
+	ASSERT_TRUE(ht.size - ht.size / 8 >= 1000 && (ht.size & (ht.size - 1)) == 0, "room for the keys expected, a power of two");
+	size = ht.size;
+	for (i = 0; i < 1000; i++)
+		setValue(&ht, i * 7919, i);
+	ASSERT_EQUALS_INT(size, ht.size, "no growth for the keys expected");
+	freeHashTable(&ht);
+
+	TEST_CHECK(initHashTable(&ht, 1));
+	size = ht.size;
+	for (i = 0; i < 100000; i++)
+		if (setValue(&ht, i * 7919, i) != 0)
+			found = false;
+	ASSERT_TRUE(found, "every key added");
+	ASSERT_TRUE(ht.size > size && ht.size - ht.size / 8 >= 100000, "table grew with its keys");
+	for (i = 0; i < 100000; i++)
+		if (getValue(&ht, i * 7919, &value) != 0 || value != i)
+			found = false;
+	ASSERT_TRUE(found, "every key found after growing");
+	ASSERT_TRUE(getValue(&ht, 1, &value) == 1, "missing key not found after growing");
+	freeHashTable(&ht);
+
+	TEST_DONE();
+}
+
+/* Removing a key moves the keys probed past it back, so none is lost and removed keys
+   leave no trace behind */
+void
+testRemovalShifts(void)
+{
+	HT_TableHandle ht;
+	int values[MODEL_KEYS];
+	bool present[MODEL_KEYS];
+	int i, round, size, count = 0;
+
+	testName = "test removing keys from full probes";
+
+	// a table filled up to the load that makes it grow, so probes run long
+	TEST_CHECK(initHashTable(&ht, 64));
+	size = ht.size;
+	memset(present, 0, sizeof(present));
+	for (round = 0; round < 50; round++)
+	{
+		for (i = 0; i < MODEL_KEYS && count < size - size / 8; i++)
+		{
+			if (present[i] || (i * 31 + round) % 73 >= 56)
+				continue;
+			values[i] = i + round;
+			setValue(&ht, i, values[i]);
+			present[i] = true;
+			count++;
+		}
+		for (i = round % 3; i < MODEL_KEYS; i += 3)
+			if (present[i])
+			{
+				removePair(&ht, i);
+				present[i] = false;
+				count--;
+			}
+		if (!holdsExactly(&ht, values, present, MODEL_KEYS, 0))
+			break;
+	}
+	ASSERT_TRUE(round == 50, "the keys left are exactly the ones not removed");
+	ASSERT_EQUALS_INT(size, ht.size, "table kept full without growing");
+	freeHashTable(&ht);
+
+	TEST_DONE();
+}
+
+/* Random sets, removals and lookups give what an array of the keys gives */
+void
+testAgainstModel(void)
+{
+	HT_TableHandle ht;
+	int values[MODEL_KEYS];
+	bool present[MODEL_KEYS];
+	int step, key, value, count = 0;
+	bool agrees = true;
+
+	testName = "test random operations against a model";
+
+	srand(42);
+	memset(present, 0, sizeof(present));
+	TEST_CHECK(initHashTable(&ht, 16));
+	for (step = 0; step < MODEL_STEPS && agrees; step++)
+	{
+		key = rand() % MODEL_KEYS;
+		switch (rand() % 3)
+		{
+			case 0:
+				agrees = (setValue(&ht, key - MODEL_KEYS / 2, step) == 0);
+				count += present[key] ? 0 : 1;
+				values[key] = step;
+				present[key] = true;
+				break;
+			case 1:
+				agrees = (removePair(&ht, key - MODEL_KEYS / 2) == (present[key] ? 0 : 1));
+				count -= present[key] ? 1 : 0;
+				present[key] = false;
+				break;
+			default:
+				agrees = (getValue(&ht, key - MODEL_KEYS / 2, &value) == (present[key] ? 0 : 1))
+					&& (!present[key] || value == values[key]);
+				break;
+		}
+	}
+	ASSERT_TRUE(agrees, "every operation agreed with the model");
+	ASSERT_TRUE(count > 0 && count < MODEL_KEYS, "keys both present and missing at the end");
+	ASSERT_TRUE(holdsExactly(&ht, values, present, MODEL_KEYS, -MODEL_KEYS / 2), "table holds the model's keys");
+	freeHashTable(&ht);
+
+	TEST_DONE();
+}
+
+// helper to check that a table holds the present keys with their values and no others;
+// key i of the arrays is firstKey + i
+bool
+holdsExactly(HT_TableHandle *ht, int *values, bool *present, int numKeys, int firstKey)
+{
+	int i, value;
+	for (i = 0; i < numKeys; i++)
+	{
+		if (getValue(ht, firstKey + i, &value) != (present[i] ? 0 : 1))
+			return false;
+		if (present[i] && value != values[i])
+			return false;
+	}
+	return true;
+}
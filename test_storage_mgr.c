@@ -0,0 +1,1072 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "storage_mgr.h"
+#include "lz_codec.h"
+#include "dberror.h"
+#include "test_helper.h"
+
+// test name
+char *testName;
+
+/* test output files */
+#define TESTPF "test_pagefile.bin"
+#define TESTDIR_A "test_stripe_a"
+#define TESTDIR_B "test_stripe_b"
+#define TESTBACKUP "test_backup.bin"
+#define TESTMEM "mem:test_pagefile"
+
+/* threads syncing at once and the syncs each makes */
+#define SYNC_THREADS 4
+#define SYNCS_PER_THREAD 25
+
+/* prototypes for test functions */
+static void testCreateOpenClose(void);
+static void testPositionalReadWrite(void);
+static void testSync(void);
+static void testMultiPageIO(void);
+static void testExtension(void);
+static void testMappedMode(void);
+static void testDirectMode(void);
+static void testAsyncIO(void);
+static void testLzCodec(void);
+static void testCompressedFile(void);
+static void testPageSizes(void);
+static void testSegmentedFile(void);
+static void testIOStats(void);
+static void testSequentialScans(void);
+static void testBackups(void);
+static void testMemoryFiles(void);
+
+/* helper methods */
+static void fillPage(SM_PageHandle page, int pageSize, int value);
+static bool pageHolds(SM_PageHandle page, int pageSize, int value);
+static void fillText(char *page, int pageSize, int seed);
+static void *syncWorker(void *arg);
+
+/* the file the sync workers write to */
+static SM_FileHandle syncFile;
+
+/* main function running all tests */
+int
+main (void)
+{
+	testName = "";
+
+	initStorageManager();
+
+	testCreateOpenClose();
+	testPositionalReadWrite();
+	testSync();
+	testMultiPageIO();
+	testExtension();
+	testMappedMode();
+	testDirectMode();
+	testAsyncIO();
+	testLzCodec();
+	testCompressedFile();
+	testPageSizes();
+	testSegmentedFile();
+	testIOStats();
+	testSequentialScans();
+	testBackups();
+	testMemoryFiles();
+
+	return 0;
+}
+
+
+/* Try to create, open, and close a page file */
+void
+testCreateOpenClose(void)
+{
+	SM_FileHandle fh;
+
+	testName = "test create open and close methods";
+
+	TEST_CHECK(createPageFile (TESTPF));
+
+	TEST_CHECK(openPageFile (TESTPF, &fh));
+	ASSERT_TRUE(strcmp(fh.fileName, TESTPF) == 0, "filename correct");
+	ASSERT_TRUE((fh.totalNumPages == 1), "expect 1 page in new file");
+	ASSERT_TRUE((fh.curPagePos == 0), "freshly opened file's page position should be 0");
+
+	TEST_CHECK(closePageFile (&fh));
+	TEST_CHECK(destroyPageFile (TESTPF));
+
+	// after destruction trying to open the file should cause an error
+	ASSERT_TRUE((openPageFile(TESTPF, &fh) != RC_OK), "opening non-existing file should return an error.");
+
+	TEST_DONE();
+}
+
+/* Write pages at arbitrary positions and read them back in any order */
+void
+testPositionalReadWrite(void)
+{
+	SM_FileHandle fh;
+	SM_PageHandle ph;
+	int i;
+
+	testName = "test reads and writes at any page";
+
+	ph = (SM_PageHandle) malloc(PAGE_SIZE);
+
+	TEST_CHECK(createPageFile (TESTPF));
+	TEST_CHECK(openPageFile (TESTPF, &fh));
+
+	// a new page is empty
+	TEST_CHECK(readFirstBlock (&fh, ph));
+	ASSERT_TRUE(pageHolds(ph, PAGE_SIZE, 0), "expected zero byte in first page of freshly initialized page");
+
+	// write the pages back to front, then read them front to back
+	TEST_CHECK(ensureCapacity(8, &fh));
+	ASSERT_EQUALS_INT(8, fh.totalNumPages, "file grown to 8 pages");
+	for (i = 7; i >= 0; i--)
+	{
+		fillPage(ph, PAGE_SIZE, i + 1);
+		TEST_CHECK(writeBlock(i, &fh, ph));
+	}
+	for (i = 0; i < 8; i++)
+	{
+		TEST_CHECK(readBlock(i, &fh, ph));
+		ASSERT_TRUE(pageHolds(ph, PAGE_SIZE, i + 1), "page read back as written");
+	}
+
+	// the position moves with readNextBlock and readPreviousBlock
+	TEST_CHECK(readNextBlock(&fh, ph));
+	TEST_CHECK(readNextBlock(&fh, ph));
+	ASSERT_EQUALS_INT(2, getBlockPos(&fh), "position after two next blocks");
+	ASSERT_TRUE(pageHolds(ph, PAGE_SIZE, 3), "next block is page 2");
+	TEST_CHECK(readPreviousBlock(&fh, ph));
+	ASSERT_TRUE(pageHolds(ph, PAGE_SIZE, 2), "previous block is page 1");
+	TEST_CHECK(readCurrentBlock(&fh, ph));
+	ASSERT_TRUE(pageHolds(ph, PAGE_SIZE, 2), "current block is page 1");
+	TEST_CHECK(readLastBlock(&fh, ph));
+	ASSERT_TRUE(pageHolds(ph, PAGE_SIZE, 8), "last block");
+	while (readNextBlock(&fh, ph) == RC_OK)
+		;
+	ASSERT_EQUALS_INT(7, getBlockPos(&fh), "next blocks stop at the last page");
+	ASSERT_ERROR(readBlock(8, &fh, ph), "reading past the end fails");
+	ASSERT_ERROR(readBlock(-1, &fh, ph), "reading a negative page fails");
+
+	// the pages are still there after reopening the file
+	TEST_CHECK(closePageFile (&fh));
+	TEST_CHECK(openPageFile (TESTPF, &fh));
+	ASSERT_EQUALS_INT(8, fh.totalNumPages, "page count kept");
+	TEST_CHECK(readBlock(6, &fh, ph));
+	ASSERT_TRUE(pageHolds(ph, PAGE_SIZE, 7), "page kept");
+
+	TEST_CHECK(closePageFile (&fh));
+	TEST_CHECK(destroyPageFile (TESTPF));
+	free(ph);
+
+	TEST_DONE();
+}
+
+/* Writes are only durable after syncPageFile, and syncs made at once share their syscalls */
+void
+testSync(void)
+{
+	SM_IOStats stats;
+	SM_PageHandle ph;
+	pthread_t threads[SYNC_THREADS];
+	long i;
+
+	testName = "test syncing writes";
+
+	ph = (SM_PageHandle) malloc(PAGE_SIZE);
+
+	TEST_CHECK(createPageFile (TESTPF));
+	TEST_CHECK(openPageFile (TESTPF, &syncFile));
+	TEST_CHECK(ensureCapacity(SYNC_THREADS, &syncFile));
+
+	// a write does not sync by itself
+	TEST_CHECK(resetIOStats(&syncFile));
+	fillPage(ph, PAGE_SIZE, 1);
+	TEST_CHECK(writeBlock(0, &syncFile, ph));
+	TEST_CHECK(getIOStats(&syncFile, &stats));
+	ASSERT_TRUE(stats.syscalls[SM_IO_SYNC] == 0, "no sync without syncPageFile");
+
+	TEST_CHECK(syncPageFile(&syncFile));
+	TEST_CHECK(getIOStats(&syncFile, &stats));
+	ASSERT_TRUE(stats.syscalls[SM_IO_SYNC] >= 1, "syncPageFile syncs");
+
+	// with nothing written since, a sync has nothing to do
+	uint64_t syscalls = stats.syscalls[SM_IO_SYNC];
+	TEST_CHECK(syncPageFile(&syncFile));
+	TEST_CHECK(getIOStats(&syncFile, &stats));
+	ASSERT_TRUE(stats.syscalls[SM_IO_SYNC] == syscalls, "a second sync needs no syscall");
+	ASSERT_TRUE(stats.operations[SM_IO_SYNC] == 2, "both syncs are counted");
+
+	// threads writing and syncing at once
+	TEST_CHECK(resetIOStats(&syncFile));
+	for (i = 0; i < SYNC_THREADS; i++)
+		pthread_create(&threads[i], NULL, syncWorker, (void *) i);
+	for (i = 0; i < SYNC_THREADS; i++)
+		pthread_join(threads[i], NULL);
+	TEST_CHECK(getIOStats(&syncFile, &stats));
+	ASSERT_TRUE(stats.operations[SM_IO_SYNC] == SYNC_THREADS * SYNCS_PER_THREAD, "every sync is counted");
+	ASSERT_TRUE(stats.errors[SM_IO_SYNC] == 0, "no sync failed");
+	ASSERT_TRUE(stats.syscalls[SM_IO_SYNC] <= stats.operations[SM_IO_SYNC] * 2, "no more syncs than calls (a sync of the file and its header at most)");
+
+	// each thread's last write is there after reopening
+	TEST_CHECK(closePageFile (&syncFile));
+	TEST_CHECK(openPageFile (TESTPF, &syncFile));
+	for (i = 0; i < SYNC_THREADS; i++)
+	{
+		TEST_CHECK(readBlock(i, &syncFile, ph));
+		ASSERT_TRUE(pageHolds(ph, PAGE_SIZE, SYNCS_PER_THREAD), "last write of the thread kept");
+	}
+
+	TEST_CHECK(closePageFile (&syncFile));
+	TEST_CHECK(destroyPageFile (TESTPF));
+	free(ph);
+
+	TEST_DONE();
+}
+
+/* Several pages move per call, adjacent ones with a single syscall */
+void
+testMultiPageIO(void)
+{
+	SM_FileHandle fh;
+	SM_IOStats stats;
+	SM_PageHandle pages, ph;
+	SM_PageIO list[3];
+	int i;
+
+	testName = "test reading and writing several pages per call";
+
+	pages = (SM_PageHandle) malloc(4 * PAGE_SIZE);
+	ph = (SM_PageHandle) malloc(PAGE_SIZE);
+
+	TEST_CHECK(createPageFile (TESTPF));
+	TEST_CHECK(openPageFile (TESTPF, &fh));
+	TEST_CHECK(ensureCapacity(8, &fh));
+
+	// four adjacent pages with one call and one syscall
+	for (i = 0; i < 4; i++)
+		fillPage(pages + i * PAGE_SIZE, PAGE_SIZE, 10 + i);
+	TEST_CHECK(resetIOStats(&fh));
+	TEST_CHECK(writeBlocks(2, 4, &fh, pages));
+	TEST_CHECK(getIOStats(&fh, &stats));
+	ASSERT_TRUE(stats.pages[SM_IO_WRITE] == 4, "four pages written");
+	ASSERT_TRUE(stats.syscalls[SM_IO_WRITE] == 1, "adjacent pages written with one syscall");
+	for (i = 0; i < 4; i++)
+	{
+		TEST_CHECK(readBlock(2 + i, &fh, ph));
+		ASSERT_TRUE(pageHolds(ph, PAGE_SIZE, 10 + i), "page written by writeBlocks");
+	}
+
+	memset(pages, 0, 4 * PAGE_SIZE);
+	TEST_CHECK(resetIOStats(&fh));
+	TEST_CHECK(readBlocks(2, 4, &fh, pages));
+	TEST_CHECK(getIOStats(&fh, &stats));
+	ASSERT_TRUE(stats.syscalls[SM_IO_READ] == 1, "adjacent pages read with one syscall");
+	for (i = 0; i < 4; i++)
+		ASSERT_TRUE(pageHolds(pages + i * PAGE_SIZE, PAGE_SIZE, 10 + i), "page read by readBlocks");
+
+	// a list of pages in any order: 7 and 0, 1 (one run each)
+	list[0].pageNum = 7;
+	list[1].pageNum = 0;
+	list[2].pageNum = 1;
+	for (i = 0; i < 3; i++)
+	{
+		list[i].memPage = pages + i * PAGE_SIZE;
+		fillPage(list[i].memPage, PAGE_SIZE, 20 + i);
+	}
+	TEST_CHECK(resetIOStats(&fh));
+	TEST_CHECK(writeBlockList(list, 3, &fh));
+	TEST_CHECK(getIOStats(&fh, &stats));
+	ASSERT_TRUE(stats.syscalls[SM_IO_WRITE] == 2, "one syscall per run of adjacent pages");
+	memset(pages, 0, 3 * PAGE_SIZE);
+	TEST_CHECK(readBlockList(list, 3, &fh));
+	for (i = 0; i < 3; i++)
+		ASSERT_TRUE(pageHolds(list[i].memPage, PAGE_SIZE, 20 + i), "page of the list read back");
+
+	// pages past the end are refused as a whole
+	ASSERT_ERROR(readBlocks(6, 4, &fh, pages), "reading past the end fails");
+	ASSERT_ERROR(writeBlocks(-1, 2, &fh, pages), "writing a negative page fails");
+
+	TEST_CHECK(closePageFile (&fh));
+	TEST_CHECK(destroyPageFile (TESTPF));
+	free(pages);
+	free(ph);
+
+	TEST_DONE();
+}
+
+/* Files grow by whole extents, but only the pages asked for count, also after a crash */
+void
+testExtension(void)
+{
+	SM_FileHandle fh, other;
+	SM_IOStats stats;
+	SM_PageHandle ph;
+	int i;
+
+	testName = "test growing files";
+
+	ph = (SM_PageHandle) malloc(PAGE_SIZE);
+
+	TEST_CHECK(createPageFile (TESTPF));
+	TEST_CHECK(openPageFile (TESTPF, &fh));
+
+	// appending page by page takes far fewer syscalls than pages
+	TEST_CHECK(resetIOStats(&fh));
+	for (i = 0; i < 64; i++)
+		TEST_CHECK(appendEmptyBlock(&fh));
+	TEST_CHECK(getIOStats(&fh, &stats));
+	ASSERT_EQUALS_INT(65, fh.totalNumPages, "64 pages appended");
+	ASSERT_TRUE(stats.pages[SM_IO_APPEND] == 64, "every appended page counted");
+	ASSERT_TRUE(stats.syscalls[SM_IO_APPEND] < 64, "the file grows by extents");
+	TEST_CHECK(readBlock(64, &fh, ph));
+	ASSERT_TRUE(pageHolds(ph, PAGE_SIZE, 0), "an appended page is empty");
+
+	// ensureCapacity only grows
+	TEST_CHECK(ensureCapacity(100, &fh));
+	ASSERT_EQUALS_INT(100, fh.totalNumPages, "grown to 100 pages");
+	TEST_CHECK(ensureCapacity(10, &fh));
+	ASSERT_EQUALS_INT(100, fh.totalNumPages, "a smaller capacity changes nothing");
+
+	ASSERT_ERROR(setExtentSize(0, &fh), "an empty extent is refused");
+	ASSERT_ERROR(setExtentSize(SM_MAX_EXTENT_SIZE + 1L, &fh), "too large an extent is refused");
+	TEST_CHECK(setExtentSize(PAGE_SIZE, &fh));
+	TEST_CHECK(appendEmptyBlock(&fh));
+	ASSERT_EQUALS_INT(101, fh.totalNumPages, "appended with one page extents");
+
+	// the page count is on disk once synced: a crash (the file opened again without
+	// closing it) finds the synced count, not the preallocated tail
+	TEST_CHECK(syncPageFile(&fh));
+	TEST_CHECK(ensureCapacity(120, &fh));
+	TEST_CHECK(openPageFile (TESTPF, &other));
+	ASSERT_EQUALS_INT(101, other.totalNumPages, "the synced page count survives a crash");
+	TEST_CHECK(closePageFile (&other));
+
+	TEST_CHECK(closePageFile (&fh));
+	TEST_CHECK(openPageFile (TESTPF, &fh));
+	ASSERT_EQUALS_INT(120, fh.totalNumPages, "closing saves the page count");
+	TEST_CHECK(closePageFile (&fh));
+	TEST_CHECK(destroyPageFile (TESTPF));
+	free(ph);
+
+	TEST_DONE();
+}
+
+/* A mapped file is read and written without syscalls and keeps the plain file format */
+void
+testMappedMode(void)
+{
+	SM_FileHandle fh;
+	SM_IOStats stats;
+	SM_PageHandle ph;
+	int i;
+
+	testName = "test memory-mapped files";
+
+	ph = (SM_PageHandle) malloc(PAGE_SIZE);
+
+	TEST_CHECK(createPageFile (TESTPF));
+	TEST_CHECK(openPageFileWithMode (TESTPF, &fh, SM_MODE_MMAP));
+	TEST_CHECK(ensureCapacity(4, &fh));
+
+	TEST_CHECK(resetIOStats(&fh));
+	for (i = 0; i < 4; i++)
+	{
+		fillPage(ph, PAGE_SIZE, 30 + i);
+		TEST_CHECK(writeBlock(i, &fh, ph));
+	}
+	for (i = 0; i < 4; i++)
+	{
+		TEST_CHECK(readBlock(i, &fh, ph));
+		ASSERT_TRUE(pageHolds(ph, PAGE_SIZE, 30 + i), "page read from the mapping");
+	}
+	TEST_CHECK(getIOStats(&fh, &stats));
+	ASSERT_TRUE(stats.syscalls[SM_IO_READ] == 0 && stats.syscalls[SM_IO_WRITE] == 0, "pages are copied, not read or written");
+
+	// the mapping follows the file as it grows
+	for (i = 0; i < 300; i++)
+		TEST_CHECK(appendEmptyBlock(&fh));
+	fillPage(ph, PAGE_SIZE, 40);
+	TEST_CHECK(writeBlock(303, &fh, ph));
+	TEST_CHECK(syncPageFile(&fh));
+	TEST_CHECK(closePageFile (&fh));
+
+	// the same file read with pread
+	TEST_CHECK(openPageFileWithMode (TESTPF, &fh, SM_MODE_PREAD));
+	ASSERT_EQUALS_INT(304, fh.totalNumPages, "page count of the mapped file");
+	TEST_CHECK(readBlock(2, &fh, ph));
+	ASSERT_TRUE(pageHolds(ph, PAGE_SIZE, 32), "page written through the mapping");
+	TEST_CHECK(readBlock(303, &fh, ph));
+	ASSERT_TRUE(pageHolds(ph, PAGE_SIZE, 40), "page written after the mapping grew");
+	TEST_CHECK(closePageFile (&fh));
+
+	// the default mode applies to openPageFile
+	setDefaultFileMode(SM_MODE_MMAP);
+	TEST_CHECK(openPageFile (TESTPF, &fh));
+	setDefaultFileMode(SM_MODE_PREAD);
+	TEST_CHECK(resetIOStats(&fh));
+	TEST_CHECK(readBlock(303, &fh, ph));
+	TEST_CHECK(getIOStats(&fh, &stats));
+	ASSERT_TRUE(pageHolds(ph, PAGE_SIZE, 40) && stats.syscalls[SM_IO_READ] == 0, "opened mapped by default");
+
+	TEST_CHECK(closePageFile (&fh));
+	TEST_CHECK(destroyPageFile (TESTPF));
+	free(ph);
+
+	TEST_DONE();
+}
+
+/* With O_DIRECT, buffers must be aligned to what the file reports */
+void
+testDirectMode(void)
+{
+	SM_FileHandle fh;
+	SM_PageHandle ph, buffer;
+	int alignment;
+
+	testName = "test direct I/O";
+
+	TEST_CHECK(createPageFile (TESTPF));
+	TEST_CHECK(openPageFileWithMode (TESTPF, &fh, SM_MODE_DIRECT));
+	alignment = getPageFileAlignment(&fh);
+	ASSERT_TRUE(alignment >= 512 && (alignment & (alignment - 1)) == 0, "the alignment is a power of two of at least a sector");
+	ASSERT_TRUE(PAGE_SIZE % alignment == 0, "pages are a multiple of the alignment");
+
+	ASSERT_TRUE(posix_memalign((void **) &buffer, alignment, 2 * PAGE_SIZE) == 0, "aligned buffer allocated");
+	ph = buffer;
+	fillPage(ph, PAGE_SIZE, 50);
+	TEST_CHECK(writeBlock(0, &fh, ph));
+	memset(ph, 0, PAGE_SIZE);
+	TEST_CHECK(readBlock(0, &fh, ph));
+	ASSERT_TRUE(pageHolds(ph, PAGE_SIZE, 50), "page read back with O_DIRECT");
+
+	// a buffer off the alignment is refused
+	ASSERT_EQUALS_INT(RC_IO_MISALIGNED, readBlock(0, &fh, buffer + 1), "misaligned read refused");
+	ASSERT_EQUALS_INT(RC_IO_MISALIGNED, writeBlock(0, &fh, buffer + 1), "misaligned write refused");
+
+	TEST_CHECK(closePageFile (&fh));
+	TEST_CHECK(destroyPageFile (TESTPF));
+	free(buffer);
+
+	TEST_DONE();
+}
+
+/* Asynchronous requests complete once each, with the data and tag they were given */
+void
+testAsyncIO(void)
+{
+	SM_FileHandle fh;
+	SM_Completion completions[8];
+	SM_PageHandle pages;
+	int tags[8], seen[8];
+	int i, done, count;
+
+	testName = "test asynchronous reads and writes";
+
+	pages = (SM_PageHandle) malloc(8 * PAGE_SIZE);
+
+	TEST_CHECK(createPageFile (TESTPF));
+	TEST_CHECK(openPageFile (TESTPF, &fh));
+	TEST_CHECK(ensureCapacity(8, &fh));
+	ASSERT_EQUALS_INT(0, pollCompletions(&fh, completions, 8, 0), "nothing to collect before a request");
+
+	for (i = 0; i < 8; i++)
+	{
+		tags[i] = i;
+		seen[i] = 0;
+		fillPage(pages + i * PAGE_SIZE, PAGE_SIZE, 60 + i);
+		TEST_CHECK(submitWrite(i, &fh, pages + i * PAGE_SIZE, &tags[i]));
+	}
+	for (done = 0; done < 8; done += count)
+	{
+		count = pollCompletions(&fh, completions, 8, 1);
+		ASSERT_TRUE(count >= 1, "waiting collects a completion");
+		for (i = 0; i < count; i++)
+		{
+			int page = *(int *) completions[i].userData;
+			ASSERT_TRUE(completions[i].result == RC_OK && completions[i].write, "write completed");
+			ASSERT_TRUE(completions[i].pageNum == page && completions[i].memPage == pages + page * PAGE_SIZE, "completion of the page submitted");
+			seen[page]++;
+		}
+	}
+	for (i = 0; i < 8; i++)
+		ASSERT_EQUALS_INT(1, seen[i], "every write completed once");
+
+	// read them back into the buffers in reverse order
+	memset(pages, 0, 8 * PAGE_SIZE);
+	for (i = 0; i < 8; i++)
+		TEST_CHECK(submitRead(i, &fh, pages + (7 - i) * PAGE_SIZE, NULL));
+	for (done = 0; done < 8; done += count)
+	{
+		count = pollCompletions(&fh, completions, 8, 1);
+		for (i = 0; i < count; i++)
+			ASSERT_TRUE(completions[i].result == RC_OK && !completions[i].write && completions[i].userData == NULL, "read completed");
+	}
+	for (i = 0; i < 8; i++)
+		ASSERT_TRUE(pageHolds(pages + (7 - i) * PAGE_SIZE, PAGE_SIZE, 60 + i), "page read asynchronously");
+
+	ASSERT_ERROR(submitRead(8, &fh, pages, NULL), "a read past the end is refused");
+
+	TEST_CHECK(closePageFile (&fh));
+	TEST_CHECK(destroyPageFile (TESTPF));
+	free(pages);
+
+	TEST_DONE();
+}
+
+/* The codec gives back what it compressed and rejects input it did not produce */
+void
+testLzCodec(void)
+{
+	char src[PAGE_SIZE], compressed[2 * PAGE_SIZE], out[PAGE_SIZE];
+	char corrupt[3] = {0x00, 0x05, 0x00};  // a match 5 bytes back at the start of the output
+	int length, i, round;
+
+	testName = "test the LZ codec";
+
+	// compressible, incompressible and short inputs all round trip
+	fillText(src, PAGE_SIZE, 1);
+	length = lzCompress(src, PAGE_SIZE, compressed, sizeof(compressed));
+	ASSERT_TRUE(length > 0 && length < PAGE_SIZE / 4, "text compresses");
+	ASSERT_EQUALS_INT(PAGE_SIZE, lzDecompress(compressed, length, out, PAGE_SIZE), "text decompresses");
+	ASSERT_TRUE(memcmp(src, out, PAGE_SIZE) == 0, "text round trip");
+
+	memset(src, 0, PAGE_SIZE);
+	length = lzCompress(src, PAGE_SIZE, compressed, sizeof(compressed));
+	ASSERT_TRUE(length > 0 && length < 64, "an empty page compresses to a few bytes");
+	ASSERT_EQUALS_INT(PAGE_SIZE, lzDecompress(compressed, length, out, PAGE_SIZE), "empty page decompresses");
+	ASSERT_TRUE(memcmp(src, out, PAGE_SIZE) == 0, "empty page round trip");
+
+	srand(42);
+	for (i = 0; i < PAGE_SIZE; i++)
+		src[i] = (char) rand();
+	length = lzCompress(src, PAGE_SIZE, compressed, sizeof(compressed));
+	ASSERT_TRUE(length >= PAGE_SIZE, "random bytes do not compress");
+	ASSERT_EQUALS_INT(PAGE_SIZE, lzDecompress(compressed, length, out, PAGE_SIZE), "random bytes decompress");
+	ASSERT_TRUE(memcmp(src, out, PAGE_SIZE) == 0, "random bytes round trip");
+	ASSERT_EQUALS_INT(-1, lzCompress(src, PAGE_SIZE, compressed, PAGE_SIZE / 2), "output that does not fit is refused");
+
+	length = lzCompress("abc", 3, compressed, sizeof(compressed));
+	ASSERT_EQUALS_INT(3, lzDecompress(compressed, length, out, PAGE_SIZE), "short input round trip");
+	ASSERT_TRUE(memcmp(out, "abc", 3) == 0, "short input content");
+
+	// corrupt input: truncated, pointing before the output, too long for the output
+	fillText(src, PAGE_SIZE, 2);
+	length = lzCompress(src, PAGE_SIZE, compressed, sizeof(compressed));
+	for (i = 1; i <= 5; i++)
+		ASSERT_EQUALS_INT(-1, lzDecompress(compressed, length - i, out, PAGE_SIZE), "truncated input rejected");
+	ASSERT_EQUALS_INT(-1, lzDecompress(corrupt, sizeof(corrupt), out, PAGE_SIZE), "match before the output rejected");
+	ASSERT_EQUALS_INT(-1, lzDecompress(compressed, length, out, PAGE_SIZE - 1), "output larger than the buffer rejected");
+
+	// flipped bytes never make it write past the buffer
+	for (round = 0; round < 1000; round++)
+	{
+		char damaged[2 * PAGE_SIZE];
+		memcpy(damaged, compressed, length);
+		damaged[rand() % length] ^= (char) (1 + rand() % 255);
+		int result = lzDecompress(damaged, length, out, PAGE_SIZE);
+		if (result < -1 || result > PAGE_SIZE)
+		{
+			printf("[%s-%s-L%i-%s] FAILED: damaged input decompressed to %i bytes\n", TEST_INFO, result);
+			exit(1);
+		}
+	}
+	ASSERT_TRUE(true, "damaged input stays within the buffer");
+
+	TEST_DONE();
+}
+
+/* A compressed file stores pages in less space and reads them back as written */
+void
+testCompressedFile(void)
+{
+	SM_FileHandle fh;
+	SM_PageHandle ph;
+	struct stat info;
+	int i;
+
+	testName = "test compressed page files";
+
+	ph = (SM_PageHandle) malloc(PAGE_SIZE);
+
+	TEST_CHECK(createPageFileWithMode (TESTPF, SM_MODE_COMPRESSED));
+	TEST_CHECK(openPageFile (TESTPF, &fh));
+	TEST_CHECK(ensureCapacity(40, &fh));
+	for (i = 0; i < 40; i++)
+	{
+		fillText(ph, PAGE_SIZE, i);
+		TEST_CHECK(writeBlock(i, &fh, ph));
+	}
+
+	// pages that grow and shrink move between slots
+	srand(7);
+	for (i = 0; i < PAGE_SIZE; i++)
+		ph[i] = (char) rand();
+	TEST_CHECK(writeBlock(3, &fh, ph));
+	memset(ph, 0, PAGE_SIZE);
+	TEST_CHECK(writeBlock(5, &fh, ph));
+	TEST_CHECK(closePageFile (&fh));
+
+	ASSERT_TRUE(stat(TESTPF, &info) == 0 && info.st_size < 20 * PAGE_SIZE, "the pages take less room than uncompressed");
+
+	// opened in any mode, the file is read as compressed
+	TEST_CHECK(openPageFileWithMode (TESTPF, &fh, SM_MODE_PREAD));
+	ASSERT_EQUALS_INT(40, fh.totalNumPages, "page count kept");
+	for (i = 0; i < 40; i++)
+	{
+		char expected[PAGE_SIZE];
+		TEST_CHECK(readBlock(i, &fh, ph));
+		if (i == 3)
+		{
+			srand(7);
+			for (int j = 0; j < PAGE_SIZE; j++)
+				expected[j] = (char) rand();
+		}
+		else if (i == 5)
+			memset(expected, 0, PAGE_SIZE);
+		else
+			fillText(expected, PAGE_SIZE, i);
+		ASSERT_TRUE(memcmp(expected, ph, PAGE_SIZE) == 0, "compressed page read back");
+	}
+	TEST_CHECK(closePageFile (&fh));
+
+	TEST_CHECK(destroyPageFile (TESTPF));
+	ASSERT_TRUE(!pageFileExists(TESTPF), "the file and its map are gone");
+	free(ph);
+
+	TEST_DONE();
+}
+
+/* A file keeps the page size it was created with */
+void
+testPageSizes(void)
+{
+	SM_FileHandle fh;
+	SM_PageHandle ph;
+	int sizes[] = {8192, SM_MAX_PAGE_SIZE};
+	int badSizes[] = {0, 1000, PAGE_SIZE + 512, 2 * SM_MAX_PAGE_SIZE};
+	int i, k;
+
+	testName = "test page sizes";
+
+	for (i = 0; i < 4; i++)
+		ASSERT_EQUALS_INT(RC_IM_CONFIG_ERROR, createPageFileWithSize(TESTPF, badSizes[i]), "page size refused");
+
+	TEST_CHECK(createPageFile (TESTPF));
+	TEST_CHECK(openPageFile (TESTPF, &fh));
+	ASSERT_EQUALS_INT(PAGE_SIZE, getPageSize(&fh), "default page size");
+	TEST_CHECK(closePageFile (&fh));
+
+	for (k = 0; k < 2; k++)
+	{
+		int pageSize = sizes[k];
+		ph = (SM_PageHandle) malloc(pageSize);
+
+		TEST_CHECK(createPageFileWithSize (TESTPF, pageSize));
+		TEST_CHECK(openPageFile (TESTPF, &fh));
+		ASSERT_EQUALS_INT(pageSize, getPageSize(&fh), "page size of the new file");
+		TEST_CHECK(ensureCapacity(3, &fh));
+		for (i = 0; i < 3; i++)
+		{
+			fillPage(ph, pageSize, 70 + i);
+			TEST_CHECK(writeBlock(i, &fh, ph));
+		}
+		TEST_CHECK(closePageFile (&fh));
+
+		// the size comes from the file, whatever is asked when it is opened
+		TEST_CHECK(openPageFileWithMode (TESTPF, &fh, SM_MODE_MMAP));
+		ASSERT_EQUALS_INT(pageSize, getPageSize(&fh), "page size read from the header");
+		ASSERT_EQUALS_INT(3, fh.totalNumPages, "pages of the larger size counted");
+		for (i = 0; i < 3; i++)
+		{
+			TEST_CHECK(readBlock(i, &fh, ph));
+			ASSERT_TRUE(pageHolds(ph, pageSize, 70 + i), "whole large page read back");
+		}
+		TEST_CHECK(closePageFile (&fh));
+		TEST_CHECK(destroyPageFile (TESTPF));
+		free(ph);
+	}
+
+	TEST_DONE();
+}
+
+/* A segmented file spreads its pages over segment files striped across directories */
+void
+testSegmentedFile(void)
+{
+	SM_FileHandle fh, other;
+	SM_PageHandle pages, ph;
+	char *dirs[] = {TESTDIR_A, TESTDIR_B};
+	struct stat info;
+	int i;
+
+	testName = "test segmented page files";
+
+	pages = (SM_PageHandle) malloc(4 * PAGE_SIZE);
+	ph = (SM_PageHandle) malloc(PAGE_SIZE);
+	mkdir(TESTDIR_A, 0755);
+	mkdir(TESTDIR_B, 0755);
+
+	// 4 pages per segment: pages 4-7 go to a/.1, 8-11 to b/.2, 12-13 to a/.3
+	TEST_CHECK(createSegmentedPageFile (TESTPF, PAGE_SIZE, 4, dirs, 2));
+	TEST_CHECK(openPageFile (TESTPF, &fh));
+	TEST_CHECK(ensureCapacity(14, &fh));
+	for (i = 0; i < 14; i++)
+	{
+		fillPage(ph, PAGE_SIZE, 80 + i);
+		TEST_CHECK(writeBlock(i, &fh, ph));
+	}
+	ASSERT_TRUE(stat(TESTDIR_A "/" TESTPF ".1", &info) == 0 && stat(TESTDIR_A "/" TESTPF ".3", &info) == 0, "odd segments in the first directory");
+	ASSERT_TRUE(stat(TESTDIR_B "/" TESTPF ".2", &info) == 0, "even segments in the second directory");
+
+	// a run across a segment boundary
+	for (i = 0; i < 4; i++)
+		fillPage(pages + i * PAGE_SIZE, PAGE_SIZE, 100 + i);
+	TEST_CHECK(writeBlocks(6, 4, &fh, pages));
+	memset(pages, 0, 4 * PAGE_SIZE);
+	TEST_CHECK(readBlocks(5, 4, &fh, pages));
+	ASSERT_TRUE(pageHolds(pages, PAGE_SIZE, 85), "page before the run");
+	for (i = 1; i < 4; i++)
+		ASSERT_TRUE(pageHolds(pages + i * PAGE_SIZE, PAGE_SIZE, 99 + i), "page of the run across segments");
+
+	// the synced page count survives a crash in a segmented file too
+	TEST_CHECK(syncPageFile(&fh));
+	TEST_CHECK(ensureCapacity(17, &fh));
+	TEST_CHECK(openPageFile (TESTPF, &other));
+	ASSERT_EQUALS_INT(14, other.totalNumPages, "synced page count of a segmented file");
+	TEST_CHECK(closePageFile (&other));
+	TEST_CHECK(closePageFile (&fh));
+
+	// the layout is found again from the header
+	TEST_CHECK(openPageFile (TESTPF, &fh));
+	ASSERT_EQUALS_INT(17, fh.totalNumPages, "page count of the segmented file");
+	TEST_CHECK(readBlock(13, &fh, ph));
+	ASSERT_TRUE(pageHolds(ph, PAGE_SIZE, 93), "page in the last written segment");
+	TEST_CHECK(readBlock(16, &fh, ph));
+	ASSERT_TRUE(pageHolds(ph, PAGE_SIZE, 0), "page added before closing is empty");
+	TEST_CHECK(closePageFile (&fh));
+
+	TEST_CHECK(destroyPageFile (TESTPF));
+	ASSERT_TRUE(stat(TESTDIR_A "/" TESTPF ".1", &info) != 0 && stat(TESTDIR_B "/" TESTPF ".2", &info) != 0, "the segments are destroyed with the file");
+	ASSERT_TRUE(rmdir(TESTDIR_A) == 0 && rmdir(TESTDIR_B) == 0, "nothing left in the directories");
+	free(pages);
+	free(ph);
+
+	TEST_DONE();
+}
+
+/* Every call is counted per kind, with its pages, bytes, errors and latency */
+void
+testIOStats(void)
+{
+	SM_FileHandle fh;
+	SM_IOStats stats;
+	SM_PageHandle ph;
+	uint64_t inHistogram;
+	int i, type;
+
+	testName = "test I/O statistics";
+
+	ph = (SM_PageHandle) calloc(1, PAGE_SIZE);
+
+	TEST_CHECK(createPageFile (TESTPF));
+	TEST_CHECK(openPageFile (TESTPF, &fh));
+	TEST_CHECK(ensureCapacity(10, &fh));
+	TEST_CHECK(resetIOStats(&fh));
+	TEST_CHECK(getIOStats(&fh, &stats));
+	for (type = 0; type < SM_IO_NUM_TYPES; type++)
+		ASSERT_TRUE(stats.operations[type] == 0 && stats.totalNanos[type] == 0, "counters reset");
+
+	for (i = 0; i < 10; i++)
+		TEST_CHECK(writeBlock(i, &fh, ph));
+	for (i = 0; i < 5; i++)
+		TEST_CHECK(readBlock(i, &fh, ph));
+	ASSERT_ERROR(readBlock(20, &fh, ph), "read past the end");
+	TEST_CHECK(appendEmptyBlock(&fh));
+	TEST_CHECK(syncPageFile(&fh));
+
+	TEST_CHECK(getIOStats(&fh, &stats));
+	ASSERT_TRUE(stats.operations[SM_IO_WRITE] == 10 && stats.pages[SM_IO_WRITE] == 10, "writes counted");
+	ASSERT_TRUE(stats.bytes[SM_IO_WRITE] == 10 * PAGE_SIZE, "bytes written counted");
+	ASSERT_TRUE(stats.operations[SM_IO_READ] == 6 && stats.pages[SM_IO_READ] == 5, "reads counted, the failed one without pages");
+	ASSERT_TRUE(stats.errors[SM_IO_READ] == 1 && stats.errors[SM_IO_WRITE] == 0, "the failed read counted as an error");
+	ASSERT_TRUE(stats.operations[SM_IO_APPEND] == 1 && stats.pages[SM_IO_APPEND] == 1, "append counted");
+	ASSERT_TRUE(stats.operations[SM_IO_SYNC] == 1, "sync counted");
+
+	// every call lands in one latency bucket, and the percentiles are bucket bounds
+	for (type = 0; type < SM_IO_NUM_TYPES; type++)
+	{
+		inHistogram = 0;
+		for (i = 0; i < SM_LATENCY_BUCKETS; i++)
+			inHistogram += stats.latency[type][i];
+		ASSERT_TRUE(inHistogram == stats.operations[type], "one latency sample per call");
+	}
+	ASSERT_TRUE(stats.totalNanos[SM_IO_WRITE] > 0, "time spent writing measured");
+	uint64_t median = getIOLatencyPercentile(&stats, SM_IO_WRITE, 50);
+	uint64_t tail = getIOLatencyPercentile(&stats, SM_IO_WRITE, 99);
+	ASSERT_TRUE(median > 0 && (median & (median - 1)) == 0, "percentile is a power of two");
+	ASSERT_TRUE(median <= tail, "percentiles grow");
+	ASSERT_TRUE(getIOLatencyPercentile(&stats, SM_IO_APPEND, 50) > 0, "percentile of a single sample");
+
+	// counters are per file handle
+	TEST_CHECK(closePageFile (&fh));
+	TEST_CHECK(openPageFile (TESTPF, &fh));
+	TEST_CHECK(getIOStats(&fh, &stats));
+	ASSERT_TRUE(stats.operations[SM_IO_WRITE] == 0, "a new handle starts from zero");
+
+	TEST_CHECK(closePageFile (&fh));
+	TEST_CHECK(destroyPageFile (TESTPF));
+	free(ph);
+
+	TEST_DONE();
+}
+
+/* Scans with readNextBlock / readPreviousBlock read every page right while reading ahead */
+void
+testSequentialScans(void)
+{
+	SM_FileHandle fh;
+	SM_PageHandle ph;
+	int i;
+
+	testName = "test sequential scans";
+
+	ph = (SM_PageHandle) malloc(PAGE_SIZE);
+
+	TEST_CHECK(createPageFile (TESTPF));
+	TEST_CHECK(openPageFile (TESTPF, &fh));
+	TEST_CHECK(ensureCapacity(2 * SM_MAX_READAHEAD, &fh));
+	for (i = 0; i < fh.totalNumPages; i++)
+	{
+		fillPage(ph, PAGE_SIZE, i % 128);
+		TEST_CHECK(writeBlock(i, &fh, ph));
+	}
+
+	// forwards to the end, backwards to the start, then forwards again from the middle
+	TEST_CHECK(readFirstBlock(&fh, ph));
+	for (i = 1; i < fh.totalNumPages; i++)
+	{
+		TEST_CHECK(readNextBlock(&fh, ph));
+		if (!pageHolds(ph, PAGE_SIZE, i % 128))
+			ASSERT_TRUE(false, "page of a forward scan");
+	}
+	ASSERT_ERROR(readNextBlock(&fh, ph), "a forward scan ends at the last page");
+	for (i = fh.totalNumPages - 2; i >= 0; i--)
+	{
+		TEST_CHECK(readPreviousBlock(&fh, ph));
+		if (!pageHolds(ph, PAGE_SIZE, i % 128))
+			ASSERT_TRUE(false, "page of a backward scan");
+	}
+	ASSERT_ERROR(readPreviousBlock(&fh, ph), "a backward scan ends at the first page");
+	ASSERT_TRUE(true, "every page of both scans read right");
+
+	TEST_CHECK(closePageFile (&fh));
+	TEST_CHECK(destroyPageFile (TESTPF));
+	free(ph);
+
+	TEST_DONE();
+}
+
+/* Backups copy every page, then only the pages written or added since the last one */
+void
+testBackups(void)
+{
+	SM_FileHandle fh, crashed, backup;
+	SM_PageHandle ph;
+	int copied, i;
+
+	testName = "test full and incremental backups";
+
+	ph = (SM_PageHandle) malloc(PAGE_SIZE);
+	destroyPageFile(TESTBACKUP);
+
+	TEST_CHECK(createPageFile (TESTPF));
+	TEST_CHECK(openPageFile (TESTPF, &fh));
+	TEST_CHECK(ensureCapacity(100, &fh));
+	for (i = 0; i < 100; i++)
+	{
+		fillPage(ph, PAGE_SIZE, i);
+		TEST_CHECK(writeBlock(i, &fh, ph));
+	}
+
+	// there is nothing to bring up to date before the first full backup
+	ASSERT_EQUALS_INT(RC_IM_CONFIG_ERROR, backupPageFileIncremental(&fh, TESTBACKUP, &copied), "incremental backup needs a full one");
+
+	// a full backup holds every page
+	TEST_CHECK(backupPageFile(&fh, TESTBACKUP));
+	TEST_CHECK(openPageFile (TESTBACKUP, &backup));
+	ASSERT_EQUALS_INT(100, backup.totalNumPages, "page count of the full backup");
+	for (i = 0; i < 100; i++)
+	{
+		TEST_CHECK(readBlock(i, &backup, ph));
+		if (!pageHolds(ph, PAGE_SIZE, i))
+			ASSERT_TRUE(false, "page of the full backup");
+	}
+	TEST_CHECK(closePageFile (&backup));
+
+	// an incremental backup copies the pages written since, each once
+	for (i = 0; i < 20; i++)
+	{
+		fillPage(ph, PAGE_SIZE, 100 + i);
+		TEST_CHECK(writeBlock(i * 5, &fh, ph));
+	}
+	TEST_CHECK(writeBlock(95, &fh, ph));  // written twice, copied once
+	TEST_CHECK(backupPageFileIncremental(&fh, TESTBACKUP, &copied));
+	ASSERT_EQUALS_INT(20, copied, "pages copied by the incremental backup");
+	TEST_CHECK(backupPageFileIncremental(&fh, TESTBACKUP, &copied));
+	ASSERT_EQUALS_INT(0, copied, "nothing written since the last backup");
+
+	// pages added since the last backup are copied, and the backup grows with them
+	fillPage(ph, PAGE_SIZE, 7);
+	TEST_CHECK(appendEmptyBlock(&fh));
+	TEST_CHECK(writeBlock(100, &fh, ph));
+	TEST_CHECK(backupPageFileIncremental(&fh, TESTBACKUP, &copied));
+	ASSERT_EQUALS_INT(1, copied, "added page copied");
+
+	// the pages written are known after the file is closed and opened again
+	TEST_CHECK(writeBlock(3, &fh, ph));
+	TEST_CHECK(writeBlock(4, &fh, ph));
+	TEST_CHECK(closePageFile (&fh));
+	TEST_CHECK(openPageFile (TESTPF, &fh));
+	TEST_CHECK(backupPageFileIncremental(&fh, TESTBACKUP, &copied));
+	ASSERT_EQUALS_INT(2, copied, "pages written before the file was closed");
+
+	TEST_CHECK(openPageFile (TESTBACKUP, &backup));
+	ASSERT_EQUALS_INT(101, backup.totalNumPages, "page count of the backup after the file grew");
+	for (i = 0; i < 101; i++)
+	{
+		TEST_CHECK(readBlock(i, &backup, ph));
+		if (!pageHolds(ph, PAGE_SIZE, (i == 3 || i == 4 || i == 100) ? 7 : (i % 5 == 0) ? 100 + i / 5 : i))
+			ASSERT_TRUE(false, "page of the incremental backup");
+	}
+	ASSERT_TRUE(true, "backup matches the file");
+	TEST_CHECK(closePageFile (&backup));
+
+	// after a crash (the file opened again without closing it) every page is copied
+	TEST_CHECK(openPageFile (TESTPF, &crashed));
+	TEST_CHECK(backupPageFileIncremental(&crashed, TESTBACKUP, &copied));
+	ASSERT_EQUALS_INT(101, copied, "every page copied after a crash");
+	TEST_CHECK(closePageFile (&crashed));
+
+	TEST_CHECK(closePageFile (&fh));
+	TEST_CHECK(destroyPageFile (TESTPF));
+	TEST_CHECK(destroyPageFile (TESTBACKUP));
+	ASSERT_TRUE(access(TESTPF ".chg", F_OK) != 0, "changes destroyed with the file");
+	free(ph);
+
+	TEST_DONE();
+}
+
+/* Files named mem:... live in memory until they are destroyed */
+void
+testMemoryFiles(void)
+{
+	SM_FileHandle fh, second;
+	SM_IOStats stats;
+	SM_PageHandle ph;
+	int i;
+
+	testName = "test page files in memory";
+
+	ph = (SM_PageHandle) malloc(PAGE_SIZE);
+
+	ASSERT_TRUE(!pageFileExists(TESTMEM), "no memory file before it is created");
+	TEST_CHECK(createPageFile (TESTMEM));
+	ASSERT_TRUE(pageFileExists(TESTMEM), "memory file exists once created");
+	ASSERT_TRUE(access(TESTMEM, F_OK) != 0, "nothing created on disk");
+
+	TEST_CHECK(openPageFile (TESTMEM, &fh));
+	ASSERT_EQUALS_INT(1, fh.totalNumPages, "new memory file has one page");
+	TEST_CHECK(readBlock(0, &fh, ph));
+	ASSERT_TRUE(pageHolds(ph, PAGE_SIZE, 0), "new page is empty");
+	TEST_CHECK(ensureCapacity(50, &fh));
+	TEST_CHECK(resetIOStats(&fh));
+	for (i = 0; i < 50; i++)
+	{
+		fillPage(ph, PAGE_SIZE, i);
+		TEST_CHECK(writeBlock(i, &fh, ph));
+	}
+	TEST_CHECK(syncPageFile(&fh));
+	TEST_CHECK(getIOStats(&fh, &stats));
+	ASSERT_TRUE(stats.syscalls[SM_IO_WRITE] == 0 && stats.syscalls[SM_IO_SYNC] == 0, "no system calls for a memory file");
+	ASSERT_ERROR(readBlock(50, &fh, ph), "reading past the end of a memory file");
+	TEST_CHECK(closePageFile (&fh));
+
+	// the pages outlive the handle, and every handle sees the same pages
+	TEST_CHECK(openPageFile (TESTMEM, &fh));
+	TEST_CHECK(openPageFile (TESTMEM, &second));
+	ASSERT_EQUALS_INT(50, fh.totalNumPages, "page count kept after closing");
+	fillPage(ph, PAGE_SIZE, 99);
+	TEST_CHECK(writeBlock(7, &second, ph));
+	for (i = 0; i < 50; i++)
+	{
+		TEST_CHECK(readBlock(i, &fh, ph));
+		if (!pageHolds(ph, PAGE_SIZE, (i == 7) ? 99 : i))
+			ASSERT_TRUE(false, "page of the memory file");
+	}
+	ASSERT_TRUE(true, "pages kept after closing");
+	TEST_CHECK(closePageFile (&second));
+	TEST_CHECK(closePageFile (&fh));
+
+	TEST_CHECK(destroyPageFile (TESTMEM));
+	ASSERT_TRUE(!pageFileExists(TESTMEM), "memory file gone once destroyed");
+	ASSERT_EQUALS_INT(RC_FILE_NOT_FOUND, openPageFile (TESTMEM, &fh), "destroyed memory file cannot be opened");
+	free(ph);
+
+	TEST_DONE();
+}
+
+// helper for testSync: writes its page and syncs it, SYNCS_PER_THREAD times
+void *
+syncWorker(void *arg)
+{
+	int page = (int) (long) arg;
+	SM_PageHandle ph = (SM_PageHandle) malloc(PAGE_SIZE);
+	int i;
+
+	for (i = 1; i <= SYNCS_PER_THREAD; i++)
+	{
+		fillPage(ph, PAGE_SIZE, i);
+		if (writeBlock(page, &syncFile, ph) != RC_OK || syncPageFile(&syncFile) != RC_OK)
+		{
+			printf("[%s-%s-L%i-%s] FAILED: write or sync of page %i\n", TEST_INFO, page);
+			exit(1);
+		}
+	}
+	free(ph);
+	return NULL;
+}
+
+// helper to fill a page with a byte value
+void
+fillPage(SM_PageHandle page, int pageSize, int value)
+{
+	memset(page, value, pageSize);
+}
+
+// helper to fill a page with text that compresses well (different for every seed)
+void
+fillText(char *page, int pageSize, int seed)
+{
+	int i;
+	for (i = 0; i < pageSize; i++)
+		page[i] = "record-"[i % 7] + (char) ((i / 256 + seed) % 3);
+}
+
+// helper to check that every byte of a page has a value
+bool
+pageHolds(SM_PageHandle page, int pageSize, int value)
+{
+	int i;
+	for (i = 0; i < pageSize; i++)
+		if (page[i] != (char) value)
+			return false;
+	return true;
+}
@@ -0,0 +1,311 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "dberror.h"
+#include "expr.h"
+#include "record_mgr.h"
+#include "storage_mgr.h"
+#include "tables.h"
+#include "wal.h"
+#include "test_helper.h"
+
+// test name
+char *testName;
+
+/* test output files */
+#define TESTLOG "test_wal_log.wal"
+#define TESTDB "test_wal_db.bin"
+#define TESTDB_LOG "test_wal_db.bin.wal"
+
+/* the pages the log is applied to: a stand-in for a page file */
+#define NUM_TEST_PAGES 4
+#define TEST_PAGE_SIZE 64
+static char testPages[NUM_TEST_PAGES][TEST_PAGE_SIZE];
+
+// test methods
+static void testCommitAndAbort (void);
+static void testCrashRecovery (void);
+static void testRecordManagerRecovery (void);
+
+// helper methods
+static RC applyToTestPages (void *applyData, int pageNum, int offset, const void *data, int length, WAL_LSN lsn);
+static void logChange (WAL_Log *log, WAL_Txn *txn, int pageNum, char *after, WAL_LSN *lsn);
+static void crashInChild (void (*work)(void));
+static void crashWithOpenTransaction (void);
+static void crashAfterRecordChanges (void);
+static Schema *testSchema (void);
+static Record *testRecord (Schema *schema, int a, char *b);
+
+// main method
+int
+main (void)
+{
+	testName = "";
+
+	initStorageManager();
+
+	testCommitAndAbort();
+	testCrashRecovery();
+	testRecordManagerRecovery();
+
+	return 0;
+}
+
+// ************************************************************
+void
+testCommitAndAbort (void)
+{
+	WAL_Log *log;
+	WAL_Txn *txn;
+	WAL_LSN first, second;
+
+	testName = "test committing and rolling back log transactions";
+
+	memset(testPages, 0, sizeof(testPages));
+	TEST_CHECK(walCreate(TESTLOG));
+	TEST_CHECK(walOpen(TESTLOG, &log));
+
+	// a committed change stays
+	TEST_CHECK(walBegin(log, &txn));
+	logChange(log, txn, 0, "one", &first);
+	TEST_CHECK(walCommit(log, txn));
+	ASSERT_EQUALS_STRING("one", testPages[0], "committed change kept");
+
+	// a rolled back transaction is undone newest change first
+	TEST_CHECK(walBegin(log, &txn));
+	logChange(log, txn, 0, "two", &second);
+	logChange(log, txn, 0, "three", &second);
+	logChange(log, txn, 1, "four", &second);
+	ASSERT_TRUE(second > first, "LSNs grow");
+	TEST_CHECK(walAbort(log, txn, applyToTestPages, NULL));
+	ASSERT_EQUALS_STRING("one", testPages[0], "page back to its committed state");
+	ASSERT_EQUALS_STRING("", testPages[1], "changed page back to empty");
+
+	TEST_CHECK(walFlush(log, second));
+	TEST_CHECK(walClose(log));
+	remove(TESTLOG);
+
+	TEST_DONE();
+}
+
+// ************************************************************
+void
+testCrashRecovery (void)
+{
+	WAL_Log *log;
+
+	testName = "test recovering the pages after a crash";
+
+	TEST_CHECK(walCreate(TESTLOG));
+	crashInChild(crashWithOpenTransaction);
+
+	// the pages as the crash left them on disk: the committed change never got
+	// there, the change that never committed did
+	memset(testPages, 0, sizeof(testPages));
+	strcpy(testPages[2], "uncommitted");
+
+	TEST_CHECK(walOpen(TESTLOG, &log));
+	TEST_CHECK(walRecover(log, applyToTestPages, NULL));
+	ASSERT_EQUALS_STRING("committed", testPages[1], "committed change redone");
+	ASSERT_EQUALS_STRING("", testPages[2], "uncommitted change undone");
+	ASSERT_EQUALS_STRING("", testPages[3], "change of a rolled back transaction not redone");
+	TEST_CHECK(walClose(log));
+
+	// recovering again (a crash during recovery) gives the same pages
+	TEST_CHECK(walOpen(TESTLOG, &log));
+	TEST_CHECK(walRecover(log, applyToTestPages, NULL));
+	ASSERT_EQUALS_STRING("committed", testPages[1], "committed change after recovering twice");
+	ASSERT_EQUALS_STRING("", testPages[2], "uncommitted change after recovering twice");
+	TEST_CHECK(walClose(log));
+	remove(TESTLOG);
+
+	TEST_DONE();
+}
+
+// ************************************************************
+void
+testRecordManagerRecovery (void)
+{
+	RM_TableData *table = (RM_TableData *) malloc(sizeof(RM_TableData));
+	RM_ScanHandle *scan = (RM_ScanHandle *) malloc(sizeof(RM_ScanHandle));
+	Schema *schema = testSchema();
+	Record *r;
+	Value *value;
+	int seen[6] = {0, 0, 0, 0, 0, 0};
+	int count = 0;
+	RC rc;
+
+	testName = "test recovering tables after a crash";
+
+	destroyPageFile(TESTDB);
+	remove(TESTDB_LOG);
+	crashInChild(crashAfterRecordChanges);
+
+	// the operations that returned before the crash are all there
+	TEST_CHECK(initRecordManager(TESTDB));
+	TEST_CHECK(openTable(table, "test_table_wal"));
+	ASSERT_EQUALS_INT(4, getNumTuples(table), "tuple count recovered");
+
+	TEST_CHECK(createRecord(&r, schema));
+	TEST_CHECK(startScan(table, scan, NULL));
+	while ((rc = next(scan, r)) == RC_OK)
+	{
+		getAttr(r, schema, 0, &value);
+		ASSERT_TRUE(value->v.intV >= 1 && value->v.intV <= 5, "recovered record is one inserted");
+		seen[value->v.intV]++;
+		count++;
+		if (value->v.intV == 2)
+		{
+			freeVal(value);
+			getAttr(r, schema, 1, &value);
+			ASSERT_EQUALS_STRING("upd2", value->v.stringV, "update recovered");
+		}
+		freeVal(value);
+	}
+	ASSERT_EQUALS_INT(RC_RM_NO_MORE_TUPLES, rc, "scan ended");
+	TEST_CHECK(closeScan(scan));
+	ASSERT_EQUALS_INT(4, count, "four records recovered");
+	ASSERT_TRUE(seen[1] == 1 && seen[2] == 1 && seen[3] == 0 && seen[4] == 1 && seen[5] == 1, "the deleted record stays deleted");
+
+	TEST_CHECK(freeRecord(r));
+	TEST_CHECK(closeTable(table));
+	TEST_CHECK(shutdownRecordManager());
+	TEST_CHECK(destroyPageFile(TESTDB));
+	remove(TESTDB_LOG);
+
+	free(scan);
+	free(table);
+	freeSchema(schema);
+	TEST_DONE();
+}
+
+// helper that puts logged bytes into the test pages
+RC
+applyToTestPages (void *applyData, int pageNum, int offset, const void *data, int length, WAL_LSN lsn)
+{
+	if (pageNum < 0 || pageNum >= NUM_TEST_PAGES || offset < 0 || offset + length > TEST_PAGE_SIZE)
+		return RC_WRITE_FAILED;
+	memcpy(testPages[pageNum] + offset, data, length);
+	return RC_OK;
+}
+
+// helper to log a change of a test page to `after` (with its terminator) and make it
+void
+logChange (WAL_Log *log, WAL_Txn *txn, int pageNum, char *after, WAL_LSN *lsn)
+{
+	char image[TEST_PAGE_SIZE];
+	memset(image, 0, sizeof(image));
+	strcpy(image, after);
+	TEST_CHECK(walWrite(log, txn, pageNum, 0, testPages[pageNum], image, TEST_PAGE_SIZE, lsn));
+	memcpy(testPages[pageNum], image, TEST_PAGE_SIZE);
+}
+
+// helper to run `work` in a child process that ends without closing anything, as a
+// crash would, and to wait for it
+void
+crashInChild (void (*work)(void))
+{
+	int status;
+	pid_t child = fork();
+	if (child == 0)
+	{
+		work();
+		_exit(0);
+	}
+	ASSERT_TRUE(child > 0 && waitpid(child, &status, 0) == child, "crashing process ran");
+	ASSERT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0, "crashing process did its work");
+}
+
+// the work before the crash of testCrashRecovery: a committed change, a rolled back
+// one and one whose transaction is still open, made durable by a flush of the log
+void
+crashWithOpenTransaction (void)
+{
+	WAL_Log *log;
+	WAL_Txn *txn;
+	WAL_LSN lsn;
+
+	memset(testPages, 0, sizeof(testPages));
+	TEST_CHECK(walOpen(TESTLOG, &log));
+	TEST_CHECK(walBegin(log, &txn));
+	logChange(log, txn, 1, "committed", &lsn);
+	TEST_CHECK(walCommit(log, txn));
+
+	TEST_CHECK(walBegin(log, &txn));
+	logChange(log, txn, 3, "rolled back", &lsn);
+	TEST_CHECK(walAbort(log, txn, applyToTestPages, NULL));
+
+	TEST_CHECK(walBegin(log, &txn));
+	logChange(log, txn, 2, "uncommitted", &lsn);
+	TEST_CHECK(walFlush(log, lsn));
+}
+
+// the work before the crash of testRecordManagerRecovery: five inserts, a delete and
+// an update, with none of the changed pages forced to the page file
+void
+crashAfterRecordChanges (void)
+{
+	RM_TableData table;
+	Schema *schema = testSchema();
+	RID rids[5];
+	Record *r;
+	int i;
+
+	TEST_CHECK(initRecordManager(TESTDB));
+	TEST_CHECK(createTable("test_table_wal", schema));
+	TEST_CHECK(openTable(&table, "test_table_wal"));
+	for (i = 0; i < 5; i++)
+	{
+		r = testRecord(schema, i + 1, "orig");
+		TEST_CHECK(insertRecord(&table, r));
+		rids[i] = r->id;
+		freeRecord(r);
+	}
+	TEST_CHECK(deleteRecord(&table, rids[2]));
+	r = testRecord(schema, 2, "upd2");
+	r->id = rids[1];
+	TEST_CHECK(updateRecord(&table, r));
+	freeRecord(r);
+}
+
+// a schema of an int key and a 4 character string
+Schema *
+testSchema (void)
+{
+	char **names = (char **) malloc(sizeof(char *) * 2);
+	DataType *dataTypes = (DataType *) malloc(sizeof(DataType) * 2);
+	int *sizes = (int *) malloc(sizeof(int) * 2);
+	int *keys = (int *) malloc(sizeof(int));
+
+	names[0] = strdup("a");
+	names[1] = strdup("b");
+	dataTypes[0] = DT_INT;
+	dataTypes[1] = DT_STRING;
+	sizes[0] = 0;
+	sizes[1] = 4;
+	keys[0] = 0;
+
+	return createSchema(2, names, dataTypes, sizes, 1, keys);
+}
+
+Record *
+testRecord (Schema *schema, int a, char *b)
+{
+	Record *result;
+	Value *value;
+
+	TEST_CHECK(createRecord(&result, schema));
+
+	MAKE_VALUE(value, DT_INT, a);
+	TEST_CHECK(setAttr(result, schema, 0, value));
+	freeVal(value);
+
+	MAKE_STRING_VALUE(value, b);
+	TEST_CHECK(setAttr(result, schema, 1, value));
+	freeVal(value);
+
+	return result;
+}
@@ -0,0 +1,837 @@
+#define _GNU_SOURCE
+
+#include "wal.h"
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+/* Additional Definitions */
+
+// the log file starts with a header, records follow it back to back
+#define WAL_HEADER_SIZE 512
+#define WAL_MAGIC "SMWALLOG"
+#define WAL_VERSION 1
+
+typedef struct WAL_FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t unused;
+    // the LSN of the first record in the file (the byte right after the header)
+    WAL_LSN baseLSN;
+    // where recovery starts, set by walCheckpoint
+    WAL_LSN redoLSN;
+} WAL_FileHeader;
+
+typedef enum WAL_RecordType {
+    WAL_WRITE = 1,
+    WAL_COMMIT = 2,
+    WAL_ABORT = 3,
+    WAL_CHECKPOINT = 4
+} WAL_RecordType;
+
+typedef struct WAL_Record {
+    // of the whole record, header included
+    uint32_t length;
+    // CRC-32 of everything after this field (a torn record at the end fails it)
+    uint32_t checksum;
+    uint64_t txnId;
+    uint16_t type;
+    uint16_t unused;
+    // WAL_WRITE only: the changed bytes, followed by their before and after image
+    int32_t pageNum;
+    int32_t offset;
+    int32_t dataLength;
+} WAL_Record;
+
+// a change of a transaction, kept until it ends in case it is rolled back
+typedef struct WAL_Change {
+    int pageNum;
+    int offset;
+    int length;
+    char *before;
+    char *after;
+} WAL_Change;
+
+struct WAL_Txn {
+    uint64_t id;
+    // the transaction's first record (0 while it has not logged anything)
+    WAL_LSN firstLSN;
+    WAL_Change *changes;
+    int numChanges;
+    int capacity;
+    // links the log's open transactions
+    WAL_Txn *next;
+};
+
+struct WAL_Log {
+    int fd;
+    char *fileName;
+    // kept in memory only (see walOpenTemporary)
+    bool temporary;
+    pthread_mutex_t lock;
+    // signalled whenever a flush finished
+    pthread_cond_t flushed;
+    // records not written yet; a flush swaps `buffer` with `flushBuffer` and writes
+    // the latter, so records can be appended while it is busy
+    char *buffer;
+    size_t bufferSize;
+    size_t bufferCapacity;
+    char *flushBuffer;
+    size_t flushCapacity;
+    WAL_LSN baseLSN;
+    WAL_LSN redoLSN;
+    // the LSN of the next record, everything before durableLSN is written and synced
+    WAL_LSN endLSN;
+    WAL_LSN durableLSN;
+    // one thread flushes on behalf of every committer waiting (group commit)
+    bool flushing;
+    bool failed;
+    int groupDelay;
+    // the end of the last checkpoint (see walSizeSinceCheckpoint)
+    WAL_LSN checkpointLSN;
+    uint64_t nextTxnId;
+    WAL_Txn *openTxns;
+};
+
+/* Helpers */
+
+static uint32_t crcTable[256];
+static pthread_once_t crcOnce = PTHREAD_ONCE_INIT;
+
+// helper to fill the CRC-32 lookup table
+void _initCrcTable(void)
+{
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320u : crc >> 1;
+        }
+        crcTable[i] = crc;
+    }
+}
+
+// helper to compute the checksum of a record (everything after the checksum field)
+uint32_t _recordChecksum(const WAL_Record *record)
+{
+    pthread_once(&crcOnce, _initCrcTable);
+    const unsigned char *bytes = (const unsigned char *)record + offsetof(WAL_Record, txnId);
+    size_t length = record->length - offsetof(WAL_Record, txnId);
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < length; i++) {
+        crc = crcTable[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+// helper to get the length of a record with `dataLength` changed bytes (padded so
+// every record starts 8-byte aligned)
+size_t _recordLength(int dataLength)
+{
+    return (sizeof(WAL_Record) + 2 * (size_t)dataLength + 7) & ~(size_t)7;
+}
+
+// helper to get the length of a valid record at the start of `data`, 0 if there is
+// none (the end of the log, or a record torn by a crash)
+size_t _validRecord(const char *data, size_t available)
+{
+    if (available < sizeof(WAL_Record)) return 0;
+    const WAL_Record *record = (const WAL_Record *)data;
+    if (record->length < sizeof(WAL_Record) || record->length > available) return 0;
+    if (record->type == WAL_WRITE && (record->dataLength < 0 || record->length != _recordLength(record->dataLength))) return 0;
+    if (_recordChecksum(record) != record->checksum) return 0;
+    return record->length;
+}
+
+// helper to write a whole buffer, retrying on EINTR and short writes
+RC _writeLog(int fd, const char *data, size_t length, off_t offset)
+{
+    size_t done = 0;
+    while (done < length) {
+        ssize_t n = pwrite(fd, data + done, length - done, offset + done);
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            return RC_WRITE_FAILED;
+        }
+        done += n;
+    }
+    return RC_OK;
+}
+
+// helper to make a rename or creation in the log's directory durable
+void _syncLogDirectory(const char *path)
+{
+    char *dir = strdup(path);
+    if (dir == NULL) return;
+
+    char *slash = strrchr(dir, '/');
+    const char *name = (slash == NULL) ? "." : (slash == dir) ? "/" : dir;
+    if (slash != NULL && slash != dir) *slash = '\0';
+
+    int fd = open(name, O_RDONLY | O_DIRECTORY);
+    if (fd != -1) {
+        fsync(fd);
+        close(fd);
+    }
+    free(dir);
+}
+
+// helper to write and sync a log header
+RC _writeLogHeader(int fd, WAL_LSN baseLSN, WAL_LSN redoLSN)
+{
+    char block[WAL_HEADER_SIZE];
+    memset(block, 0, sizeof(block));
+    WAL_FileHeader *header = (WAL_FileHeader *)block;
+    memcpy(header->magic, WAL_MAGIC, sizeof(header->magic));
+    header->version = WAL_VERSION;
+    header->baseLSN = baseLSN;
+    header->redoLSN = redoLSN;
+
+    if (_writeLog(fd, block, sizeof(block), 0) != RC_OK) return RC_WRITE_FAILED;
+    if (fdatasync(fd) != 0) return RC_SYNC_FAILED;
+    return RC_OK;
+}
+
+// helper to append a record to the log buffer and return its LSN in *lsn
+// NOTE the caller holds the log lock
+RC _appendRecord(WAL_Log *log, uint64_t txnId, WAL_RecordType type, int pageNum, int offset,
+                 const void *before, const void *after, int length, WAL_LSN *lsn)
+{
+    size_t recordLength = _recordLength(length);
+    if (log->failed) return RC_WRITE_FAILED;
+
+    if (log->bufferSize + recordLength > log->bufferCapacity) {
+        size_t capacity = log->bufferCapacity * 2;
+        while (capacity < log->bufferSize + recordLength) capacity *= 2;
+        char *buffer = realloc(log->buffer, capacity);
+        if (buffer == NULL) return RC_ALLOCATION_FAILED;
+        log->buffer = buffer;
+        log->bufferCapacity = capacity;
+    }
+
+    char *data = log->buffer + log->bufferSize;
+    WAL_Record *record = (WAL_Record *)data;
+    memset(record, 0, recordLength);
+    record->length = (uint32_t)recordLength;
+    record->txnId = txnId;
+    record->type = (uint16_t)type;
+    record->pageNum = pageNum;
+    record->offset = offset;
+    record->dataLength = length;
+    if (length > 0) {
+        memcpy(data + sizeof(WAL_Record), before, length);
+        memcpy(data + sizeof(WAL_Record) + length, after, length);
+    }
+    record->checksum = _recordChecksum(record);
+
+    *lsn = log->endLSN;
+    log->bufferSize += recordLength;
+    log->endLSN += recordLength;
+    return RC_OK;
+}
+
+// helper to make the log durable up to (not including) `target`: the first thread
+// to get here writes out every buffered record with one write and one sync, the
+// others wait for it and are done if it covered them
+RC _flushLog(WAL_Log *log, WAL_LSN target)
+{
+    RC result = RC_OK;
+    pthread_mutex_lock(&log->lock);
+    if (target > log->endLSN) target = log->endLSN;
+
+    while (log->durableLSN < target && result == RC_OK) {
+        if (log->failed) {
+            result = RC_WRITE_FAILED;
+            break;
+        }
+        if (log->flushing) {
+            pthread_cond_wait(&log->flushed, &log->lock);
+            continue;
+        }
+
+        log->flushing = true;
+        if (log->groupDelay > 0) {
+            // give the other committers a moment to join this flush
+            pthread_mutex_unlock(&log->lock);
+            usleep(log->groupDelay);
+            pthread_mutex_lock(&log->lock);
+        }
+
+        char *data = log->buffer;
+        size_t size = log->bufferSize;
+        size_t capacity = log->bufferCapacity;
+        WAL_LSN from = log->durableLSN;
+        WAL_LSN upto = log->endLSN;
+        log->buffer = log->flushBuffer;
+        log->bufferCapacity = log->flushCapacity;
+        log->bufferSize = 0;
+        pthread_mutex_unlock(&log->lock);
+
+        result = _writeLog(log->fd, data, size, WAL_HEADER_SIZE + (off_t)(from - log->baseLSN));
+        if (result == RC_OK && fdatasync(log->fd) != 0) result = RC_SYNC_FAILED;
+
+        pthread_mutex_lock(&log->lock);
+        log->flushBuffer = data;
+        log->flushCapacity = capacity;
+        if (result == RC_OK) log->durableLSN = upto;
+        else log->failed = true;  // the records are gone, later commits must not succeed
+        log->flushing = false;
+        pthread_cond_broadcast(&log->flushed);
+    }
+    pthread_mutex_unlock(&log->lock);
+    return result;
+}
+
+// helper to free a transaction
+void _freeTxn(WAL_Txn *txn)
+{
+    for (int i = 0; i < txn->numChanges; i++) {
+        free(txn->changes[i].before);
+    }
+    free(txn->changes);
+    free(txn);
+}
+
+// helper to take a transaction off the open list
+// NOTE the caller holds the log lock
+void _unlinkTxn(WAL_Log *log, WAL_Txn *txn)
+{
+    WAL_Txn **link = &log->openTxns;
+    while (*link != NULL && *link != txn) link = &(*link)->next;
+    if (*link != NULL) *link = txn->next;
+}
+
+// helper to remember a change of a transaction (before and after image in one block)
+RC _addChange(WAL_Txn *txn, int pageNum, int offset, const void *before, const void *after, int length)
+{
+    if (txn->numChanges == txn->capacity) {
+        int capacity = txn->capacity == 0 ? 8 : txn->capacity * 2;
+        WAL_Change *changes = realloc(txn->changes, sizeof(WAL_Change) * capacity);
+        if (changes == NULL) return RC_ALLOCATION_FAILED;
+        txn->changes = changes;
+        txn->capacity = capacity;
+    }
+
+    char *images = malloc(2 * (size_t)length + 1);
+    if (images == NULL) return RC_ALLOCATION_FAILED;
+    memcpy(images, before, length);
+    memcpy(images + length, after, length);
+
+    WAL_Change *change = &txn->changes[txn->numChanges++];
+    change->pageNum = pageNum;
+    change->offset = offset;
+    change->length = length;
+    change->before = images;
+    change->after = images + length;
+    return RC_OK;
+}
+
+// helper to undo a transaction's changes, newest first; each undo is logged like any
+// other change (so a crash during the rollback is rolled back further by recovery)
+// and the transaction ends with an abort record
+RC _rollback(WAL_Log *log, WAL_Txn *txn, WAL_Apply apply, void *applyData)
+{
+    RC result = RC_OK;
+    WAL_LSN lsn;
+    if (txn->numChanges == 0) return RC_OK;
+
+    for (int i = txn->numChanges - 1; i >= 0 && result == RC_OK; i--) {
+        WAL_Change *change = &txn->changes[i];
+        pthread_mutex_lock(&log->lock);
+        result = _appendRecord(log, txn->id, WAL_WRITE, change->pageNum, change->offset,
+                               change->after, change->before, change->length, &lsn);
+        pthread_mutex_unlock(&log->lock);
+        if (result == RC_OK) {
+            result = apply(applyData, change->pageNum, change->offset, change->before, change->length, lsn);
+        }
+    }
+    if (result != RC_OK) return result;
+
+    pthread_mutex_lock(&log->lock);
+    result = _appendRecord(log, txn->id, WAL_ABORT, 0, 0, NULL, NULL, 0, &lsn);
+    pthread_mutex_unlock(&log->lock);
+    return result;
+}
+
+// helper to read the log from `from` to its end into a new buffer
+RC _readLog(WAL_Log *log, WAL_LSN from, char **data, size_t *size)
+{
+    off_t start = WAL_HEADER_SIZE + (off_t)(from - log->baseLSN);
+    off_t end = lseek(log->fd, 0, SEEK_END);
+    if (end == -1) return RC_READ_FAILED;
+
+    *size = end > start ? (size_t)(end - start) : 0;
+    *data = malloc(*size + 1);
+    if (*data == NULL) return RC_ALLOCATION_FAILED;
+
+    size_t done = 0;
+    while (done < *size) {
+        ssize_t n = pread(log->fd, *data + done, *size - done, start + done);
+        if (n == -1 && errno == EINTR) continue;
+        if (n <= 0) break;
+        done += n;
+    }
+    *size = done;
+    return RC_OK;
+}
+
+/* Opening and closing */
+
+/**
+ * Creates an empty log, replacing any log of that name.
+ *
+ * @param fileName The name of the log file.
+ * @return Result code indicating success or failure.
+ */
+RC walCreate(char *fileName)
+{
+    int fd = open(fileName, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) return RC_FILE_NOT_FOUND;
+
+    RC result = _writeLogHeader(fd, WAL_HEADER_SIZE, WAL_HEADER_SIZE);
+    close(fd);
+    if (result == RC_OK) _syncLogDirectory(fileName);
+    return result;
+}
+
+// shared body of walOpen / walOpenTemporary, taking over fd
+RC _openLog(int fd, char *fileName, bool temporary, WAL_Log **log)
+{
+    WAL_FileHeader header;
+    if (pread(fd, &header, sizeof(header), 0) != sizeof(header)
+        || memcmp(header.magic, WAL_MAGIC, sizeof(header.magic)) != 0
+        || header.version != WAL_VERSION || header.redoLSN < header.baseLSN)
+    {
+        close(fd);
+        return RC_READ_FAILED;  // not a log (or one of another version)
+    }
+
+    WAL_Log *opened = (WAL_Log *)calloc(1, sizeof(WAL_Log));
+    if (opened == NULL) {
+        close(fd);
+        return RC_ALLOCATION_FAILED;
+    }
+    opened->fd = fd;
+    opened->fileName = strdup(fileName);
+    opened->temporary = temporary;
+    opened->bufferCapacity = opened->flushCapacity = 64 * 1024;
+    opened->buffer = malloc(opened->bufferCapacity);
+    opened->flushBuffer = malloc(opened->flushCapacity);
+    opened->baseLSN = header.baseLSN;
+    opened->redoLSN = header.redoLSN;
+    opened->nextTxnId = 1;
+    pthread_mutex_init(&opened->lock, NULL);
+    pthread_cond_init(&opened->flushed, NULL);
+
+    // find the end of the log (and the transaction ids in use) from the redo point
+    char *data = NULL;
+    size_t size = 0;
+    RC result = (opened->fileName == NULL || opened->buffer == NULL || opened->flushBuffer == NULL)
+                ? RC_ALLOCATION_FAILED : _readLog(opened, opened->redoLSN, &data, &size);
+    if (result != RC_OK) {
+        walClose(opened);
+        return result;
+    }
+
+    size_t position = 0, length;
+    while ((length = _validRecord(data + position, size - position)) > 0) {
+        WAL_Record *record = (WAL_Record *)(data + position);
+        if (record->txnId >= opened->nextTxnId) opened->nextTxnId = record->txnId + 1;
+        position += length;
+    }
+    free(data);
+
+    opened->endLSN = opened->durableLSN = opened->checkpointLSN = opened->redoLSN + position;
+    if (ftruncate(fd, WAL_HEADER_SIZE + (off_t)(opened->endLSN - opened->baseLSN)) != 0) {
+        walClose(opened);
+        return RC_WRITE_FAILED;
+    }
+
+    *log = opened;
+    return RC_OK;
+}
+
+/**
+ * Opens a log created with walCreate.
+ *
+ * The log ends after its last complete record: a record torn by a crash is cut off.
+ * Changes the log holds but the pages may not are brought back with walRecover.
+ *
+ * @param fileName The name of the log file.
+ * @param log Receives the open log.
+ * @return Result code indicating success or failure.
+ */
+RC walOpen(char *fileName, WAL_Log **log)
+{
+    int fd = open(fileName, O_RDWR);
+    if (fd == -1) return RC_FILE_NOT_FOUND;
+    return _openLog(fd, fileName, false, log);
+}
+
+/**
+ * Opens an empty log that is kept in memory and gone once closed.
+ *
+ * For page files that do not outlive the process (see SM_MEMORY_PREFIX): there is
+ * nothing to recover, but failed transactions are still rolled back from it.
+ *
+ * @param name A name for the log (only shown by the kernel, nothing is created under it).
+ * @param log Receives the open log.
+ * @return Result code indicating success or failure.
+ */
+RC walOpenTemporary(char *name, WAL_Log **log)
+{
+    int fd = memfd_create(name, 0);
+    if (fd == -1) return RC_FILE_NOT_FOUND;
+
+    RC result = _writeLogHeader(fd, WAL_HEADER_SIZE, WAL_HEADER_SIZE);
+    if (result != RC_OK) {
+        close(fd);
+        return result;
+    }
+    return _openLog(fd, name, true, log);
+}
+
+/**
+ * Writes out the records still buffered and closes the log.
+ *
+ * Transactions still open are dropped; recovery rolls them back.
+ *
+ * @param log The log to close.
+ * @return Result code indicating success or failure.
+ */
+RC walClose(WAL_Log *log)
+{
+    if (log == NULL) return RC_FILE_HANDLE_NOT_INIT;
+
+    RC result = RC_OK;
+    if (log->buffer != NULL && log->flushBuffer != NULL) {
+        result = _flushLog(log, log->endLSN);
+    }
+
+    while (log->openTxns != NULL) {
+        WAL_Txn *txn = log->openTxns;
+        log->openTxns = txn->next;
+        _freeTxn(txn);
+    }
+    close(log->fd);
+    pthread_mutex_destroy(&log->lock);
+    pthread_cond_destroy(&log->flushed);
+    free(log->buffer);
+    free(log->flushBuffer);
+    free(log->fileName);
+    free(log);
+    return result;
+}
+
+/* Transactions */
+
+/**
+ * Starts a transaction.
+ *
+ * @param log The log.
+ * @param txn Receives the transaction, ended with walCommit or walAbort.
+ * @return Result code indicating success or failure.
+ */
+RC walBegin(WAL_Log *log, WAL_Txn **txn)
+{
+    WAL_Txn *started = (WAL_Txn *)calloc(1, sizeof(WAL_Txn));
+    if (started == NULL) return RC_ALLOCATION_FAILED;
+
+    pthread_mutex_lock(&log->lock);
+    started->id = log->nextTxnId++;
+    started->next = log->openTxns;
+    log->openTxns = started;
+    pthread_mutex_unlock(&log->lock);
+
+    *txn = started;
+    return RC_OK;
+}
+
+/**
+ * Logs a change to a page before it is made.
+ *
+ * The page must not be written to the page file before the log is durable up to
+ * the record (walFlush with the returned LSN); the buffer manager does this for
+ * pages marked with markDirtyLSN.
+ *
+ * @param log The log.
+ * @param txn The transaction making the change.
+ * @param pageNum The page changed.
+ * @param offset Where in the page the change starts.
+ * @param before The bytes there now.
+ * @param after The bytes replacing them.
+ * @param length The number of bytes changed.
+ * @param lsn Receives the LSN of the record.
+ * @return Result code indicating success or failure.
+ */
+RC walWrite(WAL_Log *log, WAL_Txn *txn, int pageNum, int offset, const void *before, const void *after, int length, WAL_LSN *lsn)
+{
+    RC result = _addChange(txn, pageNum, offset, before, after, length);
+    if (result != RC_OK) return result;
+
+    pthread_mutex_lock(&log->lock);
+    result = _appendRecord(log, txn->id, WAL_WRITE, pageNum, offset, before, after, length, lsn);
+    if (result == RC_OK && txn->firstLSN == 0) txn->firstLSN = *lsn;
+    pthread_mutex_unlock(&log->lock);
+    return result;
+}
+
+/**
+ * Commits a transaction: its changes are durable once this returns.
+ *
+ * The commit costs one sequential append to the log. Commits arriving while the log
+ * is being synced share the next sync (see walSetGroupCommit).
+ *
+ * @param log The log.
+ * @param txn The transaction, freed by this call.
+ * @return Result code indicating success or failure.
+ */
+RC walCommit(WAL_Log *log, WAL_Txn *txn)
+{
+    RC result = RC_OK;
+    WAL_LSN lsn = 0;
+
+    pthread_mutex_lock(&log->lock);
+    _unlinkTxn(log, txn);
+    // a transaction that changed nothing has nothing to make durable
+    if (txn->numChanges > 0) {
+        result = _appendRecord(log, txn->id, WAL_COMMIT, 0, 0, NULL, NULL, 0, &lsn);
+    }
+    pthread_mutex_unlock(&log->lock);
+
+    if (result == RC_OK && lsn != 0) result = _flushLog(log, lsn + sizeof(WAL_Record));
+    _freeTxn(txn);
+    return result;
+}
+
+/**
+ * Rolls a transaction back: its changes are undone, newest first, through `apply`.
+ *
+ * @param log The log.
+ * @param txn The transaction, freed by this call.
+ * @param apply Puts a page's old bytes back (and marks the page with the LSN given).
+ * @param applyData Passed on to apply.
+ * @return Result code indicating success or failure.
+ */
+RC walAbort(WAL_Log *log, WAL_Txn *txn, WAL_Apply apply, void *applyData)
+{
+    RC result = _rollback(log, txn, apply, applyData);
+
+    pthread_mutex_lock(&log->lock);
+    _unlinkTxn(log, txn);
+    pthread_mutex_unlock(&log->lock);
+    _freeTxn(txn);
+    return result;
+}
+
+/* Durability, checkpoints and recovery */
+
+/**
+ * Makes the log durable up to and including the record at `lsn`.
+ *
+ * @param log The log.
+ * @param lsn The LSN of a record.
+ * @return Result code indicating success or failure.
+ */
+RC walFlush(WAL_Log *log, WAL_LSN lsn)
+{
+    return _flushLog(log, lsn + 1);
+}
+
+/**
+ * Sets how long the thread syncing the log waits for more commits to join the sync.
+ *
+ * Commits that arrive while a sync is running always share the next one; a delay
+ * makes the groups larger when many threads commit, at the cost of latency.
+ *
+ * @param log The log.
+ * @param delayMicros The delay in microseconds (0, the default, for none).
+ */
+void walSetGroupCommit(WAL_Log *log, int delayMicros)
+{
+    pthread_mutex_lock(&log->lock);
+    log->groupDelay = delayMicros < 0 ? 0 : delayMicros;
+    pthread_mutex_unlock(&log->lock);
+}
+
+/**
+ * Takes a fuzzy checkpoint: no page is written, the checkpoint only records where
+ * recovery has to start from now on.
+ *
+ * That is the oldest change not yet on disk in the page file, given by the caller
+ * (the oldest recLSN of the dirty pages), or the first record of a transaction
+ * still open if that is older. The log before that point is no longer needed and
+ * is cut off once it grew large enough.
+ *
+ * @param log The log.
+ * @param redoLSN The oldest change not durable in the page file, 0 if there is none.
+ * @return Result code indicating success or failure.
+ */
+RC walCheckpoint(WAL_Log *log, WAL_LSN redoLSN)
+{
+    WAL_LSN lsn;
+
+    pthread_mutex_lock(&log->lock);
+    RC result = _appendRecord(log, 0, WAL_CHECKPOINT, 0, 0, NULL, NULL, 0, &lsn);
+    WAL_LSN redo = (redoLSN == 0 || redoLSN > log->endLSN) ? log->endLSN : redoLSN;
+    for (WAL_Txn *txn = log->openTxns; txn != NULL; txn = txn->next) {
+        if (txn->firstLSN != 0 && txn->firstLSN < redo) redo = txn->firstLSN;
+    }
+    pthread_mutex_unlock(&log->lock);
+    if (result != RC_OK) return result;
+
+    result = _flushLog(log, lsn + sizeof(WAL_Record));
+    if (result != RC_OK) return result;
+
+    // take over flushing while the header is rewritten (or the file replaced)
+    pthread_mutex_lock(&log->lock);
+    while (log->flushing) pthread_cond_wait(&log->flushed, &log->lock);
+    log->flushing = true;
+    if (redo > log->durableLSN) redo = log->durableLSN;
+    WAL_LSN durable = log->durableLSN;
+    pthread_mutex_unlock(&log->lock);
+
+    WAL_LSN dead = redo - log->baseLSN;
+    WAL_LSN live = durable - redo;
+    if (dead >= WAL_COMPACT_BYTES && dead >= live) {
+        // copy what is still needed to a new file that starts at the redo point
+        size_t nameLength = strlen(log->fileName);
+        char *tempName = malloc(nameLength + 5);
+        char *data = NULL;
+        size_t size = 0;
+        int fd = -1;
+        result = RC_ALLOCATION_FAILED;
+        if (tempName != NULL) {
+            memcpy(tempName, log->fileName, nameLength);
+            memcpy(tempName + nameLength, ".tmp", 5);
+            result = _readLog(log, redo, &data, &size);
+        }
+        if (result == RC_OK) {
+            if (size > live) size = live;
+            fd = log->temporary ? memfd_create(log->fileName, 0) : open(tempName, O_RDWR | O_CREAT | O_TRUNC, 0644);
+            result = (fd == -1) ? RC_FILE_NOT_FOUND : _writeLog(fd, data, size, WAL_HEADER_SIZE);
+        }
+        if (result == RC_OK) result = _writeLogHeader(fd, redo, redo);
+        if (result == RC_OK && !log->temporary && rename(tempName, log->fileName) != 0) result = RC_WRITE_FAILED;
+
+        if (result == RC_OK) {
+            if (!log->temporary) _syncLogDirectory(log->fileName);
+            close(log->fd);
+            log->fd = fd;
+            log->baseLSN = redo;
+            log->redoLSN = redo;
+        } else {
+            if (fd != -1) close(fd);
+            if (tempName != NULL && !log->temporary) unlink(tempName);
+        }
+        free(data);
+        free(tempName);
+    } else {
+        result = _writeLogHeader(log->fd, log->baseLSN, redo);
+        if (result == RC_OK) log->redoLSN = redo;
+    }
+
+    pthread_mutex_lock(&log->lock);
+    log->checkpointLSN = log->endLSN;
+    log->flushing = false;
+    pthread_cond_broadcast(&log->flushed);
+    pthread_mutex_unlock(&log->lock);
+    return result;
+}
+
+/**
+ * The number of log bytes appended since the last checkpoint.
+ *
+ * @param log The log.
+ * @return The byte count.
+ */
+uint64_t walSizeSinceCheckpoint(WAL_Log *log)
+{
+    pthread_mutex_lock(&log->lock);
+    uint64_t size = log->endLSN - log->checkpointLSN;
+    pthread_mutex_unlock(&log->lock);
+    return size;
+}
+
+/**
+ * Repairs the pages after a crash.
+ *
+ * Every change logged since the last checkpoint's redo point is applied again, in
+ * log order, whether its transaction committed or not; the transactions that never
+ * ended are then rolled back like walAbort does. Afterwards the pages hold exactly
+ * the committed changes. Applying a change twice does no harm, so a crash during
+ * recovery is repaired by recovering again.
+ *
+ * @param log A log just opened with walOpen.
+ * @param apply Writes bytes into a page (and marks the page with the LSN given).
+ * @param applyData Passed on to apply.
+ * @return Result code indicating success or failure.
+ */
+RC walRecover(WAL_Log *log, WAL_Apply apply, void *applyData)
+{
+    char *data;
+    size_t size;
+    RC result = _readLog(log, log->redoLSN, &data, &size);
+    if (result != RC_OK) return result;
+
+    // transactions met in the log that have not ended (yet)
+    WAL_Txn *losers = NULL;
+    size_t position = 0, length;
+    while (result == RC_OK && (length = _validRecord(data + position, size - position)) > 0) {
+        WAL_Record *record = (WAL_Record *)(data + position);
+        WAL_LSN lsn = log->redoLSN + position;
+        position += length;
+        if (record->type == WAL_CHECKPOINT) continue;
+
+        WAL_Txn **link = &losers;
+        while (*link != NULL && (*link)->id != record->txnId) link = &(*link)->next;
+        WAL_Txn *txn = *link;
+
+        switch (record->type) {
+            case WAL_WRITE:
+            {
+                const char *before = (const char *)record + sizeof(WAL_Record);
+                const char *after = before + record->dataLength;
+                if (txn == NULL) {
+                    txn = (WAL_Txn *)calloc(1, sizeof(WAL_Txn));
+                    if (txn == NULL) {
+                        result = RC_ALLOCATION_FAILED;
+                        break;
+                    }
+                    txn->id = record->txnId;
+                    txn->firstLSN = lsn;
+                    txn->next = losers;
+                    losers = txn;
+                }
+                result = _addChange(txn, record->pageNum, record->offset, before, after, record->dataLength);
+                if (result == RC_OK) {
+                    result = apply(applyData, record->pageNum, record->offset, after, record->dataLength, lsn);
+                }
+                break;
+            }
+            default:
+                // committed or rolled back: nothing left to do for it
+                if (txn != NULL) {
+                    *link = txn->next;
+                    _freeTxn(txn);
+                }
+                break;
+        }
+    }
+    free(data);
+
+    // roll back what never ended, the youngest transaction first
+    while (losers != NULL) {
+        WAL_Txn *txn = losers;
+        losers = txn->next;
+        if (result == RC_OK) result = _rollback(log, txn, apply, applyData);
+        _freeTxn(txn);
+    }
+
+    if (result == RC_OK) result = _flushLog(log, log->endLSN);
+    return result;
+}
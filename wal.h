@@ -0,0 +1,49 @@
+#ifndef WAL_H
+#define WAL_H
+
+#include "dberror.h"
+#include "dt.h"
+
+#include <stdint.h>
+
+// a write-ahead log kept next to a page file: changes to pages are appended to the
+// log before the pages are changed, so the pages themselves can be written back
+// whenever the buffer manager likes and a crash is repaired from the log
+typedef struct WAL_Log WAL_Log;
+
+// a group of changes that take effect together or not at all (see walBegin)
+typedef struct WAL_Txn WAL_Txn;
+
+// log sequence number: the position of a record in the log (0 is no record)
+typedef uint64_t WAL_LSN;
+
+// applies `length` bytes of `data` at `offset` of page `pageNum`; the change was
+// logged at `lsn` (used by recovery and rollback)
+typedef RC (*WAL_Apply)(void *applyData, int pageNum, int offset, const void *data, int length, WAL_LSN lsn);
+
+/* log bytes after which the record manager takes a checkpoint */
+#define WAL_CHECKPOINT_BYTES (4 * 1024 * 1024)
+
+/* the dead log before the redo point is only cut off once it is at least this large */
+#define WAL_COMPACT_BYTES (64 * 1024)
+
+/* opening and closing */
+extern RC walCreate (char *fileName);
+extern RC walOpen (char *fileName, WAL_Log **log);
+extern RC walOpenTemporary (char *name, WAL_Log **log);
+extern RC walClose (WAL_Log *log);
+
+/* transactions */
+extern RC walBegin (WAL_Log *log, WAL_Txn **txn);
+extern RC walWrite (WAL_Log *log, WAL_Txn *txn, int pageNum, int offset, const void *before, const void *after, int length, WAL_LSN *lsn);
+extern RC walCommit (WAL_Log *log, WAL_Txn *txn);
+extern RC walAbort (WAL_Log *log, WAL_Txn *txn, WAL_Apply apply, void *applyData);
+
+/* durability, checkpoints and recovery */
+extern RC walFlush (WAL_Log *log, WAL_LSN lsn);
+extern void walSetGroupCommit (WAL_Log *log, int delayMicros);
+extern RC walCheckpoint (WAL_Log *log, WAL_LSN redoLSN);
+extern uint64_t walSizeSinceCheckpoint (WAL_Log *log);
+extern RC walRecover (WAL_Log *log, WAL_Apply apply, void *applyData);
+
+#endif